@@ -29,6 +29,11 @@
   .data.integer = i                                                           \
   })
 
+#define FLOAT_OBJ(f) ((Object) {                                              \
+  .type = kObjectTypeFloat,                                                   \
+  .data.floating = f                                                          \
+  })
+
 #define STRING_OBJ(s) ((Object) {                                             \
   .type = kObjectTypeString,                                                  \
   .data.string = s                                                            \
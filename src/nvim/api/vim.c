@@ -25,6 +25,8 @@
 #include "nvim/syntax.h"
 #include "nvim/getchar.h"
 #include "nvim/os/input.h"
+#include "nvim/os/wstream.h"
+#include "nvim/regexp.h"
 
 #define LINE_BUFFER_SIZE 4096
 
@@ -104,6 +106,21 @@ Integer vim_input(String keys)
   return (Integer)input_enqueue(keys);
 }
 
+/// Pastes text like a bracketed paste of the terminal. Text received in
+/// Insert mode is inserted in bulk, without mappings or abbreviations. In
+/// Normal mode Insert mode is started first.
+///
+/// @param data The pasted text, lines are separated by CR, NL or CRLF
+/// @param continued true when `data` continues the text of the previous call,
+///        e.g. when a large paste is received in several chunks
+void vim_paste(String data, Boolean continued)
+{
+  if (!continued) {
+    input_paste_start();
+  }
+  input_paste(data);
+}
+
 /// Replaces any terminal codes with the internal representation
 ///
 /// @see replace_termcodes
@@ -557,6 +574,68 @@ Dictionary vim_get_color_map(void)
   return colors;
 }
 
+/// Returns the counters of the cache of compiled regexps, to see how well it
+/// works for a workload.
+///
+/// @return Dictionary with "hits", "misses" and "evictions"
+Dictionary vim_get_regexp_cache_stats(void)
+{
+  Dictionary rv = ARRAY_DICT_INIT;
+  regcache_stats_T stats = regcache_get_stats();
+
+  PUT(rv, "hits", INTEGER_OBJ((Integer)stats.hits));
+  PUT(rv, "misses", INTEGER_OBJ((Integer)stats.misses));
+  PUT(rv, "evictions", INTEGER_OBJ((Integer)stats.evictions));
+  return rv;
+}
+
+/// Returns the profiles of the regexp patterns compiled or executed while
+/// ":regtime on" was active, the slowest first. Times are in seconds.
+///
+/// @return Array of Dictionaries with "pattern", "count", "match", "total",
+///         "slowest", "compile", "compile_count" and "fallbacks"
+///         "fallbacks" counts the tries that the literal or DFA matcher
+///         passed on to the NFA engine
+Array vim_get_regexp_profile(void)
+{
+  Array rv = ARRAY_DICT_INIT;
+  int count;
+  regprof_T **list = regprof_list(&count);
+
+  for (int i = 0; i < count; i++) {
+    regprof_T *rp = list[i];
+    Dictionary d = ARRAY_DICT_INIT;
+
+    PUT(d, "pattern", STRING_OBJ(cstr_to_string((char *)rp->pattern)));
+    PUT(d, "count", INTEGER_OBJ(rp->count));
+    PUT(d, "match", INTEGER_OBJ(rp->match));
+    PUT(d, "total", FLOAT_OBJ((Float)rp->total / 1e9));
+    PUT(d, "slowest", FLOAT_OBJ((Float)rp->slowest / 1e9));
+    PUT(d, "compile", FLOAT_OBJ((Float)rp->compile_time / 1e9));
+    PUT(d, "compile_count", INTEGER_OBJ(rp->compile_count));
+    PUT(d, "fallbacks", INTEGER_OBJ(rp->fallbacks));
+    ADD(rv, DICTIONARY_OBJ(d));
+  }
+  free(list);
+  return rv;
+}
+
+/// Returns the counters of the coalescing of stream writes, to see how many
+/// writes are saved for a workload.
+///
+/// @return Dictionary with "buffers" (buffers written), "writes" (`uv_write`
+///         calls used for them) and "saved" (their difference)
+Dictionary vim_get_wstream_stats(void)
+{
+  Dictionary rv = ARRAY_DICT_INIT;
+  uint64_t buffers, writes;
+
+  wstream_get_stats(&buffers, &writes);
+  PUT(rv, "buffers", INTEGER_OBJ((Integer)buffers));
+  PUT(rv, "writes", INTEGER_OBJ((Integer)writes));
+  PUT(rv, "saved", INTEGER_OBJ((Integer)(buffers - writes)));
+  return rv;
+}
 
 Array vim_get_api_info(uint64_t channel_id)
 {
@@ -513,6 +513,7 @@ void buf_freeall(buf_T *buf, int flags)
   if (buf == curbuf && !is_curbuf)
     return;
   diff_buf_delete(buf);             /* Can't use 'diff' for unloaded buffer. */
+  syn_state_save(buf);              /* remember syntax for next time */
   /* Remove any ownsyntax, unless exiting. */
   if (firstwin != NULL && curwin->w_buffer == buf)
     reset_synblock(curwin);
@@ -567,6 +568,7 @@ free_buffer_stuff (
     clear_wininfo(buf);                 /* including window-local options */
     free_buf_options(buf, TRUE);
     ga_clear(&buf->b_s.b_langp);
+    spell_cache_clear(&buf->b_s);
   }
   vars_clear(&buf->b_vars->dv_hashtab);   /* free all internal variables */
   hash_init(&buf->b_vars->dv_hashtab);
@@ -576,6 +578,7 @@ free_buffer_stuff (
   map_clear_int(buf, MAP_ALL_MODES, TRUE, TRUE);     /* clear local abbrevs */
   free(buf->b_start_fenc);
   buf->b_start_fenc = NULL;
+  hlcache_clear(buf);                   /* forget 'hlsearch' matches */
 }
 
 /*
@@ -390,10 +390,18 @@ typedef struct {
 typedef struct {
   hashtab_T b_keywtab;                  /* syntax keywords hash table */
   hashtab_T b_keywtab_ic;               /* idem, ignore case */
+  uint32_t b_keywmask[256];             /* bit N - 1 set when a keyword in
+                                           b_keywtab starts with this byte
+                                           and is N bytes long, bit 31 for
+                                           32 bytes or longer */
+  uint32_t b_keywmask_ic[256];          /* idem for ASCII keywords in
+                                           b_keywtab_ic */
   int b_syn_error;                      /* TRUE when error occurred in HL */
   int b_syn_ic;                         /* ignore case for :syn cmds */
   int b_syn_spell;                      /* SYNSPL_ values */
   garray_T b_syn_patterns;              /* table for syntax patterns */
+  synlits_T   *b_syn_lits;              /* literals in b_syn_patterns, built
+                                           when needed */
   garray_T b_syn_clusters;              /* table for syntax clusters */
   int b_spell_cluster_id;               /* @Spell cluster ID or 0 */
   int b_nospell_cluster_id;             /* @NoSpell cluster ID or 0 */
@@ -404,6 +412,7 @@ typedef struct {
   long b_syn_sync_minlines;             /* minimal sync lines offset */
   long b_syn_sync_maxlines;             /* maximal sync lines offset */
   long b_syn_sync_linebreaks;           /* offset for multi-line pattern */
+  long b_syn_sync_statelines;           /* distance between stored states */
   char_u      *b_syn_linecont_pat;      /* line continuation pattern */
   regprog_T   *b_syn_linecont_prog;     /* line continuation program */
   syn_time_T b_syn_linecont_time;
@@ -416,23 +425,32 @@ typedef struct {
    * b_sst_array[] contains the state stack for a number of lines, for the
    * start of that line (col == 0).  This avoids having to recompute the
    * syntax state too often.
-   * b_sst_array[] is allocated to hold the state for all displayed lines,
-   * and states for 1 out of about 20 other lines.
+   * b_sst_array[] holds the state for every line that was parsed, or every
+   * "statelines" lines, sorted on line number.  Lines that start with the
+   * same state share one synstack_T.
    * b_sst_array	pointer to an array of synstate_T
-   * b_sst_len	number of entries in b_sst_array[]
-   * b_sst_first	pointer to first used entry in b_sst_array[] or NULL
-   * b_sst_firstfree	pointer to first free entry in b_sst_array[] or NULL
-   * b_sst_freecount	number of free entries in b_sst_array[]
+   * b_sst_len	number of used entries in b_sst_array[]
+   * b_sst_size	number of allocated entries in b_sst_array[]
+   * b_sst_stacks	hash table with the synstack_T used by b_sst_array[]
+   * b_sst_stacks_size	number of buckets in b_sst_stacks[], a power of two
+   * b_sst_stacks_count	number of synstack_T in b_sst_stacks[]
    * b_sst_check_lnum	entries after this lnum need to be checked for
    *			validity (MAXLNUM means no check needed)
    */
   synstate_T  *b_sst_array;
   int b_sst_len;
-  synstate_T  *b_sst_first;
-  synstate_T  *b_sst_firstfree;
-  int b_sst_freecount;
+  int b_sst_size;
+  synstack_T  **b_sst_stacks;
+  int b_sst_stacks_size;
+  int b_sst_stacks_count;
   linenr_T b_sst_check_lnum;
   uint16_t b_sst_lasttick;      /* last display tick */
+  linenr_T b_sst_pending;       /* when not zero: lines from here on are
+                                   drawn without syntax highlighting until
+                                   syntax_runahead() parsed up to it */
+  bool b_sst_ahead_done;        /* syntax_runahead() parsed all lines ... */
+  int b_sst_ahead_tick;         /* ... for this b_changedtick */
+  bool b_sst_loaded;            /* states from 'synstatedir' were loaded */
 
   /* for spell checking */
   garray_T b_langp;             /* list of pointers to slang_T, see spell.c */
@@ -443,8 +461,42 @@ typedef struct {
   char_u      *b_p_spf;         /* 'spellfile' */
   char_u      *b_p_spl;         /* 'spelllang' */
   int b_cjk;                    /* all CJK letters as OK */
+  struct spellcache_S *b_spell_cache;  /* cached spell_check() results */
 } synblock_T;
 
+/*
+ * Result of vim_regexec_multi() for 'hlsearch' in one line, starting at
+ * column "col".
+ */
+typedef struct {
+  colnr_T col;                  /* column where the search started */
+  long nmatched;                /* return value, zero for no match */
+  lpos_T startpos;              /* start of the match */
+  lpos_T endpos;                /* end of the match */
+} hlmatch_T;
+
+/* The 'hlsearch' results for one line of the buffer. */
+typedef struct {
+  linenr_T lnum;
+  garray_T matches;             /* hlmatch_T items */
+} hlline_T;
+
+/*
+ * Cache of the 'hlsearch' results in a buffer, so that redrawing doesn't
+ * search the same lines again.  Only valid for program "prog" with "ic" and
+ * 'iskeyword' "isk", and as long as "changedtick" is equal to b_changedtick.
+ * Changes made with changed_lines() and changed_bytes() only remove the
+ * changed lines.
+ */
+typedef struct {
+  regprog_T   *prog;            /* program the results are for, a reference
+                                   is kept, NULL when empty */
+  int ic;                       /* ignore-case flag used */
+  char_u      *isk;             /* copy of 'iskeyword' */
+  int changedtick;              /* b_changedtick the results are valid for */
+  garray_T lines;               /* hlline_T items, sorted on lnum */
+} hlcache_T;
+
 
 /*
  * buffer: structure that holds information about one file
@@ -502,6 +554,8 @@ struct file_buffer {
   long b_mod_xlines;            /* number of extra buffer lines inserted;
                                    negative when lines were deleted */
 
+  hlcache_T b_hlcache;          /* 'hlsearch' results, see screen.c */
+
   wininfo_T   *b_wininfo;       /* list of last used info for each window */
 
   long b_mtime;                 /* last change time of original file */
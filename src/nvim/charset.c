@@ -858,6 +858,36 @@ int vim_iswordp_buf(char_u *p, buf_T *buf)
   return GET_CHARTAB(buf, *p) != 0;
 }
 
+/// Get the length of the keyword at "p", using 'iskeyword' of "buf".
+/// The character at "p" is not checked, it is included in the keyword.
+/// ASCII characters are looked up in b_chartab[] without checking for
+/// multi-byte characters, which is what most keywords consist of.
+///
+/// @param p
+/// @param buf
+/// @param[out] ascii  set to false when the keyword contains a non-ASCII
+///                    byte, otherwise true
+///
+/// @return number of bytes in the keyword.
+int vim_keyword_len_buf(char_u *p, buf_T *buf, bool *ascii)
+{
+  char_u *s = p;
+
+  *ascii = *s < 0x80;
+  s += has_mbyte ? (*mb_ptr2len)(s) : 1;
+  for (;;) {
+    while (*s < 0x80 && GET_CHARTAB(buf, *s) != 0) {
+      s++;
+    }
+    if (*s < 0x80 || !vim_iswordp_buf(s, buf)) {
+      break;
+    }
+    *ascii = false;
+    s += has_mbyte ? (*mb_ptr2len)(s) : 1;
+  }
+  return (int)(s - p);
+}
+
 /// return TRUE if 'c' is a valid file-name character
 /// Assume characters above 0x100 are valid (multi-byte).
 ///
@@ -32,7 +32,9 @@
 #include "nvim/getchar.h"
 #include "nvim/indent.h"
 #include "nvim/indent_c.h"
+#include "nvim/inputtrace.h"
 #include "nvim/main.h"
+#include "nvim/mark.h"
 #include "nvim/mbyte.h"
 #include "nvim/memline.h"
 #include "nvim/memory.h"
@@ -567,6 +569,9 @@ edit (
 
     validate_cursor();                  /* may set must_redraw */
 
+    // The previous key, or the command that started Insert mode, is done
+    INPUTTRACE(kTraceCommandEnd, c);
+
     /*
      * Redraw the display when no characters are waiting.
      * Also shows mode, ruler and positions cursor.
@@ -592,6 +597,7 @@ edit (
       c = safe_vgetc();
     } while (c == K_IGNORE);
     event_disable_deferred();
+    INPUTTRACE(kTraceCommandStart, c);
 
     if (c == K_EVENT) {
       c = lastc;
@@ -599,6 +605,12 @@ edit (
       continue;
     }
 
+    if (c == K_PASTE) {
+      c = lastc;
+      ins_paste();
+      continue;
+    }
+
     /* Don't want K_CURSORHOLD for the second key, e.g., after CTRL-V. */
     did_cursorhold = TRUE;
 
@@ -1320,6 +1332,126 @@ static void ins_ctrl_v(void)
   revins_legal++;
 }
 
+/// Handle K_PASTE: insert the text received with a bracketed paste at the
+/// cursor. The text doesn't go through the typeahead buffer, mappings,
+/// abbreviations or auto-indenting, lines are appended in bulk and all of it
+/// is part of the current insert, so it is undone as a single change.
+static void ins_paste(void)
+{
+  // A CRLF split over two chunks was already joined by input_paste()
+  String text = input_paste_take();
+  char_u *p = (char_u *)text.data, *end = p + text.size;
+
+  if (State & REPLACE_FLAG) {
+    // The replaced characters must be kept for BS, insert the text like
+    // typed characters
+    ins_paste_replace(p, end);
+    free(text.data);
+    return;
+  }
+
+  linenr_T lnum = curwin->w_cursor.lnum;
+  colnr_T col = curwin->w_cursor.col;
+  if (p == end || stop_arrow() == FAIL
+      || u_save(lnum - 1, lnum + 1) == FAIL) {
+    free(text.data);
+    return;
+  }
+
+  char_u *oldp = ml_get(lnum);
+  // Text after the cursor, it ends up after the last pasted line
+  char_u *tail = vim_strsave(oldp + col);
+  long nr_lines = 0;
+
+  for (;;) {
+    char_u *eol = p;
+    while (eol < end && *eol != CAR && *eol != NL) {
+      eol++;
+    }
+    size_t len = (size_t)(eol - p);
+    bool first = nr_lines == 0, last = eol == end;
+    size_t prefix_len = first ? (size_t)col : 0;
+    size_t tail_len = last ? STRLEN(tail) : 0;
+    char_u *newp = xmalloc(prefix_len + len + tail_len + 1);
+
+    if (first) {
+      memmove(newp, ml_get(lnum), prefix_len);
+    }
+    // NUL is stored as NL in the buffer
+    for (size_t i = 0; i < len; i++) {
+      newp[prefix_len + i] = p[i] == NUL ? NL : p[i];
+    }
+    memmove(newp + prefix_len + len, tail, tail_len);
+    newp[prefix_len + len + tail_len] = NUL;
+
+    AppendToRedobuffLit(p, (int)len);
+    if (first) {
+      ml_replace(lnum, newp, false);
+    } else {
+      ml_append(lnum + nr_lines - 1, newp, (colnr_T)0, false);
+      free(newp);
+    }
+
+    if (last) {
+      curwin->w_cursor.lnum = lnum + nr_lines;
+      curwin->w_cursor.col = (colnr_T)(prefix_len + len);
+      break;
+    }
+
+    AppendCharToRedobuff(CAR);
+    nr_lines++;
+    p = eol + 1;
+    if (*eol == CAR && p < end && *p == NL) {
+      p++;
+    }
+  }
+
+  if (nr_lines) {
+    mark_adjust(lnum + 1, (linenr_T)MAXLNUM, nr_lines, 0L);
+    changed_lines(lnum, col, lnum + 1, nr_lines);
+  } else {
+    changed_bytes(lnum, col);
+  }
+  curwin->w_set_curswant = true;
+
+  free(tail);
+  free(text.data);
+}
+
+// Inserts pasted text from "p" to "end" in Replace or Virtual Replace mode,
+// one character or line break at a time.
+static void ins_paste_replace(char_u *p, char_u *end)
+{
+  if (p == end || stop_arrow() == FAIL) {
+    return;
+  }
+
+  while (p < end) {
+    if (*p == CAR || *p == NL) {
+      if (*p == CAR && p + 1 < end && p[1] == NL) {
+        p++;
+      }
+      p++;
+      // Pasted text is not checked for abbreviations
+      int save_no_abbr = no_abbr;
+      no_abbr = true;
+      bool failed = ins_eol(CAR);
+      no_abbr = save_no_abbr;
+      if (failed) {
+        return;
+      }
+      continue;
+    }
+
+    int len = *p == NUL ? 1 : MIN((*mb_ptr2len)(p), (int)(end - p));
+    // NUL is stored as NL in the buffer
+    ins_char_bytes(*p == NUL ? (char_u *)"\n" : p, len);
+    AppendToRedobuffLit(p, len);
+    p += len;
+  }
+  curwin->w_set_curswant = true;
+}
+
 /*
  * Put a character directly onto the screen.  It's not stored in a buffer.
  * Used while handling CTRL-K, CTRL-V, etc. in Insert mode.
@@ -19761,8 +19761,14 @@ static inline void push_job_event(Job *job, RStream *rstream, char *type)
   event_data->received = NULL;
   if (rstream) {
     event_data->received = list_alloc();
-    char *ptr = rstream_read_ptr(rstream);
-    size_t count = rstream_pending(rstream);
+    size_t count = rstream_pending(rstream), contiguous;
+    char *ptr = rstream_read_ptr(rstream, &contiguous), *copy = NULL;
+    if (contiguous < count) {
+      // The data wraps around the end of the ring buffer, lines must be
+      // contiguous to be split
+      ptr = copy = xmalloc(count);
+      rbuffer_peek(rstream_buffer(rstream), copy, count);
+    }
     size_t remaining = count;
     size_t off = 0;
 
@@ -19784,6 +19790,7 @@ static inline void push_job_event(Job *job, RStream *rstream, char *type)
     }
     list_append_string(event_data->received, (uint8_t *)ptr, off);
     rbuffer_consumed(rstream_buffer(rstream), count);
+    free(copy);
   }
   event_data->id = job_id(job);
   event_data->name = job_data(job);
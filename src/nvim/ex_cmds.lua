@@ -935,6 +935,11 @@ return {
     flags=bit.bor(RANGE, NOTADR, ZEROR, EXTRA, TRLBAR, NOTRLCOM, USECTRLV, CMDWIN),
     func='ex_menu',
   },
+  {
+    command='inputtrace',
+    flags=bit.bor(NEEDARG, EXTRA, TRLBAR, CMDWIN),
+    func='ex_inputtrace',
+  },
   {
     command='intro',
     flags=bit.bor(TRLBAR, CMDWIN),
@@ -1735,6 +1740,11 @@ return {
     flags=bit.bor(EXTRA, NOTRLCOM, TRLBAR, CMDWIN),
     func='ex_display',
   },
+  {
+    command='regtime',
+    flags=bit.bor(NEEDARG, WORD1, TRLBAR, CMDWIN),
+    func='ex_regtime',
+  },
   {
     command='resize',
     flags=bit.bor(RANGE, NOTADR, TRLBAR, WORD1),
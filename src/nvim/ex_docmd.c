@@ -70,6 +70,7 @@
 #include "nvim/os/input.h"
 #include "nvim/os/time.h"
 #include "nvim/ex_cmds_defs.h"
+#include "nvim/inputtrace.h"
 #include "nvim/mouse.h"
 
 static int quitmore = 0;
@@ -3038,6 +3039,7 @@ set_one_cmd_context (
     xp->xp_pattern = arg;
     break;
   case CMD_syntime:
+  case CMD_regtime:
     xp->xp_context = EXPAND_SYNTIME;
     xp->xp_pattern = arg;
     break;
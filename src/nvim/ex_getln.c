@@ -36,6 +36,7 @@
 #include "nvim/getchar.h"
 #include "nvim/if_cscope.h"
 #include "nvim/indent.h"
+#include "nvim/inputtrace.h"
 #include "nvim/main.h"
 #include "nvim/mbyte.h"
 #include "nvim/memline.h"
@@ -63,6 +64,7 @@
 #include "nvim/ui.h"
 #include "nvim/os/os.h"
 #include "nvim/os/event.h"
+#include "nvim/os/input.h"
 
 /*
  * Variables shared between getcmdline(), redrawcmdline() and others.
@@ -109,6 +111,18 @@ typedef struct hist_entry {
  */
 typedef void *(*user_expand_func_T)(char_u *, int, char_u **, int);
 
+/*
+ * Result of the last search done for 'incsearch'.  When the pattern is only
+ * extended the next search can start at the same match, see
+ * incsearch_extends().
+ */
+typedef struct {
+  char_u      *pat;             /* pattern searched for, NULL if none */
+  int found;                    /* TRUE when it matched */
+  pos_T pos;                    /* start of the match */
+  int changedtick;              /* b_changedtick of the buffer searched */
+} incsearch_T;
+
 static histentry_T *(history[HIST_COUNT]) = {NULL, NULL, NULL, NULL, NULL};
 static int hisidx[HIST_COUNT] = {-1, -1, -1, -1, -1};       /* lastused entry */
 static int hisnum[HIST_COUNT] = {0, 0, 0, 0, 0};
@@ -166,6 +180,7 @@ getcmdline (
   linenr_T old_botline;
   int did_incsearch = FALSE;
   int incsearch_postponed = FALSE;
+  incsearch_T is_prev = { NULL, FALSE, { 0, 0, 0 }, 0 };
   int did_wild_list = FALSE;            /* did wild_list() recently */
   int wim_index = 0;                    /* index in wim_flags[] */
   int res;
@@ -293,6 +308,10 @@ getcmdline (
                                    completion may switch it on. */
     quit_more = FALSE;          /* reset after CTRL-D which had a more-prompt */
 
+    // The previous key, or the command that started the command line, is
+    // done
+    INPUTTRACE(kTraceCommandEnd, 0);
+
     cursorcmd();                /* set the cursor on the right spot */
 
     /* Get a character.  Ignore K_IGNORE, it should not do anything, such
@@ -302,6 +321,7 @@ getcmdline (
       c = safe_vgetc();
     } while (c == K_IGNORE);
     event_disable_deferred();
+    INPUTTRACE(kTraceCommandStart, c);
 
     if (c == K_EVENT) {
       event_process();
@@ -999,6 +1019,29 @@ getcmdline (
       /* Ignore mouse event or ex_window() result. */
       goto cmdline_not_changed;
 
+    case K_PASTE:
+    {
+      // Text pasted in Insert mode that arrived after leaving it.  The first
+      // line is put on the command line, the rest is handled like typed keys,
+      // as it would be without a bracketed paste: the line break executes the
+      // command line.
+      String text = input_paste_take();
+      size_t len = 0;
+      while (len < text.size && text.data[len] != CAR
+             && text.data[len] != NL && text.data[len] != NUL) {
+        len++;
+      }
+      put_on_cmdline((char_u *)text.data, (int)len, TRUE);
+      if (len < text.size) {
+        char_u *keys = paste_to_keys((char_u *)text.data + len,
+                                     text.size - len);
+        (void)ins_typebuf(keys, REMAP_NONE, 0, FALSE, FALSE);
+        free(keys);
+      }
+      free(text.data);
+      goto cmdline_changed;
+    }
+
 
     case K_MIDDLEDRAG:
     case K_MIDDLERELEASE:
@@ -1360,20 +1403,34 @@ cmdline_changed:
       incsearch_postponed = FALSE;
       curwin->w_cursor = old_cursor;        /* start at old position */
 
+      /* When the pattern was only extended every match is a match of the
+       * previous pattern, thus searching can start at the previous match,
+       * and there is no match when the previous pattern didn't have one. */
+      int extends = is_prev.pat != NULL && count <= 1
+                    && is_prev.changedtick == curbuf->b_changedtick
+                    && incsearch_extends(is_prev.pat, ccline.cmdbuff, firstc);
+
       /* If there is no command line, don't do anything */
       if (ccline.cmdlen == 0)
         i = 0;
+      else if (extends && !is_prev.found)
+        i = 0;
       else {
+        int options = SEARCH_KEEP + SEARCH_OPT + SEARCH_NOOF + SEARCH_PEEK;
+
+        if (extends) {
+          curwin->w_cursor = is_prev.pos;
+          options += SEARCH_START;
+        }
         ui_busy_start();
         ui_flush();
         ++emsg_off;            /* So it doesn't beep if bad expr */
         /* Set the time limit to half a second. */
         tm = profile_setlimit(500L);
-        i = do_search(NULL, firstc, ccline.cmdbuff, count,
-            SEARCH_KEEP + SEARCH_OPT + SEARCH_NOOF + SEARCH_PEEK,
-            &tm
-            );
+        i = do_search(NULL, firstc, ccline.cmdbuff, count, options, &tm);
         --emsg_off;
+        free(is_prev.pat);
+        is_prev.pat = NULL;
         /* if interrupted while searching, behave like it failed */
         if (got_int) {
           (void)vpeekc();               /* remove <C-C> from input stream */
@@ -1382,6 +1439,13 @@ cmdline_changed:
         } else if (char_avail())
           /* cancelled searching because a char was typed */
           incsearch_postponed = TRUE;
+        else if (i != 0 || !profile_passed_limit(tm)) {
+          /* Remember a result that wasn't cut short. */
+          is_prev.pat = vim_strsave(ccline.cmdbuff);
+          is_prev.found = i != 0;
+          is_prev.pos = curwin->w_cursor;
+          is_prev.changedtick = curbuf->b_changedtick;
+        }
         ui_busy_stop();
       }
       if (i != 0)
@@ -1455,6 +1519,8 @@ returncmd:
   ExpandCleanup(&xpc);
   ccline.xpc = NULL;
 
+  free(is_prev.pat);
+
   if (did_incsearch) {
     curwin->w_cursor = old_cursor;
     curwin->w_curswant = old_curswant;
@@ -1602,6 +1668,32 @@ int allbuf_locked(void)
   return FALSE;
 }
 
+/*
+ * Return TRUE when "pat" is "prev" with letters, digits, '_' or spaces
+ * appended and "prev" has nothing the added characters could change the
+ * meaning of.  Every match of "pat" then also is a match of "prev".
+ */
+static int incsearch_extends(char_u *prev, char_u *pat, int firstc)
+{
+  size_t len = STRLEN(prev);
+  char_u      *p;
+
+  if (len == 0 || STRNCMP(prev, pat, len) != 0 || pat[len] == NUL)
+    return FALSE;
+  /* "$" only means end-of-line at the end of the pattern */
+  if (prev[len - 1] == '$')
+    return FALSE;
+  /* A backslash may start an item that the added characters continue, e.g.
+   * "\%d12".  "firstc" starts the search offset. */
+  for (p = prev; *p != NUL; ++p)
+    if (*p == '\\' || *p == firstc)
+      return FALSE;
+  for (p = pat + len; *p != NUL; ++p)
+    if (!ASCII_ISALNUM(*p) && *p != '_' && *p != ' ')
+      return FALSE;
+  return TRUE;
+}
+
 static int cmdline_charsize(int idx)
 {
   if (cmdline_star > 0)             /* showing '*', always 1 position */
@@ -2099,6 +2191,36 @@ void unputcmdline(void)
   cursorcmd();
 }
 
+/// Turns pasted text into keys for the typeahead buffer: NUL, K_SPECIAL and
+/// CSI bytes are escaped.
+///
+/// @return allocated NUL terminated string
+static char_u *paste_to_keys(const char_u *text, size_t len)
+{
+  char_u *keys = xmalloc(len * 3 + 1);
+  char_u *d = keys;
+
+  for (size_t i = 0; i < len; i++) {
+    if (text[i] == NUL) {
+      *d++ = K_SPECIAL;
+      *d++ = KS_ZERO;
+      *d++ = KE_FILLER;
+    } else if (text[i] == K_SPECIAL) {
+      *d++ = K_SPECIAL;
+      *d++ = KS_SPECIAL;
+      *d++ = KE_FILLER;
+    } else if (text[i] == CSI) {
+      *d++ = K_SPECIAL;
+      *d++ = KS_EXTRA;
+      *d++ = (char_u)KE_CSI;
+    } else {
+      *d++ = text[i];
+    }
+  }
+  *d = NUL;
+  return keys;
+}
+
 /*
  * Put the given string, of the given length, onto the command line.
  * If len is -1, then STRLEN() is used to calculate the length.
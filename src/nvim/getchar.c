@@ -40,6 +40,7 @@
 #include "nvim/misc2.h"
 #include "nvim/keymap.h"
 #include "nvim/garray.h"
+#include "nvim/inputtrace.h"
 #include "nvim/move.h"
 #include "nvim/normal.h"
 #include "nvim/ops.h"
@@ -1500,6 +1501,7 @@ int vgetc(void)
    */
   may_garbage_collect = FALSE;
 
+  INPUTTRACE(kTraceKey, c);
   return c;
 }
 
@@ -0,0 +1,320 @@
+// inputtrace.c: Input latency tracing
+//
+// While enabled with ":inputtrace on", every stage a key goes through between
+// being read and being painted is timestamped into a fixed-size ring buffer.
+// The buffer can be summarized(":inputtrace report") or dumped in the Chrome
+// trace event format(":inputtrace dump {file}") to be inspected with
+// chrome://tracing.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvim/vim.h"
+#include "nvim/ascii.h"
+#include "nvim/inputtrace.h"
+#include "nvim/charset.h"
+#include "nvim/ex_cmds_defs.h"
+#include "nvim/globals.h"
+#include "nvim/memory.h"
+#include "nvim/message.h"
+#include "nvim/os/time.h"
+
+// Number of events kept, must be a power of two
+#define INPUTTRACE_SIZE 0x10000
+#define INPUTTRACE_MASK (INPUTTRACE_SIZE - 1)
+
+typedef struct {
+  uint64_t time;  // os_hrtime() when the event was recorded
+  int arg;        // stage-specific argument(byte count or key code)
+  InputTraceStage stage;
+} TraceEvent;
+
+// One measured key: from the time its bytes were received until the first
+// screen flush after it was processed
+typedef struct {
+  uint64_t input, key, cmd_start, cmd_end, redraw_start, redraw_end, flush;
+} KeyLatency;
+
+static const char *const stage_names[] = {
+  [kTraceInput] = "input",
+  [kTraceInchar] = "os_inchar",
+  [kTraceKey] = "vgetc",
+  [kTraceCommandStart] = "command",
+  [kTraceCommandEnd] = "command",
+  [kTraceRedrawStart] = "update_screen",
+  [kTraceRedrawEnd] = "update_screen",
+  [kTraceFlush] = "flush",
+};
+
+bool inputtrace_enabled = false;
+static TraceEvent *events = NULL;
+// Index where the next event is stored and number of events recorded
+static size_t events_head = 0, events_count = 0;
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "inputtrace.c.generated.h"
+#endif
+
+/// Records an event, overwriting the oldest one when the buffer is full. Use
+/// the INPUTTRACE macro instead of calling this directly.
+///
+/// @param stage The stage that was reached
+/// @param arg Stage-specific argument
+void inputtrace_event(InputTraceStage stage, int arg)
+{
+  TraceEvent *e = &events[events_head];
+  e->time = os_hrtime();
+  e->arg = arg;
+  e->stage = stage;
+  events_head = (events_head + 1) & INPUTTRACE_MASK;
+  if (events_count < INPUTTRACE_SIZE) {
+    events_count++;
+  }
+}
+
+/// ":inputtrace {on|off|clear|report|dump {file}}"
+void ex_inputtrace(exarg_T *eap)
+{
+  char_u *arg = eap->arg;
+
+  if (STRCMP(arg, "on") == 0) {
+    if (!events) {
+      events = xmalloc(INPUTTRACE_SIZE * sizeof(TraceEvent));
+    }
+    inputtrace_enabled = true;
+  } else if (STRCMP(arg, "off") == 0) {
+    inputtrace_enabled = false;
+  } else if (STRCMP(arg, "clear") == 0) {
+    events_head = events_count = 0;
+  } else if (STRCMP(arg, "report") == 0) {
+    inputtrace_report();
+  } else if (STRNCMP(arg, "dump", 4) == 0
+             && (arg[4] == NUL || vim_iswhite(arg[4]))) {
+    char_u *fname = skipwhite(arg + 4);
+    if (*fname == NUL) {
+      EMSG(_(e_argreq));
+    } else {
+      inputtrace_dump((char *)fname);
+    }
+  } else {
+    EMSG2(_(e_invarg2), arg);
+  }
+}
+
+// Returns the i-th oldest event in the ring buffer
+static TraceEvent *get_event(size_t i)
+{
+  return &events[(events_head - events_count + i) & INPUTTRACE_MASK];
+}
+
+// Pairs each burst of input with the first flush that happened after a key
+// from it was processed. Returns the number of measurements stored in
+// `*rv`, which must be freed by the caller.
+static size_t collect_latencies(KeyLatency **rv)
+{
+  *rv = xmalloc(MAX(events_count, 1) * sizeof(KeyLatency));
+  size_t count = 0;
+  KeyLatency cur = { 0, 0, 0, 0, 0, 0, 0 };
+  bool pending = false;
+
+  for (size_t i = 0; i < events_count; i++) {
+    TraceEvent *e = get_event(i);
+    switch (e->stage) {
+      case kTraceInput:
+        if (!pending) {
+          cur = (KeyLatency) { e->time, 0, 0, 0, 0, 0, 0 };
+          pending = true;
+        }
+        break;
+      case kTraceKey:
+        if (pending && !cur.key) {
+          cur.key = e->time;
+        }
+        break;
+      case kTraceCommandStart:
+        if (pending && cur.key && !cur.cmd_start) {
+          cur.cmd_start = e->time;
+        }
+        break;
+      case kTraceCommandEnd:
+        // Commands run by mappings may end several times, take the last
+        // end before redrawing
+        if (pending && cur.cmd_start && !cur.redraw_start) {
+          cur.cmd_end = e->time;
+        }
+        break;
+      case kTraceRedrawStart:
+        if (pending && cur.key) {
+          cur.redraw_start = e->time;
+        }
+        break;
+      case kTraceRedrawEnd:
+        if (pending && cur.redraw_start) {
+          cur.redraw_end = e->time;
+        }
+        break;
+      case kTraceFlush:
+        if (pending && cur.key) {
+          cur.flush = e->time;
+          if (!cur.cmd_end) {
+            // The command is still running, e.g. waiting for more keys
+            cur.cmd_start = 0;
+          }
+          (*rv)[count++] = cur;
+          pending = false;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  return count;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+// Returns the `p`th percentile of the sorted array `sorted`
+static uint64_t percentile(uint64_t *sorted, size_t count, size_t p)
+{
+  return sorted[(count - 1) * p / 100];
+}
+
+static void report_stage(const char *name, uint64_t *values, size_t count)
+{
+  qsort(values, count, sizeof(uint64_t), compare_u64);
+  snprintf((char *)IObuff, IOSIZE, "%-16s %10.3f %10.3f %10.3f\n", name,
+           (double)percentile(values, count, 50) / 1e6,
+           (double)percentile(values, count, 99) / 1e6,
+           (double)values[count - 1] / 1e6);
+  MSG_PUTS(IObuff);
+}
+
+static void inputtrace_report(void)
+{
+  KeyLatency *latencies;
+  size_t count = collect_latencies(&latencies);
+
+  if (!count) {
+    MSG(_("No input latency measured"));
+    free(latencies);
+    return;
+  }
+
+  uint64_t *values = xmalloc(count * sizeof(uint64_t));
+
+  MSG_PUTS_TITLE(_("STAGE                P50(ms)    P99(ms)    MAX(ms)"));
+  MSG_PUTS("\n");
+  for (size_t i = 0; i < count; i++) {
+    values[i] = latencies[i].key - latencies[i].input;
+  }
+  report_stage("input to key", values, count);
+  for (size_t i = 0; i < count; i++) {
+    KeyLatency *l = latencies + i;
+    values[i] = l->cmd_start ? l->cmd_start - l->key : 0;
+  }
+  report_stage("key to command", values, count);
+  for (size_t i = 0; i < count; i++) {
+    KeyLatency *l = latencies + i;
+    values[i] = l->cmd_start ? l->cmd_end - l->cmd_start : 0;
+  }
+  report_stage("command", values, count);
+  for (size_t i = 0; i < count; i++) {
+    KeyLatency *l = latencies + i;
+    values[i] = (l->redraw_start ? l->redraw_start : l->flush)
+                - (l->cmd_start ? l->cmd_end : l->key);
+  }
+  report_stage("command to redraw", values, count);
+  for (size_t i = 0; i < count; i++) {
+    KeyLatency *l = latencies + i;
+    values[i] = l->redraw_end ? l->redraw_end - l->redraw_start : 0;
+  }
+  report_stage("redraw", values, count);
+  for (size_t i = 0; i < count; i++) {
+    KeyLatency *l = latencies + i;
+    values[i] = l->flush - (l->redraw_end ? l->redraw_end : l->key);
+  }
+  report_stage("redraw to flush", values, count);
+  for (size_t i = 0; i < count; i++) {
+    values[i] = latencies[i].flush - latencies[i].input;
+  }
+  report_stage("input to paint", values, count);
+  snprintf((char *)IObuff, IOSIZE, _("%zu keys, %zu events recorded\n"),
+           count, events_count);
+  MSG_PUTS(IObuff);
+
+  free(values);
+  free(latencies);
+}
+
+// Writes the recorded events in the Chrome trace event format
+static void inputtrace_dump(char *fname)
+{
+  FILE *fd = mch_fopen(fname, "w");
+
+  if (!fd) {
+    EMSG2(_(e_notopen), fname);
+    return;
+  }
+
+  uint64_t base = events_count ? get_event(0)->time : 0;
+  int redraw_depth = 0, command_depth = 0;
+  bool first = true;
+
+  fputs("{\"traceEvents\":[\n", fd);
+  for (size_t i = 0; i < events_count; i++) {
+    TraceEvent *e = get_event(i);
+    const char *ph = "i";
+    if (e->stage == kTraceRedrawStart) {
+      ph = "B";
+      redraw_depth++;
+    } else if (e->stage == kTraceRedrawEnd) {
+      if (!redraw_depth) {
+        // The matching start was overwritten
+        continue;
+      }
+      ph = "E";
+      redraw_depth--;
+    } else if (e->stage == kTraceCommandStart) {
+      ph = "B";
+      command_depth++;
+    } else if (e->stage == kTraceCommandEnd) {
+      if (!command_depth) {
+        // The matching start was overwritten, or Insert mode was started
+        // without a command
+        continue;
+      }
+      ph = "E";
+      command_depth--;
+    }
+    fprintf(fd, "%s{\"name\":\"%s\",\"ph\":\"%s\",\"s\":\"t\",\"pid\":1,"
+            "\"tid\":1,\"ts\":%.3f,\"args\":{\"arg\":%d}}",
+            first ? "" : ",\n", stage_names[e->stage], ph,
+            (double)(e->time - base) / 1e3, e->arg);
+    first = false;
+  }
+
+  // Complete events on a separate track make each key's latency visible
+  KeyLatency *latencies;
+  size_t count = collect_latencies(&latencies);
+  for (size_t i = 0; i < count; i++) {
+    fprintf(fd, "%s{\"name\":\"input to paint\",\"ph\":\"X\",\"pid\":1,"
+            "\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}",
+            first ? "" : ",\n",
+            (double)(latencies[i].input - base) / 1e3,
+            (double)(latencies[i].flush - latencies[i].input) / 1e3);
+    first = false;
+  }
+  free(latencies);
+
+  fputs("\n]}\n", fd);
+  fclose(fd);
+}
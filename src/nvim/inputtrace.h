@@ -0,0 +1,34 @@
+#ifndef NVIM_INPUTTRACE_H
+#define NVIM_INPUTTRACE_H
+
+#include <stdbool.h>
+
+#include "nvim/ex_cmds_defs.h"
+
+/// Stages a key goes through between being read and being painted
+typedef enum {
+  kTraceInput,        ///< Bytes received from the terminal or the API
+  kTraceInchar,       ///< Bytes handed to the typeahead by os_inchar()
+  kTraceKey,          ///< Key returned by vgetc() after mapping resolution
+  kTraceCommandStart, ///< Started executing the command of a key
+  kTraceCommandEnd,   ///< Finished executing the command of a key
+  kTraceRedrawStart,  ///< update_screen() started
+  kTraceRedrawEnd,    ///< update_screen() finished
+  kTraceFlush,        ///< UI flushed the screen
+} InputTraceStage;
+
+/// True while `:inputtrace on` is active
+extern bool inputtrace_enabled;
+
+/// Records an input trace event. Only a flag check when tracing is off.
+#define INPUTTRACE(stage, arg) \
+  do { \
+    if (inputtrace_enabled) { \
+      inputtrace_event(stage, arg); \
+    } \
+  } while (0)
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "inputtrace.h.generated.h"
+#endif
+#endif  // NVIM_INPUTTRACE_H
@@ -154,4 +154,14 @@
 /// zero in those cases (-Wdiv-by-zero in GCC).
 #define ARRAY_SIZE(arr) ((sizeof(arr)/sizeof((arr)[0])) / ((size_t)(!(sizeof(arr) % sizeof((arr)[0])))))
 
+/// Storage class of a variable that has a separate instance in each thread.
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L \
+  && !defined(__STDC_NO_THREADS__)
+# define THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+# define THREAD_LOCAL __declspec(thread)
+#else
+# define THREAD_LOCAL __thread
+#endif
+
 #endif  // NVIM_MACROS_H
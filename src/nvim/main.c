@@ -752,6 +752,13 @@ void getout(int exitval)
     apply_autocmds(EVENT_VIMLEAVEPRE, NULL, NULL, FALSE, curbuf);
   }
 
+  /* Remember the syntax state of big buffers for the next time. */
+  if (get_vim_var_nr(VV_DYING) <= 1) {
+    FOR_ALL_BUFFERS(buf) {
+      syn_state_save(buf);
+    }
+  }
+
   if (p_viminfo && *p_viminfo != NUL)
     /* Write out the registers, history, marks etc, to the viminfo file */
     write_viminfo(NULL, FALSE);
@@ -943,6 +943,18 @@ static bool intable(const struct interval *table, size_t n_items, int c)
   return false;
 }
 
+/*
+ * Number of cells of the characters 0x100 - 0x10ffff, filled in when first
+ * used by utf_char2cells().  Indexed by the character divided by 256, each
+ * entry is NULL or points to the cells of a block of 256 characters.  Blocks
+ * where all characters take one cell share "cells_single".
+ */
+#define CELLS_BLOCK_SHIFT 8
+#define CELLS_BLOCK_SIZE  (1 << CELLS_BLOCK_SHIFT)
+static char_u *cells_blocks[0x110000 >> CELLS_BLOCK_SHIFT];
+static char_u cells_single[CELLS_BLOCK_SIZE];
+static bool cells_ambw_double;  /* 'ambiwidth' used for "cells_blocks" */
+
 /*
  * For UTF-8 character "c" return 2 for a double-width character, 1 for others.
  * Returns 4 or 6 for an unprintable character.
@@ -951,6 +963,50 @@ static bool intable(const struct interval *table, size_t n_items, int c)
  * class 'A'(mbiguous).
  */
 int utf_char2cells(int c)
+{
+  char_u *block;
+
+  /* Characters below 0x100 are influenced by 'isprint' option. */
+  if (c < 0x100 || c > 0x10ffff)
+    return utf_char2cells_nocache(c);
+
+  if (cells_ambw_double != (*p_ambw == 'd')) {
+    /* 'ambiwidth' was changed, drop the blocks computed for the old value. */
+    for (size_t i = 0; i < ARRAY_SIZE(cells_blocks); i++) {
+      if (cells_blocks[i] != cells_single)
+        free(cells_blocks[i]);
+      cells_blocks[i] = NULL;
+    }
+    cells_ambw_double = (*p_ambw == 'd');
+  }
+
+  block = cells_blocks[c >> CELLS_BLOCK_SHIFT];
+  if (block == NULL) {
+    char_u cells[CELLS_BLOCK_SIZE];
+    int first = c & ~(CELLS_BLOCK_SIZE - 1);
+    bool single = true;
+
+    for (int i = 0; i < CELLS_BLOCK_SIZE; i++) {
+      cells[i] = (char_u)utf_char2cells_nocache(first + i);
+      if (cells[i] != 1)
+        single = false;
+    }
+    if (single) {
+      if (cells_single[0] == 0)
+        memset(cells_single, 1, sizeof(cells_single));
+      block = cells_single;
+    } else {
+      block = xmemdup(cells, sizeof(cells));
+    }
+    cells_blocks[c >> CELLS_BLOCK_SHIFT] = block;
+  }
+  return block[c & (CELLS_BLOCK_SIZE - 1)];
+}
+
+/*
+ * Like utf_char2cells(), but always search the tables.
+ */
+static int utf_char2cells_nocache(int c)
 {
   /* Sorted list of non-overlapping intervals of East Asian double width
    * characters, generated with ../runtime/tools/unicode.vim. */
@@ -1316,6 +1372,10 @@ size_t mb_string2cells(const char_u *str)
 {
   size_t clen = 0;
 
+  if (enc_utf8) {
+    return utf_string2cells(str, STRLEN(str));
+  }
+
   for (const char_u *p = str; *p != NUL; p += (*mb_ptr2len)(p)) {
     clen += (*mb_ptr2cells)(p);
   }
@@ -1323,6 +1383,94 @@ size_t mb_string2cells(const char_u *str)
   return clen;
 }
 
+/// Calculate the number of cells occupied by UTF-8 string `str`, like
+/// mb_string2cells().  Runs of ASCII characters are counted without decoding
+/// them.
+///
+/// @param str The source string, must be NUL-terminated.
+/// @param len Length of `str`, STRLEN(str).
+/// @return The number of cells occupied by string `str`
+size_t utf_string2cells(const char_u *str, size_t len)
+{
+  size_t clen = 0;
+  size_t i = 0;
+
+  while (i < len) {
+    size_t n = utf_ascii_len(str + i, len - i);
+
+    // The last ASCII character may be followed by composing characters,
+    // leave it to the loop below then.
+    if (i + n < len && n > 0) {
+      n--;
+    }
+    clen += n;
+    i += n;
+
+    // Handle characters until the next ASCII character that is not followed
+    // by a composing character.
+    while (i < len && (str[i] >= 0x80 || str[i + 1] >= 0x80)) {
+      clen += (size_t)utf_ptr2cells(str + i);
+      i += (size_t)utfc_ptr2len(str + i);
+    }
+  }
+
+  return clen;
+}
+
+/// Get the number of ASCII characters at the start of `str[len]`.  Eight
+/// bytes are checked at a time.
+///
+/// @param str The source string, does not need to be NUL-terminated.
+/// @param len Length of `str`.
+/// @return The number of bytes before the first byte >= 0x80 or `len`.
+size_t utf_ascii_len(const char_u *str, size_t len)
+{
+  size_t i = 0;
+
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t v;
+
+    memcpy(&v, str + i, sizeof(v));
+    if (v & 0x8080808080808080ULL) {
+      break;
+    }
+  }
+  while (i < len && str[i] < 0x80) {
+    i++;
+  }
+
+  return i;
+}
+
+/// Get the number of bytes at the start of `str[len]` that are valid UTF-8.
+/// A sequence is invalid when it does not have enough trail bytes, when it
+/// is truncated at `len` or when it is longer than needed (overlong).
+/// Runs of ASCII characters are skipped with utf_ascii_len().
+///
+/// @param str The source string, does not need to be NUL-terminated.
+/// @param len Length of `str`.
+/// @return The offset of the first invalid sequence or `len`.
+size_t utf_valid_len(const char_u *str, size_t len)
+{
+  size_t i = 0;
+
+  for (;;) {
+    i += utf_ascii_len(str + i, len - i);
+    if (i >= len) {
+      break;
+    }
+
+    int size = len - i < 6 ? (int)(len - i) : 6;
+    int l = utf_ptr2len_len(str + i, size);
+    if (l == 1 || l > size || utf_char2len(utf_ptr2char(str + i)) != l) {
+      break;
+    }
+    i += (size_t)l;
+  }
+
+  return i;
+}
+
 /*
  * mb_off2cells() function pointer.
  * Return number of display cells for char at ScreenLines[off].
@@ -3110,26 +3258,22 @@ void utf_find_illegal(void)
       p = tofree;
     }
 
-    while (*p != NUL) {
-      /* Illegal means that there are not enough trail bytes (checked by
-       * utf_ptr2len()) or too many of them (overlong sequence). */
-      len = utf_ptr2len(p);
-      if (*p >= 0x80 && (len == 1
-            || utf_char2len(utf_ptr2char(p)) != len)) {
-        if (vimconv.vc_type == CONV_NONE)
-          curwin->w_cursor.col += (colnr_T)(p - get_cursor_pos_ptr());
-        else {
-          int l;
+    /* Illegal means that there are not enough trail bytes or too many of
+     * them (overlong sequence). */
+    p += utf_valid_len(p, STRLEN(p));
+    if (*p != NUL) {
+      if (vimconv.vc_type == CONV_NONE)
+        curwin->w_cursor.col += (colnr_T)(p - get_cursor_pos_ptr());
+      else {
+        int l;
 
-          len = (int)(p - tofree);
-          for (p = get_cursor_pos_ptr(); *p != NUL && len-- > 0; p += l) {
-            l = utf_ptr2len(p);
-            curwin->w_cursor.col += l;
-          }
+        len = (int)(p - tofree);
+        for (p = get_cursor_pos_ptr(); *p != NUL && len-- > 0; p += l) {
+          l = utf_ptr2len(p);
+          curwin->w_cursor.col += l;
         }
-        goto theend;
       }
-      p += len;
+      goto theend;
     }
     if (curwin->w_cursor.lnum == curbuf->b_ml.ml_line_count)
       break;
@@ -1823,6 +1823,53 @@ errorret:
   return buf->b_ml.ml_line_ptr;
 }
 
+/*
+ * Get line "lnum" of "buf" like ml_get_buf() and describe the lines in the
+ * data block holding it in "span".  Consecutive lines can then be obtained
+ * with ml_span_line() without going through ml_get_buf() for each of them.
+ * "span" is cleared when that isn't possible.
+ */
+char_u *ml_get_span(buf_T *buf, linenr_T lnum, mlspan_T *span)
+{
+  /* This uses the locked block when the line is in it and only flushes the
+   * changed line when going to another line. */
+  char_u *line = ml_get_buf(buf, lnum, FALSE);
+
+  span->sp_block = NULL;
+  if (buf->b_ml.ml_locked != NULL && !mf_dont_release
+      && buf->b_ml.ml_locked_low <= lnum
+      && buf->b_ml.ml_locked_high >= lnum) {
+    span->sp_buf = buf;
+    span->sp_block = buf->b_ml.ml_locked;
+    span->sp_low = buf->b_ml.ml_locked_low;
+    span->sp_high = buf->b_ml.ml_locked_high;
+  }
+  return line;
+}
+
+/*
+ * Get line "lnum" from "span", obtained with ml_get_span().  Returns NULL
+ * when the line isn't in the span, the block was released or changed since,
+ * or the line was changed and not flushed into the block yet.
+ */
+char_u *ml_span_line(mlspan_T *span, linenr_T lnum)
+{
+  buf_T       *buf = span->sp_buf;
+  DATA_BL     *dp;
+
+  if (span->sp_block == NULL
+      || lnum < span->sp_low || lnum > span->sp_high
+      || buf->b_ml.ml_locked != span->sp_block
+      || buf->b_ml.ml_locked_low != span->sp_low
+      || buf->b_ml.ml_locked_high != span->sp_high
+      || ((buf->b_ml.ml_flags & ML_LINE_DIRTY)
+          && buf->b_ml.ml_line_lnum == lnum))
+    return NULL;
+
+  dp = span->sp_block->bh_data;
+  return (char_u *)dp + ((dp->db_index[lnum - span->sp_low]) & DB_INDEX_MASK);
+}
+
 /*
  * Check if a line that was just obtained by a call to ml_get
  * is in allocated memory.
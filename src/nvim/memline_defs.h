@@ -56,4 +56,15 @@ typedef struct memline {
   int ml_usedchunks;
 } memline_T;
 
+/*
+ * Consecutive lines of a buffer that are stored in one data block, see
+ * ml_get_span().  Valid as long as that block stays locked by the buffer.
+ */
+typedef struct {
+  struct file_buffer *sp_buf;
+  bhdr_T      *sp_block;        /* the data block */
+  linenr_T sp_low;              /* first line in the block */
+  linenr_T sp_high;             /* last line in the block */
+} mlspan_T;
+
 #endif // NVIM_MEMLINE_DEFS_H
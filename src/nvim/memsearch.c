@@ -0,0 +1,162 @@
+// memsearch.c: Vectorized substring search
+//
+// Candidate positions are found by comparing a vector of bytes against the
+// first byte of the needle and the bytes `len - 1` further against its last
+// byte, only positions where both match are compared in full. AVX2 or SSE2
+// is used when the compiler targets it, otherwise a scalar loop.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__AVX2__)
+# include <immintrin.h>
+#elif defined(__GNUC__) && defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#include "nvim/vim.h"
+#include "nvim/memsearch.h"
+
+#if defined(__GNUC__) && defined(__AVX2__)
+# define MEMSEARCH_VECTOR
+# define VEC_SIZE 32
+typedef __m256i Vector;
+# define VEC_SET1(c) _mm256_set1_epi8((char)(c))
+# define VEC_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+# define VEC_EQ(a, b) _mm256_cmpeq_epi8((a), (b))
+# define VEC_OR(a, b) _mm256_or_si256((a), (b))
+# define VEC_AND(a, b) _mm256_and_si256((a), (b))
+# define VEC_MASK(v) ((uint32_t)_mm256_movemask_epi8(v))
+#elif defined(__GNUC__) && defined(__SSE2__)
+# define MEMSEARCH_VECTOR
+# define VEC_SIZE 16
+typedef __m128i Vector;
+# define VEC_SET1(c) _mm_set1_epi8((char)(c))
+# define VEC_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+# define VEC_EQ(a, b) _mm_cmpeq_epi8((a), (b))
+# define VEC_OR(a, b) _mm_or_si128((a), (b))
+# define VEC_AND(a, b) _mm_and_si128((a), (b))
+# define VEC_MASK(v) ((uint32_t)_mm_movemask_epi8(v))
+#endif
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "memsearch.c.generated.h"
+#endif
+
+// Compares `len` bytes, ignoring the case of ASCII letters when `ic` is set
+static bool mem_equal(const char_u *a, const char_u *b, size_t len, bool ic)
+{
+  if (!ic) {
+    return memcmp(a, b, len) == 0;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (TOLOWER_ASC(a[i]) != TOLOWER_ASC(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Finds the first occurrence of a byte string in a memory block.
+///
+/// @param haystack The memory block to search in
+/// @param hlen Size of `haystack`
+/// @param needle The bytes to look for
+/// @param nlen Size of `needle`
+/// @param ic Ignore the case of ASCII letters
+/// @return Pointer to the first occurrence in `haystack`, NULL when not found
+const char_u *memsearch_find(const char_u *haystack, size_t hlen,
+                             const char_u *needle, size_t nlen, bool ic)
+  FUNC_ATTR_PURE FUNC_ATTR_NONNULL_ALL
+{
+  if (nlen == 0) {
+    return haystack;
+  }
+  if (nlen > hlen) {
+    return NULL;
+  }
+
+  const char_u *p = haystack;
+  // Last position where an occurrence can start
+  const char_u *last = haystack + hlen - nlen;
+  int first_lo = TOLOWER_ASC(needle[0]), first_up = TOUPPER_ASC(needle[0]);
+  int last_lo = TOLOWER_ASC(needle[nlen - 1]);
+  int last_up = TOUPPER_ASC(needle[nlen - 1]);
+  if (!ic) {
+    first_lo = first_up = needle[0];
+    last_lo = last_up = needle[nlen - 1];
+  }
+
+#ifdef MEMSEARCH_VECTOR
+  if (hlen - nlen + 1 >= VEC_SIZE) {
+    Vector vfirst_lo = VEC_SET1(first_lo), vfirst_up = VEC_SET1(first_up);
+    Vector vlast_lo = VEC_SET1(last_lo), vlast_up = VEC_SET1(last_up);
+
+    for (; p + VEC_SIZE - 1 <= last; p += VEC_SIZE) {
+      Vector bfirst = VEC_LOAD(p);
+      Vector blast = VEC_LOAD(p + nlen - 1);
+      uint32_t mask = VEC_MASK(VEC_AND(
+          VEC_OR(VEC_EQ(bfirst, vfirst_lo), VEC_EQ(bfirst, vfirst_up)),
+          VEC_OR(VEC_EQ(blast, vlast_lo), VEC_EQ(blast, vlast_up))));
+
+      while (mask) {
+        const char_u *candidate = p + __builtin_ctz(mask);
+        // The first and last bytes are known to match
+        if (nlen <= 2 || mem_equal(candidate + 1, needle + 1, nlen - 2, ic)) {
+          return candidate;
+        }
+        mask &= mask - 1;
+      }
+    }
+  }
+#endif
+
+  // Positions not covered by a full vector
+  if (!ic) {
+    while (p <= last) {
+      p = memchr(p, first_lo, (size_t)(last - p) + 1);
+      if (p == NULL) {
+        return NULL;
+      }
+      if (memcmp(p + 1, needle + 1, nlen - 1) == 0) {
+        return p;
+      }
+      p++;
+    }
+    return NULL;
+  }
+  for (; p <= last; p++) {
+    if ((*p == first_lo || *p == first_up)
+        && mem_equal(p + 1, needle + 1, nlen - 1, true)) {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+/// Checks if a memory block only contains ASCII bytes.
+///
+/// @param p The memory block
+/// @param len Size of `p`
+bool memsearch_is_ascii(const char_u *p, size_t len)
+  FUNC_ATTR_PURE FUNC_ATTR_NONNULL_ALL
+{
+  const char_u *end = p + len;
+
+#ifdef MEMSEARCH_VECTOR
+  // movemask collects the high bit of each byte
+  for (; end - p >= VEC_SIZE; p += VEC_SIZE) {
+    if (VEC_MASK(VEC_LOAD(p))) {
+      return false;
+    }
+  }
+#endif
+
+  for (; p < end; p++) {
+    if (*p >= 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
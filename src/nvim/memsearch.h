@@ -0,0 +1,12 @@
+#ifndef NVIM_MEMSEARCH_H
+#define NVIM_MEMSEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nvim/types.h"
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "memsearch.h.generated.h"
+#endif
+#endif  // NVIM_MEMSEARCH_H
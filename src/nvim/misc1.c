@@ -2036,10 +2036,14 @@ static void changed_common(linenr_T lnum, colnr_T col, linenr_T lnume, long xtra
   int cols;
   pos_T       *p;
   int add;
+  int changedtick = curbuf->b_changedtick;
 
   /* mark the buffer as modified */
   changed();
 
+  /* Keep the 'hlsearch' results of the lines that didn't change. */
+  hlcache_changed(curbuf, changedtick, lnum, lnume, xtra);
+
   /* set the '. mark */
   if (!cmdmod.keepjumps) {
     curbuf->b_last_change.lnum = lnum;
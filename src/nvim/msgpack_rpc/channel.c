@@ -148,6 +148,7 @@ uint64_t channel_from_job(char **argv)
     return 0;
   }
 
+  job_write_cb(channel->data.job, job_write_done);
   return channel->id;
 }
 
@@ -169,6 +170,7 @@ void channel_from_stream(uv_stream_t *stream)
   // write stream
   channel->data.streams.write = wstream_new(0);
   wstream_set_stream(channel->data.streams.write, stream);
+  wstream_set_write_cb(channel->data.streams.write, write_done, channel);
   channel->data.streams.uv = stream;
 }
 
@@ -325,6 +327,7 @@ static void channel_from_stdio(void)
   // write stream
   channel->data.streams.write = wstream_new(0);
   wstream_set_file(channel->data.streams.write, 1);
+  wstream_set_write_cb(channel->data.streams.write, write_done, channel);
   channel->data.streams.uv = NULL;
 }
 
@@ -352,6 +355,37 @@ static void job_exit(Job *job, void *data)
   decref(data);
 }
 
+// Writes are queued and sent later, so most failed writes are only known
+// when the write callback is called
+static void write_done(WStream *wstream, void *data, int status)
+{
+  if (status) {
+    write_failed(data, status);
+  }
+}
+
+static void job_write_done(WStream *wstream, void *data, int status)
+{
+  if (status) {
+    write_failed(job_data(data), status);
+  }
+}
+
+static void write_failed(Channel *channel, int status)
+{
+  if (channel->closed) {
+    return;
+  }
+
+  char buf[256];
+  snprintf(buf,
+           sizeof(buf),
+           "Channel %" PRIu64 " was closed due to a failed write: %s",
+           channel->id,
+           uv_strerror(status));
+  call_set_error(channel, buf);
+}
+
 static void parse_msgpack(RStream *rstream, void *data, bool eof)
 {
   Channel *channel = data;
@@ -38,6 +38,7 @@
 #include "nvim/getchar.h"
 #include "nvim/indent.h"
 #include "nvim/indent_c.h"
+#include "nvim/inputtrace.h"
 #include "nvim/main.h"
 #include "nvim/mark.h"
 #include "nvim/memline.h"
@@ -585,6 +586,23 @@ getcount:
     }
   }
 
+  if (c == K_PASTE) {
+    // Text pasted outside of Insert mode, or that arrived after leaving it,
+    // is inserted before the cursor. A pending operator, count or Visual
+    // selection doesn't apply to it.
+    clearop(oap);
+    finish_op = false;
+    if (VIsual_active) {
+      end_visual_mode();
+    }
+    ctrl_w = false;
+    ca.opcount = 0;
+    ca.count0 = 0;
+    clear_showcmd();
+    vungetc(c);
+    c = 'i';
+  }
+
   if (c == K_CURSORHOLD) {
     /* Save the count values so that ca.opcount and ca.count0 are exactly
      * the same when coming back here after handling K_CURSORHOLD. */
@@ -904,6 +922,7 @@ getcount:
    * Call the command function found in the commands table.
    */
   ca.arg = nv_cmds[idx].cmd_arg;
+  INPUTTRACE(kTraceCommandStart, ca.cmdchar);
   (nv_cmds[idx].cmd_func)(&ca);
 
   /*
@@ -926,6 +945,7 @@ getcount:
    * If an operation is pending, handle it...
    */
   do_pending_operator(&ca, old_col, false);
+  INPUTTRACE(kTraceCommandEnd, ca.cmdchar);
 
   /*
    * Wait for a moment when a message is displayed that will be overwritten
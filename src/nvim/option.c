@@ -1499,6 +1499,10 @@ static vimoption_T
    (char_u *)&p_smc, PV_SMC,
    {(char_u *)3000L, (char_u *)0L}
    SCRIPTID_INIT},
+  {"synstatedir", "ssd",  P_STRING|P_EXPAND|P_SECURE|P_VI_DEF,
+   (char_u *)&p_ssd, PV_NONE,
+   {(char_u *)"", (char_u *)0L}
+   SCRIPTID_INIT},
   {"syntax",      "syn",  P_STRING|P_ALLOCED|P_VI_DEF|P_NOGLOB|P_NFNAME,
    (char_u *)&p_syn, PV_SYN,
    {(char_u *)"", (char_u *)0L}
@@ -4654,6 +4658,7 @@ static char_u *compile_cap_prog(synblock_T *synblock)
   }
 
   vim_regfree(rp);
+  spell_cache_clear(synblock);
   return NULL;
 }
 
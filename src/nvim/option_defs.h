@@ -550,6 +550,7 @@ static char *(p_swb_values[]) = {"useopen", "usetab", "split", "newtab", NULL};
 #define SWB_USETAB              0x002
 #define SWB_SPLIT               0x004
 #define SWB_NEWTAB              0x008
+EXTERN char_u   *p_ssd;         /* 'synstatedir' */
 EXTERN int p_tbs;               /* 'tagbsearch' */
 EXTERN long p_tl;               /* 'taglength' */
 EXTERN int p_tr;                /* 'tagrelative' */
@@ -78,6 +78,7 @@ void event_teardown(void)
   channel_teardown();
   job_teardown();
   server_teardown();
+  wstream_teardown();
   signal_teardown();
   // this last `uv_run` will return after all handles are stopped, it will
   // also take care of finishing any uv_close calls made by other *_teardown
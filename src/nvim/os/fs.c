@@ -13,6 +13,10 @@
 #include "nvim/path.h"
 #include "nvim/strings.h"
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "os/fs.c.generated.h"
 #endif
@@ -503,3 +507,32 @@ bool os_fileid_equal_fileinfo(const FileID *file_id,
          && file_id->device_id == file_info->stat.st_dev;
 }
 
+/// Map the first "size" bytes of an open file into memory.
+///
+/// The mapping is private: its pages are shared with other processes that
+/// map the same file until they are written to.  The mapping stays valid
+/// after the file is closed.
+///
+/// @param file_descriptor File descriptor of the file, opened for reading.
+/// @param size Number of bytes to map.
+/// @return pointer to the mapped bytes, or NULL on failure and on systems
+///         without mmap().
+void *os_mmap_fd(int file_descriptor, size_t size)
+{
+#ifdef HAVE_SYS_MMAN_H
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                   file_descriptor, 0);
+  return ptr == MAP_FAILED ? NULL : ptr;
+#else
+  return NULL;
+#endif
+}
+
+/// Remove a mapping made with os_mmap_fd().
+void os_munmap(void *ptr, size_t size)
+  FUNC_ATTR_NONNULL_ALL
+{
+#ifdef HAVE_SYS_MMAN_H
+  munmap(ptr, size);
+#endif
+}
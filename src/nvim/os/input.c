@@ -19,8 +19,10 @@
 #include "nvim/fileio.h"
 #include "nvim/ex_cmds2.h"
 #include "nvim/getchar.h"
+#include "nvim/inputtrace.h"
 #include "nvim/main.h"
 #include "nvim/misc1.h"
+#include "nvim/syntax.h"
 
 #define READ_BUFFER_SIZE 0xfff
 #define INPUT_BUFFER_SIZE (READ_BUFFER_SIZE * 4)
@@ -34,6 +36,13 @@ typedef enum {
 static RStream *read_stream = NULL;
 static RBuffer *read_buffer = NULL, *input_buffer = NULL;
 static bool eof = false;
+// Text received with a bracketed paste that wasn't inserted yet and whether a
+// K_PASTE key was queued for it
+static String paste_buffer = STRING_INIT;
+static size_t paste_capacity = 0;
+static bool paste_key_queued = false;
+// Whether the text of the current paste ended with a CR so far
+static bool paste_last_cr = false;
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "os/input.c.generated.h"
@@ -73,7 +82,7 @@ void input_stop_stdin(void)
 int os_inchar(uint8_t *buf, int maxlen, int ms, int tb_change_cnt)
 {
   if (rbuffer_pending(input_buffer)) {
-    return (int)rbuffer_read(input_buffer, (char *)buf, (size_t)maxlen);
+    return input_read(buf, maxlen);
   }
 
   InbufPollResult result;
@@ -82,7 +91,14 @@ int os_inchar(uint8_t *buf, int maxlen, int ms, int tb_change_cnt)
       return 0;
     }
   } else {
-    if ((result = inbuf_poll((int)p_ut)) == kInputNone) {
+    // Parse syntax ahead until a key is typed or there is nothing left to do
+    result = inbuf_poll(0);
+    while (result == kInputNone && syntax_runahead()) {
+      result = inbuf_poll(0);
+    }
+
+    if (result == kInputNone
+        && (result = inbuf_poll((int)p_ut)) == kInputNone) {
       if (trigger_cursorhold() && maxlen >= 3
           && !typebuf_changed(tb_change_cnt)) {
         buf[0] = K_SPECIAL;
@@ -102,9 +118,7 @@ int os_inchar(uint8_t *buf, int maxlen, int ms, int tb_change_cnt)
   }
 
   if (rbuffer_pending(input_buffer)) {
-    // Safe to convert rbuffer_read to int, it will never overflow since we use
-    // relatively small buffers.
-    return (int)rbuffer_read(input_buffer, (char *)buf, (size_t)maxlen);
+    return input_read(buf, maxlen);
   }
 
   // If there are deferred events, return the keys directly
@@ -142,6 +156,7 @@ bool os_isatty(int fd)
 
 size_t input_enqueue(String keys)
 {
+  INPUTTRACE(kTraceInput, (int)keys.size);
   char *ptr = keys.data, *end = ptr + keys.size;
 
   while (rbuffer_available(input_buffer) >= 6 && ptr < end) {
@@ -183,6 +198,72 @@ size_t input_enqueue(String keys)
   return rv;
 }
 
+/// Queues pasted text to be inserted in bulk by the K_PASTE key handler, which
+/// bypasses the typeahead buffer and mappings.
+///
+/// @param text The pasted bytes, without any special key translation
+void input_paste(String text)
+{
+  // A CR ending the previous chunk followed by a NL starting this one is a
+  // single line break
+  if (paste_last_cr && text.size > 0 && text.data[0] == NL) {
+    text.data++;
+    text.size--;
+  }
+  paste_last_cr = text.size > 0 && text.data[text.size - 1] == CAR;
+  if (text.size == 0) {
+    return;
+  }
+
+  if (paste_buffer.size + text.size > paste_capacity) {
+    paste_capacity = MAX(paste_capacity * 2, paste_buffer.size + text.size);
+    paste_buffer.data = xrealloc(paste_buffer.data, paste_capacity);
+  }
+  memcpy(paste_buffer.data + paste_buffer.size, text.data, text.size);
+  paste_buffer.size += text.size;
+  INPUTTRACE(kTraceInput, (int)text.size);
+
+  paste_queue_key();
+}
+
+/// Starts a new paste: the text passed to `input_paste` doesn't continue the
+/// text of the previous one.
+void input_paste_start(void)
+{
+  paste_last_cr = false;
+  // A CR at the end of the text of the previous paste that wasn't taken yet
+  // must not be joined with a NL of the new paste
+  if (paste_buffer.size > 0
+      && paste_buffer.data[paste_buffer.size - 1] == CAR) {
+    paste_buffer.data[paste_buffer.size - 1] = NL;
+  }
+}
+
+/// Takes the text queued by `input_paste`.
+///
+/// @return The pasted text, which must be freed by the caller
+String input_paste_take(void)
+{
+  String rv = paste_buffer;
+  paste_buffer = (String)STRING_INIT;
+  paste_capacity = 0;
+  paste_key_queued = false;
+  return rv;
+}
+
+// Queues a K_PASTE key for the text in the paste buffer. One key is enough
+// to insert everything pasted until it is processed. If the input buffer is
+// full, the key is queued when `input_read` made room for it.
+static void paste_queue_key(void)
+{
+  if (paste_buffer.size > 0 && !paste_key_queued
+      && rbuffer_available(input_buffer) >= 3) {
+    uint8_t key[3] = { K_SPECIAL, KS_EXTRA, KE_PASTE };
+    rbuffer_write(input_buffer, (char *)key, 3);
+    paste_key_queued = true;
+  }
+}
+
 // Mouse event handling code(Extract row/col if available and detect multiple
 // clicks)
 static unsigned int handle_mouse_event(char **ptr, uint8_t *buf,
@@ -306,10 +387,13 @@ static void read_cb(RStream *rstream, void *data, bool at_eof)
     eof = true;
   }
 
-  char *buf = rbuffer_read_ptr(read_buffer);
-  size_t buf_size = rbuffer_pending(read_buffer);
-  (void)rbuffer_write(input_buffer, buf, buf_size);
-  rbuffer_consumed(read_buffer, buf_size);
+  INPUTTRACE(kTraceInput, (int)rbuffer_pending(read_buffer));
+  uv_buf_t iov[2];
+  size_t iovcnt = rbuffer_read_iov(read_buffer, iov);
+  for (size_t i = 0; i < iovcnt; i++) {
+    (void)rbuffer_write(input_buffer, iov[i].base, iov[i].len);
+  }
+  rbuffer_consumed(read_buffer, rbuffer_pending(read_buffer));
 }
 
 static void process_interrupts(void)
@@ -318,13 +402,12 @@ static void process_interrupts(void)
     return;
   }
 
-  char *inbuf = rbuffer_read_ptr(input_buffer);
   size_t count = rbuffer_pending(input_buffer), consume_count = 0;
 
-  for (int i = (int)count - 1; i >= 0; i--) {
-    if (inbuf[i] == 3) {
+  for (size_t i = count; i > 0; i--) {
+    if (rbuffer_get(input_buffer, i - 1) == 3) {
       got_int = true;
-      consume_count = (size_t)i;
+      consume_count = i - 1;
       break;
     }
   }
@@ -335,6 +418,17 @@ static void process_interrupts(void)
   }
 }
 
+// Reads typed bytes from `input_buffer` into the typeahead
+static int input_read(uint8_t *buf, int maxlen)
+{
+  // Safe to convert rbuffer_read to int, it will never overflow since we use
+  // relatively small buffers.
+  int rv = (int)rbuffer_read(input_buffer, (char *)buf, (size_t)maxlen);
+  INPUTTRACE(kTraceInchar, rv);
+  paste_queue_key();
+  return rv;
+}
+
 static int push_event_key(uint8_t *buf, int maxlen)
 {
   static const uint8_t key[3] = { K_SPECIAL, KS_EXTRA, KE_EVENT };
@@ -17,6 +17,7 @@
 #include "nvim/os/time.h"
 #include "nvim/vim.h"
 #include "nvim/memory.h"
+#include "nvim/lib/klist.h"
 
 // {SIGNAL}_TIMEOUT is the time (in nanoseconds) that a job has to cleanly exit
 // before we send SIGNAL to it
@@ -24,6 +25,8 @@
 #define KILL_TIMEOUT (TERM_TIMEOUT * 2)
 #define MAX_RUNNING_JOBS 100
 #define JOB_BUFFER_SIZE 0xFFFF
+// Jobs can produce data faster than it is consumed, let their buffers grow
+#define JOB_BUFFER_MAX_SIZE (JOB_BUFFER_SIZE * 16)
 
 #define close_job_stream(job, stream, type)                                \
   do {                                                                     \
@@ -44,6 +47,12 @@ Job *table[MAX_RUNNING_JOBS] = {NULL};
 size_t stop_requests = 0;
 uv_timer_t job_stop_timer;
 
+// Jobs are frequently short-lived(linters, formatters, system()), so their
+// memory is recycled instead of being returned to the allocator
+#define JobFreer(x)
+KMEMPOOL_INIT(JobPool, Job, JobFreer)
+static kmempool_t(JobPool) *job_pool = NULL;
+
 // Some helpers shared in this module
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
@@ -56,6 +65,7 @@ void job_init(void)
 {
   uv_disable_stdio_inheritance();
   uv_timer_init(uv_default_loop(), &job_stop_timer);
+  job_pool = kmp_init(JobPool);
 }
 
 /// Releases job control resources and terminates running jobs
@@ -101,7 +111,7 @@ Job *job_start(JobOptions opts, int *status)
     return NULL;
   }
 
-  job = xmalloc(sizeof(Job));
+  job = kmp_alloc(JobPool, job_pool);
   // Initialize
   job->id = i + 1;
   *status = job->id;
@@ -135,13 +145,13 @@ Job *job_start(JobOptions opts, int *status)
   // Spawn the job
   if (!process_spawn(job)) {
     if (opts.writable) {
-      uv_close((uv_handle_t *)&job->proc_stdin, close_cb);
+      uv_close((uv_handle_t *)job->proc_stdin, close_cb);
     }
     if (opts.stdout_cb) {
-      uv_close((uv_handle_t *)&job->proc_stdout, close_cb);
+      uv_close((uv_handle_t *)job->proc_stdout, close_cb);
     }
     if (opts.stderr_cb) {
-      uv_close((uv_handle_t *)&job->proc_stderr, close_cb);
+      uv_close((uv_handle_t *)job->proc_stderr, close_cb);
     }
     process_close(job);
     event_poll(0);
@@ -157,13 +167,19 @@ Job *job_start(JobOptions opts, int *status)
 
   // Start the readable streams
   if (opts.stdout_cb) {
-    job->out = rstream_new(read_cb, rbuffer_new(JOB_BUFFER_SIZE), job);
+    job->out = rstream_new(read_cb,
+                           rbuffer_new_growable(JOB_BUFFER_SIZE,
+                                                JOB_BUFFER_MAX_SIZE),
+                           job);
     rstream_set_stream(job->out, job->proc_stdout);
     rstream_start(job->out);
   }
 
   if (opts.stderr_cb) {
-    job->err = rstream_new(read_cb, rbuffer_new(JOB_BUFFER_SIZE), job);
+    job->err = rstream_new(read_cb,
+                           rbuffer_new_growable(JOB_BUFFER_SIZE,
+                                                JOB_BUFFER_MAX_SIZE),
+                           job);
     rstream_set_stream(job->err, job->proc_stderr);
     rstream_start(job->err);
   }
@@ -382,6 +398,15 @@ void job_close_streams(Job *job)
   close_job_err(job);
 }
 
+/// Returns the memory used by a job to the pool. Called when the last
+/// reference is released
+///
+/// @param job The Job instance
+void job_free(Job *job)
+{
+  kmp_free(JobPool, job_pool, job);
+}
+
 static void close_cb(uv_handle_t *handle)
 {
   job_decref(handle_get_job(handle));
@@ -5,6 +5,7 @@
 
 #include <uv.h>
 
+#include "nvim/os/job.h"
 #include "nvim/os/rstream_defs.h"
 #include "nvim/os/wstream_defs.h"
 #include "nvim/os/pipe_process.h"
@@ -109,7 +110,7 @@ static inline void job_decref(Job *job)
     free(job->proc_stderr->data);
     shell_free_argv(job->opts.argv);
     process_destroy(job);
-    free(job);
+    job_free(job);
   }
 }
 
@@ -8,10 +8,29 @@
 #include "nvim/os/job_defs.h"
 #include "nvim/os/job_private.h"
 #include "nvim/os/pipe_process.h"
+#include "nvim/lib/klist.h"
+#include "nvim/vim.h"
 #include "nvim/memory.h"
 
-#ifdef INCLUDE_GENERATED_DECLARATIONS
-# include "os/pipe_process.c.generated.h"
+#ifdef HAVE_POSIX_SPAWN
+# include <fcntl.h>
+# include <signal.h>
+# include <spawn.h>
+# include <unistd.h>
+# include <sys/wait.h>
+# ifdef HAVE__NSGETENVIRON
+#  include <crt_externs.h>
+#  define environ (*_NSGetEnviron())
+# else
+extern char **environ;
+# endif
+// glibc < 2.24 only uses vfork when explicitly asked to
+# ifdef POSIX_SPAWN_USEVFORK
+#  define SPAWN_FLAGS \
+  (POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_USEVFORK)
+# else
+#  define SPAWN_FLAGS (POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF)
+# endif
 #endif
 
 typedef struct {
@@ -20,11 +39,28 @@ typedef struct {
   uv_process_options_t proc_opts;
   uv_stdio_container_t stdio[3];
   uv_pipe_t proc_stdin, proc_stdout, proc_stderr;
+#ifdef HAVE_POSIX_SPAWN
+  // When the process is created with posix_spawn, libuv doesn't know about
+  // it and exit status is collected from a SIGCHLD watcher instead of `proc`
+  uv_signal_t schld;
+#endif
 } UvProcess;
 
+#define UvProcessFreer(x)
+KMEMPOOL_INIT(UvProcessPool, UvProcess, UvProcessFreer)
+static kmempool_t(UvProcessPool) *uvprocess_pool = NULL;
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "os/pipe_process.c.generated.h"
+#endif
+
 void pipe_process_init(Job *job)
 {
-  UvProcess *pipeproc = xmalloc(sizeof(UvProcess));
+  if (!uvprocess_pool) {
+    uvprocess_pool = kmp_init(UvProcessPool);
+  }
+
+  UvProcess *pipeproc = kmp_alloc(UvProcessPool, uvprocess_pool);
   pipeproc->proc_opts.file = job->opts.argv[0];
   pipeproc->proc_opts.args = job->opts.argv;
   pipeproc->proc_opts.stdio = pipeproc->stdio;
@@ -43,7 +79,13 @@ void pipe_process_init(Job *job)
   pipeproc->stdio[1].flags = UV_IGNORE;
   pipeproc->stdio[2].flags = UV_IGNORE;
 
+#ifdef HAVE_POSIX_SPAWN
+  uv_signal_init(uv_default_loop(), &pipeproc->schld);
+  pipeproc->schld.data = NULL;
+  handle_set_job((uv_handle_t *)&pipeproc->schld, job);
+#else
   handle_set_job((uv_handle_t *)&pipeproc->proc, job);
+#endif
 
   if (job->opts.writable) {
     uv_pipe_init(uv_default_loop(), &pipeproc->proc_stdin, 0);
@@ -73,7 +115,10 @@ void pipe_process_destroy(Job *job)
 {
   UvProcess *pipeproc = job->process;
   free(pipeproc->proc.data);
-  free(pipeproc);
+#ifdef HAVE_POSIX_SPAWN
+  free(pipeproc->schld.data);
+#endif
+  kmp_free(UvProcessPool, uvprocess_pool, pipeproc);
   job->process = NULL;
 }
 
@@ -81,20 +126,151 @@ bool pipe_process_spawn(Job *job)
 {
   UvProcess *pipeproc = job->process;
 
+#ifdef HAVE_POSIX_SPAWN
+  return posix_spawn_job(job, pipeproc);
+#else
   if (uv_spawn(uv_default_loop(), &pipeproc->proc, &pipeproc->proc_opts) != 0) {
     return false;
   }
 
   job->pid = pipeproc->proc.pid;
   return true;
+#endif
 }
 
 void pipe_process_close(Job *job)
 {
   UvProcess *pipeproc = job->process;
+#ifdef HAVE_POSIX_SPAWN
+  uv_signal_stop(&pipeproc->schld);
+  uv_close((uv_handle_t *)&pipeproc->schld, close_cb);
+#else
   uv_close((uv_handle_t *)&pipeproc->proc, close_cb);
+#endif
+}
+
+#ifdef HAVE_POSIX_SPAWN
+// Spawns the job with posix_spawn, which most libc implementations back with
+// vfork/clone(CLONE_VM) and is much cheaper than the fork + exec done by
+// `uv_spawn` when the editor has a large address space. The pipes are created
+// here and the parent ends handed to libuv with `uv_pipe_open`.
+static bool posix_spawn_job(Job *job, UvProcess *pipeproc)
+{
+  // parent/child ends of the pipes for std{in,out,err}
+  int parent_fds[3] = {-1, -1, -1}, child_fds[3] = {-1, -1, -1};
+  uv_pipe_t *pipes[3] = {
+    &pipeproc->proc_stdin, &pipeproc->proc_stdout, &pipeproc->proc_stderr
+  };
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+
+  for (int i = 0; i < 3; i++) {
+    if (pipeproc->stdio[i].flags == UV_IGNORE) {
+      continue;
+    }
+
+    int fds[2];
+    if (pipe(fds)) {
+      goto cleanup_fds;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    // stdin is read by the child, stdout/stderr are written by it
+    parent_fds[i] = i == 0 ? fds[1] : fds[0];
+    child_fds[i] = i == 0 ? fds[0] : fds[1];
+  }
+
+  posix_spawn_file_actions_init(&actions);
+  for (int i = 0; i < 3; i++) {
+    if (child_fds[i] == -1) {
+      posix_spawn_file_actions_addopen(&actions, i, "/dev/null",
+                                       i == 0 ? O_RDONLY : O_WRONLY, 0);
+    } else {
+      posix_spawn_file_actions_adddup2(&actions, child_fds[i], i);
+    }
+  }
+
+  // Signals handled by the editor must be restored to their defaults, and
+  // the child must not inherit a blocked signal mask.
+  sigset_t sigdefault, sigmask;
+  sigemptyset(&sigmask);
+  sigemptyset(&sigdefault);
+  sigaddset(&sigdefault, SIGCHLD);
+  sigaddset(&sigdefault, SIGHUP);
+  sigaddset(&sigdefault, SIGINT);
+  sigaddset(&sigdefault, SIGPIPE);
+  sigaddset(&sigdefault, SIGQUIT);
+  sigaddset(&sigdefault, SIGTERM);
+  sigaddset(&sigdefault, SIGALRM);
+  sigaddset(&sigdefault, SIGWINCH);
+#ifdef SIGPWR
+  sigaddset(&sigdefault, SIGPWR);
+#endif
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, SPAWN_FLAGS);
+  posix_spawnattr_setsigmask(&attr, &sigmask);
+  posix_spawnattr_setsigdefault(&attr, &sigdefault);
+
+  // Start watching before the process exists, otherwise a child that exits
+  // immediately could be missed
+  uv_signal_start(&pipeproc->schld, chld_handler, SIGCHLD);
+
+  pid_t pid;
+  int err = posix_spawnp(&pid, job->opts.argv[0], &actions, &attr,
+                         job->opts.argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+
+  if (err) {
+    uv_signal_stop(&pipeproc->schld);
+    goto cleanup_fds;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (parent_fds[i] != -1) {
+      close(child_fds[i]);
+      uv_pipe_open(pipes[i], parent_fds[i]);
+    }
+  }
+
+  job->pid = pid;
+  return true;
+
+cleanup_fds:
+  for (int i = 0; i < 3; i++) {
+    if (parent_fds[i] != -1) {
+      close(parent_fds[i]);
+      close(child_fds[i]);
+    }
+  }
+  return false;
 }
 
+static void chld_handler(uv_signal_t *handle, int signum)
+{
+  Job *job = handle_get_job((uv_handle_t *)handle);
+  int stat = 0;
+
+  // SIGCHLD may have been sent by any other child, only reap ours
+  if (waitpid(job->pid, &stat, WNOHANG) <= 0) {
+    return;
+  }
+
+  if (WIFSTOPPED(stat) || WIFCONTINUED(stat)) {
+    // Did not exit
+    return;
+  }
+
+  if (WIFEXITED(stat)) {
+    job->status = WEXITSTATUS(stat);
+  } else if (WIFSIGNALED(stat)) {
+    job->status = WTERMSIG(stat);
+  }
+
+  pipe_process_close(job);
+}
+#endif
+
 static void exit_cb(uv_process_t *proc, int64_t status, int term_signal)
 {
   Job *job = handle_get_job((uv_handle_t *)proc);
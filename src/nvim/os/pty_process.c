@@ -151,10 +151,15 @@ static void chld_handler(uv_signal_t *handle, int signum)
   Job *job = handle->data;
   int stat = 0;
 
-  if (waitpid(job->pid, &stat, 0) < 0) {
+  // SIGCHLD is also delivered for other children(pipe jobs), so never block
+  // here waiting for a process that is still running
+  int rv = waitpid(job->pid, &stat, WNOHANG);
+  if (rv < 0) {
     fprintf(stderr, "Waiting for pid %d failed: %s\n", job->pid,
         strerror(errno));
     return;
+  } else if (rv == 0) {
+    return;
   }
 
   if (WIFSTOPPED(stat) || WIFCONTINUED(stat)) {
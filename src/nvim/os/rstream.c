@@ -14,15 +14,21 @@
 #include "nvim/log.h"
 #include "nvim/misc1.h"
 
+// Ring buffer. Data is stored in at most two contiguous regions: the readable
+// bytes start at `rpos` and may wrap around to the start of `data`, so
+// consuming data never needs to move the unread bytes. When full, the buffer
+// can grow up to `max_capacity` instead of stopping the associated RStream.
 struct rbuffer {
   char *data;
-  size_t capacity, rpos, wpos;
+  // `size` is the number of bytes pending, which disambiguates a full buffer
+  // from an empty one when `rpos == wpos`
+  size_t initial_capacity, capacity, max_capacity, rpos, wpos, size;
   RStream *rstream;
 };
 
 struct rstream {
   void *data;
-  uv_buf_t uvbuf;
+  uv_buf_t uvbufs[2];
   size_t fpos;
   RBuffer *buffer;
   uv_stream_t *stream;
@@ -33,17 +39,49 @@ struct rstream {
   bool free_handle;
 };
 
+// Number of released buffers kept for reuse. Streams are created and freed
+// for every job, so this avoids allocating(and faulting in) a new data array
+// each time.
+#define RBUFFER_CACHE_SIZE 16
+static RBuffer *rbuffer_cache[RBUFFER_CACHE_SIZE];
+static size_t rbuffer_cache_count = 0;
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "os/rstream.c.generated.h"
 #endif
 
-/// Creates a new `RBuffer` instance.
+/// Creates a new `RBuffer` instance with a fixed capacity.
 RBuffer *rbuffer_new(size_t capacity)
 {
-  RBuffer *rv = xmalloc(sizeof(RBuffer));
-  rv->data = xmalloc(capacity);
-  rv->capacity = capacity;
-  rv->rpos = rv->wpos = 0;
+  return rbuffer_new_growable(capacity, capacity);
+}
+
+/// Creates a new `RBuffer` instance that doubles its capacity when full,
+/// until `max_capacity` is reached.
+///
+/// @param capacity The initial capacity
+/// @param max_capacity Maximum capacity the buffer can grow to
+RBuffer *rbuffer_new_growable(size_t capacity, size_t max_capacity)
+{
+  assert(capacity && max_capacity >= capacity);
+  RBuffer *rv = NULL;
+
+  for (size_t i = rbuffer_cache_count; i > 0; i--) {
+    if (rbuffer_cache[i - 1]->capacity == capacity) {
+      rv = rbuffer_cache[i - 1];
+      rbuffer_cache[i - 1] = rbuffer_cache[--rbuffer_cache_count];
+      break;
+    }
+  }
+
+  if (!rv) {
+    rv = xmalloc(sizeof(RBuffer));
+    rv->data = xmalloc(capacity);
+  }
+
+  rv->initial_capacity = rv->capacity = capacity;
+  rv->max_capacity = max_capacity;
+  rv->rpos = rv->wpos = rv->size = 0;
   rv->rstream = NULL;
   return rv;
 }
@@ -56,29 +94,37 @@ RBuffer *rbuffer_new(size_t capacity)
 /// consumed.
 void rbuffer_consumed(RBuffer *rbuffer, size_t count)
 {
-  rbuffer->rpos += count;
-  if (count && rbuffer->wpos == rbuffer->capacity) {
-    // `wpos` is at the end of the buffer, so free some space by moving unread
-    // data...
-    rbuffer_relocate(rbuffer);
-    if (rbuffer->rstream) {
-      // restart the associated RStream
-      rstream_start(rbuffer->rstream);
-    }
+  assert(count <= rbuffer->size);
+  bool was_full = rbuffer->size == rbuffer->capacity;
+
+  rbuffer->rpos = (rbuffer->rpos + count) % rbuffer->capacity;
+  rbuffer->size -= count;
+
+  if (!rbuffer->size) {
+    // Keep the free space contiguous when possible
+    rbuffer->rpos = rbuffer->wpos = 0;
+  }
+
+  if (count && was_full && rbuffer->capacity == rbuffer->max_capacity
+      && rbuffer->rstream) {
+    // The associated RStream was stopped because the buffer could not grow
+    // any further, restart it
+    rstream_start(rbuffer->rstream);
   }
 }
 
-/// Advances `rbuffer` write pointers. If the internal buffer becomes full,
-/// this will stop the associated RStream instance.
+/// Advances `rbuffer` write pointers. If the internal buffer becomes full and
+/// cannot grow, this will stop the associated RStream instance.
 void rbuffer_produced(RBuffer *rbuffer, size_t count)
 {
-  rbuffer->wpos += count;
+  assert(count <= rbuffer->capacity - rbuffer->size);
+  rbuffer->wpos = (rbuffer->wpos + count) % rbuffer->capacity;
+  rbuffer->size += count;
   DLOG("Received %u bytes from RStream(%p)", (size_t)count, rbuffer->rstream);
 
-  rbuffer_relocate(rbuffer);
-  if (rbuffer->rstream && rbuffer->wpos == rbuffer->capacity) {
+  if (rbuffer->rstream && rbuffer->size == rbuffer->capacity
+      && rbuffer->capacity == rbuffer->max_capacity) {
     // The last read filled the buffer, stop reading for now
-    //
     rstream_stop(rbuffer->rstream);
     DLOG("Buffer for RStream(%p) is full, stopping it", rbuffer->rstream);
   }
@@ -92,21 +138,34 @@ void rbuffer_produced(RBuffer *rbuffer, size_t count)
 /// @return The number of bytes copied into `buffer`
 size_t rbuffer_read(RBuffer *rbuffer, char *buffer, size_t count)
 {
-  size_t read_count = rbuffer_pending(rbuffer);
-
-  if (count < read_count) {
-    read_count = count;
-  }
+  size_t read_count = rbuffer_peek(rbuffer, buffer, count);
+  rbuffer_consumed(rbuffer, read_count);
+  return read_count;
+}
 
-  if (read_count > 0) {
-    memcpy(buffer, rbuffer_read_ptr(rbuffer), read_count);
-    rbuffer_consumed(rbuffer, read_count);
+/// Copies data from a `RBuffer` instance into a raw buffer, without
+/// consuming it.
+///
+/// @param rbuffer The `RBuffer` instance
+/// @param buffer The buffer which will receive the data
+/// @param count Number of bytes that `buffer` can accept
+/// @return The number of bytes copied into `buffer`
+size_t rbuffer_peek(RBuffer *rbuffer, char *buffer, size_t count)
+{
+  uv_buf_t iov[2];
+  size_t iovcnt = rbuffer_read_iov(rbuffer, iov);
+  size_t copied = 0;
+
+  for (size_t i = 0; i < iovcnt && copied < count; i++) {
+    size_t n = MIN(iov[i].len, count - copied);
+    memcpy(buffer + copied, iov[i].base, n);
+    copied += n;
   }
 
-  return read_count;
+  return copied;
 }
 
-/// Copies data to `rbuffer` read queue.
+/// Copies data to `rbuffer` read queue, growing it if necessary and allowed.
 ///
 /// @param rbuffer the `RBuffer` instance
 /// @param buffer The buffer containing data to be copied
@@ -114,54 +173,159 @@ size_t rbuffer_read(RBuffer *rbuffer, char *buffer, size_t count)
 /// @return The number of bytes actually copied
 size_t rbuffer_write(RBuffer *rbuffer, char *buffer, size_t count)
 {
-  size_t write_count = rbuffer_available(rbuffer);
+  while (rbuffer_available(rbuffer) < count && rbuffer_grow(rbuffer)) {
+    // grow until `count` bytes fit or the maximum capacity is reached
+  }
 
-  if (count < write_count) {
-    write_count = count;
+  uv_buf_t iov[2];
+  size_t iovcnt = rbuffer_write_iov(rbuffer, iov);
+  size_t copied = 0;
+
+  for (size_t i = 0; i < iovcnt && copied < count; i++) {
+    size_t n = MIN(iov[i].len, count - copied);
+    memcpy(iov[i].base, buffer + copied, n);
+    copied += n;
   }
 
-  if (write_count > 0) {
-    memcpy(rbuffer_write_ptr(rbuffer), buffer, write_count);
-    rbuffer_produced(rbuffer, write_count);
+  if (copied > 0) {
+    rbuffer_produced(rbuffer, copied);
   }
 
-  return write_count;
+  return copied;
 }
 
-/// Returns a pointer to a raw buffer containing the first byte available for
-/// reading.
-char *rbuffer_read_ptr(RBuffer *rbuffer)
+/// Returns a pointer to the first contiguous region of data available for
+/// reading. More data may be available at the start of the buffer, use
+/// `rbuffer_read_iov` to get both regions.
+///
+/// @param rbuffer The `RBuffer` instance
+/// @param[out] count Number of bytes readable from the returned pointer
+char *rbuffer_read_ptr(RBuffer *rbuffer, size_t *count)
 {
+  *count = MIN(rbuffer->size, rbuffer->capacity - rbuffer->rpos);
   return rbuffer->data + rbuffer->rpos;
 }
 
-/// Returns a pointer to a raw buffer containing the first byte available for
-/// write.
-char *rbuffer_write_ptr(RBuffer *rbuffer)
+/// Returns a pointer to the first contiguous region of free space.
+///
+/// @param rbuffer The `RBuffer` instance
+/// @param[out] count Number of bytes writable from the returned pointer
+char *rbuffer_write_ptr(RBuffer *rbuffer, size_t *count)
 {
+  if (rbuffer->size == rbuffer->capacity) {
+    *count = 0;
+  } else if (rbuffer->wpos >= rbuffer->rpos) {
+    *count = rbuffer->capacity - rbuffer->wpos;
+  } else {
+    *count = rbuffer->rpos - rbuffer->wpos;
+  }
   return rbuffer->data + rbuffer->wpos;
 }
 
+/// Fills `iov` with the (at most two) contiguous regions holding data ready
+/// for consumption, in order.
+///
+/// @param rbuffer The `RBuffer` instance
+/// @param[out] iov Array that receives the regions
+/// @return The number of regions filled
+size_t rbuffer_read_iov(RBuffer *rbuffer, uv_buf_t iov[2])
+{
+  size_t count;
+  iov[0].base = rbuffer_read_ptr(rbuffer, &count);
+  iov[0].len = count;
+
+  if (!count) {
+    return 0;
+  } else if (count == rbuffer->size) {
+    return 1;
+  }
+
+  iov[1].base = rbuffer->data;
+  iov[1].len = rbuffer->size - count;
+  return 2;
+}
+
+/// Fills `iov` with the (at most two) contiguous regions of free space, in
+/// order.
+///
+/// @param rbuffer The `RBuffer` instance
+/// @param[out] iov Array that receives the regions
+/// @return The number of regions filled
+size_t rbuffer_write_iov(RBuffer *rbuffer, uv_buf_t iov[2])
+{
+  size_t count;
+  iov[0].base = rbuffer_write_ptr(rbuffer, &count);
+  iov[0].len = count;
+
+  if (!count) {
+    return 0;
+  } else if (count == rbuffer_available(rbuffer)) {
+    return 1;
+  }
+
+  iov[1].base = rbuffer->data;
+  iov[1].len = rbuffer_available(rbuffer) - count;
+  return 2;
+}
+
+/// Returns the byte at `index`, relative to the first byte pending for
+/// consumption.
+char rbuffer_get(RBuffer *rbuffer, size_t index)
+{
+  assert(index < rbuffer->size);
+  return rbuffer->data[(rbuffer->rpos + index) % rbuffer->capacity];
+}
+
+/// Compares the first `count` bytes pending in `rbuffer` with `str`. Returns
+/// 0 if they are equal, nonzero otherwise(also when less than `count` bytes
+/// are pending).
+int rbuffer_cmp(RBuffer *rbuffer, const char *str, size_t count)
+{
+  if (rbuffer->size < count) {
+    return -1;
+  }
+
+  size_t n;
+  char *ptr = rbuffer_read_ptr(rbuffer, &n);
+  n = MIN(n, count);
+  int rv = memcmp(ptr, str, n);
+
+  if (rv || n == count) {
+    return rv;
+  }
+
+  return memcmp(rbuffer->data, str + n, count - n);
+}
+
 /// Returns the number of bytes ready for consumption in `rbuffer`
 ///
 /// @param rbuffer The `RBuffer` instance
 /// @return The number of bytes ready for consumption
 size_t rbuffer_pending(RBuffer *rbuffer)
 {
-  return rbuffer->wpos - rbuffer->rpos;
+  return rbuffer->size;
 }
 
-/// Returns available space in `rbuffer`
+/// Returns available space in `rbuffer`, without growing it.
 ///
 /// @param rbuffer The `RBuffer` instance
 /// @return The space available in number of bytes
 size_t rbuffer_available(RBuffer *rbuffer)
 {
-  return rbuffer->capacity - rbuffer->wpos;
+  return rbuffer->capacity - rbuffer->size;
 }
 
 void rbuffer_free(RBuffer *rbuffer)
 {
+  // Only keep buffers that didn't grow, they are the ones likely to be
+  // requested again
+  if (rbuffer->capacity == rbuffer->initial_capacity
+      && rbuffer_cache_count < RBUFFER_CACHE_SIZE) {
+    rbuffer->rstream = NULL;
+    rbuffer_cache[rbuffer_cache_count++] = rbuffer;
+    return;
+  }
+
   free(rbuffer->data);
   free(rbuffer);
 }
@@ -191,9 +355,13 @@ RStream * rstream_new(rstream_cb cb, RBuffer *buffer, void *data)
 }
 
 /// Returns the read pointer used by the rstream.
-char *rstream_read_ptr(RStream *rstream)
+///
+/// @param rstream The `RStream` instance
+/// @param[out] count Number of bytes readable from the returned pointer
+/// @see rbuffer_read_ptr
+char *rstream_read_ptr(RStream *rstream, size_t *count)
 {
-  return rbuffer_read_ptr(rstream->buffer);
+  return rbuffer_read_ptr(rstream->buffer, count);
 }
 
 /// Returns the number of bytes before the rstream is full.
@@ -324,8 +492,15 @@ static void alloc_cb(uv_handle_t *handle, size_t suggested, uv_buf_t *buf)
 {
   RStream *rstream = handle_get_rstream(handle);
 
-  buf->len = rbuffer_available(rstream->buffer);
-  buf->base = rbuffer_write_ptr(rstream->buffer);
+  if (!rbuffer_available(rstream->buffer)) {
+    // The consumer is lagging, give it more room instead of blocking the
+    // producer
+    rbuffer_grow(rstream->buffer);
+  }
+
+  size_t count;
+  buf->base = rbuffer_write_ptr(rstream->buffer, &count);
+  buf->len = count;
 }
 
 // Callback invoked by libuv after it copies the data into the buffer provided
@@ -361,8 +536,16 @@ static void fread_idle_cb(uv_idle_t *handle)
   uv_fs_t req;
   RStream *rstream = handle_get_rstream((uv_handle_t *)handle);
 
-  rstream->uvbuf.len = rbuffer_available(rstream->buffer);
-  rstream->uvbuf.base = rbuffer_write_ptr(rstream->buffer);
+  if (!rbuffer_available(rstream->buffer)) {
+    rbuffer_grow(rstream->buffer);
+  }
+
+  // Scatter read into both free regions of the ring buffer
+  size_t iovcnt = rbuffer_write_iov(rstream->buffer, rstream->uvbufs);
+
+  if (!iovcnt) {
+    return;
+  }
 
   // the offset argument to uv_fs_read is int64_t, could someone really try
   // to read more than 9 quintillion (9e18) bytes?
@@ -378,8 +561,8 @@ static void fread_idle_cb(uv_idle_t *handle)
       uv_default_loop(),
       &req,
       rstream->fd,
-      &rstream->uvbuf,
-      1,
+      rstream->uvbufs,
+      (unsigned int)iovcnt,
       (int64_t) rstream->fpos,
       NULL);
 
@@ -402,14 +585,39 @@ static void close_cb(uv_handle_t *handle)
   free(handle);
 }
 
-static void rbuffer_relocate(RBuffer *rbuffer)
+// Doubles the capacity of `rbuffer`(up to `max_capacity`), moving the data
+// that wrapped around to keep the readable regions in order.
+//
+// @return false if the buffer can't grow any further
+static bool rbuffer_grow(RBuffer *rbuffer)
 {
-  assert(rbuffer->rpos <= rbuffer->wpos);
-  // Move data ...
-  memmove(
-      rbuffer->data,  // ...to the beginning of the buffer(rpos 0)
-      rbuffer->data + rbuffer->rpos,  // ...From the first unread position
-      rbuffer->wpos - rbuffer->rpos);  // ...By the number of unread bytes
-  rbuffer->wpos -= rbuffer->rpos;
-  rbuffer->rpos = 0;
+  if (rbuffer->capacity == rbuffer->max_capacity) {
+    return false;
+  }
+
+  size_t old_capacity = rbuffer->capacity;
+  size_t new_capacity = MIN(old_capacity * 2, rbuffer->max_capacity);
+  rbuffer->data = xrealloc(rbuffer->data, new_capacity);
+
+  if (rbuffer->size && rbuffer->wpos <= rbuffer->rpos) {
+    // Data wraps around(or the buffer is full): the second region, at the
+    // start of the array, must follow the first one, which is now at the
+    // start of the new free space. Copy as much of it as fits there and
+    // shift what doesn't.
+    size_t wrapped = rbuffer->wpos;
+    size_t extra = new_capacity - old_capacity;
+    size_t n = MIN(wrapped, extra);
+    memcpy(rbuffer->data + old_capacity, rbuffer->data, n);
+    if (n < wrapped) {
+      memmove(rbuffer->data, rbuffer->data + n, wrapped - n);
+    }
+    rbuffer->wpos = (old_capacity + wrapped) % new_capacity;
+  } else if (!rbuffer->size) {
+    rbuffer->rpos = rbuffer->wpos = 0;
+  }
+
+  rbuffer->capacity = new_capacity;
+  DLOG("Buffer for RStream(%p) grew to %u bytes", rbuffer->rstream,
+       new_capacity);
+  return true;
 }
@@ -296,9 +296,21 @@ static void system_data_cb(RStream *rstream, void *data, bool eof)
 static void out_data_cb(RStream *rstream, void *data, bool eof)
 {
   RBuffer *rbuffer = rstream_buffer(rstream);
-  size_t written = write_output(rbuffer_read_ptr(rbuffer),
-                                rbuffer_pending(rbuffer), false, eof);
-  rbuffer_consumed(rbuffer, written);
+  size_t count, pending = rbuffer_pending(rbuffer);
+  char *ptr = rbuffer_read_ptr(rbuffer, &count);
+
+  if (count == pending) {
+    rbuffer_consumed(rbuffer, write_output(ptr, count, false, eof));
+    return;
+  }
+
+  // The pending data wraps around the end of the buffer. Lines must be
+  // contiguous for write_output, so work on a copy and only consume what was
+  // written(an incomplete last line stays in the buffer).
+  char *copy = xmalloc(pending);
+  rbuffer_peek(rbuffer, copy, pending);
+  rbuffer_consumed(rbuffer, write_output(copy, pending, false, eof));
+  free(copy);
 }
 
 /// Parses a command string into a sequence of words, taking quotes into
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -6,21 +7,31 @@
 #include <uv.h>
 
 #include "nvim/lib/klist.h"
+#include "nvim/lib/kvec.h"
 
 #include "nvim/os/uv_helpers.h"
 #include "nvim/os/wstream.h"
 #include "nvim/os/wstream_defs.h"
 #include "nvim/vim.h"
 #include "nvim/memory.h"
+#include "nvim/log.h"
 
 #define DEFAULT_MAXMEM 1024 * 1024 * 10
+// Queued data is flushed without waiting for the end of the loop iteration
+// when it grows past this size
+#define FLUSH_THRESHOLD 0xFFFF
+
+typedef kvec_t(WBuffer *) WBufferVec;
 
 struct wstream {
   uv_stream_t *stream;
-  // Memory currently used by pending buffers
+  // Memory currently used by queued and in-flight buffers
   size_t curmem;
   // Maximum memory used by this instance
   size_t maxmem;
+  // Buffers waiting to be flushed and their total size in bytes
+  WBufferVec queue;
+  size_t queued_bytes;
   // Number of pending requests
   size_t pending_reqs;
   bool freed, free_handle;
@@ -37,7 +48,9 @@ struct wbuffer {
 
 typedef struct {
   WStream *wstream;
-  WBuffer *buffer;
+  // Buffers sent with this request, owned by it until `write_cb`
+  WBufferVec buffers;
+  size_t size;
   uv_write_t uv_req;
 } WRequest;
 
@@ -48,6 +61,15 @@ kmempool_t(WRequestPool) *wrequest_pool = NULL;
 KMEMPOOL_INIT(WBufferPool, WBuffer, WBufferFreer)
 kmempool_t(WBufferPool) *wbuffer_pool = NULL;
 
+// WStreams with queued buffers, flushed by `flush_prepare` before the event
+// loop polls for I/O again
+static kvec_t(WStream *) dirty_streams = {0, 0, NULL};
+static kvec_t(uv_buf_t) flush_bufs = {0, 0, NULL};
+static uv_prepare_t flush_prepare;
+// Number of buffers written and number of `uv_write` calls used to write
+// them. The difference is the number of writes saved by coalescing.
+static uint64_t buffers_written = 0, uv_writes = 0;
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "os/wstream.c.generated.h"
 #endif
@@ -57,6 +79,29 @@ void wstream_init(void)
 {
   wrequest_pool = kmp_init(WRequestPool);
   wbuffer_pool = kmp_init(WBufferPool);
+  uv_prepare_init(uv_default_loop(), &flush_prepare);
+}
+
+/// Flushes all queued writes and releases the resources used for write
+/// coalescing.
+void wstream_teardown(void)
+{
+  flush_all();
+  uv_close((uv_handle_t *)&flush_prepare, NULL);
+  ILOG("%" PRIu64 " buffers written with %" PRIu64 " write requests",
+       buffers_written, uv_writes);
+}
+
+/// Gets the write coalescing counters. `buffers - writes` is the number of
+/// `uv_write` calls(and thus syscalls) saved by coalescing queued buffers
+/// into a single write.
+///
+/// @param[out] buffers Number of buffers written
+/// @param[out] writes Number of `uv_write` calls used to write them
+void wstream_get_stats(uint64_t *buffers, uint64_t *writes)
+{
+  *buffers = buffers_written;
+  *writes = uv_writes;
 }
 
 /// Creates a new WStream instance. A WStream encapsulates all the boilerplate
@@ -75,6 +120,8 @@ WStream * wstream_new(size_t maxmem)
   rv->maxmem = maxmem;
   rv->stream = NULL;
   rv->curmem = 0;
+  kv_init(rv->queue);
+  rv->queued_bytes = 0;
   rv->pending_reqs = 0;
   rv->freed = false;
   rv->free_handle = false;
@@ -87,6 +134,10 @@ WStream * wstream_new(size_t maxmem)
 ///
 /// @param wstream The `WStream` instance
 void wstream_free(WStream *wstream) {
+  // Send whatever is still queued, it would be lost otherwise
+  wstream_flush(wstream);
+  kv_destroy(wstream->queue);
+
   if (!wstream->pending_reqs) {
     if (wstream->free_handle) {
       uv_close((uv_handle_t *)wstream->stream, close_cb);
@@ -133,8 +184,11 @@ void wstream_set_file(WStream *wstream, uv_file file)
 /// This affects all requests currently in-flight as well. Overwrites any
 /// possible earlier callback.
 ///
-/// @note This callback will not fire if the write request couldn't even be
-///       queued properly (i.e.: when `wstream_write() returns an error`).
+/// @note Queued buffers are sent later, when the event loop is about to poll
+///       for I/O. If the write request can't be sent then, the callback is
+///       called with the error of `uv_write`. It is not called for failures
+///       already reported by `wstream_write` or `wstream_flush` returning
+///       false, nor after the `WStream` was freed.
 ///
 /// @param wstream The `WStream` instance
 /// @param cb The callback
@@ -150,6 +204,10 @@ void wstream_set_write_cb(WStream *wstream, wstream_cb cb, void *data)
 /// instance. This will fail if the write would cause the WStream use more
 /// memory than specified by `maxmem`.
 ///
+/// Buffers are not written immediately: all buffers queued during one event
+/// loop iteration are sent with a single `uv_write` call before the loop
+/// polls for I/O again, or earlier when enough data is queued.
+///
 /// @param wstream The `WStream` instance
 /// @param buffer The buffer which contains data to be written
 /// @return false if the write failed
@@ -159,31 +217,82 @@ bool wstream_write(WStream *wstream, WBuffer *buffer)
   assert(!wstream->freed);
 
   if (wstream->curmem > wstream->maxmem) {
-    goto err;
+    release_wbuffer(buffer);
+    return false;
   }
 
   wstream->curmem += buffer->size;
 
+  if (!kv_size(wstream->queue)) {
+    if (!kv_size(dirty_streams)) {
+      uv_prepare_start(&flush_prepare, flush_prepare_cb);
+    }
+    kv_push(WStream *, dirty_streams, wstream);
+  }
+
+  kv_push(WBuffer *, wstream->queue, buffer);
+  wstream->queued_bytes += buffer->size;
+
+  if (wstream->queued_bytes >= FLUSH_THRESHOLD) {
+    return wstream_flush(wstream);
+  }
+
+  return true;
+}
+
+/// Sends all buffers queued in a `WStream` with a single write request.
+///
+/// @param wstream The `WStream` instance
+/// @return false if the write request could not be sent
+bool wstream_flush(WStream *wstream)
+{
+  return send_queue(wstream) == 0;
+}
+
+/// Like `wstream_flush`, but returns the reason of a failure.
+///
+/// @return 0 on success, the error of `uv_write` otherwise
+static int send_queue(WStream *wstream)
+{
+  size_t count = kv_size(wstream->queue);
+
+  if (!count) {
+    return 0;
+  }
+
+  remove_dirty_stream(wstream);
+
   WRequest *data = kmp_alloc(WRequestPool, wrequest_pool);
   data->wstream = wstream;
-  data->buffer = buffer;
+  // The request takes ownership of the queued buffers
+  data->buffers = wstream->queue;
+  data->size = wstream->queued_bytes;
   data->uv_req.data = data;
+  kv_init(wstream->queue);
+  wstream->queued_bytes = 0;
 
-  uv_buf_t uvbuf;
-  uvbuf.base = buffer->data;
-  uvbuf.len = buffer->size;
+  // libuv copies the `uv_buf_t` array, so it can be reused
+  if (kv_max(flush_bufs) < count) {
+    kv_resize(uv_buf_t, flush_bufs, count);
+  }
+  for (size_t i = 0; i < count; i++) {
+    WBuffer *buffer = kv_A(data->buffers, i);
+    kv_A(flush_bufs, i).base = buffer->data;
+    kv_A(flush_bufs, i).len = buffer->size;
+  }
 
-  if (uv_write(&data->uv_req, wstream->stream, &uvbuf, 1, write_cb)) {
-    kmp_free(WRequestPool, wrequest_pool, data);
-    goto err;
+  int status = uv_write(&data->uv_req, wstream->stream, flush_bufs.items,
+                        (unsigned int)count, write_cb);
+  if (status) {
+    wstream->curmem -= data->size;
+    free_wrequest(data);
+    return status;
   }
 
+  buffers_written += count;
+  uv_writes++;
   wstream->pending_reqs++;
-  return true;
-
-err:
-  release_wbuffer(buffer);
-  return false;
+  return 0;
 }
 
 /// Creates a WBuffer object for holding output data. Instances of this
@@ -216,11 +325,10 @@ static void write_cb(uv_write_t *req, int status)
 {
   WRequest *data = req->data;
 
-  data->wstream->curmem -= data->buffer->size;
+  data->wstream->curmem -= data->size;
 
-  release_wbuffer(data->buffer);
-
-  if (data->wstream->cb) {
+  // The owner of a freed WStream no longer expects to hear from it
+  if (data->wstream->cb && !data->wstream->freed) {
     data->wstream->cb(data->wstream,
                       data->wstream->data,
                       status);
@@ -237,9 +345,50 @@ static void write_cb(uv_write_t *req, int status)
     }
   }
 
+  free_wrequest(data);
+}
+
+static void free_wrequest(WRequest *data)
+{
+  for (size_t i = 0; i < kv_size(data->buffers); i++) {
+    release_wbuffer(kv_A(data->buffers, i));
+  }
+  kv_destroy(data->buffers);
   kmp_free(WRequestPool, wrequest_pool, data);
 }
 
+static void flush_prepare_cb(uv_prepare_t *handle)
+{
+  flush_all();
+}
+
+static void flush_all(void)
+{
+  while (kv_size(dirty_streams)) {
+    WStream *wstream = kv_A(dirty_streams, kv_size(dirty_streams) - 1);
+    int status = send_queue(wstream);
+    if (status && wstream->cb) {
+      // Nobody is waiting for the result of the queued writes, report the
+      // failure like a failed write request
+      wstream->cb(wstream, wstream->data, status);
+    }
+  }
+}
+
+static void remove_dirty_stream(WStream *wstream)
+{
+  for (size_t i = kv_size(dirty_streams); i > 0; i--) {
+    if (kv_A(dirty_streams, i - 1) == wstream) {
+      kv_A(dirty_streams, i - 1) = kv_pop(dirty_streams);
+      break;
+    }
+  }
+
+  if (!kv_size(dirty_streams)) {
+    uv_prepare_stop(&flush_prepare);
+  }
+}
+
 static void release_wbuffer(WBuffer *buffer)
 {
   if (!--buffer->refcount) {
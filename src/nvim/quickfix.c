@@ -12,9 +12,13 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <uv.h>
 
 #include "nvim/vim.h"
 #include "nvim/ascii.h"
@@ -140,6 +144,60 @@ struct efm_S {
   int conthere;                 /* %> used */
 };
 
+/*
+ * With ":vimgrep /pat/p" worker threads read the files ahead of the main
+ * thread and tell which ones can't contain a match.  Those are skipped
+ * without loading them into a buffer.
+ * When the matches of the pattern only depend on the text of a line, each
+ * worker matches the lines of the file with a program of its own.  The
+ * 'iskeyword' of the buffers the files would be loaded into is copied for
+ * them, since the main thread changes curbuf while they are busy.  Files are
+ * matched as they are on disk, thus when a buffer may get other lines (the
+ * file isn't valid in 'encoding' or has a BOM, a CR may end a line) the file
+ * is left to the main thread.
+ * For other patterns the workers only check for the text the pattern
+ * requires.
+ * Files with a match are loaded and searched by the main thread, for the
+ * autocommands and to find the positions, thus the matches are found in the
+ * same order as without "p".
+ */
+#define VGR_MAX_THREADS 8
+#define VGR_CHUNK       65536           /* bytes read at a time */
+
+/* State of a file in vgr_pool_T. */
+#define VGR_PENDING     0               /* not checked yet */
+#define VGR_SKIP        1               /* can't contain a match */
+#define VGR_SEARCH      2               /* must be searched */
+
+typedef struct vgr_pool vgr_pool_T;
+
+typedef struct {
+  vgr_pool_T  *pool;
+  char_u      *buf;                     /* VGR_CHUNK + overlap bytes, when
+                                           matching grows for long lines */
+  size_t bufsize;
+  regmatch_T regmatch;                  /* private program when matching */
+  uv_thread_t thread;
+} vgr_worker_T;
+
+struct vgr_pool {
+  regprog_T   *prog;                    /* only read by the workers */
+  int ic;                               /* 'ignorecase' */
+  int match;                            /* workers match the lines */
+  buf_T       *isk_buf;                 /* only b_chartab, for 'iskeyword' */
+  int cr_lines;                         /* a CR may end a line */
+  size_t overlap;                       /* bytes kept between chunks */
+  char_u      **fnames;                 /* full file names */
+  int fcount;
+  uv_mutex_t mutex;                     /* protects the members below */
+  uv_cond_t checked;                    /* signalled when a file is checked */
+  int next;                             /* next file to check */
+  int cancel;                           /* workers must stop */
+  char        *state;                   /* VGR_ state of each file */
+  int nworkers;
+  vgr_worker_T workers[VGR_MAX_THREADS];
+};
+
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "quickfix.c.generated.h"
@@ -2700,6 +2758,331 @@ void ex_cfile(exarg_T *eap)
   }
 }
 
+/*
+ * Return FALSE when file "fname" doesn't contain any text the pattern of
+ * "pool" requires.  Runs in a worker thread, thus must not use the memory
+ * allocation functions or anything else that isn't thread-safe.
+ */
+static int vgr_file_may_match(vgr_pool_T *pool, const char *fname,
+                              char_u *buf)
+{
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    /* Let the main thread give the error. */
+    return TRUE;
+  }
+
+  size_t have = 0;
+  int may_match = FALSE;
+  for (;;) {
+    ssize_t n = read(fd, buf + have, VGR_CHUNK);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      may_match = TRUE;
+      break;
+    }
+    if (n == 0)
+      break;
+    have += (size_t)n;
+    if (vim_regtext_may_match(pool->prog, pool->ic, buf, have)) {
+      may_match = TRUE;
+      break;
+    }
+    /* Keep the end, the text may continue in the next chunk. */
+    size_t keep = MIN(have, pool->overlap);
+    memmove(buf, buf + have - keep, keep);
+    have = keep;
+  }
+  close(fd);
+  return may_match;
+}
+
+/*
+ * Return TRUE when a line of file "fname" matches the program of "worker",
+ * or when the lines of a buffer with the file may differ from it.  Runs in a
+ * worker thread, like vgr_file_may_match().
+ */
+static int vgr_file_match(vgr_worker_T *worker, const char *fname)
+{
+  vgr_pool_T *pool = worker->pool;
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    /* Let the main thread give the error. */
+    return TRUE;
+  }
+
+  size_t have = 0;
+  int first = TRUE;
+  int found = FALSE;
+  for (;;) {
+    /* Leave room for the NUL after the last line. */
+    ssize_t n = read(fd, worker->buf + have, worker->bufsize - 1 - have);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      found = TRUE;
+      break;
+    }
+    int eof = n == 0;
+    have += (size_t)n;
+
+    /* Match the complete lines, at the end of the file also the last one
+     * without a NL. */
+    char_u *line = worker->buf;
+    char_u *end = worker->buf + have;
+    while (line < end && !found) {
+      char_u *nl = memchr(line, NL, (size_t)(end - line));
+      if (nl == NULL) {
+        if (!eof)
+          break;
+        nl = end;
+      }
+      found = vgr_line_match(worker, line, nl, first);
+      first = FALSE;
+      line = nl + 1;
+    }
+    if (found || eof)
+      break;
+
+    /* Keep the incomplete line for the next read, make room when it fills
+     * the buffer. */
+    have = (size_t)(end - line);
+    memmove(worker->buf, line, have);
+    if (have == worker->bufsize - 1) {
+      char_u *buf = realloc(worker->buf, worker->bufsize * 2);
+      if (buf == NULL) {
+        found = TRUE;
+        break;
+      }
+      worker->buf = buf;
+      worker->bufsize *= 2;
+    }
+
+    uv_mutex_lock(&pool->mutex);
+    int cancel = pool->cancel;
+    uv_mutex_unlock(&pool->mutex);
+    if (cancel)
+      break;
+  }
+  close(fd);
+  return found;
+}
+
+/*
+ * Match the line from "line" to "end" of a file for vgr_file_match().
+ * "first" is TRUE for the first line of the file.  Return TRUE when it
+ * matches, or when it may be different in a buffer.
+ */
+static int vgr_line_match(vgr_worker_T *worker, char_u *line, char_u *end,
+                          int first)
+{
+  size_t len = (size_t)(end - line);
+
+  if (enc_utf8
+      && (utf_valid_len(line, len) != len
+          || (first && len >= 3
+              && line[0] == 0xef && line[1] == 0xbb && line[2] == 0xbf)))
+    /* The file would be converted, or the BOM removed. */
+    return TRUE;
+  if (worker->pool->cr_lines && memchr(line, CAR, len) != NULL)
+    return TRUE;
+
+  /* NUL is stored as NL in a buffer. */
+  for (size_t i = 0; i < len; i++) {
+    if (line[i] == NUL)
+      line[i] = NL;
+  }
+  *end = NUL;
+  if (vim_regexec(&worker->regmatch, line, 0))
+    return TRUE;
+  /* The CR before the NL is removed when the file is in dos format. */
+  if (len > 0 && line[len - 1] == CAR) {
+    line[len - 1] = NUL;
+    return vim_regexec(&worker->regmatch, line, 0);
+  }
+  return FALSE;
+}
+
+static void vgr_worker(void *arg)
+{
+  vgr_worker_T *worker = arg;
+  vgr_pool_T *pool = worker->pool;
+
+  if (pool->match)
+    regexec_thread_init(pool->isk_buf);
+  for (;;) {
+    uv_mutex_lock(&pool->mutex);
+    int fi = pool->cancel ? pool->fcount : pool->next++;
+    uv_mutex_unlock(&pool->mutex);
+    if (fi >= pool->fcount)
+      break;
+
+    char *fname = (char *)pool->fnames[fi];
+    int found = pool->match ? vgr_file_match(worker, fname)
+                : vgr_file_may_match(pool, fname, worker->buf);
+
+    uv_mutex_lock(&pool->mutex);
+    pool->state[fi] = (char)(found ? VGR_SEARCH : VGR_SKIP);
+    uv_cond_broadcast(&pool->checked);
+    uv_mutex_unlock(&pool->mutex);
+  }
+  if (pool->match)
+    regexec_thread_free();
+}
+
+/*
+ * Return TRUE when files are read into a buffer without converting them to
+ * 'encoding' if they are valid in it: the first of 'fileencodings' is
+ * 'encoding', or 'fileencodings' is empty.
+ */
+static int vgr_reads_as_is(void)
+{
+  char_u buf[100];
+
+  if (has_mbyte && !enc_utf8)
+    return FALSE;
+  for (char_u *p = p_fencs; *p != NUL; ) {
+    copy_option_part(&p, buf, sizeof(buf), ",");
+    if (STRCMP(buf, "ucs-bom") != 0) {
+      char_u *enc = enc_canonize(buf);
+      int same = STRCMP(enc, p_enc) == 0;
+      free(enc);
+      return same;
+    }
+  }
+  return TRUE;
+}
+
+/*
+ * Make a buffer with the b_chartab of 'iskeyword' as a new buffer gets it,
+ * for the workers.
+ */
+static buf_T *vgr_isk_buf(void)
+{
+  buf_T *buf = xcalloc(1, sizeof(buf_T));
+  long lisp = 0;
+
+  get_option_value((char_u *)"iskeyword", NULL, &buf->b_p_isk, OPT_GLOBAL);
+  get_option_value((char_u *)"lisp", &lisp, NULL, OPT_GLOBAL);
+  buf->b_p_lisp = (int)lisp;
+  buf_init_chartab(buf, FALSE);
+  free(buf->b_p_isk);
+  buf->b_p_isk = NULL;
+  return buf;
+}
+
+/*
+ * Start worker threads matching files "fnames[fcount]" with pattern "pat",
+ * compiled into "prog", or checking them for the text that "prog" requires.
+ * Returns NULL when that isn't possible or useful.
+ */
+static vgr_pool_T *vgr_pool_start(char_u *pat, regprog_T *prog, int ic,
+                                  char_u **fnames, int fcount)
+{
+  int match = re_textonly(prog) && vgr_reads_as_is();
+  size_t maxlen = match ? 0 : vim_regtext_maxlen(prog, ic);
+  uv_cpu_info_t *cpu_info;
+  int ncpu;
+
+  if ((!match && maxlen == 0) || fcount < 2
+      || uv_cpu_info(&cpu_info, &ncpu) != 0)
+    return NULL;
+  uv_free_cpu_info(cpu_info, ncpu);
+
+  vgr_pool_T *pool = xcalloc(1, sizeof(vgr_pool_T));
+  pool->prog = prog;
+  pool->ic = ic;
+  pool->match = match;
+  if (match) {
+    char_u *ff = NULL;
+    if (*p_ffs == NUL)
+      get_option_value((char_u *)"fileformat", NULL, &ff, OPT_GLOBAL);
+    pool->cr_lines = vim_strchr(ff != NULL ? ff : p_ffs, 'm') != NULL;
+    free(ff);
+    pool->isk_buf = vgr_isk_buf();
+  } else
+    pool->overlap = maxlen - 1;
+  pool->fcount = fcount;
+  pool->fnames = xmalloc((size_t)fcount * sizeof(char_u *));
+  for (int fi = 0; fi < fcount; fi++) {
+    /* An autocommand may change directory while the workers are busy. */
+    pool->fnames[fi] = FullName_save(fnames[fi], FALSE);
+  }
+  pool->state = xcalloc((size_t)fcount, 1);
+  uv_mutex_init(&pool->mutex);
+  uv_cond_init(&pool->checked);
+
+  int nworkers = MIN(ncpu, VGR_MAX_THREADS);
+  nworkers = MIN(nworkers, fcount);
+  for (int i = 0; i < nworkers; i++) {
+    vgr_worker_T *worker = &pool->workers[pool->nworkers];
+    worker->pool = pool;
+    if (match) {
+      worker->regmatch.regprog = vim_regcomp(pat, RE_MAGIC + RE_PRIVATE);
+      if (worker->regmatch.regprog == NULL)
+        break;
+      worker->regmatch.rm_ic = ic;
+    }
+    worker->bufsize = VGR_CHUNK + pool->overlap + 1;
+    worker->buf = xmalloc(worker->bufsize);
+    if (uv_thread_create(&worker->thread, vgr_worker, worker) != 0) {
+      free(worker->buf);
+      vim_regfree(worker->regmatch.regprog);
+      break;
+    }
+    pool->nworkers++;
+  }
+  if (pool->nworkers == 0) {
+    vgr_pool_stop(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+/*
+ * Wait for the workers to have checked file "fi".  Returns FALSE when it
+ * can't contain a match, or when interrupted with CTRL-C.
+ */
+static int vgr_pool_may_match(vgr_pool_T *pool, int fi)
+{
+  uv_mutex_lock(&pool->mutex);
+  while (pool->state[fi] == VGR_PENDING && !got_int) {
+    if (uv_cond_timedwait(&pool->checked, &pool->mutex,
+            20 * 1000000) == UV_ETIMEDOUT) {
+      uv_mutex_unlock(&pool->mutex);
+      os_breakcheck();
+      uv_mutex_lock(&pool->mutex);
+    }
+  }
+  int state = pool->state[fi];
+  uv_mutex_unlock(&pool->mutex);
+  return state == VGR_SEARCH;
+}
+
+/*
+ * Stop the workers of "pool" and free it.
+ */
+static void vgr_pool_stop(vgr_pool_T *pool)
+{
+  uv_mutex_lock(&pool->mutex);
+  pool->cancel = TRUE;
+  uv_mutex_unlock(&pool->mutex);
+  for (int i = 0; i < pool->nworkers; i++) {
+    uv_thread_join(&pool->workers[i].thread);
+    free(pool->workers[i].buf);
+    vim_regfree(pool->workers[i].regmatch.regprog);
+  }
+  free(pool->isk_buf);
+  uv_cond_destroy(&pool->checked);
+  uv_mutex_destroy(&pool->mutex);
+  for (int fi = 0; fi < pool->fcount; fi++)
+    free(pool->fnames[fi]);
+  free(pool->fnames);
+  free(pool->state);
+  free(pool);
+}
+
 /*
  * ":vimgrep {pattern} file(s)"
  * ":vimgrepadd {pattern} file(s)"
@@ -2736,6 +3119,7 @@ void ex_vimgrep(exarg_T *eap)
   char_u      *dirname_now = NULL;
   char_u      *target_dir = NULL;
   char_u      *au_name =  NULL;
+  vgr_pool_T  *pool = NULL;
 
   switch (eap->cmdidx) {
   case CMD_vimgrep:     au_name = (char_u *)"vimgrep"; break;
@@ -2826,6 +3210,11 @@ void ex_vimgrep(exarg_T *eap)
    * changing the current quickfix list. */
   cur_qf_start = qi->qf_lists[qi->qf_curlist].qf_start;
 
+  if (flags & VGR_PARALLEL)
+    /* Compiled before autocommands may change the last search pattern. */
+    pool = vgr_pool_start(s != NULL && *s == NUL ? last_search_pat() : s,
+                          regmatch.regprog, regmatch.rmm_ic, fnames, fcount);
+
   seconds = (time_t)0;
   for (fi = 0; fi < fcount && !got_int && tomatch > 0; ++fi) {
     fname = path_shorten_fname_if_possible(fnames[fi]);
@@ -2849,6 +3238,11 @@ void ex_vimgrep(exarg_T *eap)
     }
 
     buf = buflist_findname_exp(fnames[fi]);
+    if ((buf == NULL || buf->b_ml.ml_mfp == NULL)
+        && pool != NULL && !vgr_pool_may_match(pool, fi))
+      /* The file doesn't have the text the pattern needs, don't load it.
+       * A loaded buffer may differ from the file, always search it. */
+      continue;
     if (buf == NULL || buf->b_ml.ml_mfp == NULL) {
       /* Remember that a buffer with this name already exists. */
       duplicate_name = (buf != NULL);
@@ -2985,6 +3379,10 @@ void ex_vimgrep(exarg_T *eap)
     }
   }
 
+  if (pool != NULL) {
+    vgr_pool_stop(pool);
+    pool = NULL;
+  }
   FreeWild(fcount, fnames);
 
   qi->qf_lists[qi->qf_curlist].qf_nonevalid = FALSE;
@@ -3033,9 +3431,10 @@ theend:
 }
 
 /*
- * Skip over the pattern argument of ":vimgrep /pat/[g][j]".
+ * Skip over the pattern argument of ":vimgrep /pat/[g][j][p]".
  * Put the start of the pattern in "*s", unless "s" is NULL.
- * If "flags" is not NULL put the flags in it: VGR_GLOBAL, VGR_NOJUMP.
+ * If "flags" is not NULL put the flags in it: VGR_GLOBAL, VGR_NOJUMP,
+ * VGR_PARALLEL.
  * If "s" is not NULL terminate the pattern with a NUL.
  * Return a pointer to the char just past the pattern plus flags.
  */
@@ -3051,7 +3450,7 @@ char_u *skip_vimgrep_pat(char_u *p, char_u **s, int *flags)
     if (s != NULL && *p != NUL)
       *p++ = NUL;
   } else {
-    /* ":vimgrep /pattern/[g][j] fname" */
+    /* ":vimgrep /pattern/[g][j][p] fname" */
     if (s != NULL)
       *s = p + 1;
     c = *p;
@@ -3065,12 +3464,14 @@ char_u *skip_vimgrep_pat(char_u *p, char_u **s, int *flags)
     ++p;
 
     /* Find the flags */
-    while (*p == 'g' || *p == 'j') {
+    while (*p == 'g' || *p == 'j' || *p == 'p') {
       if (flags != NULL) {
         if (*p == 'g')
           *flags |= VGR_GLOBAL;
-        else
+        else if (*p == 'j')
           *flags |= VGR_NOJUMP;
+        else
+          *flags |= VGR_PARALLEL;
       }
       ++p;
     }
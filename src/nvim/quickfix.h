@@ -4,6 +4,7 @@
 /* flags for skip_vimgrep_pat() */
 #define VGR_GLOBAL      1
 #define VGR_NOJUMP      2
+#define VGR_PARALLEL    4
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "quickfix.h.generated.h"
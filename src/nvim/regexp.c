@@ -48,6 +48,10 @@
 #include <stdbool.h>
 #include <string.h>
 
+#ifdef UNIT_TESTING
+# include <uv.h>
+#endif
+
 #include "nvim/vim.h"
 #include "nvim/ascii.h"
 #include "nvim/regexp.h"
@@ -61,6 +65,8 @@
 #include "nvim/misc1.h"
 #include "nvim/misc2.h"
 #include "nvim/garray.h"
+#include "nvim/hashtab.h"
+#include "nvim/profile.h"
 #include "nvim/strings.h"
 
 #ifdef REGEXP_DEBUG
@@ -375,6 +381,146 @@ typedef struct {
   int a, b, c;
 } decomp_T;
 
+/* Everything besides the pattern that changes a compiled program, used for
+ * the cache of vim_regcomp(). */
+typedef struct {
+  int re_flags;                 /* argument of vim_regcomp() */
+  int engine;                   /* 'regexpengine' */
+  int cpo_lit;                  /* 'cpoptions' contains 'l' */
+  int cpo_bsl;                  /* 'cpoptions' contains '\' */
+  int extmatch;                 /* reg_do_extmatch */
+  int enc;                      /* 'encoding' class */
+} regcache_key_T;
+
+typedef struct {
+  regprog_T *prog;              /* NULL for an unused entry */
+  char_u *expr;                 /* the pattern */
+  unsigned hash;                /* hash of "expr" and "key" */
+  regcache_key_T key;
+  int had_eol;                  /* vim_regcomp_had_eol() for "prog" */
+  uint64_t lastused;            /* "regcache_tick" when last returned */
+} regcache_entry_T;
+
+/*
+ * State of one regexp execution.  Every call of vim_regexec(),
+ * vim_regexec_nl(), vim_regexec_multi() and the functions using the submatches
+ * of a match has its own, "rex" points to the one in use by the current
+ * thread.  Thus a regexp can be executed while another execution is in
+ * progress, and in several threads at the same time.
+ */
+typedef struct {
+  /* The current match-position is remembered with these variables: */
+  linenr_T reglnum;             /* line number, relative to first line */
+  char_u      *regline;         /* start of current line */
+  char_u      *reginput;        /* current input, points into "regline" */
+
+  int need_clear_subexpr;       /* subexpressions still need to be cleared */
+  int need_clear_zsubexpr;      /* extmatch subexpressions still need to be
+                                 * cleared */
+
+  /*
+   * Internal copy of 'ignorecase'.  It is set at each call to vim_regexec().
+   * Normally it gets the value of "rm_ic" or "rmm_ic", but when the pattern
+   * contains '\c' or '\C' the value is overruled.
+   */
+  int ireg_ic;
+
+  /*
+   * Similar to ireg_ic, but only for 'combining' characters.  Set with \Z
+   * flag in the regexp.  Defaults to false, always.
+   */
+  int ireg_icombine;
+
+  /*
+   * Copy of "rmm_maxcol": maximum column to search for a match.  Zero when
+   * there is no maximum.
+   */
+  colnr_T ireg_maxcol;
+
+  /*
+   * Sometimes need to save a copy of a line.  Since alloc()/free() is very
+   * slow, we keep one allocated piece of memory and only re-allocate it when
+   * it's too small.  It's freed in bt_regexec_both() when finished.
+   */
+  char_u      *reg_tofree;
+  unsigned reg_tofreelen;
+
+  /*
+   * These variables are set when executing a regexp to speed up the
+   * execution.  Which ones are set depends on whether a single-line or
+   * multi-line match is done:
+   *			single-line		multi-line
+   * reg_match		&regmatch_T		NULL
+   * reg_mmatch		NULL			&regmmatch_T
+   * reg_startp		reg_match->startp	<invalid>
+   * reg_endp		reg_match->endp		<invalid>
+   * reg_startpos	<invalid>		reg_mmatch->startpos
+   * reg_endpos		<invalid>		reg_mmatch->endpos
+   * reg_win		NULL			window in which to search
+   * reg_buf		curbuf			buffer in which to search
+   * reg_firstlnum	<invalid>		first line in which to search
+   * reg_maxline	0			last line nr
+   * reg_line_lbr	FALSE or TRUE		FALSE
+   */
+  regmatch_T          *reg_match;
+  regmmatch_T         *reg_mmatch;
+  char_u              **reg_startp;
+  char_u              **reg_endp;
+  lpos_T              *reg_startpos;
+  lpos_T              *reg_endpos;
+  win_T               *reg_win;
+  buf_T               *reg_buf;
+  linenr_T reg_firstlnum;
+  linenr_T reg_maxline;
+  int reg_line_lbr;             /* "\n" in string is line break */
+  mlspan_T reg_span;            /* block of "reg_buf" lines in use */
+
+  /*
+   * "regstack" and "backpos" are used by regmatch().  They are kept over
+   * calls to avoid invoking malloc() and free() often.
+   * "regstack" is a stack with regitem_T items, sometimes preceded by
+   * regstar_T or regbehind_T.
+   * "backpos_T" is a table with backpos_T for BACK
+   */
+  garray_T regstack;
+  garray_T backpos;
+
+  regsave_T behind_pos;
+
+  char_u      *reg_startzp[NSUBEXP];    /* Workspace to mark beginning */
+  char_u      *reg_endzp[NSUBEXP];      /*   and end of \z(...\) matches */
+  lpos_T reg_startzpos[NSUBEXP];        /* idem, beginning pos */
+  lpos_T reg_endzpos[NSUBEXP];          /* idem, end pos */
+
+  /*
+   * The arguments from BRACE_LIMITS are stored here.  They are actually local
+   * to regmatch(), but they are here to reduce the amount of stack space used
+   * (it can be called recursively many times).
+   */
+  long bl_minval;
+  long bl_maxval;
+
+  /* Used by the NFA engine, copied from the program or set while matching. */
+  int nfa_has_zend;             /* pattern contains \ze */
+  int nfa_has_backref;          /* pattern contains \1 .. \9 */
+  int nfa_has_zsubexpr;         /* pattern has \z( ), set zsubexpr */
+  int nfa_nsubexpr;             /* number of sub expressions actually being
+                                 * used, 1 if only the whole match is used */
+  int nfa_nstate;               /* number of states in the NFA */
+  save_se_T           *nfa_endp; /* if not NULL match must end here */
+  /* listid is kept here, so that it increases on recursive calls to
+   * nfa_regmatch(), which means we don't have to clear the lastlist field of
+   * all the states. */
+  int nfa_listid;
+  int nfa_alt_listid;
+  int nfa_ll_index;             /* 0 for first call to nfa_regmatch(), 1 for
+                                 * recursive call */
+  int nfa_match;
+
+  bool reg_fallback;            /* a faster engine passed the match on to the
+                                 * NFA, set for profiling */
+} regexec_T;
+
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "regexp.c.generated.h"
@@ -674,6 +820,8 @@ static void init_class_tab(void)
 #define RF_HASNL    4   /* can match a NL */
 #define RF_ICOMBINE 8   /* ignore combining characters */
 #define RF_LOOKBH   16  /* uses "\@<=" or "\@<!" */
+#define RF_NOTTEXT  32  /* uses the cursor, marks, line numbers or other
+                         * things besides the text, see re_textonly() */
 
 /*
  * Global work variables for vim_regcomp().
@@ -750,6 +898,8 @@ static int nextchr;             /* used for ungetchr() */
 
 static regengine_T bt_regengine;
 static regengine_T nfa_regengine;
+static regengine_T dfa_regengine;
+static regengine_T lit_regengine;
 
 /*
  * Return TRUE if compiled regular expression "prog" can match a line break.
@@ -759,6 +909,15 @@ int re_multiline(regprog_T *prog)
   return prog->regflags & RF_HASNL;
 }
 
+/*
+ * Return TRUE if the matches of "prog" in a line only depend on the text of
+ * that line, the ignore-case flag and 'iskeyword'.
+ */
+int re_textonly(regprog_T *prog)
+{
+  return !(prog->regflags & (RF_HASNL | RF_LOOKBH | RF_NOTTEXT));
+}
+
 /*
  * Check for an equivalence class name "[=a=]".  "pp" points to the '['.
  * Returns a character representing the class. Zero means that no item was
@@ -1852,6 +2011,9 @@ static char_u *regatom(int *flagp)
       c = getchr();
       goto do_multibyte;
     }
+    /* These classes depend on 'isident', 'isfname' and 'isprint'. */
+    if (vim_strchr((char_u *)"iIfFpP", no_Magic(c)) != NULL)
+      regflags |= RF_NOTTEXT;
     ret = regnode(classcodes[p - classchars] + extra);
     *flagp |= HASWIDTH | SIMPLE;
     break;
@@ -2017,18 +2179,22 @@ static char_u *regatom(int *flagp)
      * pattern -- regardless of whether or not it makes sense. */
     case '^':
       ret = regnode(RE_BOF);
+      regflags |= RF_NOTTEXT;
       break;
 
     case '$':
       ret = regnode(RE_EOF);
+      regflags |= RF_NOTTEXT;
       break;
 
     case '#':
       ret = regnode(CURSOR);
+      regflags |= RF_NOTTEXT;
       break;
 
     case 'V':
       ret = regnode(RE_VISUAL);
+      regflags |= RF_NOTTEXT;
       break;
 
     case 'C':
@@ -2136,6 +2302,7 @@ static char_u *regatom(int *flagp)
           /* "\%'m", "\%<'m" and "\%>'m": Mark */
           c = getchr();
           ret = regnode(RE_MARK);
+          regflags |= RF_NOTTEXT;
           if (ret == JUST_CALC_SIZE)
             regsize += 2;
           else {
@@ -2150,6 +2317,8 @@ static char_u *regatom(int *flagp)
             ret = regnode(RE_COL);
           else
             ret = regnode(RE_VCOL);
+          if (c != 'c')
+            regflags |= RF_NOTTEXT;
           if (ret == JUST_CALC_SIZE)
             regsize += 5;
           else {
@@ -2338,6 +2507,8 @@ collection:
                   regc(cu);
               break;
             case CLASS_PRINT:
+              /* Depends on 'isprint', like "\p". */
+              regflags |= RF_NOTTEXT;
               for (cu = 1; cu <= 255; cu++)
                 if (vim_isprintc(cu))
                   regc(cu);
@@ -3120,20 +3291,22 @@ static int read_limits(long *minval, long *maxval)
  * vim_regexec and friends
  */
 
-/*
- * Global work variables for vim_regexec().
- */
+/* The execution in progress in this thread, see rex_enter(). */
+static THREAD_LOCAL regexec_T *rex = NULL;
+
+/* The state used when no other execution is in progress in this thread.  Its
+ * "regstack", "backpos" and "reg_tofree" are kept for the next one. */
+static THREAD_LOCAL regexec_T rex_outer;
 
-/* The current match-position is remembered with these variables: */
-static linenr_T reglnum;        /* line number, relative to first line */
-static char_u   *regline;       /* start of current line */
-static char_u   *reginput;      /* current input, points into "regline" */
+/* Set in threads other than the main thread, see regexec_thread_init(). */
+static THREAD_LOCAL int reg_in_thread = FALSE;
 
-static int need_clear_subexpr;          /* subexpressions still need to be
-                                         * cleared */
-static int need_clear_zsubexpr = FALSE;         /* extmatch subexpressions
-                                                 * still need to be cleared */
+/* Buffer for 'iskeyword' when matching a string in this thread, NULL to use
+ * curbuf. */
+static THREAD_LOCAL buf_T *reg_string_buf = NULL;
 
+/* Get the buffer whose 'iskeyword' is used when matching a string. */
+#define REG_STRING_BUF (reg_string_buf != NULL ? reg_string_buf : curbuf)
 
 /* Save the sub-expressions before attempting a match. */
 #define save_se(savep, posp, pp) \
@@ -3152,92 +3325,179 @@ int regnarrate = 0;
 #endif
 
 /*
- * Internal copy of 'ignorecase'.  It is set at each call to vim_regexec().
- * Normally it gets the value of "rm_ic" or "rmm_ic", but when the pattern
- * contains '\c' or '\C' the value is overruled.
+ * Both for regstack and backpos tables we use the following strategy of
+ * allocation (to reduce malloc/free calls):
+ * - Initial size is fairly small.
+ * - When needed, the tables are grown bigger (8 times at first, double after
+ *   that).
+ * - After executing the match we free the memory only if the array has grown.
+ *   Thus the memory is kept allocated when it's at the initial size.
+ * This makes it fast while not keeping a lot of memory allocated.
+ * A three times speed increase was observed when using many simple patterns.
  */
-static int ireg_ic;
+#define REGSTACK_INITIAL        2048
+#define BACKPOS_INITIAL         64
 
 /*
- * Similar to ireg_ic, but only for 'combining' characters.  Set with \Z flag
- * in the regexp.  Defaults to false, always.
+ * Start an execution of a regexp in the current thread.  Uses "nested" for
+ * its state when another execution is in progress.  Returns the state to be
+ * passed to rex_leave() when done.
  */
-static int ireg_icombine;
+static regexec_T *rex_enter(regexec_T *nested)
+{
+  regexec_T *prev = rex;
+
+  if (prev == NULL) {
+    rex = &rex_outer;
+  } else {
+    memset(nested, 0, sizeof(*nested));
+    rex = nested;
+  }
+  return prev;
+}
 
 /*
- * Copy of "rmm_maxcol": maximum column to search for a match.  Zero when
- * there is no maximum.
+ * End the execution started with rex_enter(), "prev" is what it returned.
  */
-static colnr_T ireg_maxcol;
+static void rex_leave(regexec_T *prev)
+{
+  if (rex != &rex_outer) {
+    ga_clear(&rex->regstack);
+    ga_clear(&rex->backpos);
+    free(rex->reg_tofree);
+  }
+  rex = prev;
+}
 
 /*
- * Sometimes need to save a copy of a line.  Since alloc()/free() is very
- * slow, we keep one allocated piece of memory and only re-allocate it when
- * it's too small.  It's freed in bt_regexec_both() when finished.
+ * Prepare the current thread for matching with vim_regexec() and
+ * vim_regexec_nl().  Only to be used in a thread that isn't the main thread.
+ * Such a thread must use a program of its own, compiled in the main thread
+ * with RE_PRIVATE, and it must not use vim_regexec_multi().  It doesn't check
+ * for CTRL-C and errors are not reported, the match fails.
+ * "buf" is used for 'iskeyword' instead of curbuf, only its b_chartab is
+ * read.  When NULL the main thread must not change curbuf or its
+ * 'iskeyword' while the thread is matching.
  */
-static char_u   *reg_tofree = NULL;
-static unsigned reg_tofreelen;
+void regexec_thread_init(buf_T *buf)
+{
+  reg_in_thread = TRUE;
+  reg_string_buf = buf;
+}
 
 /*
- * These variables are set when executing a regexp to speed up the execution.
- * Which ones are set depends on whether a single-line or multi-line match is
- * done:
- *			single-line		multi-line
- * reg_match		&regmatch_T		NULL
- * reg_mmatch		NULL			&regmmatch_T
- * reg_startp		reg_match->startp	<invalid>
- * reg_endp		reg_match->endp		<invalid>
- * reg_startpos		<invalid>		reg_mmatch->startpos
- * reg_endpos		<invalid>		reg_mmatch->endpos
- * reg_win		NULL			window in which to search
- * reg_buf		curbuf			buffer in which to search
- * reg_firstlnum	<invalid>		first line in which to search
- * reg_maxline		0			last line nr
- * reg_line_lbr		FALSE or TRUE		FALSE
+ * Free the memory the current thread kept for matching.  To be called when
+ * a thread that used vim_regexec() ends.
  */
-static regmatch_T       *reg_match;
-static regmmatch_T      *reg_mmatch;
-static char_u           **reg_startp = NULL;
-static char_u           **reg_endp = NULL;
-static lpos_T           *reg_startpos = NULL;
-static lpos_T           *reg_endpos = NULL;
-static win_T            *reg_win;
-static buf_T            *reg_buf;
-static linenr_T reg_firstlnum;
-static linenr_T reg_maxline;
-static int reg_line_lbr;                    /* "\n" in string is line break */
+void regexec_thread_free(void)
+{
+  ga_clear(&rex_outer.regstack);
+  ga_clear(&rex_outer.backpos);
+  free(rex_outer.reg_tofree);
+  rex_outer.reg_tofree = NULL;
+}
+
+#ifdef UNIT_TESTING
+/* One thread of regexec_test_threads(). */
+typedef struct {
+  regmatch_T regmatch;
+  char_u **lines;
+  int nlines;
+  int rounds;
+  int *cols;          /* match column of each line or -1 */
+  int mismatches;     /* results that differ from the first round */
+  uv_thread_t thread;
+} regtest_T;
+
+static void regexec_test_thread(void *arg)
+{
+  regtest_T *t = arg;
+
+  regexec_thread_init(NULL);
+  for (int round = 0; round < t->rounds; round++) {
+    for (int i = 0; i < t->nlines; i++) {
+      int col = -1;
+      if (vim_regexec(&t->regmatch, t->lines[i], 0))
+        col = (int)(t->regmatch.startp[0] - t->lines[i]);
+      if (round == 0)
+        t->cols[i] = col;
+      else if (t->cols[i] != col)
+        t->mismatches++;
+    }
+  }
+  regexec_thread_free();
+}
 
 /*
- * "regstack" and "backpos" are used by regmatch().  They are kept over calls
- * to avoid invoking malloc() and free() often.
- * "regstack" is a stack with regitem_T items, sometimes preceded by regstar_T
- * or regbehind_T.
- * "backpos_T" is a table with backpos_T for BACK
+ * For the unit tests: match "pat" against each of "lines" in "nthreads"
+ * threads at the same time, "rounds" times, each thread with a program of its
+ * own.  The match column of line "i" in thread "t", or -1, is stored in
+ * "cols[t * nlines + i]".
+ * Returns the number of results that differed from a thread's first round,
+ * -1 when "pat" is invalid.
  */
-static garray_T regstack = GA_EMPTY_INIT_VALUE;
-static garray_T backpos = GA_EMPTY_INIT_VALUE;
+int regexec_test_threads(char_u *pat, char_u **lines, int nlines,
+                         int nthreads, int rounds, int *cols)
+{
+  regtest_T *tests = xcalloc((size_t)nthreads, sizeof(regtest_T));
+  int started = 0;
+  int retval = 0;
+
+  for (int t = 0; t < nthreads; t++) {
+    tests[t].regmatch.regprog = vim_regcomp(pat, RE_MAGIC + RE_STRING
+                                                 + RE_PRIVATE);
+    if (tests[t].regmatch.regprog == NULL) {
+      retval = -1;
+      goto theend;
+    }
+    tests[t].lines = lines;
+    tests[t].nlines = nlines;
+    tests[t].rounds = rounds;
+    tests[t].cols = cols + t * nlines;
+  }
+  for (; started < nthreads; started++) {
+    if (uv_thread_create(&tests[started].thread, regexec_test_thread,
+                         &tests[started]) != 0) {
+      retval = -1;
+      break;
+    }
+  }
+  for (int t = 0; t < started; t++) {
+    uv_thread_join(&tests[t].thread);
+    if (retval >= 0)
+      retval += tests[t].mismatches;
+  }
+
+theend:
+  for (int t = 0; t < nthreads; t++)
+    vim_regfree(tests[t].regmatch.regprog);
+  free(tests);
+  return retval;
+}
+#endif
 
 /*
- * Both for regstack and backpos tables we use the following strategy of
- * allocation (to reduce malloc/free calls):
- * - Initial size is fairly small.
- * - When needed, the tables are grown bigger (8 times at first, double after
- *   that).
- * - After executing the match we free the memory only if the array has grown.
- *   Thus the memory is kept allocated when it's at the initial size.
- * This makes it fast while not keeping a lot of memory allocated.
- * A three times speed increase was observed when using many simple patterns.
+ * Check for CTRL-C once in a while, not in other threads.
  */
-#define REGSTACK_INITIAL        2048
-#define BACKPOS_INITIAL         64
+static void reg_breakcheck(void)
+{
+  if (!reg_in_thread)
+    fast_breakcheck();
+}
+
+/* Give an error message while matching, not in other threads. */
+#define REG_EMSG(s) \
+  do { if (!reg_in_thread) EMSG(s); } while (0)
+#define REG_EMSGN(s, n) \
+  do { if (!reg_in_thread) EMSGN(s, n); } while (0)
 
 #if defined(EXITFREE)
 void free_regexp_stuff(void)
 {
-  ga_clear(&regstack);
-  ga_clear(&backpos);
-  free(reg_tofree);
+  regcache_clear();
+  regexec_thread_free();
   free(reg_prev_sub);
+  regprof_free();
 }
 
 #endif
@@ -3249,23 +3509,36 @@ static char_u *reg_getline(linenr_T lnum)
 {
   /* when looking behind for a match/no-match lnum is negative.  But we
    * can't go before line 1 */
-  if (reg_firstlnum + lnum < 1)
+  if (rex->reg_firstlnum + lnum < 1)
     return NULL;
-  if (lnum > reg_maxline)
+  if (lnum > rex->reg_maxline)
     /* Must have matched the "\n" in the last line. */
     return (char_u *)"";
-  return ml_get_buf(reg_buf, reg_firstlnum + lnum, FALSE);
+  return reg_span_line(rex->reg_firstlnum + lnum);
 }
 
-static regsave_T behind_pos;
+/*
+ * Get line "lnum" of "reg_buf".  A multi-line match mostly moves to the next
+ * or previous line, which is usually in the same data block.  Keep that block
+ * in "reg_span" and take lines from it directly instead of looking up each of
+ * them through ml_get_buf().
+ */
+static char_u *reg_span_line(linenr_T lnum)
+{
+  char_u      *p;
 
-static char_u   *reg_startzp[NSUBEXP];  /* Workspace to mark beginning */
-static char_u   *reg_endzp[NSUBEXP];    /*   and end of \z(...\) matches */
-static lpos_T reg_startzpos[NSUBEXP];   /* idem, beginning pos */
-static lpos_T reg_endzpos[NSUBEXP];     /* idem, end pos */
+  if (rex->reg_span.sp_block != NULL
+      && rex->reg_span.sp_buf == rex->reg_buf) {
+    p = ml_span_line(&rex->reg_span, lnum);
+    if (p != NULL)
+      return p;
+  }
+  /* Not in the span: get the line the normal way and start a new span. */
+  return ml_get_span(rex->reg_buf, lnum, &rex->reg_span);
+}
 
 /* TRUE if using multi-line regexp. */
-#define REG_MULTI       (reg_match == NULL)
+#define REG_MULTI       (rex->reg_match == NULL)
 
 
 /*
@@ -3284,15 +3557,15 @@ bt_regexec_nl (
     bool line_lbr
 )
 {
-  reg_match = rmp;
-  reg_mmatch = NULL;
-  reg_maxline = 0;
-  reg_line_lbr = line_lbr;
-  reg_buf = curbuf;
-  reg_win = NULL;
-  ireg_ic = rmp->rm_ic;
-  ireg_icombine = FALSE;
-  ireg_maxcol = 0;
+  rex->reg_match = rmp;
+  rex->reg_mmatch = NULL;
+  rex->reg_maxline = 0;
+  rex->reg_line_lbr = line_lbr;
+  rex->reg_buf = REG_STRING_BUF;
+  rex->reg_win = NULL;
+  rex->ireg_ic = rmp->rm_ic;
+  rex->ireg_icombine = FALSE;
+  rex->ireg_maxcol = 0;
   return bt_regexec_both(line, col, NULL) != 0;
 }
 
@@ -3314,16 +3587,16 @@ static long bt_regexec_multi(regmmatch_T *rmp, win_T *win, buf_T *buf,
 {
   long r;
 
-  reg_match = NULL;
-  reg_mmatch = rmp;
-  reg_buf = buf;
-  reg_win = win;
-  reg_firstlnum = lnum;
-  reg_maxline = reg_buf->b_ml.ml_line_count - lnum;
-  reg_line_lbr = FALSE;
-  ireg_ic = rmp->rmm_ic;
-  ireg_icombine = FALSE;
-  ireg_maxcol = rmp->rmm_maxcol;
+  rex->reg_match = NULL;
+  rex->reg_mmatch = rmp;
+  rex->reg_buf = buf;
+  rex->reg_win = win;
+  rex->reg_firstlnum = lnum;
+  rex->reg_maxline = rex->reg_buf->b_ml.ml_line_count - lnum;
+  rex->reg_line_lbr = FALSE;
+  rex->ireg_ic = rmp->rmm_ic;
+  rex->ireg_icombine = FALSE;
+  rex->ireg_maxcol = rmp->rmm_maxcol;
 
   r = bt_regexec_both(NULL, col, tm);
 
@@ -3347,34 +3620,34 @@ static long bt_regexec_both(char_u *line,
    * We allocate *_INITIAL amount of bytes first and then set the grow size
    * to much bigger value to avoid many malloc calls in case of deep regular
    * expressions.  */
-  if (regstack.ga_data == NULL) {
+  if (rex->regstack.ga_data == NULL) {
     /* Use an item size of 1 byte, since we push different things
      * onto the regstack. */
-    ga_init(&regstack, 1, REGSTACK_INITIAL);
-    ga_grow(&regstack, REGSTACK_INITIAL);
-    ga_set_growsize(&regstack, REGSTACK_INITIAL * 8);
+    ga_init(&rex->regstack, 1, REGSTACK_INITIAL);
+    ga_grow(&rex->regstack, REGSTACK_INITIAL);
+    ga_set_growsize(&rex->regstack, REGSTACK_INITIAL * 8);
   }
 
-  if (backpos.ga_data == NULL) {
-    ga_init(&backpos, sizeof(backpos_T), BACKPOS_INITIAL);
-    ga_grow(&backpos, BACKPOS_INITIAL);
-    ga_set_growsize(&backpos, BACKPOS_INITIAL * 8);
+  if (rex->backpos.ga_data == NULL) {
+    ga_init(&rex->backpos, sizeof(backpos_T), BACKPOS_INITIAL);
+    ga_grow(&rex->backpos, BACKPOS_INITIAL);
+    ga_set_growsize(&rex->backpos, BACKPOS_INITIAL * 8);
   }
 
   if (REG_MULTI) {
-    prog = (bt_regprog_T *)reg_mmatch->regprog;
+    prog = (bt_regprog_T *)rex->reg_mmatch->regprog;
     line = reg_getline((linenr_T)0);
-    reg_startpos = reg_mmatch->startpos;
-    reg_endpos = reg_mmatch->endpos;
+    rex->reg_startpos = rex->reg_mmatch->startpos;
+    rex->reg_endpos = rex->reg_mmatch->endpos;
   } else {
-    prog = (bt_regprog_T *)reg_match->regprog;
-    reg_startp = reg_match->startp;
-    reg_endp = reg_match->endp;
+    prog = (bt_regprog_T *)rex->reg_match->regprog;
+    rex->reg_startp = rex->reg_match->startp;
+    rex->reg_endp = rex->reg_match->endp;
   }
 
   /* Be paranoid... */
   if (prog == NULL || line == NULL) {
-    EMSG(_(e_null));
+    REG_EMSG(_(e_null));
     goto theend;
   }
 
@@ -3383,18 +3656,18 @@ static long bt_regexec_both(char_u *line,
     goto theend;
 
   /* If the start column is past the maximum column: no need to try. */
-  if (ireg_maxcol > 0 && col >= ireg_maxcol)
+  if (rex->ireg_maxcol > 0 && col >= rex->ireg_maxcol)
     goto theend;
 
   /* If pattern contains "\c" or "\C": overrule value of ireg_ic */
   if (prog->regflags & RF_ICASE)
-    ireg_ic = TRUE;
+    rex->ireg_ic = TRUE;
   else if (prog->regflags & RF_NOICASE)
-    ireg_ic = FALSE;
+    rex->ireg_ic = FALSE;
 
   /* If pattern contains "\Z" overrule value of ireg_icombine */
   if (prog->regflags & RF_ICOMBINE)
-    ireg_icombine = TRUE;
+    rex->ireg_icombine = TRUE;
 
   /* If there is a "must appear" string, look for it. */
   if (prog->regmust != NULL) {
@@ -3410,7 +3683,7 @@ static long bt_regexec_both(char_u *line,
      * This is used very often, esp. for ":global".  Use three versions of
      * the loop to avoid overhead of conditions.
      */
-    if (!ireg_ic
+    if (!rex->ireg_ic
         && !has_mbyte
         )
       while ((s = vim_strbyte(s, c)) != NULL) {
@@ -3418,7 +3691,7 @@ static long bt_regexec_both(char_u *line,
           break;                        /* Found it. */
         ++s;
       }
-    else if (!ireg_ic || (!enc_utf8 && mb_char2len(c) > 1))
+    else if (!rex->ireg_ic || (!enc_utf8 && mb_char2len(c) > 1))
       while ((s = vim_strchr(s, c)) != NULL) {
         if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
           break;                        /* Found it. */
@@ -3434,8 +3707,8 @@ static long bt_regexec_both(char_u *line,
       goto theend;
   }
 
-  regline = line;
-  reglnum = 0;
+  rex->regline = line;
+  rex->reglnum = 0;
   reg_toolong = FALSE;
 
   /* Simplest case: Anchored match need be tried only once. */
@@ -3443,12 +3716,12 @@ static long bt_regexec_both(char_u *line,
     int c;
 
     if (has_mbyte)
-      c = (*mb_ptr2char)(regline + col);
+      c = (*mb_ptr2char)(rex->regline + col);
     else
-      c = regline[col];
+      c = rex->regline[col];
     if (prog->regstart == NUL
         || prog->regstart == c
-        || (ireg_ic && ((
+        || (rex->ireg_ic && ((
                           (enc_utf8 && utf_fold(prog->regstart) == utf_fold(c)))
                         || (c < 255 && prog->regstart < 255 &&
                             vim_tolower(prog->regstart) == vim_tolower(c)))))
@@ -3462,21 +3735,21 @@ static long bt_regexec_both(char_u *line,
       if (prog->regstart != NUL) {
         /* Skip until the char we know it must start with.
          * Used often, do some work to avoid call overhead. */
-        if (!ireg_ic
+        if (!rex->ireg_ic
             && !has_mbyte
             )
-          s = vim_strbyte(regline + col, prog->regstart);
+          s = vim_strbyte(rex->regline + col, prog->regstart);
         else
-          s = cstrchr(regline + col, prog->regstart);
+          s = cstrchr(rex->regline + col, prog->regstart);
         if (s == NULL) {
           retval = 0;
           break;
         }
-        col = (int)(s - regline);
+        col = (int)(s - rex->regline);
       }
 
       /* Check for maximum column to try. */
-      if (ireg_maxcol > 0 && col >= ireg_maxcol) {
+      if (rex->ireg_maxcol > 0 && col >= rex->ireg_maxcol) {
         retval = 0;
         break;
       }
@@ -3486,14 +3759,14 @@ static long bt_regexec_both(char_u *line,
         break;
 
       /* if not currently on the first line, get it again */
-      if (reglnum != 0) {
-        reglnum = 0;
-        regline = reg_getline((linenr_T)0);
+      if (rex->reglnum != 0) {
+        rex->reglnum = 0;
+        rex->regline = reg_getline((linenr_T)0);
       }
-      if (regline[col] == NUL)
+      if (rex->regline[col] == NUL)
         break;
       if (has_mbyte)
-        col += (*mb_ptr2len)(regline + col);
+        col += (*mb_ptr2len)(rex->regline + col);
       else
         ++col;
       /* Check for timeout once in a twenty times to avoid overhead. */
@@ -3508,14 +3781,14 @@ static long bt_regexec_both(char_u *line,
 theend:
   /* Free "reg_tofree" when it's a bit big.
    * Free regstack and backpos if they are bigger than their initial size. */
-  if (reg_tofreelen > 400) {
-    free(reg_tofree);
-    reg_tofree = NULL;
+  if (rex->reg_tofreelen > 400) {
+    free(rex->reg_tofree);
+    rex->reg_tofree = NULL;
   }
-  if (regstack.ga_maxlen > REGSTACK_INITIAL)
-    ga_clear(&regstack);
-  if (backpos.ga_maxlen > BACKPOS_INITIAL)
-    ga_clear(&backpos);
+  if (rex->regstack.ga_maxlen > REGSTACK_INITIAL)
+    ga_clear(&rex->regstack);
+  if (rex->backpos.ga_maxlen > BACKPOS_INITIAL)
+    ga_clear(&rex->backpos);
 
   return retval;
 }
@@ -3562,32 +3835,32 @@ void unref_extmatch(reg_extmatch_T *em)
  */
 static long regtry(bt_regprog_T *prog, colnr_T col)
 {
-  reginput = regline + col;
-  need_clear_subexpr = TRUE;
+  rex->reginput = rex->regline + col;
+  rex->need_clear_subexpr = TRUE;
   /* Clear the external match subpointers if necessary. */
   if (prog->reghasz == REX_SET)
-    need_clear_zsubexpr = TRUE;
+    rex->need_clear_zsubexpr = TRUE;
 
   if (regmatch(prog->program + 1) == 0)
     return 0;
 
   cleanup_subexpr();
   if (REG_MULTI) {
-    if (reg_startpos[0].lnum < 0) {
-      reg_startpos[0].lnum = 0;
-      reg_startpos[0].col = col;
+    if (rex->reg_startpos[0].lnum < 0) {
+      rex->reg_startpos[0].lnum = 0;
+      rex->reg_startpos[0].col = col;
     }
-    if (reg_endpos[0].lnum < 0) {
-      reg_endpos[0].lnum = reglnum;
-      reg_endpos[0].col = (int)(reginput - regline);
+    if (rex->reg_endpos[0].lnum < 0) {
+      rex->reg_endpos[0].lnum = rex->reglnum;
+      rex->reg_endpos[0].col = (int)(rex->reginput - rex->regline);
     } else
       /* Use line number of "\ze". */
-      reglnum = reg_endpos[0].lnum;
+      rex->reglnum = rex->reg_endpos[0].lnum;
   } else {
-    if (reg_startp[0] == NULL)
-      reg_startp[0] = regline + col;
-    if (reg_endp[0] == NULL)
-      reg_endp[0] = reginput;
+    if (rex->reg_startp[0] == NULL)
+      rex->reg_startp[0] = rex->regline + col;
+    if (rex->reg_endp[0] == NULL)
+      rex->reg_endp[0] = rex->reginput;
   }
   /* Package any found \z(...\) matches for export. Default is none. */
   unref_extmatch(re_extmatch_out);
@@ -3601,24 +3874,24 @@ static long regtry(bt_regprog_T *prog, colnr_T col)
     for (i = 0; i < NSUBEXP; i++) {
       if (REG_MULTI) {
         /* Only accept single line matches. */
-        if (reg_startzpos[i].lnum >= 0
-            && reg_endzpos[i].lnum == reg_startzpos[i].lnum
-            && reg_endzpos[i].col >= reg_startzpos[i].col) {
+        if (rex->reg_startzpos[i].lnum >= 0
+            && rex->reg_endzpos[i].lnum == rex->reg_startzpos[i].lnum
+            && rex->reg_endzpos[i].col >= rex->reg_startzpos[i].col) {
           re_extmatch_out->matches[i] =
-            vim_strnsave(reg_getline(reg_startzpos[i].lnum)
-                         + reg_startzpos[i].col,
-                         reg_endzpos[i].col
-                         - reg_startzpos[i].col);
+            vim_strnsave(reg_getline(rex->reg_startzpos[i].lnum)
+                         + rex->reg_startzpos[i].col,
+                         rex->reg_endzpos[i].col
+                         - rex->reg_startzpos[i].col);
         }
       } else {
-        if (reg_startzp[i] != NULL && reg_endzp[i] != NULL)
+        if (rex->reg_startzp[i] != NULL && rex->reg_endzp[i] != NULL)
           re_extmatch_out->matches[i] =
-            vim_strnsave(reg_startzp[i],
-                (int)(reg_endzp[i] - reg_startzp[i]));
+            vim_strnsave(rex->reg_startzp[i],
+                (int)(rex->reg_endzp[i] - rex->reg_startzp[i]));
       }
     }
   }
-  return 1 + reglnum;
+  return 1 + rex->reglnum;
 }
 
 
@@ -3627,9 +3900,9 @@ static long regtry(bt_regprog_T *prog, colnr_T col)
  */
 static int reg_prev_class(void)
 {
-  if (reginput > regline)
-    return mb_get_class_buf(reginput - 1
-        - (*mb_head_off)(regline, reginput - 1), reg_buf);
+  if (rex->reginput > rex->regline)
+    return mb_get_class_buf(rex->reginput - 1
+        - (*mb_head_off)(rex->regline, rex->reginput - 1), rex->reg_buf);
   return -1;
 }
 
@@ -3642,13 +3915,13 @@ static int reg_match_visual(void)
   pos_T top, bot;
   linenr_T lnum;
   colnr_T col;
-  win_T       *wp = reg_win == NULL ? curwin : reg_win;
+  win_T       *wp = rex->reg_win == NULL ? curwin : rex->reg_win;
   int mode;
   colnr_T start, end;
   colnr_T start2, end2;
 
   /* Check if the buffer is the current buffer. */
-  if (reg_buf != curbuf || VIsual.lnum == 0)
+  if (rex->reg_buf != curbuf || VIsual.lnum == 0)
     return FALSE;
 
   if (VIsual_active) {
@@ -3670,12 +3943,12 @@ static int reg_match_visual(void)
     }
     mode = curbuf->b_visual.vi_mode;
   }
-  lnum = reglnum + reg_firstlnum;
+  lnum = rex->reglnum + rex->reg_firstlnum;
   if (lnum < top.lnum || lnum > bot.lnum)
     return FALSE;
 
   if (mode == 'v') {
-    col = (colnr_T)(reginput - regline);
+    col = (colnr_T)(rex->reginput - rex->regline);
     if ((lnum == top.lnum && col < top.col)
         || (lnum == bot.lnum && col >= bot.col + (*p_sel != 'e')))
       return FALSE;
@@ -3688,8 +3961,8 @@ static int reg_match_visual(void)
       end = end2;
     if (top.col == MAXCOL || bot.col == MAXCOL)
       end = MAXCOL;
-    unsigned int cols_u = win_linetabsize(wp, regline,
-                                          (colnr_T)(reginput - regline));
+    unsigned int cols_u = win_linetabsize(wp, rex->regline,
+                                          (colnr_T)(rex->reginput - rex->regline));
     assert(cols_u <= MAXCOL);
     colnr_T cols = (colnr_T)cols_u;
     if (cols < start || cols > end - (*p_sel == 'e'))
@@ -3698,15 +3971,7 @@ static int reg_match_visual(void)
   return TRUE;
 }
 
-#define ADVANCE_REGINPUT() mb_ptr_adv(reginput)
-
-/*
- * The arguments from BRACE_LIMITS are stored here.  They are actually local
- * to regmatch(), but they are here to reduce the amount of stack space used
- * (it can be called recursively many times).
- */
-static long bl_minval;
-static long bl_maxval;
+#define ADVANCE_REGINPUT() mb_ptr_adv(rex->reginput)
 
 /*
  * regmatch - main matching routine
@@ -3742,8 +4007,8 @@ regmatch (
 
   /* Make "regstack" and "backpos" empty.  They are allocated and freed in
    * bt_regexec_both() to reduce malloc()/free() calls. */
-  regstack.ga_len = 0;
-  backpos.ga_len = 0;
+  rex->regstack.ga_len = 0;
+  rex->backpos.ga_len = 0;
 
   /*
    * Repeat until "regstack" is empty.
@@ -3751,7 +4016,7 @@ regmatch (
   for (;; ) {
     /* Some patterns may take a long time to match, e.g., "\([a-z]\+\)\+Q".
      * Allow interrupting them with CTRL-C. */
-    fast_breakcheck();
+    reg_breakcheck();
 
 #ifdef REGEXP_DEBUG
     if (scan != NULL && regnarrate) {
@@ -3792,21 +4057,21 @@ regmatch (
 
       op = OP(scan);
       /* Check for character class with NL added. */
-      if (!reg_line_lbr && WITH_NL(op) && REG_MULTI
-          && *reginput == NUL && reglnum <= reg_maxline) {
+      if (!rex->reg_line_lbr && WITH_NL(op) && REG_MULTI
+          && *rex->reginput == NUL && rex->reglnum <= rex->reg_maxline) {
         reg_nextline();
-      } else if (reg_line_lbr && WITH_NL(op) && *reginput == '\n') {
+      } else if (rex->reg_line_lbr && WITH_NL(op) && *rex->reginput == '\n') {
         ADVANCE_REGINPUT();
       } else {
         if (WITH_NL(op))
           op -= ADD_NL;
         if (has_mbyte)
-          c = (*mb_ptr2char)(reginput);
+          c = (*mb_ptr2char)(rex->reginput);
         else
-          c = *reginput;
+          c = *rex->reginput;
         switch (op) {
         case BOL:
-          if (reginput != regline)
+          if (rex->reginput != rex->regline)
             status = RA_NOMATCH;
           break;
 
@@ -3819,22 +4084,22 @@ regmatch (
           /* We're not at the beginning of the file when below the first
            * line where we started, not at the start of the line or we
            * didn't start at the first line of the buffer. */
-          if (reglnum != 0 || reginput != regline
-              || (REG_MULTI && reg_firstlnum > 1))
+          if (rex->reglnum != 0 || rex->reginput != rex->regline
+              || (REG_MULTI && rex->reg_firstlnum > 1))
             status = RA_NOMATCH;
           break;
 
         case RE_EOF:
-          if (reglnum != reg_maxline || c != NUL)
+          if (rex->reglnum != rex->reg_maxline || c != NUL)
             status = RA_NOMATCH;
           break;
 
         case CURSOR:
           /* Check if the buffer is in a window and compare the
            * reg_win->w_cursor position to the match position. */
-          if (reg_win == NULL
-              || (reglnum + reg_firstlnum != reg_win->w_cursor.lnum)
-              || ((colnr_T)(reginput - regline) != reg_win->w_cursor.col))
+          if (rex->reg_win == NULL
+              || (rex->reglnum + rex->reg_firstlnum != rex->reg_win->w_cursor.lnum)
+              || ((colnr_T)(rex->reginput - rex->regline) != rex->reg_win->w_cursor.col))
             status = RA_NOMATCH;
           break;
 
@@ -3845,16 +4110,16 @@ regmatch (
           int cmp = OPERAND(scan)[1];
           pos_T   *pos;
 
-          pos = getmark_buf(reg_buf, mark, FALSE);
+          pos = getmark_buf(rex->reg_buf, mark, FALSE);
           if (pos == NULL                    /* mark doesn't exist */
               || pos->lnum <= 0              /* mark isn't set in reg_buf */
-              || (pos->lnum == reglnum + reg_firstlnum
-                  ? (pos->col == (colnr_T)(reginput - regline)
+              || (pos->lnum == rex->reglnum + rex->reg_firstlnum
+                  ? (pos->col == (colnr_T)(rex->reginput - rex->regline)
                      ? (cmp == '<' || cmp == '>')
-                     : (pos->col < (colnr_T)(reginput - regline)
+                     : (pos->col < (colnr_T)(rex->reginput - rex->regline)
                         ? cmp != '>'
                         : cmp != '<'))
-                  : (pos->lnum < reglnum + reg_firstlnum
+                  : (pos->lnum < rex->reglnum + rex->reg_firstlnum
                      ? cmp != '>'
                      : cmp != '<')))
             status = RA_NOMATCH;
@@ -3867,24 +4132,24 @@ regmatch (
           break;
 
         case RE_LNUM:
-          assert(reglnum + reg_firstlnum >= 0
-                 && (uintmax_t)(reglnum + reg_firstlnum) <= UINT32_MAX);
-          if (!REG_MULTI || !re_num_cmp((uint32_t)(reglnum + reg_firstlnum),
+          assert(rex->reglnum + rex->reg_firstlnum >= 0
+                 && (uintmax_t)(rex->reglnum + rex->reg_firstlnum) <= UINT32_MAX);
+          if (!REG_MULTI || !re_num_cmp((uint32_t)(rex->reglnum + rex->reg_firstlnum),
                                         scan))
             status = RA_NOMATCH;
           break;
 
         case RE_COL:
-          assert(reginput - regline + 1 >= 0
-                 && (uintmax_t)(reginput - regline + 1) <= UINT32_MAX);
-          if (!re_num_cmp((uint32_t)(reginput - regline + 1), scan))
+          assert(rex->reginput - rex->regline + 1 >= 0
+                 && (uintmax_t)(rex->reginput - rex->regline + 1) <= UINT32_MAX);
+          if (!re_num_cmp((uint32_t)(rex->reginput - rex->regline + 1), scan))
             status = RA_NOMATCH;
           break;
 
         case RE_VCOL:
-          if (!re_num_cmp(win_linetabsize(reg_win == NULL ? curwin : reg_win,
-                                          regline,
-                                          (colnr_T)(reginput - regline)) + 1,
+          if (!re_num_cmp(win_linetabsize(rex->reg_win == NULL ? curwin : rex->reg_win,
+                                          rex->regline,
+                                          (colnr_T)(rex->reginput - rex->regline)) + 1,
                           scan))
             status = RA_NOMATCH;
           break;
@@ -3896,34 +4161,34 @@ regmatch (
             int this_class;
 
             /* Get class of current and previous char (if it exists). */
-            this_class = mb_get_class_buf(reginput, reg_buf);
+            this_class = mb_get_class_buf(rex->reginput, rex->reg_buf);
             if (this_class <= 1)
               status = RA_NOMATCH;        /* not on a word at all */
             else if (reg_prev_class() == this_class)
               status = RA_NOMATCH;        /* previous char is in same word */
           } else {
-            if (!vim_iswordc_buf(c, reg_buf) || (reginput > regline
-                                                 && vim_iswordc_buf(reginput[-1
-                                                     ], reg_buf)))
+            if (!vim_iswordc_buf(c, rex->reg_buf) || (rex->reginput > rex->regline
+                                                 && vim_iswordc_buf(rex->reginput[-1
+                                                     ], rex->reg_buf)))
               status = RA_NOMATCH;
           }
           break;
 
         case EOW:       /* word\>; reginput points after d */
-          if (reginput == regline)      /* Can't match at start of line */
+          if (rex->reginput == rex->regline)      /* Can't match at start of line */
             status = RA_NOMATCH;
           else if (has_mbyte) {
             int this_class, prev_class;
 
             /* Get class of current and previous char (if it exists). */
-            this_class = mb_get_class_buf(reginput, reg_buf);
+            this_class = mb_get_class_buf(rex->reginput, rex->reg_buf);
             prev_class = reg_prev_class();
             if (this_class == prev_class
                 || prev_class == 0 || prev_class == 1)
               status = RA_NOMATCH;
           } else {
-            if (!vim_iswordc_buf(reginput[-1], reg_buf)
-                || (reginput[0] != NUL && vim_iswordc_buf(c, reg_buf)))
+            if (!vim_iswordc_buf(rex->reginput[-1], rex->reg_buf)
+                || (rex->reginput[0] != NUL && vim_iswordc_buf(c, rex->reg_buf)))
               status = RA_NOMATCH;
           }
           break;   /* Matched with EOW */
@@ -3944,21 +4209,21 @@ regmatch (
           break;
 
         case SIDENT:
-          if (VIM_ISDIGIT(*reginput) || !vim_isIDc(c))
+          if (VIM_ISDIGIT(*rex->reginput) || !vim_isIDc(c))
             status = RA_NOMATCH;
           else
             ADVANCE_REGINPUT();
           break;
 
         case KWORD:
-          if (!vim_iswordp_buf(reginput, reg_buf))
+          if (!vim_iswordp_buf(rex->reginput, rex->reg_buf))
             status = RA_NOMATCH;
           else
             ADVANCE_REGINPUT();
           break;
 
         case SKWORD:
-          if (VIM_ISDIGIT(*reginput) || !vim_iswordp_buf(reginput, reg_buf))
+          if (VIM_ISDIGIT(*rex->reginput) || !vim_iswordp_buf(rex->reginput, rex->reg_buf))
             status = RA_NOMATCH;
           else
             ADVANCE_REGINPUT();
@@ -3972,21 +4237,21 @@ regmatch (
           break;
 
         case SFNAME:
-          if (VIM_ISDIGIT(*reginput) || !vim_isfilec(c))
+          if (VIM_ISDIGIT(*rex->reginput) || !vim_isfilec(c))
             status = RA_NOMATCH;
           else
             ADVANCE_REGINPUT();
           break;
 
         case PRINT:
-          if (!vim_isprintc(PTR2CHAR(reginput)))
+          if (!vim_isprintc(PTR2CHAR(rex->reginput)))
             status = RA_NOMATCH;
           else
             ADVANCE_REGINPUT();
           break;
 
         case SPRINT:
-          if (VIM_ISDIGIT(*reginput) || !vim_isprintc(PTR2CHAR(reginput)))
+          if (VIM_ISDIGIT(*rex->reginput) || !vim_isprintc(PTR2CHAR(rex->reginput)))
             status = RA_NOMATCH;
           else
             ADVANCE_REGINPUT();
@@ -4125,29 +4390,29 @@ regmatch (
 
           opnd = OPERAND(scan);
           /* Inline the first byte, for speed. */
-          if (*opnd != *reginput
-              && (!ireg_ic || (
+          if (*opnd != *rex->reginput
+              && (!rex->ireg_ic || (
                     !enc_utf8 &&
-                    vim_tolower(*opnd) != vim_tolower(*reginput))))
+                    vim_tolower(*opnd) != vim_tolower(*rex->reginput))))
             status = RA_NOMATCH;
           else if (*opnd == NUL) {
             /* match empty string always works; happens when "~" is
              * empty. */
           } else {
-            if (opnd[1] == NUL && !(enc_utf8 && ireg_ic)) {
+            if (opnd[1] == NUL && !(enc_utf8 && rex->ireg_ic)) {
               len = 1; /* matched a single byte above */
             } else {
               // Need to match first byte again for multi-byte.
               len = (int)STRLEN(opnd);
-              if (cstrncmp(opnd, reginput, &len) != 0) {
+              if (cstrncmp(opnd, rex->reginput, &len) != 0) {
                 status = RA_NOMATCH;
               }
             }
             // Check for following composing character, unless %C
             // follows (skips over all composing chars).
             if (status != RA_NOMATCH && enc_utf8
-                && UTF_COMPOSINGLIKE(reginput, reginput + len)
-                && !ireg_icombine
+                && UTF_COMPOSINGLIKE(rex->reginput, rex->reginput + len)
+                && !rex->ireg_icombine
                 && OP(next) != RE_COMPOSING) {
               // raaron: This code makes a composing character get
               // ignored, which is the correct behavior (sometimes)
@@ -4155,7 +4420,7 @@ regmatch (
               status = RA_NOMATCH;
             }
             if (status != RA_NOMATCH) {
-              reginput += len;
+              rex->reginput += len;
             }
           }
         }
@@ -4190,25 +4455,25 @@ regmatch (
               /* When only a composing char is given match at any
                * position where that composing char appears. */
               status = RA_NOMATCH;
-              for (i = 0; reginput[i] != NUL; i += utf_char2len(inpc)) {
-                inpc = mb_ptr2char(reginput + i);
+              for (i = 0; rex->reginput[i] != NUL; i += utf_char2len(inpc)) {
+                inpc = mb_ptr2char(rex->reginput + i);
                 if (!utf_iscomposing(inpc)) {
                   if (i > 0)
                     break;
                 } else if (opndc == inpc) {
                   /* Include all following composing chars. */
-                  len = i + mb_ptr2len(reginput + i);
+                  len = i + mb_ptr2len(rex->reginput + i);
                   status = RA_MATCH;
                   break;
                 }
               }
             } else
               for (i = 0; i < len; ++i)
-                if (opnd[i] != reginput[i]) {
+                if (opnd[i] != rex->reginput[i]) {
                   status = RA_NOMATCH;
                   break;
                 }
-            reginput += len;
+            rex->reginput += len;
           } else
             status = RA_NOMATCH;
           break;
@@ -4216,8 +4481,8 @@ regmatch (
         case RE_COMPOSING:
           if (enc_utf8) {
             // Skip composing characters.
-            while (utf_iscomposing(utf_ptr2char(reginput))) {
-              mb_cptr_adv(reginput);
+            while (utf_iscomposing(utf_ptr2char(rex->reginput))) {
+              mb_cptr_adv(rex->reginput);
             }
           }
           break;
@@ -4237,19 +4502,19 @@ regmatch (
            * The positions are stored in "backpos" and found by the
            * current value of "scan", the position in the RE program.
            */
-          backpos_T *bp = (backpos_T *)backpos.ga_data;
-          for (i = 0; i < backpos.ga_len; ++i)
+          backpos_T *bp = (backpos_T *)rex->backpos.ga_data;
+          for (i = 0; i < rex->backpos.ga_len; ++i)
             if (bp[i].bp_scan == scan)
               break;
-          if (i == backpos.ga_len) {
-            backpos_T *p = GA_APPEND_VIA_PTR(backpos_T, &backpos);
+          if (i == rex->backpos.ga_len) {
+            backpos_T *p = GA_APPEND_VIA_PTR(backpos_T, &rex->backpos);
             p->bp_scan = scan;
           } else if (reg_save_equal(&bp[i].bp_pos))
             /* Still at same position as last time, fail. */
             status = RA_NOMATCH;
 
           if (status != RA_FAIL && status != RA_NOMATCH)
-            reg_save(&bp[i].bp_pos, &backpos);
+            reg_save(&bp[i].bp_pos, &rex->backpos);
         }
         break;
 
@@ -4271,8 +4536,8 @@ regmatch (
             status = RA_FAIL;
           else {
             rp->rs_no = no;
-            save_se(&rp->rs_un.sesave, &reg_startpos[no],
-                &reg_startp[no]);
+            save_se(&rp->rs_un.sesave, &rex->reg_startpos[no],
+                &rex->reg_startp[no]);
             /* We simply continue and handle the result when done. */
           }
         }
@@ -4302,8 +4567,8 @@ regmatch (
             status = RA_FAIL;
           else {
             rp->rs_no = no;
-            save_se(&rp->rs_un.sesave, &reg_startzpos[no],
-                &reg_startzp[no]);
+            save_se(&rp->rs_un.sesave, &rex->reg_startzpos[no],
+                &rex->reg_startzp[no]);
             /* We simply continue and handle the result when done. */
           }
         }
@@ -4327,7 +4592,7 @@ regmatch (
             status = RA_FAIL;
           else {
             rp->rs_no = no;
-            save_se(&rp->rs_un.sesave, &reg_endpos[no], &reg_endp[no]);
+            save_se(&rp->rs_un.sesave, &rex->reg_endpos[no], &rex->reg_endp[no]);
             /* We simply continue and handle the result when done. */
           }
         }
@@ -4350,8 +4615,8 @@ regmatch (
             status = RA_FAIL;
           else {
             rp->rs_no = no;
-            save_se(&rp->rs_un.sesave, &reg_endzpos[no],
-                &reg_endzp[no]);
+            save_se(&rp->rs_un.sesave, &rex->reg_endzpos[no],
+                &rex->reg_endzp[no]);
             /* We simply continue and handle the result when done. */
           }
         }
@@ -4372,36 +4637,36 @@ regmatch (
           no = op - BACKREF;
           cleanup_subexpr();
           if (!REG_MULTI) {             /* Single-line regexp */
-            if (reg_startp[no] == NULL || reg_endp[no] == NULL) {
+            if (rex->reg_startp[no] == NULL || rex->reg_endp[no] == NULL) {
               /* Backref was not set: Match an empty string. */
               len = 0;
             } else {
               /* Compare current input with back-ref in the same
                * line. */
-              len = (int)(reg_endp[no] - reg_startp[no]);
-              if (cstrncmp(reg_startp[no], reginput, &len) != 0)
+              len = (int)(rex->reg_endp[no] - rex->reg_startp[no]);
+              if (cstrncmp(rex->reg_startp[no], rex->reginput, &len) != 0)
                 status = RA_NOMATCH;
             }
           } else {                            /* Multi-line regexp */
-            if (reg_startpos[no].lnum < 0 || reg_endpos[no].lnum < 0) {
+            if (rex->reg_startpos[no].lnum < 0 || rex->reg_endpos[no].lnum < 0) {
               /* Backref was not set: Match an empty string. */
               len = 0;
             } else {
-              if (reg_startpos[no].lnum == reglnum
-                  && reg_endpos[no].lnum == reglnum) {
+              if (rex->reg_startpos[no].lnum == rex->reglnum
+                  && rex->reg_endpos[no].lnum == rex->reglnum) {
                 /* Compare back-ref within the current line. */
-                len = reg_endpos[no].col - reg_startpos[no].col;
-                if (cstrncmp(regline + reg_startpos[no].col,
-                        reginput, &len) != 0)
+                len = rex->reg_endpos[no].col - rex->reg_startpos[no].col;
+                if (cstrncmp(rex->regline + rex->reg_startpos[no].col,
+                        rex->reginput, &len) != 0)
                   status = RA_NOMATCH;
               } else {
                 /* Messy situation: Need to compare between two
                  * lines. */
                 int r = match_with_backref(
-                    reg_startpos[no].lnum,
-                    reg_startpos[no].col,
-                    reg_endpos[no].lnum,
-                    reg_endpos[no].col,
+                    rex->reg_startpos[no].lnum,
+                    rex->reg_startpos[no].col,
+                    rex->reg_endpos[no].lnum,
+                    rex->reg_endpos[no].col,
                     &len);
 
                 if (r != RA_MATCH)
@@ -4411,7 +4676,7 @@ regmatch (
           }
 
           /* Matched the backref, skip over it. */
-          reginput += len;
+          rex->reginput += len;
         }
         break;
 
@@ -4433,10 +4698,10 @@ regmatch (
               && re_extmatch_in->matches[no] != NULL) {
             len = (int)STRLEN(re_extmatch_in->matches[no]);
             if (cstrncmp(re_extmatch_in->matches[no],
-                    reginput, &len) != 0)
+                    rex->reginput, &len) != 0)
               status = RA_NOMATCH;
             else
-              reginput += len;
+              rex->reginput += len;
           } else {
             /* Backref was not set: Match an empty string. */
           }
@@ -4460,8 +4725,8 @@ regmatch (
         case BRACE_LIMITS:
         {
           if (OP(next) == BRACE_SIMPLE) {
-            bl_minval = OPERAND_MIN(scan);
-            bl_maxval = OPERAND_MAX(scan);
+            rex->bl_minval = OPERAND_MIN(scan);
+            rex->bl_maxval = OPERAND_MAX(scan);
           } else if (OP(next) >= BRACE_COMPLEX
                      && OP(next) < BRACE_COMPLEX + 10) {
             no = OP(next) - BRACE_COMPLEX;
@@ -4469,7 +4734,7 @@ regmatch (
             brace_max[no] = OPERAND_MAX(scan);
             brace_count[no] = 0;
           } else {
-            EMSG(_(e_internal));                    /* Shouldn't happen */
+            REG_EMSG(_(e_internal));                /* Shouldn't happen */
             status = RA_FAIL;
           }
         }
@@ -4497,7 +4762,7 @@ regmatch (
               status = RA_FAIL;
             else {
               rp->rs_no = no;
-              reg_save(&rp->rs_un.regsave, &backpos);
+              reg_save(&rp->rs_un.regsave, &rex->backpos);
               next = OPERAND(scan);
               /* We continue and handle the result when done. */
             }
@@ -4513,7 +4778,7 @@ regmatch (
                 status = RA_FAIL;
               else {
                 rp->rs_no = no;
-                reg_save(&rp->rs_un.regsave, &backpos);
+                reg_save(&rp->rs_un.regsave, &rex->backpos);
                 next = OPERAND(scan);
                 /* We continue and handle the result when done. */
               }
@@ -4525,7 +4790,7 @@ regmatch (
               if (rp == NULL)
                 status = RA_FAIL;
               else {
-                reg_save(&rp->rs_un.regsave, &backpos);
+                reg_save(&rp->rs_un.regsave, &rex->backpos);
                 /* We continue and handle the result when done. */
               }
             }
@@ -4545,7 +4810,7 @@ regmatch (
            */
           if (OP(next) == EXACTLY) {
             rst.nextb = *OPERAND(next);
-            if (ireg_ic) {
+            if (rex->ireg_ic) {
               if (vim_isupper(rst.nextb))
                 rst.nextb_ic = vim_tolower(rst.nextb);
               else
@@ -4560,8 +4825,8 @@ regmatch (
             rst.minval = (op == STAR) ? 0 : 1;
             rst.maxval = MAX_LIMIT;
           } else {
-            rst.minval = bl_minval;
-            rst.maxval = bl_maxval;
+            rst.minval = rex->bl_minval;
+            rst.maxval = rex->bl_maxval;
           }
 
           /*
@@ -4580,12 +4845,12 @@ regmatch (
             /* It could match.  Prepare for trying to match what
              * follows.  The code is below.  Parameters are stored in
              * a regstar_T on the regstack. */
-            if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp) {
-              EMSG(_(e_maxmempat));
+            if ((long)((unsigned)rex->regstack.ga_len >> 10) >= p_mmp) {
+              REG_EMSG(_(e_maxmempat));
               status = RA_FAIL;
             } else {
-              ga_grow(&regstack, sizeof(regstar_T));
-              regstack.ga_len += sizeof(regstar_T);
+              ga_grow(&rex->regstack, sizeof(regstar_T));
+              rex->regstack.ga_len += sizeof(regstar_T);
               rp = regstack_push(rst.minval <= rst.maxval
                   ? RS_STAR_LONG : RS_STAR_SHORT, scan);
               if (rp == NULL)
@@ -4609,7 +4874,7 @@ regmatch (
             status = RA_FAIL;
           else {
             rp->rs_no = op;
-            reg_save(&rp->rs_un.regsave, &backpos);
+            reg_save(&rp->rs_un.regsave, &rex->backpos);
             next = OPERAND(scan);
             /* We continue and handle the result when done. */
           }
@@ -4618,12 +4883,12 @@ regmatch (
         case BEHIND:
         case NOBEHIND:
           /* Need a bit of room to store extra positions. */
-          if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp) {
-            EMSG(_(e_maxmempat));
+          if ((long)((unsigned)rex->regstack.ga_len >> 10) >= p_mmp) {
+            REG_EMSG(_(e_maxmempat));
             status = RA_FAIL;
           } else {
-            ga_grow(&regstack, sizeof(regbehind_T));
-            regstack.ga_len += sizeof(regbehind_T);
+            ga_grow(&rex->regstack, sizeof(regbehind_T));
+            rex->regstack.ga_len += sizeof(regbehind_T);
             rp = regstack_push(RS_BEHIND1, scan);
             if (rp == NULL)
               status = RA_FAIL;
@@ -4633,7 +4898,7 @@ regmatch (
               save_subexpr(((regbehind_T *)rp) - 1);
 
               rp->rs_no = op;
-              reg_save(&rp->rs_un.regsave, &backpos);
+              reg_save(&rp->rs_un.regsave, &rex->backpos);
               /* First try if what follows matches.  If it does then we
                * check the behind match by looping. */
             }
@@ -4642,18 +4907,18 @@ regmatch (
 
         case BHPOS:
           if (REG_MULTI) {
-            if (behind_pos.rs_u.pos.col != (colnr_T)(reginput - regline)
-                || behind_pos.rs_u.pos.lnum != reglnum)
+            if (rex->behind_pos.rs_u.pos.col != (colnr_T)(rex->reginput - rex->regline)
+                || rex->behind_pos.rs_u.pos.lnum != rex->reglnum)
               status = RA_NOMATCH;
-          } else if (behind_pos.rs_u.ptr != reginput)
+          } else if (rex->behind_pos.rs_u.ptr != rex->reginput)
             status = RA_NOMATCH;
           break;
 
         case NEWL:
-          if ((c != NUL || !REG_MULTI || reglnum > reg_maxline
-               || reg_line_lbr) && (c != '\n' || !reg_line_lbr))
+          if ((c != NUL || !REG_MULTI || rex->reglnum > rex->reg_maxline
+               || rex->reg_line_lbr) && (c != '\n' || !rex->reg_line_lbr))
             status = RA_NOMATCH;
-          else if (reg_line_lbr)
+          else if (rex->reg_line_lbr)
             ADVANCE_REGINPUT();
           else
             reg_nextline();
@@ -4664,7 +4929,7 @@ regmatch (
           break;
 
         default:
-          EMSG(_(e_re_corr));
+          REG_EMSG(_(e_re_corr));
 #ifdef REGEXP_DEBUG
           printf("Illegal op code %d\n", op);
 #endif
@@ -4686,8 +4951,8 @@ regmatch (
      * If there is something on the regstack execute the code for the state.
      * If the state is popped then loop and use the older state.
      */
-    while (!GA_EMPTY(&regstack) && status != RA_FAIL) {
-      rp = (regitem_T *)((char *)regstack.ga_data + regstack.ga_len) - 1;
+    while (!GA_EMPTY(&rex->regstack) && status != RA_FAIL) {
+      rp = (regitem_T *)((char *)rex->regstack.ga_data + rex->regstack.ga_len) - 1;
       switch (rp->rs_state) {
       case RS_NOPEN:
         /* Result is passed on as-is, simply pop the state. */
@@ -4697,32 +4962,32 @@ regmatch (
       case RS_MOPEN:
         /* Pop the state.  Restore pointers when there is no match. */
         if (status == RA_NOMATCH)
-          restore_se(&rp->rs_un.sesave, &reg_startpos[rp->rs_no],
-              &reg_startp[rp->rs_no]);
+          restore_se(&rp->rs_un.sesave, &rex->reg_startpos[rp->rs_no],
+              &rex->reg_startp[rp->rs_no]);
         regstack_pop(&scan);
         break;
 
       case RS_ZOPEN:
         /* Pop the state.  Restore pointers when there is no match. */
         if (status == RA_NOMATCH)
-          restore_se(&rp->rs_un.sesave, &reg_startzpos[rp->rs_no],
-              &reg_startzp[rp->rs_no]);
+          restore_se(&rp->rs_un.sesave, &rex->reg_startzpos[rp->rs_no],
+              &rex->reg_startzp[rp->rs_no]);
         regstack_pop(&scan);
         break;
 
       case RS_MCLOSE:
         /* Pop the state.  Restore pointers when there is no match. */
         if (status == RA_NOMATCH)
-          restore_se(&rp->rs_un.sesave, &reg_endpos[rp->rs_no],
-              &reg_endp[rp->rs_no]);
+          restore_se(&rp->rs_un.sesave, &rex->reg_endpos[rp->rs_no],
+              &rex->reg_endp[rp->rs_no]);
         regstack_pop(&scan);
         break;
 
       case RS_ZCLOSE:
         /* Pop the state.  Restore pointers when there is no match. */
         if (status == RA_NOMATCH)
-          restore_se(&rp->rs_un.sesave, &reg_endzpos[rp->rs_no],
-              &reg_endzp[rp->rs_no]);
+          restore_se(&rp->rs_un.sesave, &rex->reg_endzpos[rp->rs_no],
+              &rex->reg_endzp[rp->rs_no]);
         regstack_pop(&scan);
         break;
 
@@ -4733,7 +4998,7 @@ regmatch (
         else {
           if (status != RA_BREAK) {
             /* After a non-matching branch: try next one. */
-            reg_restore(&rp->rs_un.regsave, &backpos);
+            reg_restore(&rp->rs_un.regsave, &rex->backpos);
             scan = rp->rs_scan;
           }
           if (scan == NULL || OP(scan) != BRANCH) {
@@ -4743,7 +5008,7 @@ regmatch (
           } else {
             /* Prepare to try a branch. */
             rp->rs_scan = regnext(scan);
-            reg_save(&rp->rs_un.regsave, &backpos);
+            reg_save(&rp->rs_un.regsave, &rex->backpos);
             scan = OPERAND(scan);
           }
         }
@@ -4752,7 +5017,7 @@ regmatch (
       case RS_BRCPLX_MORE:
         /* Pop the state.  Restore pointers when there is no match. */
         if (status == RA_NOMATCH) {
-          reg_restore(&rp->rs_un.regsave, &backpos);
+          reg_restore(&rp->rs_un.regsave, &rex->backpos);
           --brace_count[rp->rs_no];             /* decrement match count */
         }
         regstack_pop(&scan);
@@ -4762,7 +5027,7 @@ regmatch (
         /* Pop the state.  Restore pointers when there is no match. */
         if (status == RA_NOMATCH) {
           /* There was no match, but we did find enough matches. */
-          reg_restore(&rp->rs_un.regsave, &backpos);
+          reg_restore(&rp->rs_un.regsave, &rex->backpos);
           --brace_count[rp->rs_no];
           /* continue with the items after "\{}" */
           status = RA_CONT;
@@ -4776,7 +5041,7 @@ regmatch (
         /* Pop the state.  Restore pointers when there is no match. */
         if (status == RA_NOMATCH)
           /* There was no match, try to match one more item. */
-          reg_restore(&rp->rs_un.regsave, &backpos);
+          reg_restore(&rp->rs_un.regsave, &rex->backpos);
         regstack_pop(&scan);
         if (status == RA_NOMATCH) {
           scan = OPERAND(scan);
@@ -4793,7 +5058,7 @@ regmatch (
         else {
           status = RA_CONT;
           if (rp->rs_no != SUBPAT)              /* zero-width */
-            reg_restore(&rp->rs_un.regsave, &backpos);
+            reg_restore(&rp->rs_un.regsave, &rex->backpos);
         }
         regstack_pop(&scan);
         if (status == RA_CONT)
@@ -4803,7 +5068,7 @@ regmatch (
       case RS_BEHIND1:
         if (status == RA_NOMATCH) {
           regstack_pop(&scan);
-          regstack.ga_len -= sizeof(regbehind_T);
+          rex->regstack.ga_len -= sizeof(regbehind_T);
         } else {
           /* The stuff after BEHIND/NOBEHIND matches.  Now try if
            * the behind part does (not) match before the current
@@ -4812,7 +5077,7 @@ regmatch (
            * the current position. */
 
           /* save the position after the found match for next */
-          reg_save(&(((regbehind_T *)rp) - 1)->save_after, &backpos);
+          reg_save(&(((regbehind_T *)rp) - 1)->save_after, &rex->backpos);
 
           /* Start looking for a match with operand at the current
            * position.  Go back one character until we find the
@@ -4820,12 +5085,12 @@ regmatch (
            * line (for multi-line matching).
            * Set behind_pos to where the match should end, BHPOS
            * will match it.  Save the current value. */
-          (((regbehind_T *)rp) - 1)->save_behind = behind_pos;
-          behind_pos = rp->rs_un.regsave;
+          (((regbehind_T *)rp) - 1)->save_behind = rex->behind_pos;
+          rex->behind_pos = rp->rs_un.regsave;
 
           rp->rs_state = RS_BEHIND2;
 
-          reg_restore(&rp->rs_un.regsave, &backpos);
+          reg_restore(&rp->rs_un.regsave, &rex->backpos);
           scan = OPERAND(rp->rs_scan) + 4;
         }
         break;
@@ -4834,12 +5099,12 @@ regmatch (
         /*
          * Looping for BEHIND / NOBEHIND match.
          */
-        if (status == RA_MATCH && reg_save_equal(&behind_pos)) {
+        if (status == RA_MATCH && reg_save_equal(&rex->behind_pos)) {
           /* found a match that ends where "next" started */
-          behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
+          rex->behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
           if (rp->rs_no == BEHIND)
             reg_restore(&(((regbehind_T *)rp) - 1)->save_after,
-                &backpos);
+                &rex->backpos);
           else {
             /* But we didn't want a match.  Need to restore the
              * subexpr, because what follows matched, so they have
@@ -4848,7 +5113,7 @@ regmatch (
             restore_subexpr(((regbehind_T *)rp) - 1);
           }
           regstack_pop(&scan);
-          regstack.ga_len -= sizeof(regbehind_T);
+          rex->regstack.ga_len -= sizeof(regbehind_T);
         } else {
           long limit;
 
@@ -4859,44 +5124,44 @@ regmatch (
           if (REG_MULTI) {
             if (limit > 0
                 && ((rp->rs_un.regsave.rs_u.pos.lnum
-                     < behind_pos.rs_u.pos.lnum
-                     ? (colnr_T)STRLEN(regline)
-                     : behind_pos.rs_u.pos.col)
+                     < rex->behind_pos.rs_u.pos.lnum
+                     ? (colnr_T)STRLEN(rex->regline)
+                     : rex->behind_pos.rs_u.pos.col)
                     - rp->rs_un.regsave.rs_u.pos.col >= limit))
               no = FAIL;
             else if (rp->rs_un.regsave.rs_u.pos.col == 0) {
               if (rp->rs_un.regsave.rs_u.pos.lnum
-                  < behind_pos.rs_u.pos.lnum
+                  < rex->behind_pos.rs_u.pos.lnum
                   || reg_getline(
                       --rp->rs_un.regsave.rs_u.pos.lnum)
                   == NULL)
                 no = FAIL;
               else {
-                reg_restore(&rp->rs_un.regsave, &backpos);
+                reg_restore(&rp->rs_un.regsave, &rex->backpos);
                 rp->rs_un.regsave.rs_u.pos.col =
-                  (colnr_T)STRLEN(regline);
+                  (colnr_T)STRLEN(rex->regline);
               }
             } else {
               if (has_mbyte)
                 rp->rs_un.regsave.rs_u.pos.col -=
-                  (*mb_head_off)(regline, regline
+                  (*mb_head_off)(rex->regline, rex->regline
                                  + rp->rs_un.regsave.rs_u.pos.col - 1) + 1;
               else
                 --rp->rs_un.regsave.rs_u.pos.col;
             }
           } else {
-            if (rp->rs_un.regsave.rs_u.ptr == regline)
+            if (rp->rs_un.regsave.rs_u.ptr == rex->regline)
               no = FAIL;
             else {
-              mb_ptr_back(regline, rp->rs_un.regsave.rs_u.ptr);
-              if (limit > 0 && (long)(behind_pos.rs_u.ptr
+              mb_ptr_back(rex->regline, rp->rs_un.regsave.rs_u.ptr);
+              if (limit > 0 && (long)(rex->behind_pos.rs_u.ptr
                                       - rp->rs_un.regsave.rs_u.ptr) > limit)
                 no = FAIL;
             }
           }
           if (no == OK) {
             /* Advanced, prepare for finding match again. */
-            reg_restore(&rp->rs_un.regsave, &backpos);
+            reg_restore(&rp->rs_un.regsave, &rex->backpos);
             scan = OPERAND(rp->rs_scan) + 4;
             if (status == RA_MATCH) {
               /* We did match, so subexpr may have been changed,
@@ -4906,10 +5171,10 @@ regmatch (
             }
           } else {
             /* Can't advance.  For NOBEHIND that's a match. */
-            behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
+            rex->behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
             if (rp->rs_no == NOBEHIND) {
               reg_restore(&(((regbehind_T *)rp) - 1)->save_after,
-                  &backpos);
+                  &rex->backpos);
               status = RA_MATCH;
             } else {
               /* We do want a proper match.  Need to restore the
@@ -4921,7 +5186,7 @@ regmatch (
               }
             }
             regstack_pop(&scan);
-            regstack.ga_len -= sizeof(regbehind_T);
+            rex->regstack.ga_len -= sizeof(regbehind_T);
           }
         }
         break;
@@ -4933,13 +5198,13 @@ regmatch (
 
         if (status == RA_MATCH) {
           regstack_pop(&scan);
-          regstack.ga_len -= sizeof(regstar_T);
+          rex->regstack.ga_len -= sizeof(regstar_T);
           break;
         }
 
         /* Tried once already, restore input pointers. */
         if (status != RA_BREAK)
-          reg_restore(&rp->rs_un.regsave, &backpos);
+          reg_restore(&rp->rs_un.regsave, &rex->backpos);
 
         /* Repeat until we found a position where it could match. */
         for (;; ) {
@@ -4950,18 +5215,18 @@ regmatch (
                * didn't match -- back up one char. */
               if (--rst->count < rst->minval)
                 break;
-              if (reginput == regline) {
+              if (rex->reginput == rex->regline) {
                 /* backup to last char of previous line */
-                --reglnum;
-                regline = reg_getline(reglnum);
+                --rex->reglnum;
+                rex->regline = reg_getline(rex->reglnum);
                 /* Just in case regrepeat() didn't count
                  * right. */
-                if (regline == NULL)
+                if (rex->regline == NULL)
                   break;
-                reginput = regline + STRLEN(regline);
-                fast_breakcheck();
+                rex->reginput = rex->regline + STRLEN(rex->regline);
+                reg_breakcheck();
               } else
-                mb_ptr_back(regline, reginput);
+                mb_ptr_back(rex->regline, rex->reginput);
             } else {
               /* Range is backwards, use shortest match first.
                * Careful: maxval and minval are exchanged!
@@ -4978,9 +5243,9 @@ regmatch (
             status = RA_NOMATCH;
 
           /* If it could match, try it. */
-          if (rst->nextb == NUL || *reginput == rst->nextb
-              || *reginput == rst->nextb_ic) {
-            reg_save(&rp->rs_un.regsave, &backpos);
+          if (rst->nextb == NUL || *rex->reginput == rst->nextb
+              || *rex->reginput == rst->nextb_ic) {
+            reg_save(&rp->rs_un.regsave, &rex->backpos);
             scan = regnext(rp->rs_scan);
             status = RA_CONT;
             break;
@@ -4989,7 +5254,7 @@ regmatch (
         if (status != RA_CONT) {
           /* Failed. */
           regstack_pop(&scan);
-          regstack.ga_len -= sizeof(regstar_T);
+          rex->regstack.ga_len -= sizeof(regstar_T);
           status = RA_NOMATCH;
         }
       }
@@ -4999,7 +5264,7 @@ regmatch (
       /* If we want to continue the inner loop or didn't pop a state
        * continue matching loop */
       if (status == RA_CONT || rp == (regitem_T *)
-          ((char *)regstack.ga_data + regstack.ga_len) - 1)
+          ((char *)rex->regstack.ga_data + rex->regstack.ga_len) - 1)
         break;
     }
 
@@ -5010,18 +5275,18 @@ regmatch (
     /*
      * If the regstack is empty or something failed we are done.
      */
-    if (GA_EMPTY(&regstack) || status == RA_FAIL) {
+    if (GA_EMPTY(&rex->regstack) || status == RA_FAIL) {
       if (scan == NULL) {
         /*
          * We get here only if there's trouble -- normally "case END" is
          * the terminating point.
          */
-        EMSG(_(e_re_corr));
+        REG_EMSG(_(e_re_corr));
 #ifdef REGEXP_DEBUG
         printf("Premature EOL\n");
 #endif
       }
-      if (status == RA_FAIL)
+      if (status == RA_FAIL && !reg_in_thread)
         got_int = TRUE;
       return status == RA_MATCH;
     }
@@ -5039,17 +5304,17 @@ static regitem_T *regstack_push(regstate_T state, char_u *scan)
 {
   regitem_T   *rp;
 
-  if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp) {
-    EMSG(_(e_maxmempat));
+  if ((long)((unsigned)rex->regstack.ga_len >> 10) >= p_mmp) {
+    REG_EMSG(_(e_maxmempat));
     return NULL;
   }
-  ga_grow(&regstack, sizeof(regitem_T));
+  ga_grow(&rex->regstack, sizeof(regitem_T));
 
-  rp = (regitem_T *)((char *)regstack.ga_data + regstack.ga_len);
+  rp = (regitem_T *)((char *)rex->regstack.ga_data + rex->regstack.ga_len);
   rp->rs_state = state;
   rp->rs_scan = scan;
 
-  regstack.ga_len += sizeof(regitem_T);
+  rex->regstack.ga_len += sizeof(regitem_T);
   return rp;
 }
 
@@ -5060,10 +5325,10 @@ static void regstack_pop(char_u **scan)
 {
   regitem_T   *rp;
 
-  rp = (regitem_T *)((char *)regstack.ga_data + regstack.ga_len) - 1;
+  rp = (regitem_T *)((char *)rex->regstack.ga_data + rex->regstack.ga_len) - 1;
   *scan = rp->rs_scan;
 
-  regstack.ga_len -= sizeof(regitem_T);
+  rex->regstack.ga_len -= sizeof(regitem_T);
 }
 
 /*
@@ -5082,7 +5347,7 @@ regrepeat (
   int mask;
   int testval = 0;
 
-  scan = reginput;          /* Make local copy of reginput for speed. */
+  scan = rex->reginput;          /* Make local copy of reginput for speed. */
   opnd = OPERAND(p);
   switch (OP(p)) {
   case ANY:
@@ -5094,12 +5359,12 @@ regrepeat (
         ++count;
         mb_ptr_adv(scan);
       }
-      if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-          || reg_line_lbr || count == maxcount)
+      if (!REG_MULTI || !WITH_NL(OP(p)) || rex->reglnum > rex->reg_maxline
+          || rex->reg_line_lbr || count == maxcount)
         break;
       ++count;                  /* count the line-break */
       reg_nextline();
-      scan = reginput;
+      scan = rex->reginput;
       if (got_int)
         break;
     }
@@ -5115,14 +5380,14 @@ regrepeat (
       if (vim_isIDc(PTR2CHAR(scan)) && (testval || !VIM_ISDIGIT(*scan))) {
         mb_ptr_adv(scan);
       } else if (*scan == NUL) {
-        if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-            || reg_line_lbr)
+        if (!REG_MULTI || !WITH_NL(OP(p)) || rex->reglnum > rex->reg_maxline
+            || rex->reg_line_lbr)
           break;
         reg_nextline();
-        scan = reginput;
+        scan = rex->reginput;
         if (got_int)
           break;
-      } else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+      } else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
         ++scan;
       else
         break;
@@ -5137,18 +5402,18 @@ regrepeat (
   case SKWORD:
   case SKWORD + ADD_NL:
     while (count < maxcount) {
-      if (vim_iswordp_buf(scan, reg_buf)
+      if (vim_iswordp_buf(scan, rex->reg_buf)
           && (testval || !VIM_ISDIGIT(*scan))) {
         mb_ptr_adv(scan);
       } else if (*scan == NUL) {
-        if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-            || reg_line_lbr)
+        if (!REG_MULTI || !WITH_NL(OP(p)) || rex->reglnum > rex->reg_maxline
+            || rex->reg_line_lbr)
           break;
         reg_nextline();
-        scan = reginput;
+        scan = rex->reginput;
         if (got_int)
           break;
-      } else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+      } else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
         ++scan;
       else
         break;
@@ -5166,14 +5431,14 @@ regrepeat (
       if (vim_isfilec(PTR2CHAR(scan)) && (testval || !VIM_ISDIGIT(*scan))) {
         mb_ptr_adv(scan);
       } else if (*scan == NUL) {
-        if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-            || reg_line_lbr)
+        if (!REG_MULTI || !WITH_NL(OP(p)) || rex->reglnum > rex->reg_maxline
+            || rex->reg_line_lbr)
           break;
         reg_nextline();
-        scan = reginput;
+        scan = rex->reginput;
         if (got_int)
           break;
-      } else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+      } else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
         ++scan;
       else
         break;
@@ -5189,17 +5454,17 @@ regrepeat (
   case SPRINT + ADD_NL:
     while (count < maxcount) {
       if (*scan == NUL) {
-        if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-            || reg_line_lbr)
+        if (!REG_MULTI || !WITH_NL(OP(p)) || rex->reglnum > rex->reg_maxline
+            || rex->reg_line_lbr)
           break;
         reg_nextline();
-        scan = reginput;
+        scan = rex->reginput;
         if (got_int)
           break;
       } else if (vim_isprintc(PTR2CHAR(scan)) == 1
                  && (testval || !VIM_ISDIGIT(*scan))) {
         mb_ptr_adv(scan);
-      } else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+      } else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
         ++scan;
       else
         break;
@@ -5214,11 +5479,11 @@ do_class:
     while (count < maxcount) {
       int l;
       if (*scan == NUL) {
-        if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-            || reg_line_lbr)
+        if (!REG_MULTI || !WITH_NL(OP(p)) || rex->reglnum > rex->reg_maxline
+            || rex->reg_line_lbr)
           break;
         reg_nextline();
-        scan = reginput;
+        scan = rex->reginput;
         if (got_int)
           break;
       } else if (has_mbyte && (l = (*mb_ptr2len)(scan)) > 1) {
@@ -5227,7 +5492,7 @@ do_class:
         scan += l;
       } else if ((class_tab[*scan] & mask) == testval)
         ++scan;
-      else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+      else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
         ++scan;
       else
         break;
@@ -5311,7 +5576,7 @@ do_class:
     /* This doesn't do a multi-byte character, because a MULTIBYTECODE
      * would have been used for it.  It does handle single-byte
      * characters, such as latin1. */
-    if (ireg_ic) {
+    if (rex->ireg_ic) {
       cu = vim_toupper(*opnd);
       cl = vim_tolower(*opnd);
       while (count < maxcount && (*scan == cu || *scan == cl)) {
@@ -5335,13 +5600,13 @@ do_class:
     /* Safety check (just in case 'encoding' was changed since
      * compiling the program). */
     if ((len = (*mb_ptr2len)(opnd)) > 1) {
-      if (ireg_ic && enc_utf8)
+      if (rex->ireg_ic && enc_utf8)
         cf = utf_fold(utf_ptr2char(opnd));
       while (count < maxcount) {
         for (i = 0; i < len; ++i)
           if (opnd[i] != scan[i])
             break;
-        if (i < len && (!ireg_ic || !enc_utf8
+        if (i < len && (!rex->ireg_ic || !enc_utf8
                         || utf_fold(utf_ptr2char(scan)) != cf))
           break;
         scan += len;
@@ -5361,14 +5626,14 @@ do_class:
     while (count < maxcount) {
       int len;
       if (*scan == NUL) {
-        if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-            || reg_line_lbr)
+        if (!REG_MULTI || !WITH_NL(OP(p)) || rex->reglnum > rex->reg_maxline
+            || rex->reg_line_lbr)
           break;
         reg_nextline();
-        scan = reginput;
+        scan = rex->reginput;
         if (got_int)
           break;
-      } else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+      } else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
         ++scan;
       else if (has_mbyte && (len = (*mb_ptr2len)(scan)) > 1) {
         if ((cstrchr(opnd, (*mb_ptr2char)(scan)) == NULL) == testval)
@@ -5385,28 +5650,28 @@ do_class:
 
   case NEWL:
     while (count < maxcount
-           && ((*scan == NUL && reglnum <= reg_maxline && !reg_line_lbr
-                && REG_MULTI) || (*scan == '\n' && reg_line_lbr))) {
+           && ((*scan == NUL && rex->reglnum <= rex->reg_maxline && !rex->reg_line_lbr
+                && REG_MULTI) || (*scan == '\n' && rex->reg_line_lbr))) {
       count++;
-      if (reg_line_lbr)
+      if (rex->reg_line_lbr)
         ADVANCE_REGINPUT();
       else
         reg_nextline();
-      scan = reginput;
+      scan = rex->reginput;
       if (got_int)
         break;
     }
     break;
 
   default:                      /* Oh dear.  Called inappropriately. */
-    EMSG(_(e_re_corr));
+    REG_EMSG(_(e_re_corr));
 #ifdef REGEXP_DEBUG
     printf("Called regrepeat with op code %d\n", OP(p));
 #endif
     break;
   }
 
-  reginput = scan;
+  rex->reginput = scan;
 
   return (int)count;
 }
@@ -5441,13 +5706,13 @@ static int prog_magic_wrong(void)
 {
   regprog_T   *prog;
 
-  prog = REG_MULTI ? reg_mmatch->regprog : reg_match->regprog;
+  prog = REG_MULTI ? rex->reg_mmatch->regprog : rex->reg_match->regprog;
   if (prog->engine == &nfa_regengine)
     /* For NFA matcher we don't check the magic */
     return FALSE;
 
   if (UCHARAT(((bt_regprog_T *)prog)->program) != REGMAGIC) {
-    EMSG(_(e_re_corr));
+    REG_EMSG(_(e_re_corr));
     return TRUE;
   }
   return FALSE;
@@ -5460,31 +5725,31 @@ static int prog_magic_wrong(void)
  */
 static void cleanup_subexpr(void)
 {
-  if (need_clear_subexpr) {
+  if (rex->need_clear_subexpr) {
     if (REG_MULTI) {
       /* Use 0xff to set lnum to -1 */
-      memset(reg_startpos, 0xff, sizeof(lpos_T) * NSUBEXP);
-      memset(reg_endpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+      memset(rex->reg_startpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+      memset(rex->reg_endpos, 0xff, sizeof(lpos_T) * NSUBEXP);
     } else {
-      memset(reg_startp, 0, sizeof(char_u *) * NSUBEXP);
-      memset(reg_endp, 0, sizeof(char_u *) * NSUBEXP);
+      memset(rex->reg_startp, 0, sizeof(char_u *) * NSUBEXP);
+      memset(rex->reg_endp, 0, sizeof(char_u *) * NSUBEXP);
     }
-    need_clear_subexpr = FALSE;
+    rex->need_clear_subexpr = FALSE;
   }
 }
 
 static void cleanup_zsubexpr(void)
 {
-  if (need_clear_zsubexpr) {
+  if (rex->need_clear_zsubexpr) {
     if (REG_MULTI) {
       /* Use 0xff to set lnum to -1 */
-      memset(reg_startzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
-      memset(reg_endzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+      memset(rex->reg_startzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+      memset(rex->reg_endzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
     } else {
-      memset(reg_startzp, 0, sizeof(char_u *) * NSUBEXP);
-      memset(reg_endzp, 0, sizeof(char_u *) * NSUBEXP);
+      memset(rex->reg_startzp, 0, sizeof(char_u *) * NSUBEXP);
+      memset(rex->reg_endzp, 0, sizeof(char_u *) * NSUBEXP);
     }
-    need_clear_zsubexpr = FALSE;
+    rex->need_clear_zsubexpr = FALSE;
   }
 }
 
@@ -5498,15 +5763,15 @@ static void save_subexpr(regbehind_T *bp)
 
   /* When "need_clear_subexpr" is set we don't need to save the values, only
    * remember that this flag needs to be set again when restoring. */
-  bp->save_need_clear_subexpr = need_clear_subexpr;
-  if (!need_clear_subexpr) {
+  bp->save_need_clear_subexpr = rex->need_clear_subexpr;
+  if (!rex->need_clear_subexpr) {
     for (i = 0; i < NSUBEXP; ++i) {
       if (REG_MULTI) {
-        bp->save_start[i].se_u.pos = reg_startpos[i];
-        bp->save_end[i].se_u.pos = reg_endpos[i];
+        bp->save_start[i].se_u.pos = rex->reg_startpos[i];
+        bp->save_end[i].se_u.pos = rex->reg_endpos[i];
       } else {
-        bp->save_start[i].se_u.ptr = reg_startp[i];
-        bp->save_end[i].se_u.ptr = reg_endp[i];
+        bp->save_start[i].se_u.ptr = rex->reg_startp[i];
+        bp->save_end[i].se_u.ptr = rex->reg_endp[i];
       }
     }
   }
@@ -5520,15 +5785,15 @@ static void restore_subexpr(regbehind_T *bp)
   int i;
 
   /* Only need to restore saved values when they are not to be cleared. */
-  need_clear_subexpr = bp->save_need_clear_subexpr;
-  if (!need_clear_subexpr) {
+  rex->need_clear_subexpr = bp->save_need_clear_subexpr;
+  if (!rex->need_clear_subexpr) {
     for (i = 0; i < NSUBEXP; ++i) {
       if (REG_MULTI) {
-        reg_startpos[i] = bp->save_start[i].se_u.pos;
-        reg_endpos[i] = bp->save_end[i].se_u.pos;
+        rex->reg_startpos[i] = bp->save_start[i].se_u.pos;
+        rex->reg_endpos[i] = bp->save_end[i].se_u.pos;
       } else {
-        reg_startp[i] = bp->save_start[i].se_u.ptr;
-        reg_endp[i] = bp->save_end[i].se_u.ptr;
+        rex->reg_startp[i] = bp->save_start[i].se_u.ptr;
+        rex->reg_endp[i] = bp->save_end[i].se_u.ptr;
       }
     }
   }
@@ -5539,9 +5804,9 @@ static void restore_subexpr(regbehind_T *bp)
  */
 static void reg_nextline(void)
 {
-  regline = reg_getline(++reglnum);
-  reginput = regline;
-  fast_breakcheck();
+  rex->regline = reg_getline(++rex->reglnum);
+  rex->reginput = rex->regline;
+  reg_breakcheck();
 }
 
 /*
@@ -5550,10 +5815,10 @@ static void reg_nextline(void)
 static void reg_save(regsave_T *save, garray_T *gap)
 {
   if (REG_MULTI) {
-    save->rs_u.pos.col = (colnr_T)(reginput - regline);
-    save->rs_u.pos.lnum = reglnum;
+    save->rs_u.pos.col = (colnr_T)(rex->reginput - rex->regline);
+    save->rs_u.pos.lnum = rex->reglnum;
   } else
-    save->rs_u.ptr = reginput;
+    save->rs_u.ptr = rex->reginput;
   save->rs_len = gap->ga_len;
 }
 
@@ -5563,15 +5828,15 @@ static void reg_save(regsave_T *save, garray_T *gap)
 static void reg_restore(regsave_T *save, garray_T *gap)
 {
   if (REG_MULTI) {
-    if (reglnum != save->rs_u.pos.lnum) {
+    if (rex->reglnum != save->rs_u.pos.lnum) {
       /* only call reg_getline() when the line number changed to save
        * a bit of time */
-      reglnum = save->rs_u.pos.lnum;
-      regline = reg_getline(reglnum);
+      rex->reglnum = save->rs_u.pos.lnum;
+      rex->regline = reg_getline(rex->reglnum);
     }
-    reginput = regline + save->rs_u.pos.col;
+    rex->reginput = rex->regline + save->rs_u.pos.col;
   } else
-    reginput = save->rs_u.ptr;
+    rex->reginput = save->rs_u.ptr;
   gap->ga_len = save->rs_len;
 }
 
@@ -5581,9 +5846,9 @@ static void reg_restore(regsave_T *save, garray_T *gap)
 static int reg_save_equal(regsave_T *save)
 {
   if (REG_MULTI)
-    return reglnum == save->rs_u.pos.lnum
-           && reginput == regline + save->rs_u.pos.col;
-  return reginput == save->rs_u.ptr;
+    return rex->reglnum == save->rs_u.pos.lnum
+           && rex->reginput == rex->regline + save->rs_u.pos.col;
+  return rex->reginput == save->rs_u.ptr;
 }
 
 /*
@@ -5596,14 +5861,14 @@ static int reg_save_equal(regsave_T *save)
 static void save_se_multi(save_se_T *savep, lpos_T *posp)
 {
   savep->se_u.pos = *posp;
-  posp->lnum = reglnum;
-  posp->col = (colnr_T)(reginput - regline);
+  posp->lnum = rex->reglnum;
+  posp->col = (colnr_T)(rex->reginput - rex->regline);
 }
 
 static void save_se_one(save_se_T *savep, char_u **pp)
 {
   savep->se_u.ptr = *pp;
-  *pp = reginput;
+  *pp = rex->reginput;
 }
 
 /*
@@ -5638,17 +5903,17 @@ static int match_with_backref(linenr_T start_lnum, colnr_T start_col, linenr_T e
   for (;; ) {
     /* Since getting one line may invalidate the other, need to make copy.
      * Slow! */
-    if (regline != reg_tofree) {
-      len = (int)STRLEN(regline);
-      if (reg_tofree == NULL || len >= (int)reg_tofreelen) {
+    if (rex->regline != rex->reg_tofree) {
+      len = (int)STRLEN(rex->regline);
+      if (rex->reg_tofree == NULL || len >= (int)rex->reg_tofreelen) {
         len += 50;              /* get some extra */
-        free(reg_tofree);
-        reg_tofree = xmalloc(len);
-        reg_tofreelen = len;
+        free(rex->reg_tofree);
+        rex->reg_tofree = xmalloc(len);
+        rex->reg_tofreelen = len;
       }
-      STRCPY(reg_tofree, regline);
-      reginput = reg_tofree + (reginput - regline);
-      regline = reg_tofree;
+      STRCPY(rex->reg_tofree, rex->regline);
+      rex->reginput = rex->reg_tofree + (rex->reginput - rex->regline);
+      rex->regline = rex->reg_tofree;
     }
 
     /* Get the line to compare with. */
@@ -5660,13 +5925,13 @@ static int match_with_backref(linenr_T start_lnum, colnr_T start_col, linenr_T e
     else
       len = (int)STRLEN(p + ccol);
 
-    if (cstrncmp(p + ccol, reginput, &len) != 0)
+    if (cstrncmp(p + ccol, rex->reginput, &len) != 0)
       return RA_NOMATCH;        /* doesn't match */
     if (bytelen != NULL)
       *bytelen += len;
     if (clnum == end_lnum)
       break;                    /* match and at end! */
-    if (reglnum >= reg_maxline)
+    if (rex->reglnum >= rex->reg_maxline)
       return RA_NOMATCH;        /* text too short */
 
     /* Advance to next line. */
@@ -6224,7 +6489,7 @@ static int cstrncmp(char_u *s1, char_u *s2, int *n)
 {
   int result;
 
-  if (!ireg_ic)
+  if (!rex->ireg_ic)
     result = STRNCMP(s1, s2, *n);
   else {
     assert(*n >= 0);
@@ -6232,7 +6497,7 @@ static int cstrncmp(char_u *s1, char_u *s2, int *n)
   }
 
   /* if it failed and it's utf8 and we want to combineignore: */
-  if (result != 0 && enc_utf8 && ireg_icombine) {
+  if (result != 0 && enc_utf8 && rex->ireg_icombine) {
     char_u  *str1, *str2;
     int c1, c2, c11, c12;
     int junk;
@@ -6249,13 +6514,13 @@ static int cstrncmp(char_u *s1, char_u *s2, int *n)
       /* decompose the character if necessary, into 'base' characters
        * because I don't care about Arabic, I will hard-code the Hebrew
        * which I *do* care about!  So sue me... */
-      if (c1 != c2 && (!ireg_ic || utf_fold(c1) != utf_fold(c2))) {
+      if (c1 != c2 && (!rex->ireg_ic || utf_fold(c1) != utf_fold(c2))) {
         /* decomposition necessary? */
         mb_decompose(c1, &c11, &junk, &junk);
         mb_decompose(c2, &c12, &junk, &junk);
         c1 = c11;
         c2 = c12;
-        if (c11 != c12 && (!ireg_ic || utf_fold(c11) != utf_fold(c12)))
+        if (c11 != c12 && (!rex->ireg_ic || utf_fold(c11) != utf_fold(c12)))
           break;
       }
     }
@@ -6275,7 +6540,7 @@ static char_u *cstrchr(char_u *s, int c)
   char_u      *p;
   int cc;
 
-  if (!ireg_ic
+  if (!rex->ireg_ic
       || (!enc_utf8 && mb_char2len(c) > 1)
       )
     return vim_strchr(s, c);
@@ -6437,23 +6702,34 @@ static int submatch_line_lbr;
  */
 int vim_regsub(regmatch_T *rmp, char_u *source, char_u *dest, int copy, int magic, int backslash)
 {
-  reg_match = rmp;
-  reg_mmatch = NULL;
-  reg_maxline = 0;
-  reg_buf = curbuf;
-  reg_line_lbr = TRUE;
-  return vim_regsub_both(source, dest, copy, magic, backslash);
+  regexec_T nested;
+  regexec_T *prev = rex_enter(&nested);
+
+  rex->reg_match = rmp;
+  rex->reg_mmatch = NULL;
+  rex->reg_maxline = 0;
+  rex->reg_buf = curbuf;
+  rex->reg_line_lbr = TRUE;
+  int retval = vim_regsub_both(source, dest, copy, magic, backslash);
+  rex_leave(prev);
+  return retval;
 }
 
 int vim_regsub_multi(regmmatch_T *rmp, linenr_T lnum, char_u *source, char_u *dest, int copy, int magic, int backslash)
 {
-  reg_match = NULL;
-  reg_mmatch = rmp;
-  reg_buf = curbuf;             /* always works on the current buffer! */
-  reg_firstlnum = lnum;
-  reg_maxline = curbuf->b_ml.ml_line_count - lnum;
-  reg_line_lbr = FALSE;
-  return vim_regsub_both(source, dest, copy, magic, backslash);
+  regexec_T nested;
+  regexec_T *prev = rex_enter(&nested);
+
+  rex->reg_match = NULL;
+  rex->reg_mmatch = rmp;
+  rex->reg_buf = curbuf;             /* always works on the current buffer! */
+  rex->reg_firstlnum = lnum;
+  rex->reg_maxline = curbuf->b_ml.ml_line_count - lnum;
+  rex->reg_line_lbr = FALSE;
+  rex->reg_span.sp_block = NULL;
+  int retval = vim_regsub_both(source, dest, copy, magic, backslash);
+  rex_leave(prev);
+  return retval;
 }
 
 static int vim_regsub_both(char_u *source, char_u *dest, int copy, int magic, int backslash)
@@ -6498,22 +6774,17 @@ static int vim_regsub_both(char_u *source, char_u *dest, int copy, int magic, in
         eval_result = NULL;
       }
     } else {
-      win_T       *save_reg_win;
-      int save_ireg_ic;
-
       free(eval_result);
 
       /* The expression may contain substitute(), which calls us
        * recursively.  Make sure submatch() gets the text from the first
-       * level.  Don't need to save "reg_buf", because
-       * vim_regexec_multi() can't be called recursively. */
-      submatch_match = reg_match;
-      submatch_mmatch = reg_mmatch;
-      submatch_firstlnum = reg_firstlnum;
-      submatch_maxline = reg_maxline;
-      submatch_line_lbr = reg_line_lbr;
-      save_reg_win = reg_win;
-      save_ireg_ic = ireg_ic;
+       * level.  The recursive call has its own execution state, thus the
+       * state of this one doesn't change. */
+      submatch_match = rex->reg_match;
+      submatch_mmatch = rex->reg_mmatch;
+      submatch_firstlnum = rex->reg_firstlnum;
+      submatch_maxline = rex->reg_maxline;
+      submatch_line_lbr = rex->reg_line_lbr;
       can_f_submatch = TRUE;
 
       eval_result = eval_to_string(source + 2, NULL, TRUE);
@@ -6549,13 +6820,6 @@ static int vim_regsub_both(char_u *source, char_u *dest, int copy, int magic, in
         dst += STRLEN(eval_result);
       }
 
-      reg_match = submatch_match;
-      reg_mmatch = submatch_mmatch;
-      reg_firstlnum = submatch_firstlnum;
-      reg_maxline = submatch_maxline;
-      reg_line_lbr = submatch_line_lbr;
-      reg_win = save_reg_win;
-      ireg_ic = save_ireg_ic;
       can_f_submatch = FALSE;
     }
   } else
@@ -6654,36 +6918,36 @@ static int vim_regsub_both(char_u *source, char_u *dest, int copy, int magic, in
         dst++;
       } else {
         if (REG_MULTI) {
-          clnum = reg_mmatch->startpos[no].lnum;
-          if (clnum < 0 || reg_mmatch->endpos[no].lnum < 0)
+          clnum = rex->reg_mmatch->startpos[no].lnum;
+          if (clnum < 0 || rex->reg_mmatch->endpos[no].lnum < 0)
             s = NULL;
           else {
-            s = reg_getline(clnum) + reg_mmatch->startpos[no].col;
-            if (reg_mmatch->endpos[no].lnum == clnum)
-              len = reg_mmatch->endpos[no].col
-                    - reg_mmatch->startpos[no].col;
+            s = reg_getline(clnum) + rex->reg_mmatch->startpos[no].col;
+            if (rex->reg_mmatch->endpos[no].lnum == clnum)
+              len = rex->reg_mmatch->endpos[no].col
+                    - rex->reg_mmatch->startpos[no].col;
             else
               len = (int)STRLEN(s);
           }
         } else {
-          s = reg_match->startp[no];
-          if (reg_match->endp[no] == NULL)
+          s = rex->reg_match->startp[no];
+          if (rex->reg_match->endp[no] == NULL)
             s = NULL;
           else
-            len = (int)(reg_match->endp[no] - s);
+            len = (int)(rex->reg_match->endp[no] - s);
         }
         if (s != NULL) {
           for (;; ) {
             if (len == 0) {
               if (REG_MULTI) {
-                if (reg_mmatch->endpos[no].lnum == clnum)
+                if (rex->reg_mmatch->endpos[no].lnum == clnum)
                   break;
                 if (copy)
                   *dst = CAR;
                 ++dst;
                 s = reg_getline(++clnum);
-                if (reg_mmatch->endpos[no].lnum == clnum)
-                  len = reg_mmatch->endpos[no].col;
+                if (rex->reg_mmatch->endpos[no].lnum == clnum)
+                  len = rex->reg_mmatch->endpos[no].col;
                 else
                   len = (int)STRLEN(s);
               } else
@@ -6757,24 +7021,20 @@ exit:
 
 
 /*
- * Call reg_getline() with the line numbers from the submatch.  If a
- * substitute() was used the reg_maxline and other values have been
- * overwritten.
+ * Start an execution state for getting the lines of the submatch with
+ * reg_getline().  A substitute() in the expression used its own state, thus
+ * the line numbers are taken from what vim_regsub_both() saved.  Returns the
+ * state to pass to rex_leave().
  */
-static char_u *reg_getline_submatch(linenr_T lnum)
+static regexec_T *rex_enter_submatch(regexec_T *nested)
 {
-  char_u *s;
-  linenr_T save_first = reg_firstlnum;
-  linenr_T save_max = reg_maxline;
-
-  reg_firstlnum = submatch_firstlnum;
-  reg_maxline = submatch_maxline;
-
-  s = reg_getline(lnum);
+  regexec_T *prev = rex_enter(nested);
 
-  reg_firstlnum = save_first;
-  reg_maxline = save_max;
-  return s;
+  rex->reg_buf = curbuf;
+  rex->reg_firstlnum = submatch_firstlnum;
+  rex->reg_maxline = submatch_maxline;
+  rex->reg_span.sp_block = NULL;
+  return prev;
 }
 
 /*
@@ -6794,6 +7054,8 @@ char_u *reg_submatch(int no)
 
   if (submatch_match == NULL) {
     ssize_t len;
+    regexec_T nested;
+    regexec_T *prev = rex_enter_submatch(&nested);
 
     /*
      * First round: compute the length and allocate memory.
@@ -6802,9 +7064,9 @@ char_u *reg_submatch(int no)
     for (round = 1; round <= 2; ++round) {
       lnum = submatch_mmatch->startpos[no].lnum;
       if (lnum < 0 || submatch_mmatch->endpos[no].lnum < 0)
-        return NULL;
+        break;
 
-      s = reg_getline_submatch(lnum) + submatch_mmatch->startpos[no].col;
+      s = reg_getline(lnum) + submatch_mmatch->startpos[no].col;
       if (s == NULL)        /* anti-crash check, cannot happen? */
         break;
       if (submatch_mmatch->endpos[no].lnum == lnum) {
@@ -6825,7 +7087,7 @@ char_u *reg_submatch(int no)
         ++len;
         ++lnum;
         while (lnum < submatch_mmatch->endpos[no].lnum) {
-          s = reg_getline_submatch(lnum++);
+          s = reg_getline(lnum++);
           if (round == 2)
             STRCPY(retval + len, s);
           len += STRLEN(s);
@@ -6834,7 +7096,7 @@ char_u *reg_submatch(int no)
           ++len;
         }
         if (round == 2)
-          STRNCPY(retval + len, reg_getline_submatch(lnum),
+          STRNCPY(retval + len, reg_getline(lnum),
               submatch_mmatch->endpos[no].col);
         len += submatch_mmatch->endpos[no].col;
         if (round == 2)
@@ -6846,6 +7108,7 @@ char_u *reg_submatch(int no)
         retval = xmalloc(len);
       }
     }
+    rex_leave(prev);
   } else {
     s = submatch_match->startp[no];
     if (s == NULL || submatch_match->endp[no] == NULL)
@@ -6882,21 +7145,24 @@ list_T *reg_submatch_list(int no)
 
     colnr_T scol = submatch_mmatch->startpos[no].col;
     colnr_T ecol = submatch_mmatch->endpos[no].col;
+    regexec_T nested;
+    regexec_T *prev = rex_enter_submatch(&nested);
 
     list = list_alloc();
 
-    s = reg_getline_submatch(slnum) + scol;
+    s = reg_getline(slnum) + scol;
     if (slnum == elnum) {
       list_append_string(list, s, ecol - scol);
     } else {
       list_append_string(list, s, -1);
       for (int i = 1; i < elnum - slnum; i++) {
-        s = reg_getline_submatch(slnum + i);
+        s = reg_getline(slnum + i);
         list_append_string(list, s, -1);
       }
-      s = reg_getline_submatch(elnum);
+      s = reg_getline(elnum);
       list_append_string(list, s, ecol);
     }
+    rex_leave(prev);
   } else {
     s = submatch_match->startp[no];
     if (s == NULL || submatch_match->endp[no] == NULL) {
@@ -6943,6 +7209,44 @@ static regengine_T nfa_regengine =
 #endif
 };
 
+// XXX Do not allow headers generator to catch definitions from regexp_dfa.c
+#ifndef DO_NOT_DEFINE_EMPTY_ATTRIBUTES
+# include "nvim/regexp_dfa.c"
+#endif
+
+static regengine_T dfa_regengine =
+{
+  dfa_regcomp,
+  dfa_regfree,
+  dfa_regexec_nl,
+  dfa_regexec_multi
+#ifdef REGEXP_DEBUG
+  ,(char_u *)""
+#endif
+#ifdef DEBUG
+  , NULL
+#endif
+};
+
+// XXX Do not allow headers generator to catch definitions from regexp_lit.c
+#ifndef DO_NOT_DEFINE_EMPTY_ATTRIBUTES
+# include "nvim/regexp_lit.c"
+#endif
+
+static regengine_T lit_regengine =
+{
+  lit_regcomp,
+  lit_regfree,
+  lit_regexec_nl,
+  lit_regexec_multi
+#ifdef REGEXP_DEBUG
+  ,(char_u *)""
+#endif
+#ifdef DEBUG
+  , NULL
+#endif
+};
+
 /* Which regexp engine to use? Needed for vim_regcomp().
  * Must match with 'regexpengine'. */
 static int regexp_engine = 0;
@@ -6957,16 +7261,334 @@ static char_u regname[][30] = {
 };
 #endif
 
+/*
+ * Cache of compiled regexps, shared by all callers of vim_regcomp().  Scripts
+ * and commands tend to compile the same patterns over and over again.
+ * A cached program has one extra reference, it is freed when it was dropped
+ * from the cache and all users called vim_regfree().
+ */
+#define REGCACHE_SIZE 64
+
+static regcache_entry_T regcache[REGCACHE_SIZE];
+static uint64_t regcache_tick = 0;
+static regcache_stats_T regcache_stats = { 0, 0, 0 };
+
+static unsigned regcache_hash(char_u *expr, regcache_key_T *key)
+{
+  unsigned hash = 2166136261u;
+  char_u *p = (char_u *)key;
+
+  for (size_t i = 0; i < sizeof(*key); i++) {
+    hash = (hash ^ p[i]) * 16777619u;
+  }
+  for (p = expr; *p != NUL; p++) {
+    hash = (hash ^ *p) * 16777619u;
+  }
+  return hash;
+}
+
+/*
+ * Drop entry "e" from the cache.
+ */
+static void regcache_drop(regcache_entry_T *e)
+{
+  vim_regfree(e->prog);
+  e->prog = NULL;
+  free(e->expr);
+  e->expr = NULL;
+}
+
 /*
  * Compile a regular expression into internal code.
- * Returns the program in allocated memory.
+ * Returns the program in allocated memory, which may be shared with other
+ * users of the same pattern unless "re_flags" has RE_PRIVATE.
  * Use vim_regfree() to free the memory.
  * Returns NULL for an error.
  */
-regprog_T *vim_regcomp(char_u *expr_arg, int re_flags)
+regprog_T *vim_regcomp(char_u *expr, int re_flags)
+{
+  regcache_key_T key;
+
+  memset(&key, 0, sizeof(key));
+  key.re_flags = re_flags;
+  key.engine = (int)p_re;
+  key.cpo_lit = vim_strchr(p_cpo, CPO_LITERAL) != NULL;
+  key.cpo_bsl = vim_strchr(p_cpo, CPO_BACKSL) != NULL;
+  key.extmatch = reg_do_extmatch;
+  key.enc = enc_utf8 ? -1 : has_mbyte ? enc_dbcs : 0;
+
+  /* "~" depends on the previous substitute string. */
+  if ((re_flags & RE_PRIVATE) || vim_strchr(expr, '~') != NULL) {
+    return regcomp_uncached(expr, re_flags & ~RE_PRIVATE);
+  }
+
+  unsigned hash = regcache_hash(expr, &key);
+  regcache_entry_T *lru = &regcache[0];
+
+  for (int i = 0; i < REGCACHE_SIZE; i++) {
+    regcache_entry_T *e = &regcache[i];
+
+    if (e->prog != NULL && e->hash == hash
+        && memcmp(&e->key, &key, sizeof(key)) == 0
+        && STRCMP(e->expr, expr) == 0) {
+      regcache_stats.hits++;
+      e->lastused = ++regcache_tick;
+      e->prog->refcount++;
+      had_eol = e->had_eol;
+      return e->prog;
+    }
+    if (lru->prog != NULL && (e->prog == NULL || e->lastused < lru->lastused)) {
+      lru = e;
+    }
+  }
+
+  regcache_stats.misses++;
+  int save_called_emsg = called_emsg;
+  called_emsg = FALSE;
+  regprog_T *prog = regcomp_uncached(expr, re_flags);
+
+  /* Don't cache a program that gave a warning, it must be given again. */
+  if (prog != NULL && !called_emsg) {
+    if (lru->prog != NULL) {
+      regcache_stats.evictions++;
+      regcache_drop(lru);
+    }
+    lru->prog = prog;
+    lru->expr = vim_strsave(expr);
+    lru->hash = hash;
+    lru->key = key;
+    lru->had_eol = had_eol;
+    lru->lastused = ++regcache_tick;
+    prog->refcount++;
+  }
+  called_emsg |= save_called_emsg;
+  return prog;
+}
+
+/*
+ * Return the hit and miss counts of the regexp cache.
+ */
+regcache_stats_T regcache_get_stats(void)
+{
+  return regcache_stats;
+}
+
+/*
+ * Empty the regexp cache.  Programs still in use are freed when their users
+ * are done with them.
+ */
+void regcache_clear(void)
+{
+  for (int i = 0; i < REGCACHE_SIZE; i++) {
+    if (regcache[i].prog != NULL) {
+      regcache_drop(&regcache[i]);
+    }
+  }
+}
+
+/*
+ * Regexp profiling, see ":regtime".  Profiles are kept by pattern text, a
+ * program finds its profile when it is first executed while profiling.  Only
+ * executions in the main thread are measured.
+ */
+static int regprof_on = FALSE;
+static hashtab_T regprof_ht;
+static int regprof_ht_init = FALSE;
+
+#define HI2RP(hi) ((regprof_T *)((hi)->hi_key - offsetof(regprof_T, pattern)))
+
+/*
+ * Return the profile of pattern "expr", adding one when there is none yet.
+ */
+static regprof_T *regprof_find(char_u *expr)
+{
+  if (!regprof_ht_init) {
+    hash_init(&regprof_ht);
+    regprof_ht_init = TRUE;
+  }
+
+  hash_T hash = hash_hash(expr);
+  hashitem_T *hi = hash_lookup(&regprof_ht, expr, hash);
+  if (!HASHITEM_EMPTY(hi))
+    return HI2RP(hi);
+
+  size_t len = STRLEN(expr);
+  regprof_T *rp = xcalloc(1, sizeof(regprof_T) + len);
+  memcpy(rp->pattern, expr, len + 1);
+  hash_add_item(&regprof_ht, hi, rp->pattern, hash);
+  return rp;
+}
+
+/*
+ * Start measuring an execution of "prog".  Returns the profile to pass to
+ * regprof_end() with "*start", or NULL when not profiling.
+ */
+static regprof_T *regprof_begin(regprog_T *prog, proftime_T *start)
+{
+  if (!regprof_on || reg_in_thread)
+    return NULL;
+  if (prog->prof == NULL)
+    prog->prof = regprof_find(prog->expr);
+  rex->reg_fallback = false;
+  *start = profile_start();
+  return prog->prof;
+}
+
+/*
+ * Add the execution started at "start" to profile "rp", "retval" is what the
+ * engine returned.
+ */
+static void regprof_end(regprof_T *rp, proftime_T start, long retval)
+{
+  proftime_T pt = profile_end(start);
+
+  rp->total = profile_add(rp->total, pt);
+  if (profile_cmp(pt, rp->slowest) < 0)
+    rp->slowest = pt;
+  rp->count++;
+  if (retval > 0)
+    rp->match++;
+  if (rex->reg_fallback)
+    rp->fallbacks++;
+}
+
+static int regprof_compare(const void *v1, const void *v2)
+{
+  const regprof_T *rp1 = *(const regprof_T **)v1;
+  const regprof_T *rp2 = *(const regprof_T **)v2;
+
+  return profile_cmp(rp1->total, rp2->total);
+}
+
+/*
+ * Return the profiles of all patterns that were compiled or executed, in
+ * allocated memory, the slowest first.  "*count" is set to their number.
+ */
+regprof_T **regprof_list(int *count)
+{
+  *count = 0;
+  if (!regprof_ht_init || regprof_ht.ht_used == 0)
+    return NULL;
+
+  regprof_T **list = xmalloc(regprof_ht.ht_used * sizeof(regprof_T *));
+  size_t todo = regprof_ht.ht_used;
+  for (hashitem_T *hi = regprof_ht.ht_array; todo > 0; hi++) {
+    if (!HASHITEM_EMPTY(hi)) {
+      list[(*count)++] = HI2RP(hi);
+      todo--;
+    }
+  }
+  qsort(list, (size_t)*count, sizeof(regprof_T *), regprof_compare);
+  return list;
+}
+
+/*
+ * Set all counters of the profiles to zero.
+ */
+static void regprof_clear(void)
+{
+  int count;
+  regprof_T **list = regprof_list(&count);
+
+  for (int i = 0; i < count; i++)
+    memset(list[i], 0, offsetof(regprof_T, pattern));
+  free(list);
+}
+
+#if defined(EXITFREE)
+static void regprof_free(void)
+{
+  if (regprof_ht_init) {
+    hash_clear_all(&regprof_ht, offsetof(regprof_T, pattern));
+    regprof_ht_init = FALSE;
+  }
+}
+#endif
+
+/*
+ * List the profiles of the patterns, the slowest first.
+ */
+static void regtime_report(void)
+{
+  int count;
+  regprof_T **list = regprof_list(&count);
+  proftime_T total_total = profile_zero();
+  long total_count = 0;
+
+  MSG_PUTS_TITLE(_(
+          "  TOTAL      COUNT  MATCH   SLOWEST     COMPILE   FALLBACK PATTERN"));
+  MSG_PUTS("\n");
+  for (int idx = 0; idx < count && !got_int; ++idx) {
+    regprof_T *rp = list[idx];
+
+    total_total = profile_add(total_total, rp->total);
+    total_count += rp->count;
+
+    MSG_PUTS(profile_msg(rp->total));
+    MSG_PUTS(" ");     /* make sure there is always a separating space */
+    msg_advance(13);
+    msg_outnum(rp->count);
+    MSG_PUTS(" ");
+    msg_advance(20);
+    msg_outnum(rp->match);
+    MSG_PUTS(" ");
+    msg_advance(26);
+    MSG_PUTS(profile_msg(rp->slowest));
+    MSG_PUTS(" ");
+    msg_advance(38);
+    MSG_PUTS(profile_msg(rp->compile_time));
+    MSG_PUTS(" ");
+    msg_advance(50);
+    msg_outnum(rp->fallbacks);
+    MSG_PUTS(" ");
+
+    msg_advance(59);
+    int len;
+    if (Columns < 80)
+      len = 20;       /* will wrap anyway */
+    else
+      len = Columns - 60;
+    if (len > (int)STRLEN(rp->pattern))
+      len = (int)STRLEN(rp->pattern);
+    msg_outtrans_len(rp->pattern, len);
+    MSG_PUTS("\n");
+  }
+  free(list);
+  if (!got_int) {
+    MSG_PUTS("\n");
+    MSG_PUTS(profile_msg(total_total));
+    msg_advance(13);
+    msg_outnum(total_count);
+    MSG_PUTS("\n");
+  }
+}
+
+/*
+ * ":regtime {on,off,clear,report}".
+ */
+void ex_regtime(exarg_T *eap)
+{
+  if (STRCMP(eap->arg, "on") == 0)
+    regprof_on = TRUE;
+  else if (STRCMP(eap->arg, "off") == 0)
+    regprof_on = FALSE;
+  else if (STRCMP(eap->arg, "clear") == 0)
+    regprof_clear();
+  else if (STRCMP(eap->arg, "report") == 0)
+    regtime_report();
+  else
+    EMSG2(_(e_invarg2), eap->arg);
+}
+
+/*
+ * Compile a regular expression with the engine selected by 'regexpengine'
+ * or the "\%#=" prefix, bypassing the cache.
+ */
+static regprog_T *regcomp_uncached(char_u *expr_arg, int re_flags)
 {
   regprog_T   *prog = NULL;
   char_u      *expr = expr_arg;
+  proftime_T start = regprof_on ? profile_start() : profile_zero();
 
   regexp_engine = p_re;
 
@@ -6996,9 +7618,13 @@ regprog_T *vim_regcomp(char_u *expr_arg, int re_flags)
 #endif
 
   /*
-   * First try the NFA engine, unless backtracking was requested.
+   * First try the NFA engine, unless backtracking was requested.  With
+   * automatic selection plain text is searched for directly, otherwise the
+   * DFA matcher is used in front of it when the pattern allows.
    */
-  if (regexp_engine != BACKTRACKING_ENGINE)
+  if (regexp_engine == AUTOMATIC_ENGINE)
+    prog = lit_regengine.regcomp(expr, re_flags);
+  else if (regexp_engine != BACKTRACKING_ENGINE)
     prog = nfa_regengine.regcomp(expr, re_flags);
   else
     prog = bt_regengine.regcomp(expr, re_flags);
@@ -7024,22 +7650,137 @@ regprog_T *vim_regcomp(char_u *expr_arg, int re_flags)
      */
   }
 
+  if (prog != NULL) {
+    prog->refcount = 1;
+    prog->expr = vim_strsave(expr_arg);
+    prog->prof = NULL;
+    if (regprof_on) {
+      prog->prof = regprof_find(expr_arg);
+      prog->prof->compile_time = profile_add(prog->prof->compile_time,
+          profile_end(start));
+      prog->prof->compile_count++;
+    }
+  }
   return prog;
 }
 
 /*
- * Free a compiled regexp program, returned by vim_regcomp().
+ * Free a compiled regexp program, returned by vim_regcomp().  Only frees the
+ * memory when this was the last user.
  */
 void vim_regfree(regprog_T *prog)
 {
-  if (prog != NULL)
+  if (prog != NULL && --prog->refcount == 0) {
+    free(prog->expr);
     prog->engine->regfree(prog);
+  }
+}
+
+/*
+ * Add a user of "prog", who must call vim_regfree() when done with it.
+ */
+void vim_regref(regprog_T *prog)
+{
+  prog->refcount++;
+}
+
+/*
+ * Return the literals of which one must appear in every match of "prog", as
+ * found when compiling it for the NFA engine.  Returns NULL when not known,
+ * or when the raw text of a file can't be checked for them: they are only
+ * used when they are ASCII, other characters may be encoded differently in
+ * the file.  "*icp" is set to whether case is to be ignored, "ic" being the
+ * value of 'ignorecase'.
+ */
+static nfa_literals_T *reg_file_literals(regprog_T *prog, int ic, int *icp)
+{
+  if (prog->engine == &lit_regengine)
+    prog = ((lit_regprog_T *)prog)->fallback;
+  if (prog->engine == &dfa_regengine)
+    prog = ((dfa_regprog_T *)prog)->nfa;
+  if (prog->engine != &nfa_regengine || (prog->regflags & RF_ICOMBINE))
+    return NULL;
+
+  nfa_literals_T *lits = ((nfa_regprog_T *)prog)->literals;
+  if (lits == NULL || !lits->ascii)
+    return NULL;
+  if (prog->regflags & RF_ICASE)
+    ic = TRUE;
+  else if (prog->regflags & RF_NOICASE)
+    ic = FALSE;
+  *icp = ic;
+  return lits;
+}
+
+/*
+ * Return the length of the longest literal that vim_regtext_may_match()
+ * looks for, zero when it can't rule out any text.  "ic" is 'ignorecase'.
+ */
+size_t vim_regtext_maxlen(regprog_T *prog, int ic)
+{
+  int icase;
+  nfa_literals_T *lits = reg_file_literals(prog, ic, &icase);
+  size_t maxlen = 0;
+
+  if (lits != NULL) {
+    for (int i = 0; i < lits->count; i++) {
+      if (lits->len[i] > maxlen)
+        maxlen = lits->len[i];
+    }
+  }
+  return maxlen;
+}
+
+/*
+ * Get the literals of which one appears in every match of "prog" in a line,
+ * starting at or after the column where matching starts.  Used to check many
+ * programs against the same line at once.  "ic" is the ignore-case flag for
+ * matching, "*icp" is set to the value "prog" uses.  "texts[]" and "lens[]"
+ * must have room for NFA_MAX_LITERALS items, the texts are owned by "prog".
+ * Returns the number of literals, zero when nothing is known.
+ */
+int vim_regliterals(regprog_T *prog, int ic, int *icp, char_u **texts,
+                    size_t *lens)
+{
+  nfa_literals_T *lits;
+
+  if (prog == NULL || (lits = reg_file_literals(prog, ic, icp)) == NULL)
+    return 0;
+  for (int i = 0; i < lits->count; i++) {
+    if (lits->len[i] == 0)
+      return 0;
+    texts[i] = lits->text[i];
+    lens[i] = lits->len[i];
+  }
+  return lits->count;
+}
+
+/*
+ * Return FALSE when no line in "text", raw file contents of "len" bytes, can
+ * contain a match for "prog".  Only reads "prog", thus may be called from
+ * another thread while "prog" is not freed.  "ic" is 'ignorecase'.
+ */
+int vim_regtext_may_match(regprog_T *prog, int ic, const char_u *text,
+                          size_t len)
+{
+  int icase;
+  nfa_literals_T *lits = reg_file_literals(prog, ic, &icase);
+
+  if (lits == NULL)
+    return TRUE;
+  for (int i = 0; i < lits->count; i++) {
+    if (memsearch_find(text, len, lits->text[i], lits->len[i], icase) != NULL)
+      return TRUE;
+  }
+  /* Non-ASCII characters may fold to ASCII with 'ignorecase'. */
+  return icase && !memsearch_is_ascii(text, len);
 }
 
 /*
  * Match a regexp against a string.
  * "rmp->regprog" is a compiled regexp as returned by vim_regcomp().
- * Uses curbuf for line count and 'iskeyword'.
+ * Uses curbuf for line count and 'iskeyword', in a thread the buffer passed
+ * to regexec_thread_init().
  *
  * Return TRUE if there is a match, FALSE if not.
  */
@@ -7050,7 +7791,15 @@ vim_regexec (
     colnr_T col            /* column to start looking for match */
 )
 {
-  return rmp->regprog->engine->regexec_nl(rmp, line, col, false);
+  regexec_T nested;
+  regexec_T *prev = rex_enter(&nested);
+  proftime_T start;
+  regprof_T *rp = regprof_begin(rmp->regprog, &start);
+  int retval = rmp->regprog->engine->regexec_nl(rmp, line, col, false);
+  if (rp != NULL)
+    regprof_end(rp, start, retval);
+  rex_leave(prev);
+  return retval;
 }
 
 /*
@@ -7058,7 +7807,15 @@ vim_regexec (
  */
 int vim_regexec_nl(regmatch_T *rmp, char_u *line, colnr_T col)
 {
-  return rmp->regprog->engine->regexec_nl(rmp, line, col, true);
+  regexec_T nested;
+  regexec_T *prev = rex_enter(&nested);
+  proftime_T start;
+  regprof_T *rp = regprof_begin(rmp->regprog, &start);
+  int retval = rmp->regprog->engine->regexec_nl(rmp, line, col, true);
+  if (rp != NULL)
+    regprof_end(rp, start, retval);
+  rex_leave(prev);
+  return retval;
 }
 
 /*
@@ -7078,5 +7835,17 @@ long vim_regexec_multi(
   proftime_T  *tm                 /* timeout limit or NULL */
 )
 {
-  return rmp->regprog->engine->regexec_multi(rmp, win, buf, lnum, col, tm);
+  regexec_T nested;
+  regexec_T *prev = rex_enter(&nested);
+
+  /* Lines of another buffer or from a previous call may have changed. */
+  rex->reg_span.sp_block = NULL;
+  proftime_T start;
+  regprof_T *rp = regprof_begin(rmp->regprog, &start);
+  long retval = rmp->regprog->engine->regexec_multi(rmp, win, buf, lnum, col,
+                                                    tm);
+  if (rp != NULL)
+    regprof_end(rp, start, retval);
+  rex_leave(prev);
+  return retval;
 }
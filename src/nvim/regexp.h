@@ -5,6 +5,8 @@
 #define RE_MAGIC        1       /* 'magic' option */
 #define RE_STRING       2       /* match in string instead of buffer text */
 #define RE_STRICT       4       /* don't allow [abc] without ] */
+#define RE_PRIVATE      8       /* don't share the program with other users,
+                                 * e.g. to match in another thread */
 
 /* values for reg_do_extmatch */
 #define REX_SET        1       /* to allow \z\(...\), */
@@ -15,4 +17,9 @@
 # include "regexp.h.generated.h"
 #endif
 
+#ifdef UNIT_TESTING
+int regexec_test_threads(char_u *pat, char_u **lines, int nlines,
+                         int nthreads, int rounds, int *cols);
+#endif
+
 #endif /* NVIM_REGEXP_H */
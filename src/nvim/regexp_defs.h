@@ -13,8 +13,10 @@
 #define NVIM_REGEXP_DEFS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "nvim/pos.h"
+#include "nvim/profile.h"
 
 /*
  * The number of sub-matches is limited to 10.
@@ -32,6 +34,21 @@
 
 typedef struct regengine regengine_T;
 
+/*
+ * Cost of a pattern, measured while ":regtime on" is active.  Kept for every
+ * pattern text compiled while profiling, also after its programs were freed.
+ */
+typedef struct regprof {
+  proftime_T compile_time;              /* total time spent compiling */
+  int compile_count;                    /* number of times compiled */
+  proftime_T total;                     /* total time spent matching */
+  proftime_T slowest;                   /* longest single match attempt */
+  long count;                           /* number of match attempts */
+  long match;                           /* number of successful attempts */
+  long fallbacks;                       /* attempts passed on to the NFA */
+  char_u pattern[1];                    /* actually longer */
+} regprof_T;
+
 /*
  * Structure returned by vim_regcomp() to pass on to vim_regexec().
  * This is the general structure. For the actual matcher, two specific
@@ -40,6 +57,9 @@ typedef struct regengine regengine_T;
 typedef struct regprog {
   regengine_T         *engine;
   unsigned regflags;
+  int refcount;                 /* users, including the regexp cache */
+  char_u              *expr;    /* the pattern, for profiling and copies */
+  regprof_T           *prof;    /* profile of "expr" or NULL */
 } regprog_T;
 
 /*
@@ -48,9 +68,12 @@ typedef struct regprog {
  * See regexp.c for an explanation.
  */
 typedef struct {
-  /* These two members implement regprog_T */
+  /* These five members implement regprog_T */
   regengine_T         *engine;
   unsigned regflags;
+  int refcount;
+  char_u              *expr;
+  regprof_T           *prof;
 
   int regstart;
   char_u reganch;
@@ -77,16 +100,34 @@ struct nfa_state {
 /*
  * Structure used by the NFA matcher.
  */
+/*
+ * Literal strings at least one of which is contained in every match of an NFA
+ * program.  Used to skip text without starting the matcher.
+ */
+#define NFA_MAX_LITERALS 8      /* max number of alternatives */
+#define NFA_LIT_MAXLEN 32       /* max length of a literal */
+
 typedef struct {
-  /* These two members implement regprog_T */
+  int count;                    /* number of literals */
+  int ascii;                    /* all literals are ASCII */
+  size_t len[NFA_MAX_LITERALS];
+  char_u text[NFA_MAX_LITERALS][NFA_LIT_MAXLEN];
+} nfa_literals_T;
+
+typedef struct {
+  /* These five members implement regprog_T */
   regengine_T         *engine;
   unsigned regflags;
+  int refcount;
+  char_u              *expr;
+  regprof_T           *prof;
 
   nfa_state_T         *start;           /* points into state[] */
 
   int reganch;                          /* pattern starts with ^ */
   int regstart;                         /* char at start of pattern */
   char_u              *match_text;      /* plain text to match with */
+  nfa_literals_T      *literals;        /* required literals or NULL */
 
   int has_zend;                         /* pattern contains \ze */
   int has_backref;                      /* pattern contains \1 .. \9 */
@@ -99,6 +140,45 @@ typedef struct {
   nfa_state_T state[1];                 /* actually longer.. */
 } nfa_regprog_T;
 
+typedef struct dfa_cache dfa_cache_T;
+
+/*
+ * Structure used by the lazy DFA matcher.  It only finds out whether a line
+ * contains a match, the NFA program is used to find the match itself.
+ */
+typedef struct {
+  /* These five members implement regprog_T */
+  regengine_T         *engine;
+  unsigned regflags;
+  int refcount;
+  char_u              *expr;
+  regprof_T           *prof;
+
+  regprog_T           *nfa;             /* NFA program for the same pattern */
+  dfa_cache_T         *cache;           /* DFA states built so far */
+} dfa_regprog_T;
+
+/*
+ * Structure used by the literal matcher, for a pattern that is plain text,
+ * optionally with "\<" and "\>" around it.
+ */
+typedef struct {
+  /* These five members implement regprog_T */
+  regengine_T         *engine;
+  unsigned regflags;
+  int refcount;
+  char_u              *expr;
+  regprof_T           *prof;
+
+  regprog_T           *fallback;        /* program used when the text can't
+                                           be searched for directly */
+  char_u              *text;            /* the text to find */
+  size_t len;                           /* length of "text" in bytes */
+  bool ascii;                           /* "text" is ASCII */
+  bool bow;                             /* match must start a word */
+  bool eow;                             /* match must end a word */
+} lit_regprog_T;
+
 /*
  * Structure to be used for single-line matching.
  * Sub-match "no" starts at "startp[no]" and ends just before "endp[no]".
@@ -137,6 +217,15 @@ typedef struct {
   char_u              *matches[NSUBEXP];
 } reg_extmatch_T;
 
+/*
+ * Counters of the compiled regexp cache, see vim_regcomp().
+ */
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;                   /* programs dropped for new ones */
+} regcache_stats_T;
+
 struct regengine {
   regprog_T   *(*regcomp)(char_u*, int);
   void (*regfree)(regprog_T *);
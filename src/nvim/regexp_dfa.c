@@ -0,0 +1,632 @@
+// Lazy DFA regular expression matcher.
+//
+// This file is included in "regexp.c", after "regexp_nfa.c".
+//
+// Patterns that only use characters, character classes, collections, "^",
+// "$", groups and alternation are matched by simulating the NFA built by
+// regexp_nfa.c as a DFA whose states are sets of NFA states.  DFA states are
+// only built when the text being scanned needs them and kept in a bounded
+// cache, so once it is warm scanning costs one table lookup per character
+// instead of updating a list of NFA threads.
+//
+// The DFA only tells whether a line contains a match.  Lines that do are
+// passed on to the NFA matcher, which finds the leftmost match and the
+// submatches.  Lines that don't are rejected without starting the NFA, which
+// is what happens for most lines when searching.
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvim/ascii.h"
+#include "nvim/mbyte.h"
+#include "nvim/memline.h"
+#include "nvim/memory.h"
+
+// Maximum number of DFA states cached per pattern.  When the cache is full it
+// is cleared.
+#define DFA_MAX_STATES  256
+// Number of hash buckets for looking up states, must be a power of two.
+#define DFA_HASH_SIZE   256
+// After the cache was cleared this many times the pattern is considered a bad
+// fit for the DFA and is matched with the NFA only.
+#define DFA_MAX_FLUSHES 8
+// Transitions are stored in the state for characters below this value, for
+// other characters they are computed again each time they are needed.
+#define DFA_TABLE_SIZE  128
+
+// Results of dfa_scan()
+#define DFA_NOMATCH     0       // the line does not contain a match
+#define DFA_MATCH       1       // the line contains a match
+#define DFA_UNKNOWN     2       // could not tell, use the NFA
+
+typedef struct dfa_state dfa_state_T;
+struct dfa_state {
+  // State after each character, NULL when not computed yet
+  dfa_state_T *next[DFA_TABLE_SIZE];
+  dfa_state_T *hash_next;       // next state in the same hash bucket
+  unsigned hash;
+  bool match;                   // contains NFA_MATCH
+  // Indexes of the NFA states that consume a character, NFA_EOL and
+  // NFA_MATCH, sorted
+  int nkernel;
+  int kernel[];
+};
+
+struct dfa_cache {
+  nfa_regprog_T *nfa;           // program the DFA is built from
+  bool ic;                      // ignore case value the states were built with
+  int nstates;                  // number of states in "buckets"
+  int flushes;                  // number of times the cache was cleared
+  bool disabled;                // always use the NFA
+  dfa_state_T *start[2];        // start state when not at/at start of line
+  dfa_state_T *buckets[DFA_HASH_SIZE];
+
+  // Work space for building a state
+  int *work;                    // kernel being built
+  int nwork;
+  int *mark;                    // equal to "markid" when already added
+  int markid;
+  nfa_state_T **stack;
+};
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "regexp_dfa.c.generated.h"
+#endif
+
+// Return true if "c" is a state that doesn't consume a character and always
+// continues with its "out" state.
+static bool dfa_is_epsilon(int c)
+{
+  return c == NFA_EMPTY
+         || c == NFA_NOPEN
+         || c == NFA_NCLOSE
+         || c == NFA_ZSTART
+         || c == NFA_ZEND
+         || (c >= NFA_MOPEN && c <= NFA_ZCLOSE9);
+}
+
+// Return true if the items of the collection starting at "state" can be
+// matched by the DFA.
+static bool dfa_coll_supported(nfa_state_T *state)
+{
+  for (state = state->out; state->c != NFA_END_COLL; state = state->out) {
+    if (state->c == NFA_RANGE_MIN) {
+      state = state->out;           // skip NFA_RANGE_MAX
+    } else if (state->c < 0
+               && (state->c < NFA_CLASS_ALNUM || state->c > NFA_CLASS_ESCAPE
+                   || state->c == NFA_CLASS_PRINT)) {
+      // 'isprint' can change while the DFA states are cached
+      return false;
+    }
+  }
+  return true;
+}
+
+// Return true if the NFA program "prog" can be matched by the DFA.  Items that
+// depend on the position, the buffer, options that may change while states
+// are cached or that need more than the current character are not supported.
+static bool dfa_supported(nfa_regprog_T *prog)
+{
+  if (prog->has_backref
+      || prog->match_text != NULL       // find_match_text() is faster
+      || (prog->regflags & RF_ICOMBINE)) {
+    return false;
+  }
+
+  bool ok = true;
+  int sp = 0;
+  bool *visited = xcalloc((size_t)prog->nstate, sizeof(bool));
+  nfa_state_T **stack = xmalloc((size_t)prog->nstate * sizeof(*stack));
+
+  stack[sp++] = prog->start;
+  visited[prog->start - prog->state] = true;
+  while (ok && sp > 0) {
+    nfa_state_T *state = stack[--sp];
+    nfa_state_T *out = state->out;
+    nfa_state_T *out1 = NULL;
+
+    switch (state->c) {
+    case NFA_MATCH:
+      out = NULL;
+      break;
+
+    case NFA_SPLIT:
+      out1 = state->out1;
+      break;
+
+    case NFA_START_COLL:
+    case NFA_START_NEG_COLL:
+      ok = dfa_coll_supported(state);
+      out = state->out1->out;
+      break;
+
+    case NFA_BOL:
+    case NFA_EOL:
+    case NFA_ANY:
+      break;
+
+    default:
+      ok = state->c > 0
+           || dfa_is_epsilon(state->c)
+           || (state->c >= NFA_WHITE && state->c <= NFA_NUPPER_IC);
+      break;
+    }
+
+    if (out != NULL && !visited[out - prog->state]) {
+      visited[out - prog->state] = true;
+      stack[sp++] = out;
+    }
+    if (out1 != NULL && !visited[out1 - prog->state]) {
+      visited[out1 - prog->state] = true;
+      stack[sp++] = out1;
+    }
+  }
+
+  free(visited);
+  free(stack);
+  return ok;
+}
+
+static dfa_cache_T *dfa_cache_new(nfa_regprog_T *nfa)
+{
+  dfa_cache_T *dc = xcalloc(1, sizeof(dfa_cache_T));
+
+  dc->nfa = nfa;
+  dc->work = xmalloc((size_t)nfa->nstate * sizeof(int));
+  dc->mark = xcalloc((size_t)nfa->nstate, sizeof(int));
+  dc->stack = xmalloc((size_t)nfa->nstate * sizeof(nfa_state_T *));
+  return dc;
+}
+
+// Free all the DFA states in the cache.
+static void dfa_flush(dfa_cache_T *dc)
+{
+  for (int i = 0; i < DFA_HASH_SIZE; i++) {
+    dfa_state_T *state = dc->buckets[i];
+    while (state != NULL) {
+      dfa_state_T *next = state->hash_next;
+      free(state);
+      state = next;
+    }
+    dc->buckets[i] = NULL;
+  }
+  dc->start[0] = NULL;
+  dc->start[1] = NULL;
+  dc->nstates = 0;
+}
+
+static void dfa_cache_free(dfa_cache_T *dc)
+{
+  if (dc == NULL) {
+    return;
+  }
+  dfa_flush(dc);
+  free(dc->work);
+  free(dc->mark);
+  free(dc->stack);
+  free(dc);
+}
+
+// Start building a new state.
+static void dfa_begin(dfa_cache_T *dc)
+{
+  dc->nwork = 0;
+  if (++dc->markid == 0) {
+    // wrapped around, clear the marks
+    memset(dc->mark, 0, (size_t)dc->nfa->nstate * sizeof(int));
+    dc->markid = 1;
+  }
+}
+
+// Add the states reachable from "state" without consuming a character to the
+// state being built.  "bol" and "eol" tell whether "^" and "$" match at the
+// current position.
+static void dfa_closure(dfa_cache_T *dc, nfa_state_T *state, bool bol,
+                        bool eol)
+{
+  nfa_state_T *base = dc->nfa->state;
+  nfa_state_T **stack = dc->stack;
+  int sp = 0;
+
+#define DFA_PUSH(s) \
+  if (dc->mark[(s) - base] != dc->markid) { \
+    dc->mark[(s) - base] = dc->markid; \
+    stack[sp++] = (s); \
+  }
+
+  DFA_PUSH(state);
+  while (sp > 0) {
+    state = stack[--sp];
+    if (state->c == NFA_SPLIT) {
+      DFA_PUSH(state->out1);
+      DFA_PUSH(state->out);
+    } else if (dfa_is_epsilon(state->c)
+               || (state->c == NFA_BOL && bol)
+               || (state->c == NFA_EOL && eol)) {
+      DFA_PUSH(state->out);
+    } else if (state->c != NFA_BOL) {
+      dc->work[dc->nwork++] = (int)(state - base);
+    }
+  }
+
+#undef DFA_PUSH
+}
+
+static int dfa_compare_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+// Find the state for the kernel that was built in "dc->work", creating it
+// when it doesn't exist yet.
+// Returns NULL when the cache is full.
+static dfa_state_T *dfa_find_state(dfa_cache_T *dc)
+{
+  unsigned hash = 2166136261u;
+
+  qsort(dc->work, (size_t)dc->nwork, sizeof(int), dfa_compare_int);
+  for (int i = 0; i < dc->nwork; i++) {
+    hash = (hash ^ (unsigned)dc->work[i]) * 16777619u;
+  }
+
+  dfa_state_T **bucket = &dc->buckets[hash & (DFA_HASH_SIZE - 1)];
+  for (dfa_state_T *state = *bucket; state != NULL;
+       state = state->hash_next) {
+    if (state->hash == hash && state->nkernel == dc->nwork
+        && memcmp(state->kernel, dc->work,
+                  (size_t)dc->nwork * sizeof(int)) == 0) {
+      return state;
+    }
+  }
+
+  if (dc->nstates >= DFA_MAX_STATES) {
+    return NULL;
+  }
+
+  dfa_state_T *state = xcalloc(1, sizeof(dfa_state_T)
+                               + (size_t)dc->nwork * sizeof(int));
+  state->hash = hash;
+  state->nkernel = dc->nwork;
+  memcpy(state->kernel, dc->work, (size_t)dc->nwork * sizeof(int));
+  for (int i = 0; i < dc->nwork; i++) {
+    if (dc->nfa->state[dc->work[i]].c == NFA_MATCH) {
+      state->match = true;
+    }
+  }
+  state->hash_next = *bucket;
+  *bucket = state;
+  dc->nstates++;
+  return state;
+}
+
+// Return true if character "c" matches the collection starting at "state".
+// This is the same check as done for NFA_START_COLL in nfa_regmatch().
+static bool dfa_coll_match(nfa_state_T *state, int c, bool ic)
+{
+  bool result_if_matched = (state->c == NFA_START_COLL);
+
+  for (state = state->out; state->c != NFA_END_COLL; state = state->out) {
+    if (state->c == NFA_RANGE_MIN) {
+      int c1 = state->val;
+      state = state->out;           // advance to NFA_RANGE_MAX
+      int c2 = state->val;
+
+      if (c >= c1 && c <= c2) {
+        return result_if_matched;
+      }
+      if (ic) {
+        int c_low = vim_tolower(c);
+
+        for (; c1 <= c2; c1++) {
+          if (vim_tolower(c1) == c_low) {
+            return result_if_matched;
+          }
+        }
+      }
+    } else if (state->c < 0 ? check_char_class(state->c, c)
+               : (c == state->c
+                  || (ic && vim_tolower(c) == vim_tolower(state->c)))) {
+      return result_if_matched;
+    }
+  }
+  return !result_if_matched;
+}
+
+// Return the state that follows "state" when it consumes character "c",
+// which is not NUL.  Returns NULL when "c" doesn't match.
+static nfa_state_T *dfa_consume(nfa_state_T *state, int c, bool ic)
+{
+  bool result;
+
+  switch (state->c) {
+  case NFA_MATCH:
+  case NFA_EOL:
+    return NULL;
+
+  case NFA_ANY:
+    return state->out;
+
+  case NFA_START_COLL:
+  case NFA_START_NEG_COLL:
+    return dfa_coll_match(state, c, ic) ? state->out1->out : NULL;
+
+  case NFA_WHITE:
+    result = vim_iswhite(c);
+    break;
+  case NFA_NWHITE:
+    result = !vim_iswhite(c);
+    break;
+  case NFA_DIGIT:
+    result = ri_digit(c);
+    break;
+  case NFA_NDIGIT:
+    result = !ri_digit(c);
+    break;
+  case NFA_HEX:
+    result = ri_hex(c);
+    break;
+  case NFA_NHEX:
+    result = !ri_hex(c);
+    break;
+  case NFA_OCTAL:
+    result = ri_octal(c);
+    break;
+  case NFA_NOCTAL:
+    result = !ri_octal(c);
+    break;
+  case NFA_WORD:
+    result = ri_word(c);
+    break;
+  case NFA_NWORD:
+    result = !ri_word(c);
+    break;
+  case NFA_HEAD:
+    result = ri_head(c);
+    break;
+  case NFA_NHEAD:
+    result = !ri_head(c);
+    break;
+  case NFA_ALPHA:
+    result = ri_alpha(c);
+    break;
+  case NFA_NALPHA:
+    result = !ri_alpha(c);
+    break;
+  case NFA_LOWER:
+    result = ri_lower(c);
+    break;
+  case NFA_NLOWER:
+    result = !ri_lower(c);
+    break;
+  case NFA_UPPER:
+    result = ri_upper(c);
+    break;
+  case NFA_NUPPER:
+    result = !ri_upper(c);
+    break;
+  case NFA_LOWER_IC:
+    result = ri_lower(c) || (ic && ri_upper(c));
+    break;
+  case NFA_NLOWER_IC:
+    result = !(ri_lower(c) || (ic && ri_upper(c)));
+    break;
+  case NFA_UPPER_IC:
+    result = ri_upper(c) || (ic && ri_lower(c));
+    break;
+  case NFA_NUPPER_IC:
+    result = !(ri_upper(c) || (ic && ri_lower(c)));
+    break;
+
+  default:          // regular character
+    result = c == state->c || (ic && vim_tolower(c) == vim_tolower(state->c));
+    break;
+  }
+
+  return result ? state->out : NULL;
+}
+
+// Compute the state that follows "state" after character "c".
+// Returns NULL when the cache is full.
+static dfa_state_T *dfa_step(dfa_cache_T *dc, dfa_state_T *state, int c)
+{
+  dfa_begin(dc);
+  for (int i = 0; i < state->nkernel; i++) {
+    nfa_state_T *next = dfa_consume(&dc->nfa->state[state->kernel[i]], c,
+                                    dc->ic);
+    if (next != NULL) {
+      dfa_closure(dc, next, false, false);
+    }
+  }
+  // A match can start at every position
+  dfa_closure(dc, dc->nfa->start, false, false);
+  return dfa_find_state(dc);
+}
+
+// Return the state to start scanning with.  "bol" is true when starting at
+// the start of the line.  Returns NULL when the cache is full.
+static dfa_state_T *dfa_start(dfa_cache_T *dc, bool bol)
+{
+  if (dc->start[bol] == NULL) {
+    dfa_begin(dc);
+    dfa_closure(dc, dc->nfa->start, bol, false);
+    dc->start[bol] = dfa_find_state(dc);
+  }
+  return dc->start[bol];
+}
+
+// Return true if "state" matches at the end of the line, where "$" matches.
+static bool dfa_eol_match(dfa_cache_T *dc, dfa_state_T *state, bool bol)
+{
+  dfa_begin(dc);
+  for (int i = 0; i < state->nkernel; i++) {
+    nfa_state_T *s = &dc->nfa->state[state->kernel[i]];
+    if (s->c == NFA_EOL) {
+      dfa_closure(dc, s->out, bol, true);
+    }
+  }
+  for (int i = 0; i < dc->nwork; i++) {
+    if (dc->nfa->state[dc->work[i]].c == NFA_MATCH) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Scan "line" from column "col" for a match of "prog".
+// Returns DFA_MATCH, DFA_NOMATCH or DFA_UNKNOWN.
+static int dfa_scan(dfa_regprog_T *prog, char_u *line, colnr_T col, bool ic)
+{
+  if (prog->cache == NULL) {
+    prog->cache = dfa_cache_new((nfa_regprog_T *)prog->nfa);
+  }
+
+  dfa_cache_T *dc = prog->cache;
+
+  // If pattern contains "\c" or "\C": overrule value of "ic"
+  if (prog->regflags & RF_ICASE) {
+    ic = true;
+  } else if (prog->regflags & RF_NOICASE) {
+    ic = false;
+  }
+
+  // Finding the required literals is cheaper than running the DFA
+  if (nfa_literals_reject((nfa_regprog_T *)prog->nfa, line, col, ic)) {
+    return DFA_NOMATCH;
+  }
+  if (dc->disabled) {
+    return DFA_UNKNOWN;
+  }
+  if (ic != dc->ic) {
+    dfa_flush(dc);
+    dc->ic = ic;
+  }
+
+  char_u *p = line + col;
+  dfa_state_T *state = dfa_start(dc, col == 0);
+
+  while (state != NULL && !state->match) {
+    if (state->nkernel == 0) {
+      return DFA_NOMATCH;                 // dead state
+    }
+    if (*p == NUL) {
+      return dfa_eol_match(dc, state, p == line) ? DFA_MATCH : DFA_NOMATCH;
+    }
+
+    int c;
+    int clen;
+    if (!has_mbyte || (*p < 0x80 && p[1] < 0x80)) {
+      c = *p;
+      clen = 1;
+    } else {
+      c = (*mb_ptr2char)(p);
+      clen = (*mb_ptr2len)(p);
+      if (enc_utf8) {
+        // The NFA matches a composing character by itself or together with
+        // the character before it, depending on the item, and doesn't skip
+        // over illegal bytes the same way for all items. Leave those lines
+        // to the NFA.
+        clen = utf_ptr2len(p);
+        if (utf_char2len(c) != clen || utf_iscomposing(c)
+            || (p[clen] >= 0x80 && utf_iscomposing(utf_ptr2char(p + clen)))) {
+          return DFA_UNKNOWN;
+        }
+      }
+    }
+
+    dfa_state_T *next = c < DFA_TABLE_SIZE ? state->next[c] : NULL;
+    if (next == NULL) {
+      next = dfa_step(dc, state, c);
+      if (next != NULL && c < DFA_TABLE_SIZE) {
+        state->next[c] = next;
+      }
+    }
+    state = next;
+    p += clen;
+  }
+
+  if (state == NULL) {
+    // The cache is full, start over with an empty one next time.
+    dfa_flush(dc);
+    if (++dc->flushes >= DFA_MAX_FLUSHES) {
+      dc->disabled = true;
+    }
+    return DFA_UNKNOWN;
+  }
+  return DFA_MATCH;
+}
+
+// Compile a regular expression for the DFA matcher.  Returns the NFA program
+// when the pattern can't be matched with the DFA.
+// Returns NULL for an error.
+static regprog_T *dfa_regcomp(char_u *expr, int re_flags)
+{
+  regprog_T *nfa = nfa_regcomp(expr, re_flags);
+
+  if (nfa == NULL || !dfa_supported((nfa_regprog_T *)nfa)) {
+    return nfa;
+  }
+
+  dfa_regprog_T *prog = xmalloc(sizeof(dfa_regprog_T));
+  prog->engine = &dfa_regengine;
+  prog->regflags = nfa->regflags;
+  prog->nfa = nfa;
+  prog->cache = NULL;           // allocated when first used
+  return (regprog_T *)prog;
+}
+
+// Free a compiled regexp program, returned by dfa_regcomp().
+static void dfa_regfree(regprog_T *prog)
+{
+  if (prog != NULL) {
+    dfa_cache_free(((dfa_regprog_T *)prog)->cache);
+    nfa_regfree(((dfa_regprog_T *)prog)->nfa);
+    free(prog);
+  }
+}
+
+// Match a regexp against a string, see nfa_regexec_nl().
+// A "\n" in "line" is only handled by the NFA.
+static int dfa_regexec_nl(regmatch_T *rmp, char_u *line, colnr_T col,
+                          bool line_lbr)
+{
+  dfa_regprog_T *prog = (dfa_regprog_T *)rmp->regprog;
+  int r = line_lbr ? DFA_UNKNOWN : dfa_scan(prog, line, col, rmp->rm_ic);
+
+  if (r == DFA_NOMATCH) {
+    return 0;
+  }
+  if (r == DFA_UNKNOWN) {
+    rex->reg_fallback = true;
+  }
+
+  rmp->regprog = prog->nfa;
+  int retval = nfa_regexec_nl(rmp, line, col, line_lbr);
+  rmp->regprog = (regprog_T *)prog;
+  return retval;
+}
+
+// Match a regexp against multiple lines, see nfa_regexec_multi().
+// Supported patterns can't match a line break, thus the match must be in
+// line "lnum".
+static long dfa_regexec_multi(regmmatch_T *rmp, win_T *win, buf_T *buf,
+                              linenr_T lnum, colnr_T col, proftime_T *tm)
+{
+  dfa_regprog_T *prog = (dfa_regprog_T *)rmp->regprog;
+  int r = DFA_UNKNOWN;
+
+  if (lnum >= 1 && lnum <= buf->b_ml.ml_line_count) {
+    r = dfa_scan(prog, ml_get_buf(buf, lnum, false), col, rmp->rmm_ic);
+  }
+  if (r == DFA_NOMATCH) {
+    return 0;
+  }
+  if (r == DFA_UNKNOWN) {
+    rex->reg_fallback = true;
+  }
+
+  rmp->regprog = prog->nfa;
+  long retval = nfa_regexec_multi(rmp, win, buf, lnum, col, tm);
+  rmp->regprog = (regprog_T *)prog;
+  return retval;
+}
@@ -0,0 +1,250 @@
+// Literal string matcher.
+//
+// This file is included in "regexp.c", after "regexp_dfa.c".
+//
+// Patterns that are plain text, possibly with "\<" and "\>" around it as "*"
+// and "#" use, don't need a state machine at all.  The text is found with
+// memsearch_find(), which only compares the bytes at positions where the
+// first and last byte of the text appear.  Case is folded by comparing with
+// both the lower and upper case bytes, which only works for ASCII, thus with
+// 'ignorecase' lines that are not ASCII are passed on to the program the
+// pattern was compiled into as usual.
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvim/ascii.h"
+#include "nvim/charset.h"
+#include "nvim/mbyte.h"
+#include "nvim/memline.h"
+#include "nvim/memory.h"
+#include "nvim/memsearch.h"
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "regexp_lit.c.generated.h"
+#endif
+
+// Return the text "nfa" matches when it only consists of characters, with
+// "\<" and "\>" around them when "*bow" and "*eow" are set.  Returns NULL for
+// any other program.
+static char_u *lit_get_text(nfa_regprog_T *nfa, bool *bow, bool *eow)
+{
+  nfa_state_T *p = nfa->start;
+  size_t len = 0;
+
+  if (p->c != NFA_MOPEN) {
+    return NULL;
+  }
+  p = p->out;
+  *bow = p->c == NFA_BOW;
+  if (*bow) {
+    p = p->out;
+  }
+  nfa_state_T *first = p;
+  for (; p->c > 0; p = p->out) {
+    // A NL can be a line break with vim_regexec_nl().
+    if (p->c == NL) {
+      return NULL;
+    }
+    len += (size_t)(*mb_char2len)(p->c);
+  }
+  *eow = p->c == NFA_EOW;
+  if (*eow) {
+    p = p->out;
+  }
+  if (len == 0 || p->c != NFA_MCLOSE || p->out->c != NFA_MATCH
+      || (enc_utf8 && utf_iscomposing(first->c))) {
+    return NULL;
+  }
+
+  char_u *text = xmalloc(len + 1);
+  char_u *s = text;
+  for (p = first; p->c > 0; p = p->out) {
+    s += (*mb_char2bytes)(p->c, s);
+  }
+  *s = NUL;
+  return text;
+}
+
+// Compile a regexp, see nfa_regcomp().  Returns a literal program when the
+// pattern is plain text, otherwise what dfa_regcomp() returns.
+static regprog_T *lit_regcomp(char_u *expr, int re_flags)
+{
+  regprog_T *fallback = dfa_regcomp(expr, re_flags);
+
+  // With a double-byte encoding the text may be found in the middle of a
+  // character.
+  if (fallback == NULL || (fallback->regflags & RF_ICOMBINE)
+      || (has_mbyte && !enc_utf8)) {
+    return fallback;
+  }
+
+  regprog_T *nfa = fallback;
+  if (nfa->engine == &dfa_regengine) {
+    nfa = ((dfa_regprog_T *)nfa)->nfa;
+  }
+  bool bow, eow;
+  char_u *text = lit_get_text((nfa_regprog_T *)nfa, &bow, &eow);
+  if (text == NULL) {
+    return fallback;
+  }
+
+  lit_regprog_T *prog = xmalloc(sizeof(lit_regprog_T));
+  prog->engine = &lit_regengine;
+  prog->regflags = fallback->regflags;
+  prog->fallback = fallback;
+  prog->text = text;
+  prog->len = STRLEN(text);
+  prog->ascii = memsearch_is_ascii(text, prog->len);
+  prog->bow = bow;
+  prog->eow = eow;
+  return (regprog_T *)prog;
+}
+
+// Free a compiled regexp program, returned by lit_regcomp().
+static void lit_regfree(regprog_T *prog)
+{
+  if (prog != NULL) {
+    lit_regprog_T *lp = (lit_regprog_T *)prog;
+    lp->fallback->engine->regfree(lp->fallback);
+    free(lp->text);
+    free(prog);
+  }
+}
+
+// Return the class of the character before "p" in "line", -1 at the start.
+static int lit_prev_class(char_u *line, char_u *p, buf_T *buf)
+{
+  if (p > line) {
+    return mb_get_class_buf(p - 1 - (*mb_head_off)(line, p - 1), buf);
+  }
+  return -1;
+}
+
+// Return true if "p" in "line" is at the start of a word, like "\<".
+static bool lit_at_bow(char_u *line, char_u *p, buf_T *buf)
+{
+  if (*p == NUL) {
+    return false;
+  }
+  if (has_mbyte) {
+    int this_class = mb_get_class_buf(p, buf);
+    return this_class > 1 && lit_prev_class(line, p, buf) != this_class;
+  }
+  return vim_iswordc_buf(*p, buf)
+         && (p == line || !vim_iswordc_buf(p[-1], buf));
+}
+
+// Return true if "p" in "line" is just after the end of a word, like "\>".
+static bool lit_at_eow(char_u *line, char_u *p, buf_T *buf)
+{
+  if (p == line) {
+    return false;
+  }
+  if (has_mbyte) {
+    int prev_class = lit_prev_class(line, p, buf);
+    return prev_class > 1 && mb_get_class_buf(p, buf) != prev_class;
+  }
+  return vim_iswordc_buf(p[-1], buf)
+         && (*p == NUL || !vim_iswordc_buf(*p, buf));
+}
+
+// Find the first match of "prog" in "line" at or after column "col".  Returns
+// NULL when there is none.  Sets "*fallback" when the line must be matched
+// with the fallback program instead.  "buf" is used for 'iskeyword'.
+static char_u *lit_find(lit_regprog_T *prog, char_u *line, colnr_T col,
+                        bool ic, buf_T *buf, bool *fallback)
+{
+  char_u *p = line + col;
+  char_u *end = p + STRLEN(p);
+
+  if (prog->regflags & RF_ICASE) {
+    ic = true;
+  } else if (prog->regflags & RF_NOICASE) {
+    ic = false;
+  }
+  // Other characters may fold to ASCII and the other way around.
+  if (ic && (!prog->ascii || !memsearch_is_ascii(p, (size_t)(end - p)))) {
+    *fallback = true;
+    return NULL;
+  }
+  *fallback = false;
+
+  while ((p = (char_u *)memsearch_find(p, (size_t)(end - p), prog->text,
+                                       prog->len, ic)) != NULL) {
+    char_u *e = p + prog->len;
+
+    if ((!prog->bow || lit_at_bow(line, p, buf))
+        && (!prog->eow || lit_at_eow(line, e, buf))
+        // A match can't end before a composing character.
+        && !(enc_utf8 && utf_iscomposing(utf_ptr2char(e)))) {
+      return p;
+    }
+    p += has_mbyte ? (*mb_ptr2len)(p) : 1;
+  }
+  return NULL;
+}
+
+// Match a regexp against a string, see nfa_regexec_nl().  Uses curbuf for
+// 'iskeyword'.
+static int lit_regexec_nl(regmatch_T *rmp, char_u *line, colnr_T col,
+                          bool line_lbr)
+{
+  lit_regprog_T *prog = (lit_regprog_T *)rmp->regprog;
+  bool fallback;
+  char_u *p = lit_find(prog, line, col, rmp->rm_ic, REG_STRING_BUF,
+                       &fallback);
+
+  if (fallback) {
+    rex->reg_fallback = true;
+    rmp->regprog = prog->fallback;
+    int retval = prog->fallback->engine->regexec_nl(rmp, line, col,
+                                                    line_lbr);
+    rmp->regprog = (regprog_T *)prog;
+    return retval;
+  }
+  if (p == NULL) {
+    return 0;
+  }
+  memset(rmp->startp, 0, sizeof(rmp->startp));
+  memset(rmp->endp, 0, sizeof(rmp->endp));
+  rmp->startp[0] = p;
+  rmp->endp[0] = p + prog->len;
+  return 1;
+}
+
+// Match a regexp against multiple lines, see nfa_regexec_multi().  The text
+// has no line break, thus the match must be in line "lnum".
+static long lit_regexec_multi(regmmatch_T *rmp, win_T *win, buf_T *buf,
+                              linenr_T lnum, colnr_T col, proftime_T *tm)
+{
+  lit_regprog_T *prog = (lit_regprog_T *)rmp->regprog;
+  bool fallback = true;
+  char_u *line = NULL;
+  char_u *p = NULL;
+
+  if (lnum >= 1 && lnum <= buf->b_ml.ml_line_count && rmp->rmm_maxcol == 0) {
+    line = ml_get_buf(buf, lnum, false);
+    p = lit_find(prog, line, col, rmp->rmm_ic, buf, &fallback);
+  }
+  if (fallback) {
+    rex->reg_fallback = true;
+    rmp->regprog = prog->fallback;
+    long retval = prog->fallback->engine->regexec_multi(rmp, win, buf, lnum,
+                                                        col, tm);
+    rmp->regprog = (regprog_T *)prog;
+    return retval;
+  }
+  if (p == NULL) {
+    return 0;
+  }
+  // Like cleanup_subexpr(): no submatches
+  memset(rmp->startpos, 0xff, sizeof(rmp->startpos));
+  memset(rmp->endpos, 0xff, sizeof(rmp->endpos));
+  rmp->startpos[0].lnum = 0;
+  rmp->startpos[0].col = (colnr_T)(p - line);
+  rmp->endpos[0].lnum = 0;
+  rmp->endpos[0].col = (colnr_T)(p - line + (ptrdiff_t)prog->len);
+  return 1;
+}
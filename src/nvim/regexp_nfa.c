@@ -13,6 +13,7 @@
 #include "nvim/ascii.h"
 #include "nvim/misc2.h"
 #include "nvim/garray.h"
+#include "nvim/memsearch.h"
 
 /*
  * Logging of NFA engine.
@@ -315,38 +316,41 @@ typedef struct {
   int has_pim;                  /* TRUE when any state has a PIM */
 } nfa_list_T;
 
-/* NFA regexp \ze operator encountered. */
+/* NFA regexp \ze operator encountered, while compiling. */
 static int nfa_has_zend;
 
-/* NFA regexp \1 .. \9 encountered. */
+/* NFA regexp \1 .. \9 encountered, while compiling. */
 static int nfa_has_backref;
 
-/* NFA regexp has \z( ), set zsubexpr. */
-static int nfa_has_zsubexpr;
-
-/* Number of sub expressions actually being used during execution. 1 if only
- * the whole match (subexpr 0) is used. */
-static int nfa_nsubexpr;
-
 static int *post_start;  /* holds the postfix form of r.e. */
 static int *post_end;
 static int *post_ptr;
 
-static int nstate;      /* Number of states in the NFA. Also used when
-                         * executing. */
+static int nstate;      /* Number of states in the NFA. */
 static int istate;      /* Index in the state vector, used in alloc_state() */
 
-/* If not NULL match must end at this position */
-static save_se_T *nfa_endp = NULL;
+/*
+ * Literal text known about a fragment of the postfix form, used by
+ * nfa_get_literals().  Every text matched by the fragment:
+ * - is "exact" when exact.len >= 0,
+ * - starts with "prefix" and ends with "suffix",
+ * - contains one of the "nbest" strings in "best" (nothing known when zero).
+ */
+typedef struct {
+  int len;                        /* -1 for unknown */
+  char_u text[NFA_LIT_MAXLEN];
+} nfa_lit_T;
 
-/* listid is global, so that it increases on recursive calls to
- * nfa_regmatch(), which means we don't have to clear the lastlist field of
- * all the states. */
-static int nfa_listid;
-static int nfa_alt_listid;
+typedef struct {
+  int in_coll;                    /* part of the items inside [] */
+  nfa_lit_T exact;
+  nfa_lit_T prefix;
+  nfa_lit_T suffix;
+  int nbest;
+  nfa_lit_T best[NFA_MAX_LITERALS];
+} nfa_litfrag_T;
 
-/* 0 for first call to nfa_regmatch(), 1 for recursive call. */
-static int nfa_ll_index = 0;
+#define NFA_LIT_MAXDEPTH 30       /* max fragments on the stack */
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "regexp_nfa.c.generated.h"
@@ -566,6 +570,398 @@ static char_u *nfa_get_match_text(nfa_state_T *start)
   return ret;
 }
 
+/*
+ * Set "f" to a fragment nothing is known about.  When "empty" is TRUE it only
+ * matches the empty string.
+ */
+static void lit_clear(nfa_litfrag_T *f, int empty)
+{
+  f->in_coll = FALSE;
+  f->exact.len = empty ? 0 : -1;
+  f->prefix.len = 0;
+  f->suffix.len = 0;
+  f->nbest = 0;
+}
+
+/*
+ * Store the concatenation of "a" and "b" in "r", keeping the start when it is
+ * too long if "keep_start" is TRUE and the end otherwise.
+ */
+static void lit_join(nfa_lit_T *r, nfa_lit_T *a, nfa_lit_T *b, int keep_start)
+{
+  char_u buf[NFA_LIT_MAXLEN * 2];
+  int len = a->len + b->len;
+  int skip = 0;
+
+  memmove(buf, a->text, (size_t)a->len);
+  memmove(buf + a->len, b->text, (size_t)b->len);
+  if (len > NFA_LIT_MAXLEN) {
+    if (!keep_start) {
+      skip = len - NFA_LIT_MAXLEN;
+    }
+    len = NFA_LIT_MAXLEN;
+  }
+  memmove(r->text, buf + skip, (size_t)len);
+  r->len = len;
+}
+
+/*
+ * Return how useful a set of alternative literals is for skipping text:
+ * the length of the shortest one.
+ */
+static int lit_score(nfa_lit_T *lits, int n)
+{
+  int score = NFA_LIT_MAXLEN + 1;
+
+  if (n == 0) {
+    return 0;
+  }
+  for (int i = 0; i < n; i++) {
+    score = MIN(score, lits[i].len);
+  }
+  return score;
+}
+
+/*
+ * Use the alternatives "lits" for "f" when they are better than what it has.
+ */
+static void lit_consider(nfa_litfrag_T *f, nfa_lit_T *lits, int n)
+{
+  int score = lit_score(lits, n);
+  int cur = lit_score(f->best, f->nbest);
+
+  if (score > cur || (score == cur && score > 0 && n < f->nbest)) {
+    memmove(f->best, lits, (size_t)n * sizeof(nfa_lit_T));
+    f->nbest = n;
+  }
+}
+
+/*
+ * Also consider the exact text, prefix and suffix of "f" for its best
+ * literals.
+ */
+static void lit_consider_parts(nfa_litfrag_T *f)
+{
+  nfa_lit_T lit;
+
+  if (f->exact.len > 0) {
+    lit = f->exact;
+    lit_consider(f, &lit, 1);
+  }
+  lit = f->prefix;
+  lit_consider(f, &lit, 1);
+  lit = f->suffix;
+  lit_consider(f, &lit, 1);
+}
+
+/*
+ * "a" followed by "b", result in "a".
+ */
+static void lit_concat(nfa_litfrag_T *a, nfa_litfrag_T *b)
+{
+  nfa_litfrag_T r;
+
+  lit_clear(&r, FALSE);
+  if (a->exact.len >= 0 && b->exact.len >= 0
+      && a->exact.len + b->exact.len <= NFA_LIT_MAXLEN) {
+    lit_join(&r.exact, &a->exact, &b->exact, TRUE);
+  }
+  if (a->exact.len >= 0) {
+    lit_join(&r.prefix, &a->exact, &b->prefix, TRUE);
+  } else {
+    r.prefix = a->prefix;
+  }
+  if (b->exact.len >= 0) {
+    lit_join(&r.suffix, &a->suffix, &b->exact, FALSE);
+  } else {
+    r.suffix = b->suffix;
+  }
+
+  lit_consider(&r, a->best, a->nbest);
+  lit_consider(&r, b->best, b->nbest);
+  /* The text where "a" and "b" meet. */
+  nfa_lit_T joined;
+  lit_join(&joined, &a->suffix, &b->prefix, TRUE);
+  lit_consider(&r, &joined, 1);
+  lit_consider_parts(&r);
+  *a = r;
+}
+
+/*
+ * "a" or "b", result in "a".
+ */
+static void lit_alternate(nfa_litfrag_T *a, nfa_litfrag_T *b)
+{
+  nfa_litfrag_T r;
+  int n;
+
+  lit_clear(&r, FALSE);
+  if (a->exact.len >= 0 && a->exact.len == b->exact.len
+      && memcmp(a->exact.text, b->exact.text, (size_t)a->exact.len) == 0) {
+    r.exact = a->exact;
+  }
+  for (n = 0; n < a->prefix.len && n < b->prefix.len
+       && a->prefix.text[n] == b->prefix.text[n]; n++) {
+  }
+  memmove(r.prefix.text, a->prefix.text, (size_t)n);
+  r.prefix.len = n;
+  for (n = 0; n < a->suffix.len && n < b->suffix.len
+       && a->suffix.text[a->suffix.len - 1 - n]
+       == b->suffix.text[b->suffix.len - 1 - n]; n++) {
+  }
+  memmove(r.suffix.text, a->suffix.text + a->suffix.len - n, (size_t)n);
+  r.suffix.len = n;
+
+  /* Either one of the literals of "a" or one of "b" must be there. */
+  if (a->nbest > 0 && b->nbest > 0) {
+    r.nbest = a->nbest;
+    memmove(r.best, a->best, (size_t)a->nbest * sizeof(nfa_lit_T));
+    for (int i = 0; i < b->nbest && r.nbest >= 0; i++) {
+      int j;
+
+      for (j = 0; j < r.nbest; j++) {
+        if (r.best[j].len == b->best[i].len
+            && memcmp(r.best[j].text, b->best[i].text,
+                      (size_t)b->best[i].len) == 0) {
+          break;
+        }
+      }
+      if (j < r.nbest) {
+        continue;               /* duplicate */
+      }
+      if (r.nbest == NFA_MAX_LITERALS) {
+        r.nbest = -1;           /* too many */
+      } else {
+        r.best[r.nbest++] = b->best[i];
+      }
+    }
+    if (r.nbest < 0) {
+      r.nbest = 0;
+    }
+  }
+  lit_consider_parts(&r);
+  *a = r;
+}
+
+/*
+ * Find literal strings in the postfix form of a regexp, one of which must
+ * appear in any match, also when the pattern contains alternations.  Returns
+ * NULL when there is nothing useful, allocated memory otherwise.
+ */
+static nfa_literals_T *nfa_get_literals(int *postfix, int *end)
+{
+  nfa_litfrag_T *stack = xmalloc(NFA_LIT_MAXDEPTH * sizeof(nfa_litfrag_T));
+  int sp = -1;                    /* index of the top of the stack */
+  nfa_literals_T *ret = NULL;
+  int *p;
+
+#define LIT_NEED(n) \
+  if (sp < (n) - 1) { \
+    goto theend; \
+  }
+#define LIT_PUSH() \
+  if (++sp >= NFA_LIT_MAXDEPTH) { \
+    goto theend; \
+  }
+
+  for (p = postfix; p < end; p++) {
+    switch (*p) {
+    case NFA_CONCAT:
+      LIT_NEED(2);
+      if (stack[sp - 1].in_coll || stack[sp].in_coll) {
+        stack[sp - 1].in_coll = TRUE;
+      } else {
+        lit_concat(&stack[sp - 1], &stack[sp]);
+      }
+      sp--;
+      break;
+
+    case NFA_OR:
+      LIT_NEED(2);
+      lit_alternate(&stack[sp - 1], &stack[sp]);
+      sp--;
+      break;
+
+    case NFA_RANGE:
+      LIT_NEED(2);
+      sp--;
+      break;
+
+    case NFA_START_COLL:
+    case NFA_START_NEG_COLL:
+      LIT_PUSH();
+      lit_clear(&stack[sp], FALSE);
+      stack[sp].in_coll = TRUE;
+      break;
+
+    /* Anything that may match nothing or something else than its atom. */
+    case NFA_END_COLL:
+    case NFA_END_NEG_COLL:
+    case NFA_STAR:
+    case NFA_STAR_NONGREEDY:
+    case NFA_QUEST:
+    case NFA_QUEST_NONGREEDY:
+    case NFA_COMPOSING:
+    case NFA_PREV_ATOM_NO_WIDTH:
+    case NFA_PREV_ATOM_NO_WIDTH_NEG:
+    case NFA_PREV_ATOM_LIKE_PATTERN:
+      LIT_NEED(1);
+      lit_clear(&stack[sp], FALSE);
+      break;
+
+    case NFA_PREV_ATOM_JUST_BEFORE:
+    case NFA_PREV_ATOM_JUST_BEFORE_NEG:
+      LIT_NEED(1);
+      lit_clear(&stack[sp], FALSE);
+      p++;                      /* skip the count */
+      break;
+
+    case NFA_OPT_CHARS:
+    {
+      int n = *++p;
+
+      LIT_NEED(n);
+      sp -= n - 1;
+      lit_clear(&stack[sp], FALSE);
+      break;
+    }
+
+    /* Submatches leave the text alone. */
+    case NFA_MOPEN:
+    case NFA_MOPEN1:
+    case NFA_MOPEN2:
+    case NFA_MOPEN3:
+    case NFA_MOPEN4:
+    case NFA_MOPEN5:
+    case NFA_MOPEN6:
+    case NFA_MOPEN7:
+    case NFA_MOPEN8:
+    case NFA_MOPEN9:
+    case NFA_ZOPEN:
+    case NFA_ZOPEN1:
+    case NFA_ZOPEN2:
+    case NFA_ZOPEN3:
+    case NFA_ZOPEN4:
+    case NFA_ZOPEN5:
+    case NFA_ZOPEN6:
+    case NFA_ZOPEN7:
+    case NFA_ZOPEN8:
+    case NFA_ZOPEN9:
+    case NFA_NOPEN:
+      if (sp < 0) {
+        /* empty regexp */
+        LIT_PUSH();
+        lit_clear(&stack[sp], TRUE);
+      }
+      break;
+
+    /* A match that includes a line break continues in another line. */
+    case NFA_NEWL:
+      goto theend;
+
+    /* Zero-width items. */
+    case NFA_LNUM:
+    case NFA_LNUM_GT:
+    case NFA_LNUM_LT:
+    case NFA_VCOL:
+    case NFA_VCOL_GT:
+    case NFA_VCOL_LT:
+    case NFA_COL:
+    case NFA_COL_GT:
+    case NFA_COL_LT:
+    case NFA_MARK:
+    case NFA_MARK_GT:
+    case NFA_MARK_LT:
+      p++;                      /* skip the number or mark name */
+    /* FALLTHROUGH */
+    case NFA_EMPTY:
+    case NFA_BOL:
+    case NFA_EOL:
+    case NFA_BOW:
+    case NFA_EOW:
+    case NFA_BOF:
+    case NFA_EOF:
+    case NFA_ZSTART:
+    case NFA_ZEND:
+    case NFA_CURSOR:
+    case NFA_VISUAL:
+      LIT_PUSH();
+      lit_clear(&stack[sp], TRUE);
+      break;
+
+    default:
+      LIT_PUSH();
+      lit_clear(&stack[sp], FALSE);
+      if (*p > 0 && (has_mbyte || *p < 256)) {
+        /* A literal character. */
+        nfa_litfrag_T *f = &stack[sp];
+
+        if (has_mbyte) {
+          f->exact.len = (*mb_char2bytes)(*p, f->exact.text);
+        } else {
+          f->exact.text[0] = (char_u)*p;
+          f->exact.len = 1;
+        }
+        f->prefix = f->suffix = f->best[0] = f->exact;
+        f->nbest = 1;
+      }
+      break;
+    }
+  }
+
+  if (sp != 0 || stack->in_coll || stack->nbest == 0
+      || lit_score(stack->best, stack->nbest) == 0) {
+    goto theend;
+  }
+
+  ret = xmalloc(sizeof(nfa_literals_T));
+  ret->count = stack->nbest;
+  ret->ascii = TRUE;
+  for (int i = 0; i < ret->count; i++) {
+    nfa_lit_T *lit = &stack->best[i];
+
+    ret->len[i] = (size_t)lit->len;
+    memmove(ret->text[i], lit->text, (size_t)lit->len);
+    for (int j = 0; j < lit->len; j++) {
+      if (lit->text[j] >= 0x80) {
+        ret->ascii = FALSE;
+      }
+    }
+  }
+
+theend:
+  free(stack);
+  return ret;
+
+#undef LIT_NEED
+#undef LIT_PUSH
+}
+
+/*
+ * Return TRUE when none of the literals of "prog" appear in "line" from
+ * column "col" on, thus the pattern can't match there.
+ */
+static int nfa_literals_reject(nfa_regprog_T *prog, char_u *line,
+                               colnr_T col, int ic)
+{
+  nfa_literals_T *lits = prog->literals;
+
+  /* Non-ASCII characters may fold to ASCII with 'ignorecase'. */
+  if (lits == NULL || (ic && !lits->ascii)) {
+    return FALSE;
+  }
+
+  char_u *text = line + col;
+  size_t len = STRLEN(text);
+
+  for (int i = 0; i < lits->count; i++) {
+    if (memsearch_find(text, len, lits->text[i], lits->len[i], ic) != NULL) {
+      return FALSE;
+    }
+  }
+  return !ic || memsearch_is_ascii(text, len);
+}
+
 /*
  * Allocate more space for post_start.  Called when
  * running above the estimated number of states.
@@ -1184,6 +1580,9 @@ static int nfa_regatom(void)
       c = getchr();
       goto nfa_do_multibyte;
     }
+    /* These classes depend on 'isident', 'isfname' and 'isprint'. */
+    if (vim_strchr((char_u *)"iIfFpP", no_Magic(c)) != NULL)
+      regflags |= RF_NOTTEXT;
     EMIT(nfa_classcodes[p - classchars]);
     if (extra == NFA_ADD_NL) {
       EMIT(NFA_NEWL);
@@ -1345,18 +1744,22 @@ static int nfa_regatom(void)
      * pattern -- regardless of whether or not it makes sense. */
     case '^':
       EMIT(NFA_BOF);
+      regflags |= RF_NOTTEXT;
       break;
 
     case '$':
       EMIT(NFA_EOF);
+      regflags |= RF_NOTTEXT;
       break;
 
     case '#':
       EMIT(NFA_CURSOR);
+      regflags |= RF_NOTTEXT;
       break;
 
     case 'V':
       EMIT(NFA_VISUAL);
+      regflags |= RF_NOTTEXT;
       break;
 
     case 'C':
@@ -1406,6 +1809,8 @@ static int nfa_regatom(void)
         c = getchr();
       }
       if (c == 'l' || c == 'c' || c == 'v') {
+        if (c != 'c')
+          regflags |= RF_NOTTEXT;
         if (c == 'l')
           /* \%{n}l  \%{n}<l  \%{n}>l  */
           EMIT(cmp == '<' ? NFA_LNUM_LT :
@@ -1422,6 +1827,7 @@ static int nfa_regatom(void)
         break;
       } else if (c == '\'' && n == 0) {
         /* \%'m  \%<'m  \%>'m  */
+        regflags |= RF_NOTTEXT;
         EMIT(cmp == '<' ? NFA_MARK_LT :
             cmp == '>' ? NFA_MARK_GT : NFA_MARK);
         EMIT(getchr());
@@ -1526,6 +1932,8 @@ collection:
               EMIT(NFA_CLASS_LOWER);
               break;
             case CLASS_PRINT:
+              /* Depends on 'isprint', like "\p". */
+              regflags |= RF_NOTTEXT;
               EMIT(NFA_CLASS_PRINT);
               break;
             case CLASS_PUNCT:
@@ -2463,6 +2871,10 @@ static void nfa_dump(nfa_regprog_T *prog)
           prog->regstart, prog->regstart);
     if (prog->match_text != NULL)
       fprintf(debugf, "match_text: \"%s\"\n", prog->match_text);
+    if (prog->literals != NULL)
+      for (int i = 0; i < prog->literals->count; i++)
+        fprintf(debugf, "literal: \"%.*s\"\n", (int)prog->literals->len[i],
+            prog->literals->text[i]);
 
     fclose(debugf);
   }
@@ -3414,7 +3826,7 @@ static void nfa_postprocess(nfa_regprog_T *prog)
 static void log_subsexpr(regsubs_T *subs)
 {
   log_subexpr(&subs->norm);
-  if (nfa_has_zsubexpr)
+  if (rex->nfa_has_zsubexpr)
     log_subexpr(&subs->synt);
 }
 
@@ -3449,17 +3861,13 @@ static char *pim_info(nfa_pim_T *pim)
     buf[0] = NUL;
   else {
     sprintf(buf, " PIM col %d", REG_MULTI ? (int)pim->end.pos.col
-        : (int)(pim->end.ptr - reginput));
+        : (int)(pim->end.ptr - rex->reginput));
   }
   return buf;
 }
 
 #endif
 
-/* Used during execution: whether a match has been found. */
-static int nfa_match;
-
-
 /*
  * Copy postponed invisible match info from "from" to "to".
  */
@@ -3468,7 +3876,7 @@ static void copy_pim(nfa_pim_T *to, nfa_pim_T *from)
   to->result = from->result;
   to->state = from->state;
   copy_sub(&to->subs.norm, &from->subs.norm);
-  if (nfa_has_zsubexpr)
+  if (rex->nfa_has_zsubexpr)
     copy_sub(&to->subs.synt, &from->subs.synt);
   to->end = from->end;
 }
@@ -3478,9 +3886,9 @@ static void clear_sub(regsub_T *sub)
   if (REG_MULTI)
     /* Use 0xff to set lnum to -1 */
     memset(sub->list.multi, 0xff,
-        sizeof(struct multipos) * nfa_nsubexpr);
+        sizeof(struct multipos) * rex->nfa_nsubexpr);
   else
-    memset(sub->list.line, 0, sizeof(struct linepos) * nfa_nsubexpr);
+    memset(sub->list.line, 0, sizeof(struct linepos) * rex->nfa_nsubexpr);
   sub->in_use = 0;
 }
 
@@ -3528,7 +3936,7 @@ static void copy_sub_off(regsub_T *to, regsub_T *from)
  */
 static void copy_ze_off(regsub_T *to, regsub_T *from)
 {
-  if (nfa_has_zend) {
+  if (rex->nfa_has_zend) {
     if (REG_MULTI) {
       if (from->list.multi[0].end.lnum >= 0)
         to->list.multi[0].end = from->list.multi[0].end;
@@ -3567,7 +3975,7 @@ static int sub_equal(regsub_T *sub1, regsub_T *sub2)
           != sub2->list.multi[i].start.col)
         return FALSE;
 
-      if (nfa_has_backref) {
+      if (rex->nfa_has_backref) {
         if (i < sub1->in_use) {
           s1 = sub1->list.multi[i].end.lnum;
         } else {
@@ -3600,7 +4008,7 @@ static int sub_equal(regsub_T *sub1, regsub_T *sub2)
       if (sp1 != sp2)
         return FALSE;
 
-      if (nfa_has_backref) {
+      if (rex->nfa_has_backref) {
         if (i < sub1->in_use) {
           sp1 = sub1->list.line[i].end;
         } else {
@@ -3634,7 +4042,7 @@ static void report_state(char *action,
   else if (REG_MULTI)
     col = sub->list.multi[0].start.col;
   else
-    col = (int)(sub->list.line[0].start - regline);
+    col = (int)(sub->list.line[0].start - rex->regline);
   nfa_set_code(state->c);
   fprintf(log_fd, "> %s state %d to list %d. char %d: %s (start col %d)%s\n",
       action, abs(state->id), lid, state->c, code, col,
@@ -3662,7 +4070,7 @@ has_state_with_pos (
     thread = &l->t[i];
     if (thread->state->id == state->id
         && sub_equal(&thread->subs.norm, &subs->norm)
-        && (!nfa_has_zsubexpr
+        && (!rex->nfa_has_zsubexpr
             || sub_equal(&thread->subs.synt, &subs->synt))
         && pim_equal(&thread->pim, pim))
       return TRUE;
@@ -3795,8 +4203,8 @@ state_in_list (
     regsubs_T *subs      /* pointers to subexpressions */
 )
 {
-  if (state->lastlist[nfa_ll_index] == l->id) {
-    if (!nfa_has_backref || has_state_with_pos(l, state, subs, NULL))
+  if (state->lastlist[rex->nfa_ll_index] == l->id) {
+    if (!rex->nfa_has_backref || has_state_with_pos(l, state, subs, NULL))
       return TRUE;
   }
   return FALSE;
@@ -3864,11 +4272,11 @@ addstate (
     /* "^" won't match past end-of-line, don't bother trying.
      * Except when at the end of the line, or when we are going to the
      * next line for a look-behind match. */
-    if (reginput > regline
-        && *reginput != NUL
-        && (nfa_endp == NULL
+    if (rex->reginput > rex->regline
+        && *rex->reginput != NUL
+        && (rex->nfa_endp == NULL
             || !REG_MULTI
-            || reglnum == nfa_endp->se_u.pos.lnum))
+            || rex->reglnum == rex->nfa_endp->se_u.pos.lnum))
       goto skip_add;
   /* FALLTHROUGH */
 
@@ -3898,12 +4306,12 @@ addstate (
    * endless loop for "\(\)*" */
 
   default:
-    if (state->lastlist[nfa_ll_index] == l->id && state->c != NFA_SKIP) {
+    if (state->lastlist[rex->nfa_ll_index] == l->id && state->c != NFA_SKIP) {
       /* This state is already in the list, don't add it again,
        * unless it is an MOPEN that is used for a backreference or
        * when there is a PIM. For NFA_MATCH check the position,
        * lower position is preferred. */
-      if (!nfa_has_backref && pim == NULL && !l->has_pim
+      if (!rex->nfa_has_backref && pim == NULL && !l->has_pim
           && state->c != NFA_MATCH) {
 skip_add:
 #ifdef REGEXP_DEBUG
@@ -3929,7 +4337,7 @@ skip_add:
         /* "subs" may point into the current array, need to make a
          * copy before it becomes invalid. */
         copy_sub(&temp_subs.norm, &subs->norm);
-        if (nfa_has_zsubexpr)
+        if (rex->nfa_has_zsubexpr)
           copy_sub(&temp_subs.synt, &subs->synt);
         subs = &temp_subs;
       }
@@ -3939,7 +4347,7 @@ skip_add:
     }
 
     /* add the state to the list */
-    state->lastlist[nfa_ll_index] = l->id;
+    state->lastlist[rex->nfa_ll_index] = l->id;
     thread = &l->t[l->n++];
     thread->state = state;
     if (pim == NULL)
@@ -3949,7 +4357,7 @@ skip_add:
       l->has_pim = TRUE;
     }
     copy_sub(&thread->subs.norm, &subs->norm);
-    if (nfa_has_zsubexpr)
+    if (rex->nfa_has_zsubexpr)
       copy_sub(&thread->subs.synt, &subs->synt);
 #ifdef REGEXP_DEBUG
     report_state("Adding", &thread->subs.norm, state, l->id, pim);
@@ -4029,12 +4437,12 @@ skip_add:
         sub->in_use = subidx + 1;
       }
       if (off == -1) {
-        sub->list.multi[subidx].start.lnum = reglnum + 1;
+        sub->list.multi[subidx].start.lnum = rex->reglnum + 1;
         sub->list.multi[subidx].start.col = 0;
       } else {
-        sub->list.multi[subidx].start.lnum = reglnum;
+        sub->list.multi[subidx].start.lnum = rex->reglnum;
         sub->list.multi[subidx].start.col =
-          (colnr_T)(reginput - regline + off);
+          (colnr_T)(rex->reginput - rex->regline + off);
       }
     } else {
       if (subidx < sub->in_use) {
@@ -4048,7 +4456,7 @@ skip_add:
         }
         sub->in_use = subidx + 1;
       }
-      sub->list.line[subidx].start = reginput + off;
+      sub->list.line[subidx].start = rex->reginput + off;
     }
 
     subs = addstate(l, state->out, subs, pim, off);
@@ -4068,7 +4476,7 @@ skip_add:
     break;
 
   case NFA_MCLOSE:
-    if (nfa_has_zend && (REG_MULTI
+    if (rex->nfa_has_zend && (REG_MULTI
                          ? subs->norm.list.multi[0].end.lnum >= 0
                          : subs->norm.list.line[0].end != NULL)) {
       /* Do not overwrite the position set by \ze. */
@@ -4114,18 +4522,18 @@ skip_add:
     if (REG_MULTI) {
       save_lpos = sub->list.multi[subidx].end;
       if (off == -1) {
-        sub->list.multi[subidx].end.lnum = reglnum + 1;
+        sub->list.multi[subidx].end.lnum = rex->reglnum + 1;
         sub->list.multi[subidx].end.col = 0;
       } else {
-        sub->list.multi[subidx].end.lnum = reglnum;
+        sub->list.multi[subidx].end.lnum = rex->reglnum;
         sub->list.multi[subidx].end.col =
-          (colnr_T)(reginput - regline + off);
+          (colnr_T)(rex->reginput - rex->regline + off);
       }
       /* avoid compiler warnings */
       save_ptr = NULL;
     } else {
       save_ptr = sub->list.line[subidx].end;
-      sub->list.line[subidx].end = reginput + off;
+      sub->list.line[subidx].end = rex->reginput + off;
       /* avoid compiler warnings */
       save_lpos.lnum = 0;
       save_lpos.col = 0;
@@ -4287,7 +4695,7 @@ static int check_char_class(int class, int c)
 
   default:
     /* should not be here :P */
-    EMSGN(_(e_ill_char_class), class);
+    REG_EMSGN(_(e_ill_char_class), class);
     return FAIL;
   }
   return FAIL;
@@ -4317,12 +4725,12 @@ retempty:
     if (sub->list.multi[subidx].start.lnum < 0
         || sub->list.multi[subidx].end.lnum < 0)
       goto retempty;
-    if (sub->list.multi[subidx].start.lnum == reglnum
-        && sub->list.multi[subidx].end.lnum == reglnum) {
+    if (sub->list.multi[subidx].start.lnum == rex->reglnum
+        && sub->list.multi[subidx].end.lnum == rex->reglnum) {
       len = sub->list.multi[subidx].end.col
             - sub->list.multi[subidx].start.col;
-      if (cstrncmp(regline + sub->list.multi[subidx].start.col,
-              reginput, &len) == 0) {
+      if (cstrncmp(rex->regline + sub->list.multi[subidx].start.col,
+              rex->reginput, &len) == 0) {
         *bytelen = len;
         return TRUE;
       }
@@ -4340,7 +4748,7 @@ retempty:
         || sub->list.line[subidx].end == NULL)
       goto retempty;
     len = (int)(sub->list.line[subidx].end - sub->list.line[subidx].start);
-    if (cstrncmp(sub->list.line[subidx].start, reginput, &len) == 0) {
+    if (cstrncmp(sub->list.line[subidx].start, rex->reginput, &len) == 0) {
       *bytelen = len;
       return TRUE;
     }
@@ -4370,7 +4778,7 @@ match_zref (
   }
 
   len = (int)STRLEN(re_extmatch_in->matches[subidx]);
-  if (cstrncmp(re_extmatch_in->matches[subidx], reginput, &len) == 0) {
+  if (cstrncmp(re_extmatch_in->matches[subidx], rex->reginput, &len) == 0) {
     *bytelen = len;
     return TRUE;
   }
@@ -4426,11 +4834,11 @@ static bool nfa_re_num_cmp(uintmax_t val, int op, uintmax_t pos)
  */
 static int recursive_regmatch(nfa_state_T *state, nfa_pim_T *pim, nfa_regprog_T *prog, regsubs_T *submatch, regsubs_T *m, int **listids)
 {
-  int save_reginput_col = (int)(reginput - regline);
-  int save_reglnum = reglnum;
-  int save_nfa_match = nfa_match;
-  int save_nfa_listid = nfa_listid;
-  save_se_T   *save_nfa_endp = nfa_endp;
+  int save_reginput_col = (int)(rex->reginput - rex->regline);
+  int save_reglnum = rex->reglnum;
+  int save_nfa_match = rex->nfa_match;
+  int save_nfa_listid = rex->nfa_listid;
+  save_se_T   *save_nfa_endp = rex->nfa_endp;
   save_se_T endpos;
   save_se_T   *endposp = NULL;
   int result;
@@ -4439,9 +4847,9 @@ static int recursive_regmatch(nfa_state_T *state, nfa_pim_T *pim, nfa_regprog_T
   if (pim != NULL) {
     /* start at the position where the postponed match was */
     if (REG_MULTI)
-      reginput = regline + pim->end.pos.col;
+      rex->reginput = rex->regline + pim->end.pos.col;
     else
-      reginput = pim->end.ptr;
+      rex->reginput = pim->end.ptr;
   }
 
   if (state->c == NFA_START_INVISIBLE_BEFORE
@@ -4453,13 +4861,13 @@ static int recursive_regmatch(nfa_state_T *state, nfa_pim_T *pim, nfa_regprog_T
     endposp = &endpos;
     if (REG_MULTI) {
       if (pim == NULL) {
-        endpos.se_u.pos.col = (int)(reginput - regline);
-        endpos.se_u.pos.lnum = reglnum;
+        endpos.se_u.pos.col = (int)(rex->reginput - rex->regline);
+        endpos.se_u.pos.lnum = rex->reglnum;
       } else
         endpos.se_u.pos = pim->end.pos;
     } else {
       if (pim == NULL)
-        endpos.se_u.ptr = reginput;
+        endpos.se_u.ptr = rex->reginput;
       else
         endpos.se_u.ptr = pim->end.ptr;
     }
@@ -4470,30 +4878,30 @@ static int recursive_regmatch(nfa_state_T *state, nfa_pim_T *pim, nfa_regprog_T
      * bytes if possible. */
     if (state->val <= 0) {
       if (REG_MULTI) {
-        regline = reg_getline(--reglnum);
-        if (regline == NULL)
+        rex->regline = reg_getline(--rex->reglnum);
+        if (rex->regline == NULL)
           /* can't go before the first line */
-          regline = reg_getline(++reglnum);
+          rex->regline = reg_getline(++rex->reglnum);
       }
-      reginput = regline;
+      rex->reginput = rex->regline;
     } else {
-      if (REG_MULTI && (int)(reginput - regline) < state->val) {
+      if (REG_MULTI && (int)(rex->reginput - rex->regline) < state->val) {
         /* Not enough bytes in this line, go to end of
          * previous line. */
-        regline = reg_getline(--reglnum);
-        if (regline == NULL) {
+        rex->regline = reg_getline(--rex->reglnum);
+        if (rex->regline == NULL) {
           /* can't go before the first line */
-          regline = reg_getline(++reglnum);
-          reginput = regline;
+          rex->regline = reg_getline(++rex->reglnum);
+          rex->reginput = rex->regline;
         } else
-          reginput = regline + STRLEN(regline);
+          rex->reginput = rex->regline + STRLEN(rex->regline);
       }
-      if ((int)(reginput - regline) >= state->val) {
-        reginput -= state->val;
+      if ((int)(rex->reginput - rex->regline) >= state->val) {
+        rex->reginput -= state->val;
         if (has_mbyte)
-          reginput -= mb_head_off(regline, reginput);
+          rex->reginput -= mb_head_off(rex->regline, rex->reginput);
       } else
-        reginput = regline;
+        rex->reginput = rex->regline;
     }
   }
 
@@ -4504,7 +4912,7 @@ static int recursive_regmatch(nfa_state_T *state, nfa_pim_T *pim, nfa_regprog_T
 #endif
   /* Have to clear the lastlist field of the NFA nodes, so that
    * nfa_regmatch() and addstate() can run properly after recursion. */
-  if (nfa_ll_index == 1) {
+  if (rex->nfa_ll_index == 1) {
     /* Already calling nfa_regmatch() recursively.  Save the lastlist[1]
      * values and clear them. */
     if (*listids == NULL) {
@@ -4517,31 +4925,31 @@ static int recursive_regmatch(nfa_state_T *state, nfa_pim_T *pim, nfa_regprog_T
     /* First recursive nfa_regmatch() call, switch to the second lastlist
      * entry.  Make sure nfa_listid is different from a previous recursive
      * call, because some states may still have this ID. */
-    ++nfa_ll_index;
-    if (nfa_listid <= nfa_alt_listid)
-      nfa_listid = nfa_alt_listid;
+    ++rex->nfa_ll_index;
+    if (rex->nfa_listid <= rex->nfa_alt_listid)
+      rex->nfa_listid = rex->nfa_alt_listid;
   }
 
   /* Call nfa_regmatch() to check if the current concat matches at this
    * position. The concat ends with the node NFA_END_INVISIBLE */
-  nfa_endp = endposp;
+  rex->nfa_endp = endposp;
   result = nfa_regmatch(prog, state->out, submatch, m);
 
   if (need_restore)
     nfa_restore_listids(prog, *listids);
   else {
-    --nfa_ll_index;
-    nfa_alt_listid = nfa_listid;
+    --rex->nfa_ll_index;
+    rex->nfa_alt_listid = rex->nfa_listid;
   }
 
   /* restore position in input text */
-  reglnum = save_reglnum;
+  rex->reglnum = save_reglnum;
   if (REG_MULTI)
-    regline = reg_getline(reglnum);
-  reginput = regline + save_reginput_col;
-  nfa_match = save_nfa_match;
-  nfa_endp = save_nfa_endp;
-  nfa_listid = save_nfa_listid;
+    rex->regline = reg_getline(rex->reglnum);
+  rex->reginput = rex->regline + save_reginput_col;
+  rex->nfa_match = save_nfa_match;
+  rex->nfa_endp = save_nfa_endp;
+  rex->nfa_listid = save_nfa_listid;
 
 #ifdef REGEXP_DEBUG
   log_fd = fopen(NFA_REGEXP_RUN_LOG, "a");
@@ -4726,15 +5134,15 @@ static int skip_to_start(int c, colnr_T *colp)
   char_u *s;
 
   /* Used often, do some work to avoid call overhead. */
-  if (!ireg_ic
+  if (!rex->ireg_ic
       && !has_mbyte
       )
-    s = vim_strbyte(regline + *colp, c);
+    s = vim_strbyte(rex->regline + *colp, c);
   else
-    s = cstrchr(regline + *colp, c);
+    s = cstrchr(rex->regline + *colp, c);
   if (s == NULL)
     return FAIL;
-  *colp = (int)(s - regline);
+  *colp = (int)(s - rex->regline);
   return OK;
 }
 
@@ -4755,8 +5163,8 @@ static long find_match_text(colnr_T startcol, int regstart, char_u *match_text)
     len2 = MB_CHAR2LEN(regstart);     /* skip regstart */
     for (len1 = 0; match_text[len1] != NUL; len1 += MB_CHAR2LEN(c1)) {
       c1 = PTR2CHAR(match_text + len1);
-      c2 = PTR2CHAR(regline + col + len2);
-      if (c1 != c2 && (!ireg_ic || vim_tolower(c1) != vim_tolower(c2))) {
+      c2 = PTR2CHAR(rex->regline + col + len2);
+      if (c1 != c2 && (!rex->ireg_ic || vim_tolower(c1) != vim_tolower(c2))) {
         match = FALSE;
         break;
       }
@@ -4765,17 +5173,17 @@ static long find_match_text(colnr_T startcol, int regstart, char_u *match_text)
     if (match
         /* check that no composing char follows */
         && !(enc_utf8
-             && utf_iscomposing(PTR2CHAR(regline + col + len2)))
+             && utf_iscomposing(PTR2CHAR(rex->regline + col + len2)))
         ) {
       cleanup_subexpr();
       if (REG_MULTI) {
-        reg_startpos[0].lnum = reglnum;
-        reg_startpos[0].col = col;
-        reg_endpos[0].lnum = reglnum;
-        reg_endpos[0].col = col + len2;
+        rex->reg_startpos[0].lnum = rex->reglnum;
+        rex->reg_startpos[0].col = col;
+        rex->reg_endpos[0].lnum = rex->reglnum;
+        rex->reg_endpos[0].col = col + len2;
       } else {
-        reg_startp[0] = regline + col;
-        reg_endp[0] = regline + col + len2;
+        rex->reg_startp[0] = rex->regline + col;
+        rex->reg_endp[0] = rex->regline + col + len2;
       }
       return 1L;
     }
@@ -4825,18 +5233,18 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
 #endif
   /* Some patterns may take a long time to match, especially when using
    * recursive_regmatch(). Allow interrupting them with CTRL-C. */
-  fast_breakcheck();
+  reg_breakcheck();
   if (got_int)
     return FALSE;
 
-  nfa_match = FALSE;
+  rex->nfa_match = FALSE;
 
   /* Allocate memory for the lists of nodes. */
-  size_t size = (nstate + 1) * sizeof(nfa_thread_T);
+  size_t size = (rex->nfa_nstate + 1) * sizeof(nfa_thread_T);
   list[0].t = xmalloc(size);
-  list[0].len = nstate + 1;
+  list[0].len = rex->nfa_nstate + 1;
   list[1].t = xmalloc(size);
-  list[1].len = nstate + 1;
+  list[1].len = rex->nfa_nstate + 1;
 
 #ifdef REGEXP_DEBUG
   log_fd = fopen(NFA_REGEXP_RUN_LOG, "a");
@@ -4862,16 +5270,16 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
 #ifdef REGEXP_DEBUG
   fprintf(log_fd, "(---) STARTSTATE first\n");
 #endif
-  thislist->id = nfa_listid + 1;
+  thislist->id = rex->nfa_listid + 1;
 
   /* Inline optimized code for addstate(thislist, start, m, 0) if we know
    * it's the first MOPEN. */
   if (toplevel) {
     if (REG_MULTI) {
-      m->norm.list.multi[0].start.lnum = reglnum;
-      m->norm.list.multi[0].start.col = (colnr_T)(reginput - regline);
+      m->norm.list.multi[0].start.lnum = rex->reglnum;
+      m->norm.list.multi[0].start.col = (colnr_T)(rex->reginput - rex->regline);
     } else
-      m->norm.list.line[0].start = reginput;
+      m->norm.list.line[0].start = rex->reginput;
     m->norm.in_use = 1;
     addstate(thislist, start->out, m, NULL, 0);
   } else
@@ -4891,10 +5299,10 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
     int clen;
 
     if (has_mbyte) {
-      curc = (*mb_ptr2char)(reginput);
-      clen = (*mb_ptr2len)(reginput);
+      curc = (*mb_ptr2char)(rex->reginput);
+      clen = (*mb_ptr2len)(rex->reginput);
     } else {
-      curc = *reginput;
+      curc = *rex->reginput;
       clen = 1;
     }
     if (curc == NUL) {
@@ -4907,13 +5315,13 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
     nextlist = &list[flag ^= 1];
     nextlist->n = 0;                /* clear nextlist */
     nextlist->has_pim = FALSE;
-    ++nfa_listid;
-    thislist->id = nfa_listid;
-    nextlist->id = nfa_listid + 1;
+    ++rex->nfa_listid;
+    thislist->id = rex->nfa_listid;
+    nextlist->id = rex->nfa_listid + 1;
 
 #ifdef REGEXP_DEBUG
     fprintf(log_fd, "------------------------------------------\n");
-    fprintf(log_fd, ">>> Reginput is \"%s\"\n", reginput);
+    fprintf(log_fd, ">>> Reginput is \"%s\"\n", rex->reginput);
     fprintf(log_fd,
         ">>> Advanced one character ... Current char is %c (code %d) \n", curc,
         (int)curc);
@@ -4953,7 +5361,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
         else if (REG_MULTI)
           col = t->subs.norm.list.multi[0].start.col;
         else
-          col = (int)(t->subs.norm.list.line[0].start - regline);
+          col = (int)(t->subs.norm.list.line[0].start - rex->regline);
         nfa_set_code(t->state->c);
         fprintf(log_fd, "(%d) char %d %s (start col %d)%s ... \n",
             abs(t->state->id), (int)t->state->c, code, col,
@@ -4973,12 +5381,12 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
       {
         // If the match ends before a composing characters and
         // ireg_icombine is not set, that is not really a match.
-        if (enc_utf8 && !ireg_icombine && utf_iscomposing(curc)) {
+        if (enc_utf8 && !rex->ireg_icombine && utf_iscomposing(curc)) {
           break;
         }
-        nfa_match = TRUE;
+        rex->nfa_match = TRUE;
         copy_sub(&submatch->norm, &t->subs.norm);
-        if (nfa_has_zsubexpr)
+        if (rex->nfa_has_zsubexpr)
           copy_sub(&submatch->synt, &t->subs.synt);
 #ifdef REGEXP_DEBUG
         log_subsexpr(&t->subs);
@@ -5007,41 +5415,41 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
          * Submatches are stored in *m, and used in the parent call.
          */
 #ifdef REGEXP_DEBUG
-        if (nfa_endp != NULL) {
+        if (rex->nfa_endp != NULL) {
           if (REG_MULTI)
             fprintf(
                 log_fd,
                 "Current lnum: %d, endp lnum: %d; current col: %d, endp col: %d\n",
-                (int)reglnum,
-                (int)nfa_endp->se_u.pos.lnum,
-                (int)(reginput - regline),
-                nfa_endp->se_u.pos.col);
+                (int)rex->reglnum,
+                (int)rex->nfa_endp->se_u.pos.lnum,
+                (int)(rex->reginput - rex->regline),
+                rex->nfa_endp->se_u.pos.col);
           else
             fprintf(log_fd, "Current col: %d, endp col: %d\n",
-                (int)(reginput - regline),
-                (int)(nfa_endp->se_u.ptr - reginput));
+                (int)(rex->reginput - rex->regline),
+                (int)(rex->nfa_endp->se_u.ptr - rex->reginput));
         }
 #endif
         /* If "nfa_endp" is set it's only a match if it ends at
          * "nfa_endp" */
-        if (nfa_endp != NULL && (REG_MULTI
-                                 ? (reglnum != nfa_endp->se_u.pos.lnum
-                                    || (int)(reginput - regline)
-                                    != nfa_endp->se_u.pos.col)
-                                 : reginput != nfa_endp->se_u.ptr))
+        if (rex->nfa_endp != NULL && (REG_MULTI
+                                 ? (rex->reglnum != rex->nfa_endp->se_u.pos.lnum
+                                    || (int)(rex->reginput - rex->regline)
+                                    != rex->nfa_endp->se_u.pos.col)
+                                 : rex->reginput != rex->nfa_endp->se_u.ptr))
           break;
 
         /* do not set submatches for \@! */
         if (t->state->c != NFA_END_INVISIBLE_NEG) {
           copy_sub(&m->norm, &t->subs.norm);
-          if (nfa_has_zsubexpr)
+          if (rex->nfa_has_zsubexpr)
             copy_sub(&m->synt, &t->subs.synt);
         }
 #ifdef REGEXP_DEBUG
         fprintf(log_fd, "Match found:\n");
         log_subsexpr(m);
 #endif
-        nfa_match = TRUE;
+        rex->nfa_match = TRUE;
         /* See comment above at "goto nextchar". */
         if (nextlist->n == 0)
           clen = 0;
@@ -5073,7 +5481,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
           /* Copy submatch info for the recursive call, opposite
            * of what happens on success below. */
           copy_sub_off(&m->norm, &t->subs.norm);
-          if (nfa_has_zsubexpr)
+          if (rex->nfa_has_zsubexpr)
             copy_sub_off(&m->synt, &t->subs.synt);
 
           /*
@@ -5093,7 +5501,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
                          == NFA_START_INVISIBLE_BEFORE_NEG_FIRST)) {
             /* Copy submatch info from the recursive call */
             copy_sub_off(&t->subs.norm, &m->norm);
-            if (nfa_has_zsubexpr)
+            if (rex->nfa_has_zsubexpr)
               copy_sub_off(&t->subs.synt, &m->synt);
             /* If the pattern has \ze and it matched in the
              * sub pattern, use it. */
@@ -5120,10 +5528,10 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
           pim.subs.norm.in_use = 0;
           pim.subs.synt.in_use = 0;
           if (REG_MULTI) {
-            pim.end.pos.col = (int)(reginput - regline);
-            pim.end.pos.lnum = reglnum;
+            pim.end.pos.col = (int)(rex->reginput - rex->regline);
+            pim.end.pos.lnum = rex->reglnum;
           } else
-            pim.end.ptr = reginput;
+            pim.end.ptr = rex->reginput;
 
           /* t->state->out1 is the corresponding END_INVISIBLE
            * node; Add its out to the current list (zero-width
@@ -5174,7 +5582,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
         /* Copy submatch info to the recursive call, opposite of what
          * happens afterwards. */
         copy_sub_off(&m->norm, &t->subs.norm);
-        if (nfa_has_zsubexpr)
+        if (rex->nfa_has_zsubexpr)
           copy_sub_off(&m->synt, &t->subs.synt);
 
         /* First try matching the pattern. */
@@ -5189,16 +5597,16 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
 #endif
           /* Copy submatch info from the recursive call */
           copy_sub_off(&t->subs.norm, &m->norm);
-          if (nfa_has_zsubexpr)
+          if (rex->nfa_has_zsubexpr)
             copy_sub_off(&t->subs.synt, &m->synt);
           /* Now we need to skip over the matched text and then
            * continue with what follows. */
           if (REG_MULTI)
             /* TODO: multi-line match */
             bytelen = m->norm.list.multi[0].end.col
-                      - (int)(reginput - regline);
+                      - (int)(rex->reginput - rex->regline);
           else
-            bytelen = (int)(m->norm.list.line[0].end - reginput);
+            bytelen = (int)(m->norm.list.line[0].end - rex->reginput);
 
 #ifdef REGEXP_DEBUG
           fprintf(log_fd, "NFA_START_PATTERN length: %d\n", bytelen);
@@ -5226,7 +5634,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
       }
 
       case NFA_BOL:
-        if (reginput == regline) {
+        if (rex->reginput == rex->regline) {
           add_here = TRUE;
           add_state = t->state->out;
         }
@@ -5248,14 +5656,14 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
           int this_class;
 
           /* Get class of current and previous char (if it exists). */
-          this_class = mb_get_class_buf(reginput, reg_buf);
+          this_class = mb_get_class_buf(rex->reginput, rex->reg_buf);
           if (this_class <= 1)
             result = FALSE;
           else if (reg_prev_class() == this_class)
             result = FALSE;
-        } else if (!vim_iswordc_buf(curc, reg_buf)
-                   || (reginput > regline
-                       && vim_iswordc_buf(reginput[-1], reg_buf)))
+        } else if (!vim_iswordc_buf(curc, rex->reg_buf)
+                   || (rex->reginput > rex->regline
+                       && vim_iswordc_buf(rex->reginput[-1], rex->reg_buf)))
           result = FALSE;
         if (result) {
           add_here = TRUE;
@@ -5265,20 +5673,20 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
 
       case NFA_EOW:
         result = TRUE;
-        if (reginput == regline)
+        if (rex->reginput == rex->regline)
           result = FALSE;
         else if (has_mbyte) {
           int this_class, prev_class;
 
           /* Get class of current and previous char (if it exists). */
-          this_class = mb_get_class_buf(reginput, reg_buf);
+          this_class = mb_get_class_buf(rex->reginput, rex->reg_buf);
           prev_class = reg_prev_class();
           if (this_class == prev_class
               || prev_class == 0 || prev_class == 1)
             result = FALSE;
-        } else if (!vim_iswordc_buf(reginput[-1], reg_buf)
-                   || (reginput[0] != NUL
-                       && vim_iswordc_buf(curc, reg_buf)))
+        } else if (!vim_iswordc_buf(rex->reginput[-1], rex->reg_buf)
+                   || (rex->reginput[0] != NUL
+                       && vim_iswordc_buf(curc, rex->reg_buf)))
           result = FALSE;
         if (result) {
           add_here = TRUE;
@@ -5287,15 +5695,15 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
         break;
 
       case NFA_BOF:
-        if (reglnum == 0 && reginput == regline
-            && (!REG_MULTI || reg_firstlnum == 1)) {
+        if (rex->reglnum == 0 && rex->reginput == rex->regline
+            && (!REG_MULTI || rex->reg_firstlnum == 1)) {
           add_here = TRUE;
           add_state = t->state->out;
         }
         break;
 
       case NFA_EOF:
-        if (reglnum == reg_maxline && curc == NUL) {
+        if (rex->reglnum == rex->reg_maxline && curc == NUL) {
           add_here = TRUE;
           add_state = t->state->out;
         }
@@ -5319,7 +5727,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
            * (no preceding character). */
           len += mb_char2len(mc);
         }
-        if (ireg_icombine && len == 0) {
+        if (rex->ireg_icombine && len == 0) {
           /* If \Z was present, then ignore composing characters.
            * When ignoring the base character this always matches. */
           if (sta->c != curc)
@@ -5339,7 +5747,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
           /* We don't care about the order of composing characters.
            * Get them into cchars[] first. */
           while (len < clen) {
-            mc = mb_ptr2char(reginput + len);
+            mc = mb_ptr2char(rex->reginput + len);
             cchars[ccount++] = mc;
             len += mb_char2len(mc);
             if (ccount == MAX_MCO)
@@ -5369,14 +5777,14 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
       }
 
       case NFA_NEWL:
-        if (curc == NUL && !reg_line_lbr && REG_MULTI
-            && reglnum <= reg_maxline) {
+        if (curc == NUL && !rex->reg_line_lbr && REG_MULTI
+            && rex->reglnum <= rex->reg_maxline) {
           go_to_nextline = TRUE;
           /* Pass -1 for the offset, which means taking the position
            * at the start of the next line. */
           add_state = t->state->out;
           add_off = -1;
-        } else if (curc == '\n' && reg_line_lbr) {
+        } else if (curc == '\n' && rex->reg_line_lbr) {
           /* match \n as if it is an ordinary character */
           add_state = t->state->out;
           add_off = 1;
@@ -5416,7 +5824,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
               result = result_if_matched;
               break;
             }
-            if (ireg_ic) {
+            if (rex->ireg_ic) {
               int curc_low = vim_tolower(curc);
               int done = FALSE;
 
@@ -5431,7 +5839,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
             }
           } else if (state->c < 0 ? check_char_class(state->c, curc)
                      : (curc == state->c
-                        || (ireg_ic && vim_tolower(curc)
+                        || (rex->ireg_ic && vim_tolower(curc)
                             == vim_tolower(state->c)))) {
             result = result_if_matched;
             break;
@@ -5481,13 +5889,13 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
         break;
 
       case NFA_KWORD:           /*  \k	*/
-        result = vim_iswordp_buf(reginput, reg_buf);
+        result = vim_iswordp_buf(rex->reginput, rex->reg_buf);
         ADD_STATE_IF_MATCH(t->state);
         break;
 
       case NFA_SKWORD:          /*  \K	*/
         result = !VIM_ISDIGIT(curc)
-                 && vim_iswordp_buf(reginput, reg_buf);
+                 && vim_iswordp_buf(rex->reginput, rex->reg_buf);
         ADD_STATE_IF_MATCH(t->state);
         break;
 
@@ -5502,12 +5910,12 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
         break;
 
       case NFA_PRINT:           /*  \p	*/
-        result = vim_isprintc(PTR2CHAR(reginput));
+        result = vim_isprintc(PTR2CHAR(rex->reginput));
         ADD_STATE_IF_MATCH(t->state);
         break;
 
       case NFA_SPRINT:          /*  \P	*/
-        result = !VIM_ISDIGIT(curc) && vim_isprintc(PTR2CHAR(reginput));
+        result = !VIM_ISDIGIT(curc) && vim_isprintc(PTR2CHAR(rex->reginput));
         ADD_STATE_IF_MATCH(t->state);
         break;
 
@@ -5602,24 +6010,24 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
         break;
 
       case NFA_LOWER_IC:        /* [a-z] */
-        result = ri_lower(curc) || (ireg_ic && ri_upper(curc));
+        result = ri_lower(curc) || (rex->ireg_ic && ri_upper(curc));
         ADD_STATE_IF_MATCH(t->state);
         break;
 
       case NFA_NLOWER_IC:       /* [^a-z] */
         result = curc != NUL
-                 && !(ri_lower(curc) || (ireg_ic && ri_upper(curc)));
+                 && !(ri_lower(curc) || (rex->ireg_ic && ri_upper(curc)));
         ADD_STATE_IF_MATCH(t->state);
         break;
 
       case NFA_UPPER_IC:        /* [A-Z] */
-        result = ri_upper(curc) || (ireg_ic && ri_lower(curc));
+        result = ri_upper(curc) || (rex->ireg_ic && ri_lower(curc));
         ADD_STATE_IF_MATCH(t->state);
         break;
 
       case NFA_NUPPER_IC:       /* ^[A-Z] */
         result = curc != NUL
-                 && !(ri_upper(curc) || (ireg_ic && ri_lower(curc)));
+                 && !(ri_upper(curc) || (rex->ireg_ic && ri_lower(curc)));
         ADD_STATE_IF_MATCH(t->state);
         break;
 
@@ -5693,13 +6101,13 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
       case NFA_LNUM_GT:
       case NFA_LNUM_LT:
         assert(t->state->val >= 0
-               && !((reg_firstlnum > 0 && reglnum > LONG_MAX - reg_firstlnum)
-                    || (reg_firstlnum <0 && reglnum < LONG_MIN + reg_firstlnum))
-               && reglnum + reg_firstlnum >= 0);
+               && !((rex->reg_firstlnum > 0 && rex->reglnum > LONG_MAX - rex->reg_firstlnum)
+                    || (rex->reg_firstlnum <0 && rex->reglnum < LONG_MIN + rex->reg_firstlnum))
+               && rex->reglnum + rex->reg_firstlnum >= 0);
         result = (REG_MULTI
                   && nfa_re_num_cmp((uintmax_t)t->state->val,
                                     t->state->c - NFA_LNUM,
-                                    (uintmax_t)(reglnum + reg_firstlnum)));
+                                    (uintmax_t)(rex->reglnum + rex->reg_firstlnum)));
         if (result) {
           add_here = TRUE;
           add_state = t->state->out;
@@ -5710,11 +6118,11 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
       case NFA_COL_GT:
       case NFA_COL_LT:
         assert(t->state->val >= 0
-               && reginput >= regline
-               && (uintmax_t)(reginput - regline) <= UINTMAX_MAX - 1);
+               && rex->reginput >= rex->regline
+               && (uintmax_t)(rex->reginput - rex->regline) <= UINTMAX_MAX - 1);
         result = nfa_re_num_cmp((uintmax_t)t->state->val,
                                 t->state->c - NFA_COL,
-                                (uintmax_t)(reginput - regline + 1));
+                                (uintmax_t)(rex->reginput - rex->regline + 1));
         if (result) {
           add_here = TRUE;
           add_state = t->state->out;
@@ -5725,9 +6133,9 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
       case NFA_VCOL_GT:
       case NFA_VCOL_LT:
         {
-          uintmax_t lts = win_linetabsize(reg_win == NULL ? curwin : reg_win,
-                                          regline,
-                                          (colnr_T)(reginput - regline));
+          uintmax_t lts = win_linetabsize(rex->reg_win == NULL ? curwin : rex->reg_win,
+                                          rex->regline,
+                                          (colnr_T)(rex->reginput - rex->regline));
           assert(t->state->val >= 0);
           result = nfa_re_num_cmp((uintmax_t)t->state->val,
                                   t->state->c - NFA_VCOL,
@@ -5743,18 +6151,18 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
       case NFA_MARK_GT:
       case NFA_MARK_LT:
       {
-        pos_T   *pos = getmark_buf(reg_buf, t->state->val, FALSE);
+        pos_T   *pos = getmark_buf(rex->reg_buf, t->state->val, FALSE);
 
         /* Compare the mark position to the match position. */
         result = (pos != NULL                        /* mark doesn't exist */
                   && pos->lnum > 0          /* mark isn't set in reg_buf */
-                  && (pos->lnum == reglnum + reg_firstlnum
-                      ? (pos->col == (colnr_T)(reginput - regline)
+                  && (pos->lnum == rex->reglnum + rex->reg_firstlnum
+                      ? (pos->col == (colnr_T)(rex->reginput - rex->regline)
                          ? t->state->c == NFA_MARK
-                         : (pos->col < (colnr_T)(reginput - regline)
+                         : (pos->col < (colnr_T)(rex->reginput - rex->regline)
                             ? t->state->c == NFA_MARK_GT
                             : t->state->c == NFA_MARK_LT))
-                      : (pos->lnum < reglnum + reg_firstlnum
+                      : (pos->lnum < rex->reglnum + rex->reg_firstlnum
                          ? t->state->c == NFA_MARK_GT
                          : t->state->c == NFA_MARK_LT)));
         if (result) {
@@ -5765,10 +6173,10 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
       }
 
       case NFA_CURSOR:
-        result = (reg_win != NULL
-                  && (reglnum + reg_firstlnum == reg_win->w_cursor.lnum)
-                  && ((colnr_T)(reginput - regline)
-                      == reg_win->w_cursor.col));
+        result = (rex->reg_win != NULL
+                  && (rex->reglnum + rex->reg_firstlnum == rex->reg_win->w_cursor.lnum)
+                  && ((colnr_T)(rex->reginput - rex->regline)
+                      == rex->reg_win->w_cursor.col));
         if (result) {
           add_here = TRUE;
           add_state = t->state->out;
@@ -5814,16 +6222,16 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
 
 #ifdef REGEXP_DEBUG
         if (c < 0)
-          EMSGN("INTERNAL: Negative state char: %" PRId64, c);
+          REG_EMSGN("INTERNAL: Negative state char: %" PRId64, c);
 #endif
         result = (c == curc);
 
-        if (!result && ireg_ic)
+        if (!result && rex->ireg_ic)
           result = vim_tolower(c) == vim_tolower(curc);
 
         // If ireg_icombine is not set only skip over the character
         // itself.  When it is set skip over composing characters.
-        if (result && enc_utf8 && !ireg_icombine) {
+        if (result && enc_utf8 && !rex->ireg_icombine) {
           clen = utf_char2len(curc);
         }
 
@@ -5865,7 +6273,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
                            == NFA_START_INVISIBLE_BEFORE_NEG_FIRST)) {
               /* Copy submatch info from the recursive call */
               copy_sub_off(&pim->subs.norm, &m->norm);
-              if (nfa_has_zsubexpr)
+              if (rex->nfa_has_zsubexpr)
                 copy_sub_off(&pim->subs.synt, &m->synt);
             }
           } else {
@@ -5890,7 +6298,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
                          == NFA_START_INVISIBLE_BEFORE_NEG_FIRST)) {
             /* Copy submatch info from the recursive call */
             copy_sub_off(&t->subs.norm, &pim->subs.norm);
-            if (nfa_has_zsubexpr)
+            if (rex->nfa_has_zsubexpr)
               copy_sub_off(&t->subs.synt, &pim->subs.synt);
           } else
             /* look-behind match failed, don't add the state */
@@ -5928,19 +6336,19 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
      * because recursive calls should only start in the first position.
      * Unless "nfa_endp" is not NULL, then we match the end position.
      * Also don't start a match past the first line. */
-    if (nfa_match == FALSE
+    if (rex->nfa_match == FALSE
         && ((toplevel
-             && reglnum == 0
+             && rex->reglnum == 0
              && clen != 0
-             && (ireg_maxcol == 0
-                 || (colnr_T)(reginput - regline) < ireg_maxcol))
-            || (nfa_endp != NULL
+             && (rex->ireg_maxcol == 0
+                 || (colnr_T)(rex->reginput - rex->regline) < rex->ireg_maxcol))
+            || (rex->nfa_endp != NULL
                 && (REG_MULTI
-                    ? (reglnum < nfa_endp->se_u.pos.lnum
-                       || (reglnum == nfa_endp->se_u.pos.lnum
-                           && (int)(reginput - regline)
-                           < nfa_endp->se_u.pos.col))
-                    : reginput < nfa_endp->se_u.ptr)))) {
+                    ? (rex->reglnum < rex->nfa_endp->se_u.pos.lnum
+                       || (rex->reglnum == rex->nfa_endp->se_u.pos.lnum
+                           && (int)(rex->reginput - rex->regline)
+                           < rex->nfa_endp->se_u.pos.col))
+                    : rex->reginput < rex->nfa_endp->se_u.ptr)))) {
 #ifdef REGEXP_DEBUG
       fprintf(log_fd, "(---) STARTSTATE\n");
 #endif
@@ -5952,7 +6360,7 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
 
         if (prog->regstart != NUL && clen != 0) {
           if (nextlist->n == 0) {
-            colnr_T col = (colnr_T)(reginput - regline) + clen;
+            colnr_T col = (colnr_T)(rex->reginput - rex->regline) + clen;
 
             /* Nextlist is empty, we can skip ahead to the
              * character that must appear at the start. */
@@ -5960,14 +6368,14 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
               break;
 #ifdef REGEXP_DEBUG
             fprintf(log_fd, "  Skipping ahead %d bytes to regstart\n",
-                col - ((colnr_T)(reginput - regline) + clen));
+                col - ((colnr_T)(rex->reginput - rex->regline) + clen));
 #endif
-            reginput = regline + col - clen;
+            rex->reginput = rex->regline + col - clen;
           } else {
             /* Checking if the required start character matches is
              * cheaper than adding a state that won't match. */
-            c = PTR2CHAR(reginput + clen);
-            if (c != prog->regstart && (!ireg_ic || vim_tolower(c)
+            c = PTR2CHAR(rex->reginput + clen);
+            if (c != prog->regstart && (!rex->ireg_ic || vim_tolower(c)
                                         != vim_tolower(prog->regstart))) {
 #ifdef REGEXP_DEBUG
               fprintf(log_fd,
@@ -5981,9 +6389,9 @@ static int nfa_regmatch(nfa_regprog_T *prog, nfa_state_T *start, regsubs_T *subm
         if (add) {
           if (REG_MULTI)
             m->norm.list.multi[0].start.col =
-              (colnr_T)(reginput - regline) + clen;
+              (colnr_T)(rex->reginput - rex->regline) + clen;
           else
-            m->norm.list.line[0].start = reginput + clen;
+            m->norm.list.line[0].start = rex->reginput + clen;
           addstate(nextlist, start->out, m, NULL, clen);
         }
       } else
@@ -6005,9 +6413,9 @@ nextchar:
     /* Advance to the next character, or advance to the next line, or
      * finish. */
     if (clen != 0)
-      reginput += clen;
-    else if (go_to_nextline || (nfa_endp != NULL && REG_MULTI
-                                && reglnum < nfa_endp->se_u.pos.lnum))
+      rex->reginput += clen;
+    else if (go_to_nextline || (rex->nfa_endp != NULL && REG_MULTI
+                                && rex->reglnum < rex->nfa_endp->se_u.pos.lnum))
       reg_nextline();
     else
       break;
@@ -6028,7 +6436,7 @@ nextchar:
   fclose(debug);
 #endif
 
-  return nfa_match;
+  return rex->nfa_match;
 }
 
 /*
@@ -6044,7 +6452,7 @@ static long nfa_regtry(nfa_regprog_T *prog, colnr_T col)
   FILE        *f;
 #endif
 
-  reginput = regline + col;
+  rex->reginput = rex->regline + col;
 
 #ifdef REGEXP_DEBUG
   f = fopen(NFA_REGEXP_RUN_LOG, "a");
@@ -6054,7 +6462,7 @@ static long nfa_regtry(nfa_regprog_T *prog, colnr_T col)
 #ifdef REGEXP_DEBUG
     fprintf(f, "\tRegexp is \"%s\"\n", nfa_regengine.expr);
 #endif
-    fprintf(f, "\tInput text is \"%s\" \n", reginput);
+    fprintf(f, "\tInput text is \"%s\" \n", rex->reginput);
     fprintf(f, "\t=======================================================\n\n");
     nfa_print_state(f, start);
     fprintf(f, "\n\n");
@@ -6074,31 +6482,31 @@ static long nfa_regtry(nfa_regprog_T *prog, colnr_T col)
   cleanup_subexpr();
   if (REG_MULTI) {
     for (i = 0; i < subs.norm.in_use; i++) {
-      reg_startpos[i] = subs.norm.list.multi[i].start;
-      reg_endpos[i] = subs.norm.list.multi[i].end;
+      rex->reg_startpos[i] = subs.norm.list.multi[i].start;
+      rex->reg_endpos[i] = subs.norm.list.multi[i].end;
     }
 
-    if (reg_startpos[0].lnum < 0) {
-      reg_startpos[0].lnum = 0;
-      reg_startpos[0].col = col;
+    if (rex->reg_startpos[0].lnum < 0) {
+      rex->reg_startpos[0].lnum = 0;
+      rex->reg_startpos[0].col = col;
     }
-    if (reg_endpos[0].lnum < 0) {
+    if (rex->reg_endpos[0].lnum < 0) {
       /* pattern has a \ze but it didn't match, use current end */
-      reg_endpos[0].lnum = reglnum;
-      reg_endpos[0].col = (int)(reginput - regline);
+      rex->reg_endpos[0].lnum = rex->reglnum;
+      rex->reg_endpos[0].col = (int)(rex->reginput - rex->regline);
     } else
       /* Use line number of "\ze". */
-      reglnum = reg_endpos[0].lnum;
+      rex->reglnum = rex->reg_endpos[0].lnum;
   } else {
     for (i = 0; i < subs.norm.in_use; i++) {
-      reg_startp[i] = subs.norm.list.line[i].start;
-      reg_endp[i] = subs.norm.list.line[i].end;
+      rex->reg_startp[i] = subs.norm.list.line[i].start;
+      rex->reg_endp[i] = subs.norm.list.line[i].end;
     }
 
-    if (reg_startp[0] == NULL)
-      reg_startp[0] = regline + col;
-    if (reg_endp[0] == NULL)
-      reg_endp[0] = reginput;
+    if (rex->reg_startp[0] == NULL)
+      rex->reg_startp[0] = rex->regline + col;
+    if (rex->reg_endp[0] == NULL)
+      rex->reg_endp[0] = rex->reginput;
   }
 
   /* Package any found \z(...\) matches for export. Default is none. */
@@ -6131,7 +6539,7 @@ static long nfa_regtry(nfa_regprog_T *prog, colnr_T col)
     }
   }
 
-  return 1 + reglnum;
+  return 1 + rex->reglnum;
 }
 
 /*
@@ -6152,40 +6560,40 @@ nfa_regexec_both (
   colnr_T col = startcol;
 
   if (REG_MULTI) {
-    prog = (nfa_regprog_T *)reg_mmatch->regprog;
+    prog = (nfa_regprog_T *)rex->reg_mmatch->regprog;
     line = reg_getline((linenr_T)0);        /* relative to the cursor */
-    reg_startpos = reg_mmatch->startpos;
-    reg_endpos = reg_mmatch->endpos;
+    rex->reg_startpos = rex->reg_mmatch->startpos;
+    rex->reg_endpos = rex->reg_mmatch->endpos;
   } else {
-    prog = (nfa_regprog_T *)reg_match->regprog;
-    reg_startp = reg_match->startp;
-    reg_endp = reg_match->endp;
+    prog = (nfa_regprog_T *)rex->reg_match->regprog;
+    rex->reg_startp = rex->reg_match->startp;
+    rex->reg_endp = rex->reg_match->endp;
   }
 
   /* Be paranoid... */
   if (prog == NULL || line == NULL) {
-    EMSG(_(e_null));
+    REG_EMSG(_(e_null));
     goto theend;
   }
 
   /* If pattern contains "\c" or "\C": overrule value of ireg_ic */
   if (prog->regflags & RF_ICASE)
-    ireg_ic = TRUE;
+    rex->ireg_ic = TRUE;
   else if (prog->regflags & RF_NOICASE)
-    ireg_ic = FALSE;
+    rex->ireg_ic = FALSE;
 
   /* If pattern contains "\Z" overrule value of ireg_icombine */
   if (prog->regflags & RF_ICOMBINE)
-    ireg_icombine = TRUE;
+    rex->ireg_icombine = TRUE;
 
-  regline = line;
-  reglnum = 0;      /* relative to line */
+  rex->regline = line;
+  rex->reglnum = 0;      /* relative to line */
 
-  nfa_has_zend = prog->has_zend;
-  nfa_has_backref = prog->has_backref;
-  nfa_nsubexpr = prog->nsubexp;
-  nfa_listid = 1;
-  nfa_alt_listid = 2;
+  rex->nfa_has_zend = prog->has_zend;
+  rex->nfa_has_backref = prog->has_backref;
+  rex->nfa_nsubexpr = prog->nsubexp;
+  rex->nfa_listid = 1;
+  rex->nfa_alt_listid = 2;
 #ifdef REGEXP_DEBUG
   nfa_regengine.expr = prog->pattern;
 #endif
@@ -6193,13 +6601,18 @@ nfa_regexec_both (
   if (prog->reganch && col > 0)
     return 0L;
 
-  need_clear_subexpr = TRUE;
+  /* Skip the line when it doesn't contain any of the literals that must be
+   * in a match.  Composing characters between them are skipped with "\Z". */
+  if (!rex->ireg_icombine && nfa_literals_reject(prog, line, col, rex->ireg_ic))
+    return 0L;
+
+  rex->need_clear_subexpr = TRUE;
   /* Clear the external match subpointers if necessary. */
   if (prog->reghasz == REX_SET) {
-    nfa_has_zsubexpr = TRUE;
-    need_clear_zsubexpr = TRUE;
+    rex->nfa_has_zsubexpr = TRUE;
+    rex->need_clear_zsubexpr = TRUE;
   } else
-    nfa_has_zsubexpr = FALSE;
+    rex->nfa_has_zsubexpr = FALSE;
 
   if (prog->regstart != NUL) {
     /* Skip ahead until a character we know the match must start with.
@@ -6210,17 +6623,17 @@ nfa_regexec_both (
     /* If match_text is set it contains the full text that must match.
      * Nothing else to try. Doesn't handle combining chars well. */
     if (prog->match_text != NULL
-        && !ireg_icombine
+        && !rex->ireg_icombine
         )
       return find_match_text(col, prog->regstart, prog->match_text);
   }
 
   /* If the start column is past the maximum column: no need to try. */
-  if (ireg_maxcol > 0 && col >= ireg_maxcol)
+  if (rex->ireg_maxcol > 0 && col >= rex->ireg_maxcol)
     goto theend;
 
-  nstate = prog->nstate;
-  for (i = 0; i < nstate; ++i) {
+  rex->nfa_nstate = prog->nstate;
+  for (i = 0; i < rex->nfa_nstate; ++i) {
     prog->state[i].id = i;
     prog->state[i].lastlist[0] = 0;
     prog->state[i].lastlist[1] = 0;
@@ -6318,6 +6731,7 @@ static regprog_T *nfa_regcomp(char_u *expr, int re_flags)
   prog->reganch = nfa_get_reganch(prog->start, 0);
   prog->regstart = nfa_get_regstart(prog->start, 0);
   prog->match_text = nfa_get_match_text(prog->start);
+  prog->literals = nfa_get_literals(postfix, post_ptr);
 
 #ifdef REGEXP_DEBUG
   nfa_postfix_dump(expr, OK);
@@ -6355,6 +6769,7 @@ static void nfa_regfree(regprog_T *prog)
 {
   if (prog != NULL) {
     free(((nfa_regprog_T *)prog)->match_text);
+    free(((nfa_regprog_T *)prog)->literals);
 #ifdef REGEXP_DEBUG
     free(((nfa_regprog_T *)prog)->pattern);
 #endif
@@ -6378,15 +6793,15 @@ nfa_regexec_nl (
     bool line_lbr
 )
 {
-  reg_match = rmp;
-  reg_mmatch = NULL;
-  reg_maxline = 0;
-  reg_line_lbr = line_lbr;
-  reg_buf = curbuf;
-  reg_win = NULL;
-  ireg_ic = rmp->rm_ic;
-  ireg_icombine = FALSE;
-  ireg_maxcol = 0;
+  rex->reg_match = rmp;
+  rex->reg_mmatch = NULL;
+  rex->reg_maxline = 0;
+  rex->reg_line_lbr = line_lbr;
+  rex->reg_buf = REG_STRING_BUF;
+  rex->reg_win = NULL;
+  rex->ireg_ic = rmp->rm_ic;
+  rex->ireg_icombine = FALSE;
+  rex->ireg_maxcol = 0;
   return nfa_regexec_both(line, col);
 }
 
@@ -6427,16 +6842,16 @@ nfa_regexec_nl (
 static long nfa_regexec_multi(regmmatch_T *rmp, win_T *win, buf_T *buf,
                               linenr_T lnum, colnr_T col, proftime_T *tm)
 {
-  reg_match = NULL;
-  reg_mmatch = rmp;
-  reg_buf = buf;
-  reg_win = win;
-  reg_firstlnum = lnum;
-  reg_maxline = reg_buf->b_ml.ml_line_count - lnum;
-  reg_line_lbr = FALSE;
-  ireg_ic = rmp->rmm_ic;
-  ireg_icombine = FALSE;
-  ireg_maxcol = rmp->rmm_maxcol;
+  rex->reg_match = NULL;
+  rex->reg_mmatch = rmp;
+  rex->reg_buf = buf;
+  rex->reg_win = win;
+  rex->reg_firstlnum = lnum;
+  rex->reg_maxline = rex->reg_buf->b_ml.ml_line_count - lnum;
+  rex->reg_line_lbr = FALSE;
+  rex->ireg_ic = rmp->rmm_ic;
+  rex->ireg_icombine = FALSE;
+  rex->ireg_maxcol = rmp->rmm_maxcol;
 
   return nfa_regexec_both(NULL, col);
 }
@@ -119,6 +119,7 @@
 #include "nvim/misc1.h"
 #include "nvim/misc2.h"
 #include "nvim/garray.h"
+#include "nvim/inputtrace.h"
 #include "nvim/move.h"
 #include "nvim/normal.h"
 #include "nvim/option.h"
@@ -148,6 +149,9 @@ static int screen_attr = 0;
 
 static match_T search_hl;       /* used for 'hlsearch' highlight matching */
 
+/* Maximum number of lines in the 'hlsearch' cache of a buffer. */
+#define HLCACHE_MAXLINES 4096
+
 static foldinfo_T win_foldinfo; /* info for 'foldcolumn' */
 
 /*
@@ -304,6 +308,7 @@ void update_screen(int type)
     return;
   }
 
+  INPUTTRACE(kTraceRedrawStart, type);
   updating_screen = TRUE;
   ++display_tick;           /* let syntax code know we're in a next round of
                              * display updating */
@@ -451,6 +456,7 @@ void update_screen(int type)
     maybe_intro_message();
   did_intro = TRUE;
 
+  INPUTTRACE(kTraceRedrawEnd, type);
 }
 
 /*
@@ -2120,6 +2126,7 @@ win_line (
   int nextlinecol = 0;                  /* column where nextline[] starts */
   int nextline_idx = 0;                 /* index in nextline[] where next line
                                            starts */
+  spell_line_T *spell_line = NULL;      /* cached spell results for "line" */
   int spell_attr = 0;                   /* attributes desired by spelling */
   int word_end = 0;                     /* last byte with same spell_attr */
   static linenr_T checked_lnum = 0;     /* line number for "checked_col" */
@@ -2199,13 +2206,15 @@ win_line (
      * error, stop syntax highlighting. */
     save_did_emsg = did_emsg;
     did_emsg = FALSE;
-    syntax_start(wp, lnum);
+    int ready = syntax_start_redraw(wp, lnum);
     if (did_emsg)
       wp->w_s->b_syn_error = TRUE;
     else {
       did_emsg = save_did_emsg;
-      has_syntax = TRUE;
-      extra_check = TRUE;
+      if (ready) {
+        has_syntax = TRUE;
+        extra_check = TRUE;
+      }
     }
   }
 
@@ -3242,8 +3251,16 @@ win_line (
             else
               p = prev_ptr;
             cap_col -= (int)(prev_ptr - line);
-            len = spell_check(wp, p, &spell_hlf, &cap_col,
-                nochange);
+            if (p == prev_ptr) {
+              /* Within the line the results only depend on the line
+               * text, remember them for when it is drawn again. */
+              if (spell_line == NULL)
+                spell_line = spell_cache_line(wp, line);
+              len = spell_check_line(wp, spell_line, line, p, &spell_hlf,
+                  &cap_col, nochange);
+            } else
+              len = spell_check(wp, p, &spell_hlf, &cap_col,
+                  nochange);
             word_end = v + len;
 
             /* In Insert mode only highlight a word that
@@ -5512,14 +5529,20 @@ next_search_hl (
       matchcol = shl->rm.endpos[0].col;
 
     shl->lnum = lnum;
-    if (shl->rm.regprog != NULL) {
+    /* The results for 'hlsearch' are kept with the buffer. */
+    hlcache_T *hc = shl == &search_hl ? hlcache_get(shl->buf, &shl->rm)
+                                      : NULL;
+
+    if (hc != NULL
+        && hlcache_lookup(hc, lnum, matchcol, &shl->rm, &nmatched)) {
+      /* found in the cache */
+    } else if (shl->rm.regprog != NULL) {
       /* Remember whether shl->rm is using a copy of the regprog in
        * cur->match. */
       bool regprog_is_copy = (shl != &search_hl
                               && cur != NULL
                               && shl == &cur->hl
                               && cur->match.regprog == cur->hl.rm.regprog);
-
       nmatched = vim_regexec_multi(&shl->rm, win, shl->buf, lnum, matchcol, &(shl->tm));
       /* Copy the regprog, in case it got freed and recompiled. */
       if (regprog_is_copy) {
@@ -5537,6 +5560,11 @@ next_search_hl (
         got_int = FALSE; // avoid the "Type :quit to exit Vim" message
         break;
       }
+      /* A search cut short by the time limit is not a result. */
+      if (hc != NULL && hc->prog == shl->rm.regprog
+          && !profile_passed_limit(shl->tm)) {
+        hlcache_store(hc, lnum, matchcol, &shl->rm, nmatched);
+      }
     } else if (cur != NULL) {
       nmatched = next_search_hl_pos(shl, lnum, &(cur->pos), matchcol);
     }
@@ -5554,6 +5582,166 @@ next_search_hl (
   }
 }
 
+/*
+ * Return the 'hlsearch' cache of "buf" if it can be used for "rm", emptying
+ * it when it was for another pattern or the buffer changed.
+ * Returns NULL when the matches of "rm" can't be cached.
+ */
+static hlcache_T *hlcache_get(buf_T *buf, regmmatch_T *rm)
+{
+  hlcache_T *hc = &buf->b_hlcache;
+
+  if (rm->regprog == NULL || !re_textonly(rm->regprog))
+    return NULL;
+  if (hc->prog != rm->regprog || hc->ic != rm->rmm_ic
+      || hc->changedtick != buf->b_changedtick
+      || STRCMP(hc->isk, buf->b_p_isk) != 0) {
+    hlcache_clear(buf);
+    vim_regref(rm->regprog);
+    hc->prog = rm->regprog;
+    hc->ic = rm->rmm_ic;
+    hc->isk = vim_strsave(buf->b_p_isk);
+    hc->changedtick = buf->b_changedtick;
+  }
+  return hc;
+}
+
+/*
+ * Find line "lnum" in "hc".  When it's not there returns NULL and sets
+ * "*idxp" to the index where it is to be inserted.
+ */
+static hlline_T *hlcache_find_line(hlcache_T *hc, linenr_T lnum, int *idxp)
+{
+  hlline_T    *lines = (hlline_T *)hc->lines.ga_data;
+  int lo = 0;
+  int hi = hc->lines.ga_len;
+
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+
+    if (lines[mid].lnum < lnum)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *idxp = lo;
+  if (lo < hc->lines.ga_len && lines[lo].lnum == lnum)
+    return &lines[lo];
+  return NULL;
+}
+
+/*
+ * Look up the result of searching line "lnum" from column "col" in "hc".
+ * When found sets the match in "rm" and "*nmatchedp" and returns TRUE.
+ */
+static int hlcache_lookup(hlcache_T *hc, linenr_T lnum, colnr_T col,
+                          regmmatch_T *rm, long *nmatchedp)
+{
+  int idx;
+  hlline_T    *line = hlcache_find_line(hc, lnum, &idx);
+
+  if (line == NULL)
+    return FALSE;
+  for (int i = 0; i < line->matches.ga_len; ++i) {
+    hlmatch_T *m = (hlmatch_T *)line->matches.ga_data + i;
+
+    if (m->col == col) {
+      rm->startpos[0] = m->startpos;
+      rm->endpos[0] = m->endpos;
+      *nmatchedp = m->nmatched;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/*
+ * Remember the result of searching line "lnum" from column "col" in "hc".
+ */
+static void hlcache_store(hlcache_T *hc, linenr_T lnum, colnr_T col,
+                          regmmatch_T *rm, long nmatched)
+{
+  int idx;
+  hlline_T    *line = hlcache_find_line(hc, lnum, &idx);
+  hlmatch_T   *m;
+
+  if (line == NULL) {
+    if (hc->lines.ga_len >= HLCACHE_MAXLINES) {
+      /* Start over, lines near the ones displayed now are more useful
+       * than the ones kept. */
+      hlcache_clear_lines(hc);
+      idx = 0;
+    }
+    ga_grow(&hc->lines, 1);
+    line = (hlline_T *)hc->lines.ga_data + idx;
+    memmove(line + 1, line, (size_t)(hc->lines.ga_len - idx) * sizeof(*line));
+    ++hc->lines.ga_len;
+    line->lnum = lnum;
+    ga_init(&line->matches, (int)sizeof(hlmatch_T), 4);
+  }
+  ga_grow(&line->matches, 1);
+  m = (hlmatch_T *)line->matches.ga_data + line->matches.ga_len++;
+  m->col = col;
+  m->nmatched = nmatched;
+  m->startpos = rm->startpos[0];
+  m->endpos = rm->endpos[0];
+}
+
+/*
+ * Remove all lines from "hc".
+ */
+static void hlcache_clear_lines(hlcache_T *hc)
+{
+  for (int i = 0; i < hc->lines.ga_len; ++i)
+    ga_clear(&((hlline_T *)hc->lines.ga_data)[i].matches);
+  ga_clear(&hc->lines);
+  ga_init(&hc->lines, (int)sizeof(hlline_T), 64);
+}
+
+/*
+ * Empty the 'hlsearch' cache of "buf" and free its memory.
+ */
+void hlcache_clear(buf_T *buf)
+{
+  hlcache_T *hc = &buf->b_hlcache;
+
+  hlcache_clear_lines(hc);
+  vim_regfree(hc->prog);
+  hc->prog = NULL;
+  free(hc->isk);
+  hc->isk = NULL;
+}
+
+/*
+ * Update the 'hlsearch' cache of "buf" for a change of lines "lnum" to
+ * "lnume" (not including), with "xtra" lines inserted below them.  See
+ * changed_lines().  "changedtick" is b_changedtick from before the change,
+ * which must have incremented it once.  Otherwise the cache is left alone
+ * and it will be emptied when used.
+ */
+void hlcache_changed(buf_T *buf, int changedtick, linenr_T lnum,
+                     linenr_T lnume, long xtra)
+{
+  hlcache_T *hc = &buf->b_hlcache;
+  hlline_T    *lines = (hlline_T *)hc->lines.ga_data;
+  int from;
+  int to;
+
+  if (hc->prog == NULL || hc->changedtick != changedtick
+      || buf->b_changedtick != changedtick + 1)
+    return;
+  (void)hlcache_find_line(hc, lnum, &from);
+  (void)hlcache_find_line(hc, lnume, &to);
+  for (int i = from; i < to; ++i)
+    ga_clear(&lines[i].matches);
+  memmove(lines + from, lines + to,
+      (size_t)(hc->lines.ga_len - to) * sizeof(*lines));
+  hc->lines.ga_len -= to - from;
+  for (int i = from; i < hc->lines.ga_len; ++i)
+    lines[i].lnum += xtra;
+  hc->changedtick = buf->b_changedtick;
+}
+
 static int
 next_search_hl_pos(
     match_T *shl,         // points to a match
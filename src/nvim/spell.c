@@ -71,6 +71,7 @@
 //                        <LWORDTREE>
 //                        <KWORDTREE>
 //                        <PREFIXTREE>
+//                        [<TREEMAP>]
 //
 // <HEADER>: <fileID> <versionnr>
 //
@@ -258,6 +259,30 @@
 // <prefcondnr> 2 bytes     Prefix condition number, index in <prefcond> list
 //                          from HEADER.
 //
+//
+// <TREEMAP>: NUL <pad> <maptree> <maptree> <maptree> <mapfooter>
+//
+// The three trees once more, as they are stored in memory after reading, so
+// that the file can be mapped into memory instead of read, see
+// spell_map_trees().  Everything uses the byte order and sizes of the
+// machine that wrote the file.  Older versions stop reading after
+// <PREFIXTREE> and ignore it.
+//
+// <pad>        N bytes     NUL bytes up to a multiple of four.
+//
+// <maptree>: <nodecount> <idxs> <byts> <pad>
+//
+// <nodecount>  4 bytes     Number of nodes.
+// <idxs>       N * 4 bytes The "idxs" array, see slang_T.
+// <byts>       N bytes     The "byts" array, see slang_T.
+//
+// <mapfooter>: <treestart> <mapstart> <mapcheck> <mapID>
+//
+// <treestart>  4 bytes     File offset of <LWORDTREE>.
+// <mapstart>   4 bytes     File offset of the first <maptree>.
+// <mapcheck>   4 bytes     SPL_MAP_CHECK, detects another byte order.
+// <mapID>      8 bytes     "VIMspmap"
+//
 // All text characters are in 'encoding', but stored as single bytes.
 
 // Vim .sug file format:  <SUGHEADER>
@@ -320,6 +345,7 @@
 #include "nvim/option.h"
 #include "nvim/os_unix.h"
 #include "nvim/path.h"
+#include "nvim/profile.h"
 #include "nvim/regexp.h"
 #include "nvim/screen.h"
 #include "nvim/search.h"
@@ -463,6 +489,9 @@ struct slang_S {
   idx_T       *sl_kidxs;        // keep-case word indexes
   char_u      *sl_pbyts;        // prefix tree word bytes
   idx_T       *sl_pidxs;        // prefix tree word indexes
+  char_u      *sl_map;          // mapped spell file the trees point into,
+                                // NULL when they were allocated
+  size_t sl_map_len;            // size of "sl_map"
 
   char_u      *sl_info;         // infotext string or NULL
 
@@ -479,6 +508,8 @@ struct slang_S {
   garray_T sl_comppat;          // CHECKCOMPOUNDPATTERN items
   regprog_T   *sl_compprog;     // COMPOUNDRULE turned into a regexp progrm
                                 // (NULL when no compounding)
+  regprog_T   **sl_compwprogs;  // copies of "sl_compprog" for each worker
+                                // thread, see sug_compile_wprogs()
   char_u      *sl_comprules;    // all COMPOUNDRULE concatenated (or NULL)
   char_u      *sl_compstartflags;   // flags for first compound word
   char_u      *sl_compallflags;   // all flags for compound words
@@ -488,6 +519,8 @@ struct slang_S {
 
   int sl_prefixcnt;             // number of items in "sl_prefprog"
   regprog_T   **sl_prefprog;    // table with regprogs for prefixes
+  regprog_T   **sl_prefwprogs;  // copies of "sl_prefprog" for each worker
+                                // thread, "sl_prefixcnt" items per worker
 
   garray_T sl_rep;              // list of fromto_T entries from REP lines
   short sl_rep_first[256];          // indexes where byte first appears, -1 if
@@ -545,6 +578,21 @@ typedef struct langp_S {
 #define VIMSPELLMAGICL 8
 #define VIMSPELLVERSION 50
 
+#define SPL_MAP_MAGIC "VIMspmap"  // string at the end of a <TREEMAP>
+#define SPL_MAP_MAGICL 8
+#define SPL_MAP_CHECK ((uint32_t)(0x01020300 + sizeof(idx_T)))
+
+// <mapfooter> at the end of a spell file with a <TREEMAP>.
+typedef struct {
+  int32_t sm_treestart;         // file offset of <LWORDTREE>
+  int32_t sm_mapstart;          // file offset of the first <maptree>
+  uint32_t sm_check;            // SPL_MAP_CHECK
+  char sm_magic[SPL_MAP_MAGICL];  // SPL_MAP_MAGIC
+} splmap_T;
+
+// Round "n" up to a multiple of four, for the alignment in <TREEMAP>.
+#define SPL_MAP_ALIGN(n) (((n) + 3) & ~(size_t)3)
+
 #define VIMSUGMAGIC "VIMsug"    // string at start of Vim .sug file
 #define VIMSUGMAGICL 6
 #define VIMSUGVERSION 1
@@ -590,6 +638,8 @@ static wordcount_T dumwc;
 #define HI2WC(hi)     ((wordcount_T *)((hi)->hi_key - WC_KEY_OFF))
 #define MAXWORDCOUNT 0xffff
 
+typedef struct sugpool_S sugpool_T;
+
 // Information used when looking for suggestions.
 typedef struct suginfo_S {
   garray_T su_ga;                   // suggestions, contains "suggest_T"
@@ -605,6 +655,12 @@ typedef struct suginfo_S {
   char_u su_sal_badword[MAXWLEN];   // su_badword soundfolded
   hashtab_T su_banned;              // table with banned words
   slang_T     *su_sallang;          // default language for sound folding
+  proftime_T su_deadline;           // stop searching at this time or zero
+  bool su_stopped;                  // stopped searching for "su_deadline"
+  sugpool_T   *su_pool;             // for a worker thread: its pool
+  int su_part;                      // for a worker thread: search only words
+                                    // starting with a byte that is "su_part"
+  int su_nparts;                    // modulo "su_nparts"; zero for all words
 } suginfo_T;
 
 // One word suggestion.  Used in "si_ga".
@@ -624,6 +680,47 @@ typedef struct {
 // True if a word appears in the list of banned words.
 #define WAS_BANNED(su, word) (!HASHITEM_EMPTY(hash_find(&su->su_banned, word)))
 
+// True if the search in "su" includes words starting with byte "c".
+#define SUG_FIRST_BYTE(su, c) \
+  ((su)->su_nparts == 0 || (c) % (su)->su_nparts == (su)->su_part)
+
+#define SUG_MAX_THREADS 8       // max nr of worker threads for suggestions
+#define SUG_PARTS_PER_THREAD 4  // parts a word tree is split in, per thread
+
+// A worker thread of a sugpool_T.
+typedef struct {
+  sugpool_T   *sw_pool;
+  suginfo_T sw_su;              // copy of the search, with its own
+                                // suggestions and banned words
+  int sw_idx;                   // index in "sl_compwprogs"
+  uv_thread_t sw_thread;
+} sugworker_T;
+
+// Worker threads that look for suggestions by changing the bad word, see
+// suggest_try_change_threaded().  Each task is a part of the word tree of one
+// language.
+struct sugpool_S {
+  char_u      *sg_fword;        // case-folded bad word, only read
+  langp_T     **sg_langs;       // languages to search
+  int sg_nparts;                // parts per language
+  int sg_ntasks;                // languages times parts
+  uv_mutex_t sg_mutex;          // protects the members below
+  uv_cond_t sg_done;            // signalled when a worker finished
+  int sg_next;                  // next task to do
+  int sg_maxscore;              // lowest "su_maxscore" of the workers
+  bool sg_cancel;               // workers must stop
+  int sg_running;               // nr of workers still busy
+  int sg_nworkers;
+  sugworker_T sg_workers[SUG_MAX_THREADS];
+};
+
+// The pool that is searching for suggestions or NULL.
+static sugpool_T *sug_pool_active = NULL;
+
+// In a worker thread of a sugpool_T: its index in "sl_compwprogs".  -1 in
+// the main thread.
+static THREAD_LOCAL int sug_worker_idx = -1;
+
 // Number of suggestions kept when cleaning up.  We need to keep more than
 // what is displayed, because when rescore_suggestions() is called the score
 // may change and wrong suggestions may be removed later.
@@ -828,6 +925,9 @@ struct affentry_S {
   char_u      *ae_flags;        // flags on the affix (can be NULL)
   char_u      *ae_cond;         // condition (NULL for ".")
   regprog_T   *ae_prog;         // regexp program for ae_cond or NULL
+  int ae_re_flags;              // flags "ae_prog" was compiled with
+  regprog_T   **ae_wprogs;      // copies of "ae_prog" for each worker thread
+                                // of a dicpool_T or NULL
   char ae_compforbid;           // COMPOUNDFORBIDFLAG found
   char ae_comppermit;           // COMPOUNDPERMITFLAG found
 };
@@ -923,6 +1023,9 @@ typedef struct spellinfo_S {
 
   sblock_T    *si_blocks;       // memory blocks used
   long si_blocks_cnt;           // memory blocks allocated
+  long si_blocks_total;         // idem, not lowered for compression
+  size_t si_pending_peak;       // max bytes used for words waiting to be
+                                // added to the trees
   int si_did_emsg;              // TRUE when ran out of memory
 
   long si_compress_cnt;         // words to add before lowering
@@ -978,6 +1081,56 @@ typedef struct spellinfo_S {
   int si_newcompID;             // current value for compound ID
 } spellinfo_T;
 
+#define DIC_MAX_THREADS 8       // max nr of threads for expanding affixes
+#define DIC_QUEUE_SIZE 1024     // max nr of .dic lines queued
+#define DIC_MAX_PENDING (16 * 1024 * 1024)  // max bytes of expanded words
+                                            // waiting to be stored
+
+// A line of a .dic file, the affixes are applied by a worker thread.
+typedef struct {
+  char_u      *dj_word;         // basic word, allocated with getroom()
+  char_u      *dj_afflist;      // allocated list of affix names or NULL
+  int dj_flags;                 // WF_ flags for the word
+  char_u dj_pfxlist[MAXWLEN];   // prefix IDs and compound flags
+  int dj_pfxlen;                // nr of prefix IDs in "dj_pfxlist"
+  bool dj_need_affix;           // only store word with affix ID
+  int dj_worker;                // worker applying the affixes
+  int dj_retval;                // OK or FAIL
+  bool dj_done;                 // affixes have been applied
+  garray_T dj_words;            // resulting words, see dic_job_add_word()
+} dicjob_T;
+
+typedef struct dicpool_S dicpool_T;
+
+// A worker thread of a dicpool_T.
+typedef struct {
+  dicpool_T   *dw_pool;
+  int dw_idx;                   // index in "ae_wprogs"
+  uv_thread_t dw_thread;
+} dicworker_T;
+
+// Worker threads that apply the affixes to the words of a .dic file.  The
+// lines are queued in file order and the resulting words are added to the
+// trees in that same order, thus the spell file does not depend on how the
+// work was divided.
+struct dicpool_S {
+  spellinfo_T *dp_spin;         // only read by the workers
+  afffile_T   *dp_affile;       // only read by the workers
+  dicjob_T    *dp_jobs;         // ring buffer of DIC_QUEUE_SIZE lines
+  int dp_nprogs;                // nr of programs in "ae_wprogs"
+  uv_mutex_t dp_mutex;          // protects the members below
+  uv_cond_t dp_work;            // signalled when a line was queued
+  uv_cond_t dp_done;            // signalled when a line was done
+  long dp_head;                 // next line to add to the trees
+  long dp_next;                 // next line to apply affixes to
+  long dp_tail;                 // next free entry
+  size_t dp_pending;            // bytes in "dj_words" of done lines
+  size_t dp_pending_peak;       // max of "dp_pending"
+  bool dp_quit;                 // workers must stop
+  int dp_nworkers;
+  dicworker_T dp_workers[DIC_MAX_THREADS];
+};
+
 static spelltab_T spelltab;
 static int did_set_spelltab;
 
@@ -997,6 +1150,40 @@ typedef struct {
   int score;
 } limitscore_T;
 
+// One remembered spell_check() result, see spell_check_line().
+typedef struct {
+  int sce_col;                  // byte offset of the checked position
+  bool sce_capin;               // "*capcol" was zero when checking
+  bool sce_counted;             // good word was counted already
+  int sce_len;                  // length returned by spell_check()
+  hlf_T sce_attr;               // highlight for a bad word or HLF_COUNT
+  int sce_capcol;               // "*capcol" set by spell_check()
+} spellentry_T;
+
+// Results of spell_check() for one text, found by the hash of that text.
+struct spell_line_S {
+  spell_line_T *sl_next;        // next text in the same hash bucket
+  uint64_t sl_hash;             // hash of the text
+  size_t sl_len;                // length of the text
+  int sl_lookup;                // entry to try first for the next lookup
+  garray_T sl_entries;          // spellentry_T items, sorted on column
+  char_u sl_text[1];            // the text, actually longer
+};
+
+#define SPELL_CACHE_BUCKETS 1024  // nr of hash buckets, power of two
+#define SPELL_CACHE_MAXLINES 8192 // clear the cache when it has more texts
+
+// Cached spell_check() results for a synblock_T, in "b_spell_cache".
+typedef struct spellcache_S {
+  int sc_gen;                   // value of "spell_cache_gen" when filled
+  int sc_count;                 // nr of texts in the cache
+  spell_line_T *sc_buckets[SPELL_CACHE_BUCKETS];
+} spellcache_T;
+
+// Incremented when a loaded language changes, to invalidate the cached
+// results of all buffers.
+static int spell_cache_gen = 0;
+
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "spell.c.generated.h"
@@ -1257,6 +1444,146 @@ spell_check (
   return (int)(mi.mi_end - ptr);
 }
 
+// Get the cached spell_check() results for "text", a NUL terminated line
+// (possibly with the start of the next line appended) that is going to be
+// checked in window "wp".  An empty record is created when the text was not
+// checked before.
+// The returned pointer is valid until the next call.
+spell_line_T *spell_cache_line(win_T *wp, char_u *text)
+{
+  synblock_T *synblock = wp->w_s;
+  spellcache_T *sc = synblock->b_spell_cache;
+
+  if (sc != NULL && (sc->sc_gen != spell_cache_gen
+                     || sc->sc_count >= SPELL_CACHE_MAXLINES)) {
+    spell_cache_clear(synblock);
+    sc = NULL;
+  }
+  if (sc == NULL) {
+    sc = xcalloc(1, sizeof(spellcache_T));
+    sc->sc_gen = spell_cache_gen;
+    synblock->b_spell_cache = sc;
+  }
+
+  uint64_t hash = 14695981039346656037ULL;
+  size_t len = 0;
+  for (char_u *p = text; *p != NUL; p++, len++) {
+    hash = (hash ^ *p) * 1099511628211ULL;
+  }
+
+  spell_line_T **bucket = &sc->sc_buckets[hash & (SPELL_CACHE_BUCKETS - 1)];
+  for (spell_line_T *sl = *bucket; sl != NULL; sl = sl->sl_next) {
+    if (sl->sl_hash == hash && sl->sl_len == len
+        && memcmp(sl->sl_text, text, len) == 0) {
+      sl->sl_lookup = 0;
+      return sl;
+    }
+  }
+
+  spell_line_T *sl = xmalloc(sizeof(spell_line_T) + len);
+  memcpy(sl->sl_text, text, len + 1);
+  sl->sl_hash = hash;
+  sl->sl_len = len;
+  sl->sl_lookup = 0;
+  ga_init(&sl->sl_entries, (int)sizeof(spellentry_T), 16);
+  sl->sl_next = *bucket;
+  *bucket = sl;
+  sc->sc_count++;
+  return sl;
+}
+
+// Free the cached spell_check() results of "synblock".
+void spell_cache_clear(synblock_T *synblock)
+{
+  spellcache_T *sc = synblock->b_spell_cache;
+
+  if (sc == NULL) {
+    return;
+  }
+  for (int i = 0; i < SPELL_CACHE_BUCKETS; i++) {
+    while (sc->sc_buckets[i] != NULL) {
+      spell_line_T *sl = sc->sc_buckets[i];
+      sc->sc_buckets[i] = sl->sl_next;
+      ga_clear(&sl->sl_entries);
+      free(sl);
+    }
+  }
+  free(sc);
+  synblock->b_spell_cache = NULL;
+}
+
+// Like spell_check(), but "ptr" points into "text", for which "sl" was
+// obtained with spell_cache_line().  When the same position of the same text
+// was checked before the remembered result is used.
+// When "sl" or "capcol" is NULL this just calls spell_check().
+int spell_check_line(win_T *wp, spell_line_T *sl, char_u *text, char_u *ptr,
+                     hlf_T *attrp, int *capcol, bool docount)
+{
+  if (sl == NULL || capcol == NULL) {
+    return spell_check(wp, ptr, attrp, capcol, docount);
+  }
+
+  int col = (int)(ptr - text);
+  bool capin = *capcol == 0;
+  garray_T *gap = &sl->sl_entries;
+  spellentry_T *entries = (spellentry_T *)gap->ga_data;
+  int idx = sl->sl_lookup;
+
+  // Lookups are mostly done with increasing columns, try the entry after
+  // the previous one before searching.
+  if (idx >= gap->ga_len || entries[idx].sce_col != col
+      || entries[idx].sce_capin != capin) {
+    int lo = 0;
+    int hi = gap->ga_len;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (entries[mid].sce_col < col
+          || (entries[mid].sce_col == col && entries[mid].sce_capin < capin)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    idx = lo;
+  }
+
+  if (idx < gap->ga_len && entries[idx].sce_col == col
+      && entries[idx].sce_capin == capin
+      && (!docount || entries[idx].sce_counted)) {
+    spellentry_T *sce = &entries[idx];
+    if (sce->sce_attr != HLF_COUNT) {
+      *attrp = sce->sce_attr;
+    }
+    *capcol = sce->sce_capcol;
+    sl->sl_lookup = idx + 1;
+    return sce->sce_len;
+  }
+
+  hlf_T attr = HLF_COUNT;
+  int len = spell_check(wp, ptr, &attr, capcol, docount);
+  if (attr != HLF_COUNT) {
+    *attrp = attr;
+  }
+
+  if (idx >= gap->ga_len || entries[idx].sce_col != col
+      || entries[idx].sce_capin != capin) {
+    ga_grow(gap, 1);
+    entries = (spellentry_T *)gap->ga_data;
+    memmove(entries + idx + 1, entries + idx,
+            (size_t)(gap->ga_len - idx) * sizeof(spellentry_T));
+    gap->ga_len++;
+  }
+  spellentry_T *sce = &entries[idx];
+  sce->sce_col = col;
+  sce->sce_capin = capin;
+  sce->sce_counted = docount;
+  sce->sce_len = len;
+  sce->sce_attr = attr;
+  sce->sce_capcol = *capcol;
+  sl->sl_lookup = idx + 1;
+  return len;
+}
+
 // Check if the word at "mip->mi_word" is in the tree.
 // When "mode" is FIND_FOLDWORD check in fold-case word tree.
 // When "mode" is FIND_KEEPWORD check in keep-case word tree.
@@ -1749,7 +2076,9 @@ static bool can_compound(slang_T *slang, char_u *word, char_u *flags)
     p = uflags;
   } else
     p = flags;
-  regmatch.regprog = slang->sl_compprog;
+  // A worker thread uses its own copy of the program.
+  regmatch.regprog = sug_worker_idx < 0 ? slang->sl_compprog
+                     : slang->sl_compwprogs[sug_worker_idx];
   regmatch.rm_ic = FALSE;
   if (!vim_regexec(&regmatch, p, 0))
     return false;
@@ -1869,8 +2198,12 @@ valid_word_prefix (
 
     // Check the condition, if there is one.  The condition index is
     // stored in the two bytes above the prefix ID byte.
-    rp = slang->sl_prefprog[((unsigned)pidx >> 8) & 0xffff];
+    int cond = (int)(((unsigned)pidx >> 8) & 0xffff);
+    rp = slang->sl_prefprog[cond];
     if (rp != NULL) {
+      // A worker thread uses its own copy of the program.
+      if (sug_worker_idx >= 0)
+        rp = slang->sl_prefwprogs[sug_worker_idx * slang->sl_prefixcnt + cond];
       regmatch.regprog = rp;
       regmatch.rm_ic = FALSE;
       if (!vim_regexec(&regmatch, word, 0))
@@ -2076,6 +2409,7 @@ spell_move_to (
   int capcol = -1;
   bool found_one = false;
   bool wrapped = false;
+  spell_line_T *sl;
 
   if (no_spell_checking(wp))
     return 0;
@@ -2128,6 +2462,8 @@ spell_move_to (
       spell_cat_line(buf + STRLEN(buf),
           ml_get_buf(wp->w_buffer, lnum + 1, FALSE), MAXWLEN);
 
+    sl = spell_cache_line(wp, buf);
+
     p = buf + skip;
     endp = buf + len;
     while (p < endp) {
@@ -2141,7 +2477,7 @@ spell_move_to (
 
       // start of word
       attr = HLF_COUNT;
-      len = spell_check(wp, p, &attr, &capcol, false);
+      len = spell_check_line(wp, sl, buf, p, &attr, &capcol, false);
 
       if (attr != HLF_COUNT) {
         // We found a bad word.  Check the attribute.
@@ -2403,18 +2739,26 @@ static void slang_clear(slang_T *lp)
 {
   garray_T    *gap;
 
-  free(lp->sl_fbyts);
+  // Worker threads may be using it, see suggest_try_change_threaded().
+  assert(sug_pool_active == NULL);
+
+  if (lp->sl_map != NULL) {
+    // The trees point into the mapped file.
+    os_munmap(lp->sl_map, lp->sl_map_len);
+    lp->sl_map = NULL;
+  } else {
+    free(lp->sl_fbyts);
+    free(lp->sl_kbyts);
+    free(lp->sl_pbyts);
+    free(lp->sl_fidxs);
+    free(lp->sl_kidxs);
+    free(lp->sl_pidxs);
+  }
   lp->sl_fbyts = NULL;
-  free(lp->sl_kbyts);
   lp->sl_kbyts = NULL;
-  free(lp->sl_pbyts);
   lp->sl_pbyts = NULL;
-
-  free(lp->sl_fidxs);
   lp->sl_fidxs = NULL;
-  free(lp->sl_kidxs);
   lp->sl_kidxs = NULL;
-  free(lp->sl_pidxs);
   lp->sl_pidxs = NULL;
 
   GA_DEEP_CLEAR(&lp->sl_rep, fromto_T, free_fromto);
@@ -2699,21 +3043,30 @@ truncerr:
       goto endFAIL;
   }
 
-  // <LWORDTREE>
-  res = spell_read_tree(fd, &lp->sl_fbyts, &lp->sl_fidxs, false, 0);
-  if (res != 0)
-    goto someerror;
+  // When the file has a <TREEMAP> the trees don't need to be read.
+  if (spell_map_trees(fd, ftell(fd), lp) == OK) {
+    if (p_verbose > 2) {
+      verbose_enter();
+      smsg((char_u *)_("Mapped the word trees of \"%s\""), fname);
+      verbose_leave();
+    }
+  } else {
+    // <LWORDTREE>
+    res = spell_read_tree(fd, &lp->sl_fbyts, &lp->sl_fidxs, false, 0);
+    if (res != 0)
+      goto someerror;
 
-  // <KWORDTREE>
-  res = spell_read_tree(fd, &lp->sl_kbyts, &lp->sl_kidxs, false, 0);
-  if (res != 0)
-    goto someerror;
+    // <KWORDTREE>
+    res = spell_read_tree(fd, &lp->sl_kbyts, &lp->sl_kidxs, false, 0);
+    if (res != 0)
+      goto someerror;
 
-  // <PREFIXTREE>
-  res = spell_read_tree(fd, &lp->sl_pbyts, &lp->sl_pidxs, true,
-      lp->sl_prefixcnt);
-  if (res != 0)
-    goto someerror;
+    // <PREFIXTREE>
+    res = spell_read_tree(fd, &lp->sl_pbyts, &lp->sl_pidxs, true,
+        lp->sl_prefixcnt);
+    if (res != 0)
+      goto someerror;
+  }
 
   // For a new file link it in the list of spell files.
   if (old_lp == NULL && lang != NULL) {
@@ -3588,6 +3941,116 @@ spell_read_tree (
   return 0;
 }
 
+// Use the <TREEMAP> of spell file "fd" for the trees of "lp": map the file
+// into memory and point the byte and index arrays into it, so that the trees
+// don't need to be read and the memory is shared with other processes using
+// the same file.  "treestart" is the file offset of <LWORDTREE>.
+// Returns OK when done, FAIL when the trees must be read.
+static int spell_map_trees(FILE *fd, long treestart, slang_T *lp)
+{
+  FileInfo file_info;
+  splmap_T sm;
+
+  // A .add file is rewritten in place by "zg", which must not happen while
+  // it is mapped.
+  if (lp->sl_add || !os_fileinfo_fd(fileno(fd), &file_info)) {
+    return FAIL;
+  }
+  uint64_t size = os_fileinfo_size(&file_info);
+  if (size < sizeof(sm) || size > INT32_MAX) {
+    return FAIL;
+  }
+  char_u *map = os_mmap_fd(fileno(fd), (size_t)size);
+  if (map == NULL) {
+    return FAIL;
+  }
+
+  // <mapfooter>
+  size_t end = (size_t)size - sizeof(sm);
+  memcpy(&sm, map + end, sizeof(sm));
+  if (memcmp(sm.sm_magic, SPL_MAP_MAGIC, SPL_MAP_MAGICL) != 0
+      || sm.sm_check != SPL_MAP_CHECK
+      || sm.sm_treestart != treestart
+      || sm.sm_mapstart <= sm.sm_treestart
+      || (size_t)sm.sm_mapstart > end
+      || sm.sm_mapstart % sizeof(idx_T) != 0) {
+    os_munmap(map, (size_t)size);
+    return FAIL;
+  }
+
+  char_u **bytsp[3] = { &lp->sl_fbyts, &lp->sl_kbyts, &lp->sl_pbyts };
+  idx_T **idxsp[3] = { &lp->sl_fidxs, &lp->sl_kidxs, &lp->sl_pidxs };
+  size_t off = (size_t)sm.sm_mapstart;
+  for (int i = 0; i < 3; i++) {
+    int32_t len;                                        // <nodecount>
+    if (off > end || end - off < sizeof(len)) {
+      break;
+    }
+    memcpy(&len, map + off, sizeof(len));
+    off += sizeof(len);
+    if (len < 0 || (size_t)len * (sizeof(idx_T) + 1) > end - off) {
+      break;
+    }
+    if (len > 0) {
+      *idxsp[i] = (idx_T *)(map + off);                 // <idxs>
+      *bytsp[i] = map + off + (size_t)len * sizeof(idx_T);  // <byts>
+      if (!spell_check_map_tree(*bytsp[i], *idxsp[i], len, i == 2,
+                                lp->sl_prefixcnt)) {
+        break;
+      }
+    }
+    off += SPL_MAP_ALIGN((size_t)len * (sizeof(idx_T) + 1));
+    if (i == 2) {
+      lp->sl_map = map;
+      lp->sl_map_len = (size_t)size;
+      return OK;
+    }
+  }
+
+  // Truncated or damaged <TREEMAP>, read the trees.
+  for (int i = 0; i < 3; i++) {
+    *bytsp[i] = NULL;
+    *idxsp[i] = NULL;
+  }
+  os_munmap(map, (size_t)size);
+  return FAIL;
+}
+
+// Check the mapped tree "byts" and "idxs" with "len" nodes the way
+// read_tree_node() checks what it reads: every child index must be the start
+// of a node and in the prefix tree every <prefcondnr> must be below
+// "prefixcnt".  Otherwise a damaged file would make lookups go outside of the
+// mapping.
+static bool spell_check_map_tree(char_u *byts, idx_T *idxs, int len,
+                                 bool prefixtree, int prefixcnt)
+{
+  char_u *starts = xcalloc((size_t)len / 8 + 1, 1);
+  bool ok = true;
+
+  // Mark where the nodes start, they follow each other without gaps.
+  for (int idx = 0; idx < len; idx += byts[idx] + 1) {
+    if (byts[idx] == 0 || byts[idx] >= len - idx) {    // <siblingcount>
+      ok = false;
+      break;
+    }
+    starts[idx / 8] |= (char_u)(1 << (idx % 8));
+  }
+
+  for (int idx = 0; ok && idx < len; idx += byts[idx] + 1) {
+    for (int i = idx + 1; ok && i <= idx + byts[idx]; i++) {
+      idx_T n = idxs[i];
+      if (byts[i] != 0) {
+        ok = n >= 0 && n < len && (starts[n / 8] & (1 << (n % 8)));
+      } else if (prefixtree) {
+        ok = ((n >> 8) & 0xffff) < prefixcnt;
+      }
+    }
+  }
+
+  free(starts);
+  return ok;
+}
+
 // Read one row of siblings from the spell file and store it in the byte array
 // "byts" and index array "idxs".  Recursively read the children.
 //
@@ -3920,6 +4383,7 @@ char_u *did_set_spelllang(win_T *wp)
   // Everything is fine, store the new b_langp value.
   ga_clear(&wp->w_s->b_langp);
   wp->w_s->b_langp = ga;
+  spell_cache_clear(wp->w_s);
 
   // For each language figure out what language to use for sound folding and
   // REP items.  If the language doesn't support it itself use another one
@@ -4137,7 +4601,9 @@ void spell_free_all(void)
   // Go through all buffers and handle 'spelllang'. <VN>
   FOR_ALL_BUFFERS(buf) {
     ga_clear(&buf->b_s.b_langp);
+    spell_cache_clear(&buf->b_s);
   }
+  spell_cache_gen++;
 
   while (first_lang != NULL) {
     slang = first_lang;
@@ -4193,6 +4659,7 @@ spell_reload_one (
         // reloading failed, clear the language
         slang_clear(slang);
       redraw_all_later(SOME_VALID);
+      spell_cache_gen++;
       didit = true;
     }
   }
@@ -4773,8 +5240,8 @@ static afffile_T *spell_read_aff(spellinfo_T *spin, char_u *fname)
               sprintf((char *)buf, "^%s", items[4]);
             else
               sprintf((char *)buf, "%s$", items[4]);
-            aff_entry->ae_prog = vim_regcomp(buf,
-                RE_MAGIC + RE_STRING + RE_STRICT);
+            aff_entry->ae_re_flags = RE_MAGIC + RE_STRING + RE_STRICT;
+            aff_entry->ae_prog = vim_regcomp(buf, aff_entry->ae_re_flags);
             if (aff_entry->ae_prog == NULL)
               smsg((char_u *)_("Broken condition in %s line %d: %s"),
                   fname, lnum, items[4]);
@@ -4826,8 +5293,9 @@ static afffile_T *spell_read_aff(spellinfo_T *spin, char_u *fname)
                       sprintf((char *)buf, "^%s",
                           aff_entry->ae_cond);
                       vim_regfree(aff_entry->ae_prog);
+                      aff_entry->ae_re_flags = RE_MAGIC + RE_STRING;
                       aff_entry->ae_prog = vim_regcomp(
-                          buf, RE_MAGIC + RE_STRING);
+                          buf, aff_entry->ae_re_flags);
                     }
                   }
                 }
@@ -5390,6 +5858,7 @@ static int spell_read_dic(spellinfo_T *spin, char_u *fname, afffile_T *affile)
   char_u message[MAXLINELEN + MAXWLEN];
   int flags;
   int duplicate = 0;
+  dicpool_T   *pool;
 
   // Open the file.
   fd = mch_fopen((char *)fname, "r");
@@ -5413,6 +5882,9 @@ static int spell_read_dic(spellinfo_T *spin, char_u *fname, afffile_T *affile)
   if (!vim_isdigit(*skipwhite(line)))
     EMSG2(_("E760: No word count in %s"), fname);
 
+  // Applying the affixes is done by worker threads when possible.
+  pool = dic_pool_start(spin, affile);
+
   // Read all the lines in the file one by one.
   // The words are converted to 'encoding' here, before being added to
   // the hashtable.
@@ -5522,6 +5994,16 @@ static int spell_read_dic(spellinfo_T *spin, char_u *fname, afffile_T *affile)
         get_compflags(affile, afflist, store_afflist + pfxlen);
     }
 
+    if (pool != NULL) {
+      // Queue the line, the word is added to the word tree(s) when the
+      // affixes have been applied.
+      if (dic_pool_add(pool, dw, afflist, flags, store_afflist, pfxlen,
+              need_affix) == FAIL)
+        retval = FAIL;
+      free(pc);
+      continue;
+    }
+
     // Add the word to the word tree(s).
     if (store_word(spin, dw, flags, spin->si_region,
             store_afflist, need_affix) == FAIL)
@@ -5532,19 +6014,22 @@ static int spell_read_dic(spellinfo_T *spin, char_u *fname, afffile_T *affile)
       // Additionally do matching prefixes that combine.
       if (store_aff_word(spin, dw, afflist, affile,
               &affile->af_suff, &affile->af_pref,
-              CONDIT_SUF, flags, store_afflist, pfxlen) == FAIL)
+              CONDIT_SUF, flags, store_afflist, pfxlen, NULL) == FAIL)
         retval = FAIL;
 
       // Find all matching prefixes and add the resulting words.
       if (store_aff_word(spin, dw, afflist, affile,
               &affile->af_pref, NULL,
-              CONDIT_SUF, flags, store_afflist, pfxlen) == FAIL)
+              CONDIT_SUF, flags, store_afflist, pfxlen, NULL) == FAIL)
         retval = FAIL;
     }
 
     free(pc);
   }
 
+  if (pool != NULL && dic_pool_stop(pool, !got_int) == FAIL)
+    retval = FAIL;
+
   if (duplicate > 0)
     smsg((char_u *)_("%d duplicate word(s) in %s"), duplicate, fname);
   if (spin->si_ascii && non_ascii > 0)
@@ -5649,6 +6134,8 @@ static void get_compflags(afffile_T *affile, char_u *afflist, char_u *store_affl
 // prefixes or suffixes.
 // "xht", when not NULL, is the prefix hashtable, to be used additionally on
 // the resulting words for combining affixes.
+// "job", when not NULL, is the line of a worker thread: the resulting words
+// are put in "job" instead of the trees, see dic_job_add_word().
 //
 // Returns FAIL when out of memory.
 static int
@@ -5662,8 +6149,9 @@ store_aff_word (
     int condit,                // CONDIT_SUF et al.
     int flags,                 // flags for the word
     char_u *pfxlist,           // list of prefix IDs
-    int pfxlen                 // nr of flags in "pfxlist" for prefixes, rest
+    int pfxlen,                // nr of flags in "pfxlist" for prefixes, rest
                                // is compound flags
+    dicjob_T *job              // line of a worker thread or NULL
 )
 {
   int todo;
@@ -5707,7 +6195,8 @@ store_aff_word (
           // When a previously added affix had CIRCUMFIX this one
           // must have it too, if it had not then this one must not
           // have one either.
-          regmatch.regprog = ae->ae_prog;
+          regmatch.regprog = job == NULL || ae->ae_prog == NULL
+                             ? ae->ae_prog : ae->ae_wprogs[job->dj_worker];
           regmatch.rm_ic = FALSE;
           if ((xht != NULL || !affile->af_pfxpostpone
                || ae->ae_chop != NULL
@@ -5853,9 +6342,12 @@ store_aff_word (
             }
 
             // Store the modified word.
-            if (store_word(spin, newword, use_flags,
-                    spin->si_region, use_pfxlist,
-                    need_affix) == FAIL)
+            if (job != NULL)
+              dic_job_add_word(job, newword, use_flags, use_pfxlist,
+                  need_affix);
+            else if (store_word(spin, newword, use_flags,
+                         spin->si_region, use_pfxlist,
+                         need_affix) == FAIL)
               retval = FAIL;
 
             // When added a prefix or a first suffix and the affix
@@ -5865,7 +6357,7 @@ store_aff_word (
                       affile, &affile->af_suff, xht,
                       use_condit & (xht == NULL
                                     ? ~0 :  ~CONDIT_SUF),
-                      use_flags, use_pfxlist, pfxlen) == FAIL)
+                      use_flags, use_pfxlist, pfxlen, job) == FAIL)
                 retval = FAIL;
 
             // When added a suffix and combining is allowed also
@@ -5876,13 +6368,13 @@ store_aff_word (
                       afflist, affile,
                       xht, NULL, use_condit,
                       use_flags, use_pfxlist,
-                      pfxlen) == FAIL
+                      pfxlen, job) == FAIL
                   || (ae->ae_flags != NULL
                       && store_aff_word(spin, newword,
                           ae->ae_flags, affile,
                           xht, NULL, use_condit,
                           use_flags, use_pfxlist,
-                          pfxlen) == FAIL))
+                          pfxlen, job) == FAIL))
                 retval = FAIL;
             }
           }
@@ -5894,6 +6386,310 @@ store_aff_word (
   return retval;
 }
 
+// Start worker threads for applying the affixes of "affile" to the words of
+// a .dic file.
+// Returns NULL when not using threads.
+static dicpool_T *dic_pool_start(spellinfo_T *spin, afffile_T *affile)
+{
+  if (affile->af_pref.ht_used == 0 && affile->af_suff.ht_used == 0)
+    return NULL;
+  int nworkers = spell_nthreads(DIC_MAX_THREADS);
+  if (nworkers < 2)
+    return NULL;
+
+  // Each worker needs its own regexp programs for the conditions.
+  if (!dic_compile_wprogs(affile, nworkers)) {
+    dic_free_wprogs(affile, nworkers);
+    return NULL;
+  }
+
+  dicpool_T *pool = xcalloc(1, sizeof(dicpool_T));
+  pool->dp_spin = spin;
+  pool->dp_affile = affile;
+  pool->dp_nprogs = nworkers;
+  pool->dp_jobs = xcalloc(DIC_QUEUE_SIZE, sizeof(dicjob_T));
+  uv_mutex_init(&pool->dp_mutex);
+  uv_cond_init(&pool->dp_work);
+  uv_cond_init(&pool->dp_done);
+  for (int i = 0; i < nworkers; i++) {
+    dicworker_T *worker = &pool->dp_workers[pool->dp_nworkers];
+
+    worker->dw_pool = pool;
+    worker->dw_idx = pool->dp_nworkers;
+    if (uv_thread_create(&worker->dw_thread, dic_worker, worker) != 0)
+      break;
+    pool->dp_nworkers++;
+  }
+
+  if (pool->dp_nworkers == 0) {
+    dic_pool_stop(pool, false);
+    return NULL;
+  }
+  return pool;
+}
+
+// Compile a copy of the condition of each affix entry for "nworkers" worker
+// threads.
+// Returns false when this failed.
+static bool dic_compile_wprogs(afffile_T *affile, int nworkers)
+{
+  hashtab_T *hts[2] = { &affile->af_pref, &affile->af_suff };
+  char_u buf[MAXLINELEN];
+
+  for (int k = 0; k < 2; k++) {
+    int todo = (int)hts[k]->ht_used;
+    for (hashitem_T *hi = hts[k]->ht_array; todo > 0; hi++) {
+      if (HASHITEM_EMPTY(hi))
+        continue;
+      todo--;
+      for (affentry_T *ae = HI2AH(hi)->ah_first; ae != NULL;
+           ae = ae->ae_next) {
+        if (ae->ae_prog == NULL)
+          continue;
+        if (ae->ae_cond == NULL)
+          return false;
+        vim_snprintf((char *)buf, MAXLINELEN, k == 0 ? "^%s" : "%s$",
+            ae->ae_cond);
+        ae->ae_wprogs = xcalloc((size_t)nworkers, sizeof(regprog_T *));
+        for (int i = 0; i < nworkers; i++) {
+          ae->ae_wprogs[i] = vim_regcomp(buf, ae->ae_re_flags + RE_PRIVATE);
+          if (ae->ae_wprogs[i] == NULL)
+            return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Free the programs compiled by dic_compile_wprogs().
+static void dic_free_wprogs(afffile_T *affile, int nworkers)
+{
+  hashtab_T *hts[2] = { &affile->af_pref, &affile->af_suff };
+
+  for (int k = 0; k < 2; k++) {
+    int todo = (int)hts[k]->ht_used;
+    for (hashitem_T *hi = hts[k]->ht_array; todo > 0; hi++) {
+      if (HASHITEM_EMPTY(hi))
+        continue;
+      todo--;
+      for (affentry_T *ae = HI2AH(hi)->ah_first; ae != NULL;
+           ae = ae->ae_next) {
+        if (ae->ae_wprogs != NULL) {
+          for (int i = 0; i < nworkers; i++)
+            vim_regfree(ae->ae_wprogs[i]);
+          free(ae->ae_wprogs);
+          ae->ae_wprogs = NULL;
+        }
+      }
+    }
+  }
+}
+
+// Queue a line of a .dic file for the worker threads.  Adds the words of
+// lines that are done to the trees first, waits when the queue is full.
+// Returns FAIL when adding a word failed.
+static int dic_pool_add(dicpool_T *pool, char_u *word, char_u *afflist,
+                        int flags, char_u *pfxlist, int pfxlen,
+                        bool need_affix)
+{
+  int retval = dic_pool_store(pool, false);
+
+  // The free entry is not used by the workers.
+  dicjob_T *job = &pool->dp_jobs[pool->dp_tail % DIC_QUEUE_SIZE];
+  job->dj_word = word;
+  job->dj_afflist = afflist == NULL ? NULL : vim_strsave(afflist);
+  job->dj_flags = flags;
+  STRLCPY(job->dj_pfxlist, pfxlist, MAXWLEN);
+  job->dj_pfxlen = pfxlen;
+  job->dj_need_affix = need_affix;
+  job->dj_retval = OK;
+  job->dj_done = false;
+  ga_init(&job->dj_words, 1, 256);
+
+  uv_mutex_lock(&pool->dp_mutex);
+  pool->dp_tail++;
+  uv_cond_signal(&pool->dp_work);
+  uv_mutex_unlock(&pool->dp_mutex);
+  return retval;
+}
+
+// Add the words of the lines at the head of the queue that are done to the
+// trees.  Then wait until there is room for another line, or, when "all" is
+// true, until all lines have been added.
+// Returns FAIL when adding a word failed.
+static int dic_pool_store(dicpool_T *pool, bool all)
+{
+  int retval = OK;
+
+  uv_mutex_lock(&pool->dp_mutex);
+  for (;;) {
+    while (pool->dp_head < pool->dp_tail
+           && pool->dp_jobs[pool->dp_head % DIC_QUEUE_SIZE].dj_done) {
+      dicjob_T *job = &pool->dp_jobs[pool->dp_head % DIC_QUEUE_SIZE];
+
+      // A line that is done is not used by the workers.
+      uv_mutex_unlock(&pool->dp_mutex);
+      if (dic_job_store(pool->dp_spin, job) == FAIL)
+        retval = FAIL;
+      size_t len = (size_t)job->dj_words.ga_len;
+      ga_clear(&job->dj_words);
+      free(job->dj_afflist);
+      job->dj_afflist = NULL;
+      uv_mutex_lock(&pool->dp_mutex);
+      pool->dp_pending -= len;
+      pool->dp_head++;
+    }
+    if (all ? pool->dp_head == pool->dp_tail
+        : (pool->dp_tail - pool->dp_head < DIC_QUEUE_SIZE
+           && pool->dp_pending < DIC_MAX_PENDING))
+      break;
+    uv_cond_wait(&pool->dp_done, &pool->dp_mutex);
+  }
+  uv_mutex_unlock(&pool->dp_mutex);
+  return retval;
+}
+
+// Stop the worker threads of "pool" and free it.  When "store" is true the
+// queued lines are added to the trees first, otherwise they are dropped.
+// Returns FAIL when adding a word failed.
+static int dic_pool_stop(dicpool_T *pool, bool store)
+{
+  int retval = OK;
+
+  if (store)
+    retval = dic_pool_store(pool, true);
+
+  uv_mutex_lock(&pool->dp_mutex);
+  pool->dp_quit = true;
+  uv_cond_broadcast(&pool->dp_work);
+  uv_mutex_unlock(&pool->dp_mutex);
+  for (int i = 0; i < pool->dp_nworkers; i++)
+    uv_thread_join(&pool->dp_workers[i].dw_thread);
+
+  for (; pool->dp_head < pool->dp_tail; pool->dp_head++) {
+    dicjob_T *job = &pool->dp_jobs[pool->dp_head % DIC_QUEUE_SIZE];
+    ga_clear(&job->dj_words);
+    free(job->dj_afflist);
+  }
+
+  spellinfo_T *spin = pool->dp_spin;
+  size_t used = sizeof(dicpool_T) + DIC_QUEUE_SIZE * sizeof(dicjob_T)
+                + pool->dp_pending_peak;
+  if (spin->si_pending_peak < used)
+    spin->si_pending_peak = used;
+
+  dic_free_wprogs(pool->dp_affile, pool->dp_nprogs);
+  uv_cond_destroy(&pool->dp_done);
+  uv_cond_destroy(&pool->dp_work);
+  uv_mutex_destroy(&pool->dp_mutex);
+  free(pool->dp_jobs);
+  free(pool);
+  return retval;
+}
+
+// A worker thread of a dicpool_T: applies the affixes to queued lines until
+// told to quit.
+static void dic_worker(void *arg)
+{
+  dicworker_T *worker = arg;
+  dicpool_T *pool = worker->dw_pool;
+  afffile_T *affile = pool->dp_affile;
+
+  regexec_thread_init(NULL);
+  uv_mutex_lock(&pool->dp_mutex);
+  for (;;) {
+    while (pool->dp_next == pool->dp_tail && !pool->dp_quit)
+      uv_cond_wait(&pool->dp_work, &pool->dp_mutex);
+    if (pool->dp_quit)
+      break;
+    dicjob_T *job = &pool->dp_jobs[pool->dp_next++ % DIC_QUEUE_SIZE];
+    uv_mutex_unlock(&pool->dp_mutex);
+
+    if (job->dj_afflist != NULL) {
+      job->dj_worker = worker->dw_idx;
+
+      // Find all matching suffixes, additionally do matching prefixes that
+      // combine.  Then find all matching prefixes.
+      if (store_aff_word(pool->dp_spin, job->dj_word, job->dj_afflist,
+              affile, &affile->af_suff, &affile->af_pref, CONDIT_SUF,
+              job->dj_flags, job->dj_pfxlist, job->dj_pfxlen, job) == FAIL
+          || store_aff_word(pool->dp_spin, job->dj_word, job->dj_afflist,
+              affile, &affile->af_pref, NULL, CONDIT_SUF,
+              job->dj_flags, job->dj_pfxlist, job->dj_pfxlen, job) == FAIL)
+        job->dj_retval = FAIL;
+    }
+
+    uv_mutex_lock(&pool->dp_mutex);
+    job->dj_done = true;
+    pool->dp_pending += (size_t)job->dj_words.ga_len;
+    if (pool->dp_pending_peak < pool->dp_pending)
+      pool->dp_pending_peak = pool->dp_pending;
+    uv_cond_signal(&pool->dp_done);
+  }
+  uv_mutex_unlock(&pool->dp_mutex);
+  regexec_thread_free();
+}
+
+// Remember a word with affixes for the line "job".  Each word is stored in
+// "dj_words" as: the flags, the "need_affix" byte, a byte that is one when
+// there is a prefix list, the NUL terminated word and the NUL terminated
+// prefix list, if there is one.
+static void dic_job_add_word(dicjob_T *job, char_u *word, int flags,
+                             char_u *pfxlist, bool need_affix)
+{
+  garray_T *gap = &job->dj_words;
+  size_t wlen = STRLEN(word) + 1;
+  size_t plen = pfxlist == NULL ? 0 : STRLEN(pfxlist) + 1;
+
+  ga_grow(gap, (int)(sizeof(int) + 2 + wlen + plen));
+  char_u *p = (char_u *)gap->ga_data + gap->ga_len;
+  memcpy(p, &flags, sizeof(int));
+  p += sizeof(int);
+  *p++ = need_affix;
+  *p++ = pfxlist != NULL;
+  memcpy(p, word, wlen);
+  p += wlen;
+  if (pfxlist != NULL)
+    memcpy(p, pfxlist, plen);
+  gap->ga_len += (int)(sizeof(int) + 2 + wlen + plen);
+}
+
+// Add the word of the line "job" and the words with affixes to the trees, in
+// the order they would have been added without worker threads.
+// Returns FAIL when adding a word failed.
+static int dic_job_store(spellinfo_T *spin, dicjob_T *job)
+{
+  int retval = job->dj_retval;
+
+  if (store_word(spin, job->dj_word, job->dj_flags, spin->si_region,
+          job->dj_pfxlist, job->dj_need_affix) == FAIL)
+    retval = FAIL;
+
+  char_u *p = job->dj_words.ga_data;
+  char_u *end = p + job->dj_words.ga_len;
+  while (p < end) {
+    int flags;
+    memcpy(&flags, p, sizeof(int));
+    p += sizeof(int);
+    bool need_affix = *p++;
+    bool has_pfxlist = *p++;
+    char_u *word = p;
+    p += STRLEN(p) + 1;
+    char_u *pfxlist = NULL;
+    if (has_pfxlist) {
+      pfxlist = p;
+      p += STRLEN(p) + 1;
+    }
+    if (store_word(spin, word, flags, spin->si_region, pfxlist,
+            need_affix) == FAIL) {
+      retval = FAIL;
+      break;
+    }
+  }
+  return retval;
+}
+
 // Read a file with a list of words.
 static int spell_read_wordfile(spellinfo_T *spin, char_u *fname)
 {
@@ -6095,6 +6891,7 @@ static void *getroom(spellinfo_T *spin, size_t len, bool align)
     spin->si_blocks = bl;
     bl->sb_used = 0;
     ++spin->si_blocks_cnt;
+    ++spin->si_blocks_total;
   }
 
   p = bl->sb_data + bl->sb_used;
@@ -6597,6 +7394,13 @@ static int write_vim_spell(spellinfo_T *spin, char_u *fname)
 {
   int retval = OK;
   int regionmask;
+  bool add_file = strstr((char *)path_tail(fname), SPL_FNAME_ADD) != NULL;
+
+  // Another process may have mapped the file, see spell_map_trees().
+  // Truncating it would pull the trees from under its feet, create a new
+  // file instead.
+  if (!add_file)
+    os_remove((char *)fname);
 
   FILE *fd = mch_fopen((char *)fname, "w");
   if (fd == NULL) {
@@ -6909,6 +7713,8 @@ static int write_vim_spell(spellinfo_T *spin, char_u *fname)
 
 
   // <LWORDTREE>  <KWORDTREE>  <PREFIXTREE>
+  long treestart = ftell(fd);
+  int nodecounts[3];
   spin->si_memtot = 0;
   for (unsigned int round = 1; round <= 3; ++round) {
     wordnode_T *tree;
@@ -6931,6 +7737,7 @@ static int write_vim_spell(spellinfo_T *spin, char_u *fname)
     put_bytes(fd, nodecount, 4);                        // <nodecount>
     assert(nodecount + nodecount * sizeof(int) < INT_MAX);
     spin->si_memtot += (int)(nodecount + nodecount * sizeof(int));
+    nodecounts[round - 1] = (int)nodecount;
 
     // Write the nodes.
     (void)put_node(fd, tree, 0, regionmask, round == 3);
@@ -6939,6 +7746,12 @@ static int write_vim_spell(spellinfo_T *spin, char_u *fname)
   // Write another byte to check for errors (file system full).
   if (putc(0, fd) == EOF)
     retval = FAIL;
+
+  // <TREEMAP>, not for a .add file, it is never mapped.
+  if (retval == OK && fwv == (size_t)1 && !add_file
+      && !put_tree_map(fd, fname, treestart, nodecounts,
+                       spin->si_prefcond.ga_len))
+    retval = FAIL;
 theend:
   if (fclose(fd) == EOF)
     retval = FAIL;
@@ -6951,6 +7764,76 @@ theend:
   return retval;
 }
 
+// Write the <TREEMAP> of spell file "fname", which is being written with
+// "fd": read back the trees that start at file offset "treestart" and have
+// "nodecounts" nodes, and write them the way they are stored in memory.
+// Returns false for a write error.
+static bool put_tree_map(FILE *fd, char_u *fname, long treestart,
+                         int *nodecounts, int prefixcnt)
+{
+  char_u *byts[3] = { NULL, NULL, NULL };
+  idx_T *idxs[3] = { NULL, NULL, NULL };
+  bool ok = true;
+
+  if (fflush(fd) != 0) {
+    return false;
+  }
+  long mapstart = ftell(fd);
+  FILE *rfd = mch_fopen((char *)fname, "r");
+  if (rfd == NULL || treestart < 0 || mapstart < 0 || mapstart > INT32_MAX
+      || fseek(rfd, treestart, SEEK_SET) != 0) {
+    // Can't read it back, the file just can't be mapped.
+    goto theend;
+  }
+  for (int i = 0; i < 3; i++) {
+    if (get4c(rfd) != nodecounts[i]
+        || fseek(rfd, -4L, SEEK_CUR) != 0
+        || spell_read_tree(rfd, &byts[i], &idxs[i], i == 2, prefixcnt) != 0) {
+      goto theend;
+    }
+  }
+
+  for (; mapstart % 4 != 0; mapstart++) {
+    if (putc(0, fd) == EOF) {                           // <pad>
+      ok = false;
+      goto theend;
+    }
+  }
+  splmap_T sm = {
+    .sm_treestart = (int32_t)treestart,
+    .sm_mapstart = (int32_t)mapstart,
+    .sm_check = SPL_MAP_CHECK,
+  };
+  memcpy(sm.sm_magic, SPL_MAP_MAGIC, SPL_MAP_MAGICL);
+
+  for (int i = 0; i < 3 && ok; i++) {
+    int32_t len = nodecounts[i];
+    size_t size = (size_t)len * (sizeof(idx_T) + 1);
+    ok = fwrite(&len, sizeof(len), 1, fd) == 1          // <nodecount>
+         && (len == 0
+             || (fwrite(idxs[i], sizeof(idx_T), (size_t)len, fd)  // <idxs>
+                 == (size_t)len
+                 && fwrite(byts[i], 1, (size_t)len, fd)  // <byts>
+                 == (size_t)len));
+    for (; ok && size % 4 != 0; size++) {
+      ok = putc(0, fd) != EOF;                          // <pad>
+    }
+  }
+  if (ok) {
+    ok = fwrite(&sm, sizeof(sm), 1, fd) == 1;           // <mapfooter>
+  }
+
+theend:
+  if (rfd != NULL) {
+    fclose(rfd);
+  }
+  for (int i = 0; i < 3; i++) {
+    free(byts[i]);
+    free(idxs[i]);
+  }
+  return ok;
+}
+
 // Clear the index and wnode fields of "node", it siblings and its
 // children.  This is needed because they are a union with other items to save
 // space.
@@ -7706,6 +8589,11 @@ mkspell (
       vim_snprintf((char *)IObuff, IOSIZE,
           _("Estimated runtime memory use: %d bytes"), spin.si_memtot);
       spell_message(&spin, IObuff);
+      vim_snprintf((char *)IObuff, IOSIZE,
+          _("Peak memory use while building: %ld bytes"),
+          spin.si_blocks_total * (long)(sizeof(sblock_T) + SBLOCKSIZE)
+          + (long)spin.si_pending_peak);
+      spell_message(&spin, IObuff);
 
       // If the file is loaded need to reload it.
       if (!error)
@@ -8333,9 +9221,10 @@ static int spell_casefold(char_u *str, int len, char_u *buf, int buflen)
 
 static int sps_flags = SPS_BEST;        // flags from 'spellsuggest'
 static int sps_limit = 9999;            // max nr of suggestions given
+static long sps_timeout = 5000;         // msec limit for the internal methods
 
 // Check the 'spellsuggest' option.  Return FAIL if it's wrong.
-// Sets "sps_flags" and "sps_limit".
+// Sets "sps_flags", "sps_limit" and "sps_timeout".
 int spell_check_sps(void)
 {
   char_u      *p;
@@ -8345,6 +9234,7 @@ int spell_check_sps(void)
 
   sps_flags = 0;
   sps_limit = 9999;
+  sps_timeout = 5000;
 
   for (p = p_sps; *p != NUL; ) {
     copy_option_part(&p, buf, MAXPATHL, ",");
@@ -8361,13 +9251,27 @@ int spell_check_sps(void)
       f = SPS_FAST;
     else if (STRCMP(buf, "double") == 0)
       f = SPS_DOUBLE;
-    else if (STRNCMP(buf, "expr:", 5) != 0
+    else if (STRNCMP(buf, "timeout:", 8) == 0) {
+      s = buf + 8;
+      if (*s == '-')
+        ++s;
+      // More digits would not fit in the profiling time.
+      if (!VIM_ISDIGIT(*s) || STRLEN(s) > 9)
+        f = -1;
+      else {
+        s = buf + 8;
+        sps_timeout = getdigits_long(&s);
+        if (*s != NUL)
+          f = -1;
+      }
+    } else if (STRNCMP(buf, "expr:", 5) != 0
              && STRNCMP(buf, "file:", 5) != 0)
       f = -1;
 
     if (f == -1 || (sps_flags != 0 && f != 0)) {
       sps_flags = SPS_BEST;
       sps_limit = 9999;
+      sps_timeout = 5000;
       return FAIL;
     }
     if (f != 0)
@@ -8942,6 +9846,11 @@ static void spell_suggest_intern(suginfo_T *su, bool interactive)
   // Load the .sug file(s) that are available and not done yet.
   suggest_load_files();
 
+  // Limit the time used for searching, the best suggestions found until then
+  // are used.
+  su->su_deadline = profile_setlimit(sps_timeout);
+  su->su_stopped = false;
+
   // 1. Try special cases, such as repeating a word: "the the" -> "the".
   //
   // Set a maximum score to limit the combination of operations that is
@@ -9303,6 +10212,9 @@ static void suggest_try_change(suginfo_T *su)
   p = su->su_badptr + su->su_badlen;
   (void)spell_casefold(p, (int)STRLEN(p), fword + n, MAXWLEN - n);
 
+  if (suggest_try_change_threaded(su, fword))
+    return;
+
   for (int lpi = 0; lpi < curwin->w_s->b_langp.ga_len; ++lpi) {
     lp = LANGP_ENTRY(curwin->w_s->b_langp, lpi);
 
@@ -9316,6 +10228,260 @@ static void suggest_try_change(suginfo_T *su)
   }
 }
 
+// Return the number of worker threads to use, at most "max": one for each
+// processor, or $NVIM_SPELL_THREADS when set.  The processors are only
+// counted once.
+static int spell_nthreads(int max)
+{
+  static int ncpu = 0;
+  int n;
+
+  const char *env = os_getenv("NVIM_SPELL_THREADS");
+  if (env != NULL && VIM_ISDIGIT(*env)) {
+    n = atoi(env);
+  } else {
+    if (ncpu == 0) {
+      uv_cpu_info_t *cpu_info;
+      if (uv_cpu_info(&cpu_info, &ncpu) == 0)
+        uv_free_cpu_info(cpu_info, ncpu);
+      if (ncpu < 1)
+        ncpu = 1;
+    }
+    n = ncpu;
+  }
+  return n < max ? n : max;
+}
+
+// Do the work of suggest_try_change() in worker threads.  The word tree of
+// each language is split into parts by the first byte of the words.  Each
+// worker searches parts with a copy of "su", the results are added to "su"
+// when all are done.  "fword" is the case-folded bad word with the text after
+// it.
+// Returns false when this is not possible, nothing was done then.
+static bool suggest_try_change_threaded(suginfo_T *su, char_u *fword)
+{
+  int nworkers = spell_nthreads(SUG_MAX_THREADS);
+  if (nworkers < 2)
+    return false;
+
+  // If reloading a spell file fails it's still in the list but everything
+  // has been cleared.
+  garray_T *gap = &curwin->w_s->b_langp;
+  langp_T **langs = xmalloc((size_t)MAX(gap->ga_len, 1) * sizeof(langp_T *));
+  int nlangs = 0;
+  for (int lpi = 0; lpi < gap->ga_len; lpi++) {
+    if (LANGP_ENTRY(*gap, lpi)->lp_slang->sl_fbyts != NULL)
+      langs[nlangs++] = LANGP_ENTRY(*gap, lpi);
+  }
+  if (nlangs == 0) {
+    free(langs);
+    return false;
+  }
+
+  // Each worker needs its own regexp programs of the spell files.
+  if (!sug_compile_wprogs(langs, nlangs, nworkers)) {
+    sug_free_wprogs(langs, nlangs, nworkers);
+    free(langs);
+    return false;
+  }
+
+  sugpool_T *pool = xcalloc(1, sizeof(sugpool_T));
+  pool->sg_fword = fword;
+  pool->sg_langs = langs;
+  pool->sg_nparts = nworkers * SUG_PARTS_PER_THREAD;
+  pool->sg_ntasks = nlangs * pool->sg_nparts;
+  pool->sg_maxscore = su->su_maxscore;
+  uv_mutex_init(&pool->sg_mutex);
+  uv_cond_init(&pool->sg_done);
+
+  sug_pool_active = pool;
+  for (int i = 0; i < nworkers; i++) {
+    sugworker_T *worker = &pool->sg_workers[pool->sg_nworkers];
+    suginfo_T *wsu = &worker->sw_su;
+
+    worker->sw_pool = pool;
+    worker->sw_idx = pool->sg_nworkers;
+    *wsu = *su;
+    ga_init(&wsu->su_ga, (int)sizeof(suggest_T), 10);
+    ga_init(&wsu->su_sga, (int)sizeof(suggest_T), 10);
+    hash_init(&wsu->su_banned);
+    sug_copy_banned(wsu, su);
+    wsu->su_pool = pool;
+    wsu->su_nparts = pool->sg_nparts;
+    pool->sg_running++;
+    if (uv_thread_create(&worker->sw_thread, sug_worker, worker) != 0) {
+      pool->sg_running--;
+      hash_clear_all(&wsu->su_banned, 0);
+      ga_clear(&wsu->su_ga);
+      ga_clear(&wsu->su_sga);
+      break;
+    }
+    pool->sg_nworkers++;
+  }
+
+  // Wait for the workers, checking for CTRL-C and the time limit.
+  // os_breakcheck() only handles the events that are not deferred: typed
+  // keys, signals, resizing and API functions without FUNC_ATTR_DEFERRED.
+  // None of these changes 'spelllang' or reloads a spell file, which would
+  // free the trees the workers are walking; slang_clear() checks this.
+  uv_mutex_lock(&pool->sg_mutex);
+  while (pool->sg_running > 0) {
+    if (uv_cond_timedwait(&pool->sg_done, &pool->sg_mutex,
+            20 * 1000000) == UV_ETIMEDOUT) {
+      uv_mutex_unlock(&pool->sg_mutex);
+      os_breakcheck();
+      bool timedout = profile_passed_limit(su->su_deadline);
+      uv_mutex_lock(&pool->sg_mutex);
+      if (got_int || timedout) {
+        pool->sg_cancel = true;
+        su->su_stopped = timedout;
+      }
+    }
+  }
+  uv_mutex_unlock(&pool->sg_mutex);
+  sug_pool_active = NULL;
+
+  // Collect the suggestions and banned words found by the workers.
+  for (int i = 0; i < pool->sg_nworkers; i++) {
+    sugworker_T *worker = &pool->sg_workers[i];
+    suginfo_T *wsu = &worker->sw_su;
+
+    uv_thread_join(&worker->sw_thread);
+    for (int j = 0; j < wsu->su_ga.ga_len; j++) {
+      suggest_T *stp = &SUG(wsu->su_ga, j);
+      add_suggestion(su, &su->su_ga, stp->st_word, stp->st_orglen,
+          stp->st_score, stp->st_altscore, stp->st_had_bonus,
+          stp->st_slang, false);
+      free(stp->st_word);
+    }
+    ga_clear(&wsu->su_ga);
+    ga_clear(&wsu->su_sga);
+    sug_copy_banned(su, wsu);
+    hash_clear_all(&wsu->su_banned, 0);
+  }
+  if (pool->sg_maxscore < su->su_maxscore)
+    su->su_maxscore = pool->sg_maxscore;
+
+  bool done = pool->sg_nworkers > 0;
+  uv_cond_destroy(&pool->sg_done);
+  uv_mutex_destroy(&pool->sg_mutex);
+  sug_free_wprogs(langs, nlangs, nworkers);
+  free(langs);
+  free(pool);
+  return done;
+}
+
+// Compile a copy of the COMPOUNDRULE and prefix condition programs of the
+// languages "langs" for "nworkers" worker threads.  The programs are
+// compiled again from their pattern, with the flags used when loading the
+// spell file.
+// Returns false when this failed.
+static bool sug_compile_wprogs(langp_T **langs, int nlangs, int nworkers)
+{
+  for (int l = 0; l < nlangs; l++) {
+    slang_T *slang = langs[l]->lp_slang;
+
+    // A language may be used for several regions.
+    if (slang->sl_compwprogs != NULL || slang->sl_prefwprogs != NULL)
+      continue;
+    if (slang->sl_compprog != NULL) {
+      slang->sl_compwprogs = xcalloc((size_t)nworkers, sizeof(regprog_T *));
+      for (int i = 0; i < nworkers; i++) {
+        slang->sl_compwprogs[i] = vim_regcomp(slang->sl_compprog->expr,
+            RE_MAGIC + RE_STRING + RE_STRICT + RE_PRIVATE);
+        if (slang->sl_compwprogs[i] == NULL)
+          return false;
+      }
+    }
+    int cnt = slang->sl_prefixcnt;
+    if (cnt > 0) {
+      slang->sl_prefwprogs = xcalloc((size_t)(nworkers * cnt),
+          sizeof(regprog_T *));
+      for (int i = 0; i < cnt; i++) {
+        if (slang->sl_prefprog[i] == NULL)
+          continue;
+        for (int w = 0; w < nworkers; w++) {
+          regprog_T *rp = vim_regcomp(slang->sl_prefprog[i]->expr,
+              RE_MAGIC + RE_STRING + RE_PRIVATE);
+          if (rp == NULL)
+            return false;
+          slang->sl_prefwprogs[w * cnt + i] = rp;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Free the programs compiled by sug_compile_wprogs().
+static void sug_free_wprogs(langp_T **langs, int nlangs, int nworkers)
+{
+  for (int l = 0; l < nlangs; l++) {
+    slang_T *slang = langs[l]->lp_slang;
+
+    if (slang->sl_compwprogs != NULL) {
+      for (int i = 0; i < nworkers; i++)
+        vim_regfree(slang->sl_compwprogs[i]);
+      free(slang->sl_compwprogs);
+      slang->sl_compwprogs = NULL;
+    }
+    if (slang->sl_prefwprogs != NULL) {
+      for (int i = 0; i < nworkers * slang->sl_prefixcnt; i++)
+        vim_regfree(slang->sl_prefwprogs[i]);
+      free(slang->sl_prefwprogs);
+      slang->sl_prefwprogs = NULL;
+    }
+  }
+}
+
+// A worker thread of a sugpool_T: does tasks until there are no more.
+static void sug_worker(void *arg)
+{
+  sugworker_T *worker = arg;
+  sugpool_T *pool = worker->sw_pool;
+  suginfo_T *su = &worker->sw_su;
+  char_u fword[MAXWLEN];
+
+  regexec_thread_init(NULL);
+  sug_worker_idx = worker->sw_idx;
+  while (!su->su_stopped) {
+    uv_mutex_lock(&pool->sg_mutex);
+    int task = pool->sg_cancel ? pool->sg_ntasks : pool->sg_next++;
+    uv_mutex_unlock(&pool->sg_mutex);
+    if (task >= pool->sg_ntasks)
+      break;
+
+    // suggest_trie_walk() changes "fword" and restores it.
+    STRCPY(fword, pool->sg_fword);
+    su->su_part = task % pool->sg_nparts;
+    suggest_trie_walk(su, pool->sg_langs[task / pool->sg_nparts], fword,
+        false);
+  }
+  regexec_thread_free();
+
+  // Share the final maximum score.
+  suggest_breakcheck(su);
+
+  uv_mutex_lock(&pool->sg_mutex);
+  pool->sg_running--;
+  uv_cond_signal(&pool->sg_done);
+  uv_mutex_unlock(&pool->sg_mutex);
+}
+
+// Add the banned words of "from" to "su".
+static void sug_copy_banned(suginfo_T *su, suginfo_T *from)
+{
+  hashtab_T *ht = &from->su_banned;
+  int todo = (int)ht->ht_used;
+
+  for (hashitem_T *hi = ht->ht_array; todo > 0; ++hi) {
+    if (!HASHITEM_EMPTY(hi)) {
+      --todo;
+      add_banned(su, hi->hi_key);
+    }
+  }
+}
+
 // Check the maximum score, if we go over it we won't try this change.
 #define TRY_DEEPER(su, stack, depth, add) \
   (stack[depth].ts_score + (add) < su->su_maxscore)
@@ -9427,7 +10593,7 @@ static void suggest_trie_walk(suginfo_T *su, langp_T *lp, char_u *fword, bool so
   //   increase "depth".
   // - When a state is done go to the next, set "ts_state".
   // - When all states are tried decrease "depth".
-  while (depth >= 0 && !got_int) {
+  while (depth >= 0 && !got_int && !su->su_stopped) {
     sp = &stack[depth];
     switch (sp->ts_state) {
     case STATE_START:
@@ -9965,6 +11131,7 @@ static void suggest_trie_walk(suginfo_T *su, langp_T *lp, char_u *fword, bool so
              || (sp->ts_fidx >= sp->ts_fidxtry
                  && ((sp->ts_flags & TSF_DIDDEL) == 0
                      || c != fword[sp->ts_delidx])))
+            && (sp->ts_twordlen > 0 || SUG_FIRST_BYTE(su, c))
             && TRY_DEEPER(su, stack, depth, newscore)) {
           go_deeper(stack, depth, newscore);
 #ifdef DEBUG_TRIEWALK
@@ -10174,6 +11341,7 @@ static void suggest_trie_walk(suginfo_T *su, langp_T *lp, char_u *fword, bool so
       else
         newscore = SCORE_INS;
       if (c != fword[sp->ts_fidx]
+          && (sp->ts_twordlen > 0 || SUG_FIRST_BYTE(su, c))
           && TRY_DEEPER(su, stack, depth, newscore)) {
         go_deeper(stack, depth, newscore);
 #ifdef DEBUG_TRIEWALK
@@ -10586,13 +11754,37 @@ static void suggest_trie_walk(suginfo_T *su, langp_T *lp, char_u *fword, bool so
 
       // Don't check for CTRL-C too often, it takes time.
       if (--breakcheckcount == 0) {
-        os_breakcheck();
+        suggest_breakcheck(su);
         breakcheckcount = 1000;
       }
     }
   }
 }
 
+// Check for CTRL-C and the time limit while looking for suggestions.  In a
+// worker thread share the lowest maximum score with the other workers
+// instead, so that they all skip changes that can't make it into the list.
+static void suggest_breakcheck(suginfo_T *su)
+{
+  sugpool_T *pool = su->su_pool;
+
+  if (pool == NULL) {
+    os_breakcheck();
+    if (profile_passed_limit(su->su_deadline))
+      su->su_stopped = true;
+    return;
+  }
+
+  uv_mutex_lock(&pool->sg_mutex);
+  if (su->su_maxscore < pool->sg_maxscore)
+    pool->sg_maxscore = su->su_maxscore;
+  else
+    su->su_maxscore = pool->sg_maxscore;
+  if (pool->sg_cancel)
+    su->su_stopped = true;
+  uv_mutex_unlock(&pool->sg_mutex);
+}
+
 
 // Go one level deeper in the tree.
 static void go_deeper(trystate_T *stack, int depth, int score_add)
@@ -3,6 +3,9 @@
 
 #include <stdbool.h>
 
+/// Cached spell_check() results for one line, see spell_cache_line().
+typedef struct spell_line_S spell_line_T;
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "spell.h.generated.h"
 #endif
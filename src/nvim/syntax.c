@@ -42,10 +42,13 @@
 #include "nvim/path.h"
 #include "nvim/regexp.h"
 #include "nvim/screen.h"
+#include "nvim/sha256.h"
+#include "nvim/spell.h"
 #include "nvim/strings.h"
 #include "nvim/syntax_defs.h"
 #include "nvim/ui.h"
 #include "nvim/os/os.h"
+#include "nvim/os/event.h"
 #include "nvim/os/time.h"
 
 // Structure that stores information about a highlight group.
@@ -205,6 +208,44 @@ struct name_list {
   char        *name;
 };
 
+/*
+ * Literal text of which one appears in every match of a pattern, see
+ * vim_regliterals().
+ */
+typedef struct {
+  int sl_idx;                   /* index of the pattern */
+  int sl_ic;                    /* ignore case */
+  size_t sl_len;                /* length of sl_text */
+  char_u *sl_text;              /* owned by the program of the pattern */
+} synlit_T;
+
+/*
+ * What is known about one pattern, and where its literals appear in the line
+ * with ID sls_line_id.
+ */
+typedef struct {
+  int sp_known;                 /* the pattern has literals */
+  int sp_ic;                    /* ignore case for the literals */
+  colnr_T sp_lastcol;           /* last column where a literal starts,
+                                   -1 for none */
+} synlitpat_T;
+
+/*
+ * The literals of all start and match patterns, indexed by their first byte,
+ * so that one pass over a line finds out for all patterns at once whether
+ * they can match in it.
+ */
+struct syn_lits {
+  int sls_npat;                 /* number of patterns when built */
+  synlitpat_T *sls_pats;        /* sls_npat items */
+  synlit_T *sls_lits;           /* all the literals */
+  int sls_start[257];           /* sls_items[] for byte "c" are at
+                                   sls_start[c] until sls_start[c + 1] */
+  int *sls_items;               /* indexes in sls_lits[] */
+  int sls_line_id;              /* line for sp_lastcol and sls_nonascii */
+  colnr_T sls_nonascii;         /* last column with a non-ASCII byte or -1 */
+};
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "syntax.c.generated.h"
 #endif
@@ -240,10 +281,11 @@ static char *(spo_name_tab[SPO_COUNT]) =
 #define SF_CCOMMENT     0x01    /* sync on a C-style comment */
 #define SF_MATCH        0x02    /* sync by matching a pattern */
 
-#define SYN_STATE_P(ssp)    ((bufstate_T *)((ssp)->ga_data))
-
 #define MAXKEYWLEN      80          /* maximum length of a keyword */
 
+/* Bit in b_keywmask[] for a keyword of "len" bytes. */
+#define KEYW_LENBIT(len)    ((uint32_t)1 << ((len) > 32 ? 31 : (len) - 1))
+
 /*
  * The attributes of the syntax item that has been recognized.
  */
@@ -369,6 +411,17 @@ static int current_line_id = 0;         /* unique number for current line */
 static int syn_time_on = FALSE;
 # define IF_SYN_TIME(p) (p)
 
+/*
+ * When not NULL, syntax_start() stops parsing when this time has passed and
+ * sets "syn_timed_out".  The state is then valid for "current_lnum", parsing
+ * can continue from there.
+ */
+static proftime_T *syn_tm = NULL;
+static int syn_timed_out = FALSE;
+
+#define SYN_REDRAW_MSEC     250 /* max time to parse before drawing a line */
+#define SYN_RUNAHEAD_MSEC   20  /* parse time between checks for typeahead */
+
 
 
 /*
@@ -383,9 +436,10 @@ void syntax_start(win_T *wp, linenr_T lnum)
   synstate_T  *p;
   synstate_T  *last_valid = NULL;
   synstate_T  *last_min_valid = NULL;
-  synstate_T  *sp, *prev = NULL;
+  synstate_T  *sp, *prev;
   linenr_T parsed_lnum;
   linenr_T first_stored;
+  int idx;
   int dist;
   static int changedtick = 0;           /* remember the last change ID */
 
@@ -412,6 +466,17 @@ void syntax_start(win_T *wp, linenr_T lnum)
     return;             /* out of memory */
   syn_block->b_sst_lasttick = display_tick;
 
+  /*
+   * The first time the syntax of a big buffer is needed, get the states
+   * saved in 'synstatedir' when it was unloaded before.
+   */
+  if (!syn_block->b_sst_loaded && syn_block->b_sst_len == 0
+      && syn_block == &syn_buf->b_s) {
+    syn_block->b_sst_loaded = true;
+    if (*p_ssd != NUL)
+      syn_state_load(syn_buf);
+  }
+
   /*
    * If the state of the end of the previous line is useful, store it.
    */
@@ -440,13 +505,13 @@ void syntax_start(win_T *wp, linenr_T lnum)
    */
   if (INVALID_STATE(&current_state) && syn_block->b_sst_array != NULL) {
     /* Find last valid saved state before start_lnum. */
-    for (p = syn_block->b_sst_first; p != NULL; p = p->sst_next) {
-      if (p->sst_lnum > lnum)
-        break;
-      if (p->sst_lnum <= lnum && p->sst_change_lnum == 0) {
+    for (idx = syn_stack_find_idx(lnum); idx >= 0; --idx) {
+      p = &syn_block->b_sst_array[idx];
+      if (p->sst_change_lnum == 0) {
         last_valid = p;
         if (p->sst_lnum >= lnum - syn_block->b_syn_sync_minlines)
           last_min_valid = p;
+        break;
       }
     }
     if (last_min_valid != NULL)
@@ -473,10 +538,10 @@ void syntax_start(win_T *wp, linenr_T lnum)
    * Advance from the sync point or saved state until the current line.
    * Save some entries for syncing with later on.
    */
-  if (syn_block->b_sst_len <= Rows)
-    dist = 999999;
+  if (syn_block->b_syn_sync_statelines > 1)
+    dist = (int)syn_block->b_syn_sync_statelines;
   else
-    dist = syn_buf->b_ml.ml_line_count / (syn_block->b_sst_len - Rows) + 1;
+    dist = 1;
   while (current_lnum < lnum) {
     syn_start_line();
     (void)syn_finish_line(FALSE);
@@ -488,20 +553,17 @@ void syntax_start(win_T *wp, linenr_T lnum)
       /* Check if the saved state entry is for the current line and is
        * equal to the current state.  If so, then validate all saved
        * states that depended on a change before the parsed line. */
-      if (prev == NULL)
-        prev = syn_stack_find_entry(current_lnum - 1);
-      if (prev == NULL)
-        sp = syn_block->b_sst_first;
-      else
-        sp = prev;
-      while (sp != NULL && sp->sst_lnum < current_lnum)
-        sp = sp->sst_next;
+      idx = syn_stack_find_idx(current_lnum);
+      sp = idx < 0 ? NULL : &syn_block->b_sst_array[idx];
       if (sp != NULL
           && sp->sst_lnum == current_lnum
           && syn_stack_equal(sp)) {
         parsed_lnum = current_lnum;
         prev = sp;
-        while (sp != NULL && sp->sst_change_lnum <= parsed_lnum) {
+        for (; idx < syn_block->b_sst_len; ++idx) {
+          sp = &syn_block->b_sst_array[idx];
+          if (sp->sst_change_lnum > parsed_lnum)
+            break;
           if (sp->sst_lnum <= lnum)
             /* valid state before desired line, use this one */
             prev = sp;
@@ -509,17 +571,20 @@ void syntax_start(win_T *wp, linenr_T lnum)
             /* past saved states depending on change, break here. */
             break;
           sp->sst_change_lnum = 0;
-          sp = sp->sst_next;
         }
         load_current_state(prev);
+      } else {
+        /* Store the state at this line when it's the first one, the line
+         * where we start parsing, or "statelines" lines from the
+         * previously saved state.  But only when parsed at least
+         * 'minlines'. */
+        if (sp != NULL && sp->sst_lnum == current_lnum)
+          sp = idx == 0 ? NULL : &syn_block->b_sst_array[idx - 1];
+        if (sp == NULL
+            || current_lnum == lnum
+            || current_lnum >= sp->sst_lnum + dist)
+          (void)store_current_state();
       }
-      /* Store the state at this line when it's the first one, the line
-       * where we start parsing, or some distance from the previously
-       * saved state.  But only when parsed at least 'minlines'. */
-      else if (prev == NULL
-               || current_lnum == lnum
-               || current_lnum >= prev->sst_lnum + dist)
-        prev = store_current_state();
     }
 
     /* This can take a long time: break when CTRL-C pressed.  The current
@@ -529,24 +594,121 @@ void syntax_start(win_T *wp, linenr_T lnum)
       current_lnum = lnum;
       break;
     }
+
+    /* Out of time: stop here, the caller continues later. */
+    if (syn_tm != NULL && current_lnum < lnum
+        && profile_passed_limit(*syn_tm)) {
+      syn_timed_out = TRUE;
+      break;
+    }
   }
 
   syn_start_line();
 }
 
 /*
- * We cannot simply discard growarrays full of state_items or buf_states; we
- * have to manually release their extmatch pointers first.
+ * Like syntax_start(), for drawing line "lnum" in window "wp".  When getting
+ * the state for "lnum" takes too long, gives up and lets syntax_runahead()
+ * continue parsing while waiting for a typed character.  The window is
+ * redrawn when it reached "lnum".
+ * Returns FALSE when "lnum" is to be drawn without syntax highlighting.
  */
-static void clear_syn_state(synstate_T *p)
+int syntax_start_redraw(win_T *wp, linenr_T lnum)
 {
-  if (p->sst_stacksize > SST_FIX_STATES) {
-#   define UNREF_BUFSTATE_EXTMATCH(bs) unref_extmatch((bs)->bs_extmatch)
-    GA_DEEP_CLEAR(&(p->sst_union.sst_ga), bufstate_T, UNREF_BUFSTATE_EXTMATCH);
-  } else {
-    for (int i = 0; i < p->sst_stacksize; i++) {
-      unref_extmatch(p->sst_union.sst_stack[i].bs_extmatch);
+  synblock_T *block = wp->w_s;
+
+  if (block->b_sst_pending != 0 && lnum >= block->b_sst_pending)
+    return FALSE;
+
+  proftime_T tm = profile_setlimit(SYN_REDRAW_MSEC);
+  syn_tm = &tm;
+  syn_timed_out = FALSE;
+  syntax_start(wp, lnum);
+  syn_tm = NULL;
+
+  if (syn_timed_out) {
+    block->b_sst_pending = lnum;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/*
+ * Parse syntax ahead in the windows of the current tab page, for a short
+ * time.  To be called while waiting for the user to type something.  Parses
+ * up to a line that was drawn without highlighting, see
+ * syntax_start_redraw(), and with "sync fromstart" up to the last line, so
+ * that jumping anywhere doesn't require parsing from the start of the file.
+ * Windows are only handled when the stored states were updated for the last
+ * change, thus after redrawing them.
+ * Returns TRUE when some parsing was done, FALSE when there is nothing to do.
+ */
+int syntax_runahead(void)
+{
+  FOR_ALL_WINDOWS_IN_TAB(wp, curtab) {
+    synblock_T *block = wp->w_s;
+    buf_T *buf = wp->w_buffer;
+    linenr_T target = block->b_sst_pending;
+
+    if (!syntax_present(wp) || block->b_syn_error || buf->b_mod_set
+        || block->b_sst_array == NULL)
+      continue;
+    if (target == 0 && block->b_syn_sync_minlines == MAXLNUM
+        && !(block->b_sst_ahead_done
+             && block->b_sst_ahead_tick == buf->b_changedtick))
+      target = buf->b_ml.ml_line_count;
+    if (target == 0)
+      continue;
+    if (target > buf->b_ml.ml_line_count)
+      target = buf->b_ml.ml_line_count;
+
+    int save_did_emsg = did_emsg;
+    did_emsg = FALSE;
+    proftime_T tm = profile_setlimit(SYN_RUNAHEAD_MSEC);
+    syn_tm = &tm;
+    syn_timed_out = FALSE;
+    syntax_start(wp, target);
+    syn_tm = NULL;
+    if (did_emsg)
+      block->b_syn_error = TRUE;
+    did_emsg |= save_did_emsg;
+
+    if (!syn_timed_out) {
+      if (block->b_sst_pending != 0) {
+        /* Redraw the lines that were drawn without highlighting. */
+        block->b_sst_pending = 0;
+        FOR_ALL_WINDOWS_IN_TAB(wp2, curtab) {
+          if (wp2->w_s == block) {
+            redraw_win_later(wp2, NOT_VALID);
+          }
+        }
+        event_push((Event) { .handler = syn_runahead_redraw }, true);
+      } else {
+        block->b_sst_ahead_done = true;
+        block->b_sst_ahead_tick = buf->b_changedtick;
+      }
     }
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/*
+ * Handler for the event pushed by syntax_runahead(), only to get out of
+ * waiting for a character.  The screen is updated after handling events.
+ */
+static void syn_runahead_redraw(Event event)
+{
+}
+
+/*
+ * Drop the reference of entry "p" in b_sst_array[] to its state stack.
+ */
+static void clear_syn_state(synblock_T *block, synstate_T *p)
+{
+  if (p->sst_stack != NULL) {
+    syn_stack_unref(block, p->sst_stack);
+    p->sst_stack = NULL;
   }
 }
 
@@ -921,15 +1083,15 @@ static void syn_update_ends(int startofline)
 /*
  * EXPLANATION OF THE SYNTAX STATE STACK CACHE
  *
- * To speed up syntax highlighting, the state stack for the start of some
- * lines is cached.  These entries can be used to start parsing at that point.
+ * To speed up syntax highlighting, the state stack for the start of lines is
+ * cached.  These entries can be used to start parsing at that point.
  *
- * The stack is kept in b_sst_array[] for each buffer.  There is a list of
- * valid entries.  b_sst_first points to the first one, then follow sst_next.
- * The entries are sorted on line number.  The first entry is often for line 2
- * (line 1 always starts with an empty stack).
- * There is also a list for free entries.  This construction is used to avoid
- * having to allocate and free memory blocks too often.
+ * The entries are kept in b_sst_array[] for each buffer, sorted on line
+ * number, so that the entry for any line is found with a binary search.  The
+ * first entry is often for line 2 (line 1 always starts with an empty stack).
+ * Most lines start with the same stack as the line above them, thus an entry
+ * only points to a synstack_T, which is shared by all entries with the same
+ * stack.  The stacks are found through the b_sst_stacks[] hash table.
  *
  * When making changes to the buffer, this is logged in b_mod_*.  When calling
  * update_screen() to update the display, it will call
@@ -943,24 +1105,30 @@ static void syn_update_ends(int startofline)
  * When later displaying lines, an entry is stored for each line.  Displayed
  * lines are likely to be displayed again, in which case the state at the
  * start of the line is needed.
- * For not displayed lines, an entry is stored for every so many lines.  These
- * entries will be used e.g., when scrolling backwards.  The distance between
- * entries depends on the number of lines in the buffer.  For small buffers
- * the distance is fixed at SST_DIST, for large buffers there is a fixed
- * number of entries SST_MAX_ENTRIES, and the distance is computed.
+ * For not displayed lines, an entry is stored for every parsed line, or every
+ * "statelines" lines when set with ":syntax sync statelines={N}".  These
+ * entries will be used e.g., when scrolling backwards.  When there are
+ * SST_MAX_ENTRIES entries, every other entry for a line that is not displayed
+ * is dropped.
  */
 
 static void syn_stack_free_block(synblock_T *block)
 {
-  synstate_T  *p;
-
   if (block->b_sst_array != NULL) {
-    for (p = block->b_sst_first; p != NULL; p = p->sst_next)
-      clear_syn_state(p);
+    for (int i = 0; i < block->b_sst_len; i++) {
+      clear_syn_state(block, &block->b_sst_array[i]);
+    }
     free(block->b_sst_array);
     block->b_sst_array = NULL;
     block->b_sst_len = 0;
+    block->b_sst_size = 0;
   }
+  assert(block->b_sst_stacks_count == 0);
+  free(block->b_sst_stacks);
+  block->b_sst_stacks = NULL;
+  block->b_sst_stacks_size = 0;
+  block->b_sst_pending = 0;
+  block->b_sst_ahead_done = false;
 }
 /*
  * Free b_sst_array[] for buffer "buf".
@@ -969,6 +1137,9 @@ static void syn_stack_free_block(synblock_T *block)
 void syn_stack_free_all(synblock_T *block)
 {
   syn_stack_free_block(block);
+  syn_lits_free(block);
+  /* Saved states may match the changed syntax items. */
+  block->b_sst_loaded = false;
 
   /* When using "syntax" fold method, must update all folds. */
   FOR_ALL_WINDOWS_IN_TAB(wp, curtab) {
@@ -980,72 +1151,37 @@ void syn_stack_free_all(synblock_T *block)
 
 /*
  * Allocate the syntax state stack for syn_buf when needed.
- * If the number of entries in b_sst_array[] is much too big or a bit too
- * small, reallocate it.
- * Also used to allocate b_sst_array[] for the first time.
  */
 static void syn_stack_alloc(void)
 {
-  long len;
-  synstate_T  *to, *from;
-  synstate_T  *sstp;
-
-  len = syn_buf->b_ml.ml_line_count / SST_DIST + Rows * 2;
-  if (len < SST_MIN_ENTRIES)
-    len = SST_MIN_ENTRIES;
-  else if (len > SST_MAX_ENTRIES)
-    len = SST_MAX_ENTRIES;
-  if (syn_block->b_sst_len > len * 2 || syn_block->b_sst_len < len) {
-    /* Allocate 50% too much, to avoid reallocating too often. */
-    len = syn_buf->b_ml.ml_line_count;
-    len = (len + len / 2) / SST_DIST + Rows * 2;
-    if (len < SST_MIN_ENTRIES)
-      len = SST_MIN_ENTRIES;
-    else if (len > SST_MAX_ENTRIES)
-      len = SST_MAX_ENTRIES;
-
-    if (syn_block->b_sst_array != NULL) {
-      /* When shrinking the array, cleanup the existing stack.
-       * Make sure that all valid entries fit in the new array. */
-      while (syn_block->b_sst_len - syn_block->b_sst_freecount + 2 > len
-             && syn_stack_cleanup())
-        ;
-      if (len < syn_block->b_sst_len - syn_block->b_sst_freecount + 2)
-        len = syn_block->b_sst_len - syn_block->b_sst_freecount + 2;
-    }
-
-    assert(len >= 0);
-    sstp = xcalloc(len, sizeof(synstate_T));
-
-    to = sstp - 1;
-    if (syn_block->b_sst_array != NULL) {
-      /* Move the states from the old array to the new one. */
-      for (from = syn_block->b_sst_first; from != NULL;
-           from = from->sst_next) {
-        ++to;
-        *to = *from;
-        to->sst_next = to + 1;
-      }
-    }
-    if (to != sstp - 1) {
-      to->sst_next = NULL;
-      syn_block->b_sst_first = sstp;
-      syn_block->b_sst_freecount = len - (int)(to - sstp) - 1;
-    } else {
-      syn_block->b_sst_first = NULL;
-      syn_block->b_sst_freecount = len;
-    }
-
-    /* Create the list of free entries. */
-    syn_block->b_sst_firstfree = to + 1;
-    while (++to < sstp + len)
-      to->sst_next = to + 1;
-    (sstp + len - 1)->sst_next = NULL;
+  if (syn_block->b_sst_array == NULL) {
+    syn_block->b_sst_array = xmalloc(SST_MIN_ENTRIES * sizeof(synstate_T));
+    syn_block->b_sst_size = SST_MIN_ENTRIES;
+    syn_block->b_sst_len = 0;
+  }
+}
 
-    free(syn_block->b_sst_array);
-    syn_block->b_sst_array = sstp;
-    syn_block->b_sst_len = len;
+/*
+ * Make room for one more entry in b_sst_array[]: grow the array, or cleanup
+ * the entries when it reached SST_MAX_ENTRIES.
+ * Returns FALSE when there is no room.
+ */
+static int syn_stack_make_room(void)
+{
+  if (syn_block->b_sst_len < syn_block->b_sst_size)
+    return TRUE;
+  if (syn_block->b_sst_size < SST_MAX_ENTRIES) {
+    int size = syn_block->b_sst_size * 2;
+
+    if (size > SST_MAX_ENTRIES)
+      size = SST_MAX_ENTRIES;
+    syn_block->b_sst_array = xrealloc(syn_block->b_sst_array,
+        (size_t)size * sizeof(synstate_T));
+    syn_block->b_sst_size = size;
+    return TRUE;
   }
+  (void)syn_stack_cleanup();
+  return syn_block->b_sst_len < syn_block->b_sst_size;
 }
 
 /*
@@ -1067,25 +1203,28 @@ void syn_stack_apply_changes(buf_T *buf)
 
 static void syn_stack_apply_changes_block(synblock_T *block, buf_T *buf)
 {
-  synstate_T  *p, *prev, *np;
+  synstate_T  *p;
   linenr_T n;
+  int to = 0;
 
   if (block->b_sst_array == NULL)       /* nothing to do */
     return;
 
-  prev = NULL;
-  for (p = block->b_sst_first; p != NULL; ) {
+  if (block->b_sst_pending > buf->b_mod_top) {
+    block->b_sst_pending += buf->b_mod_xlines;
+    if (block->b_sst_pending < buf->b_mod_top)
+      block->b_sst_pending = buf->b_mod_top;
+  }
+
+  /* Entries below the changed area keep their order, the remaining entries
+   * are moved down over the removed ones. */
+  for (int from = 0; from < block->b_sst_len; from++) {
+    p = &block->b_sst_array[from];
     if (p->sst_lnum + block->b_syn_sync_linebreaks > buf->b_mod_top) {
       n = p->sst_lnum + buf->b_mod_xlines;
       if (n <= buf->b_mod_bot) {
         /* this state is inside the changed area, remove it */
-        np = p->sst_next;
-        if (prev == NULL)
-          block->b_sst_first = np;
-        else
-          prev->sst_next = np;
-        syn_stack_free_entry(block, p);
-        p = np;
+        clear_syn_state(block, p);
         continue;
       }
       /* This state is below the changed area.  Remember the line
@@ -1103,96 +1242,187 @@ static void syn_stack_apply_changes_block(synblock_T *block, buf_T *buf)
 
       p->sst_lnum = n;
     }
-    prev = p;
-    p = p->sst_next;
+    block->b_sst_array[to++] = *p;
   }
+  block->b_sst_len = to;
 }
 
 /*
- * Reduce the number of entries in the state stack for syn_buf.
+ * Reduce the number of entries in the state stack for syn_buf, by removing
+ * every other entry for a line that was not displayed in the last redraw.
  * Returns TRUE if at least one entry was freed.
  */
 static int syn_stack_cleanup(void)
 {
-  synstate_T  *p, *prev;
-  disptick_T tick;
-  int above;
-  int dist;
+  synstate_T  *p;
+  int to = 0;
   int retval = FALSE;
 
-  if (syn_block->b_sst_array == NULL || syn_block->b_sst_first == NULL)
+  if (syn_block->b_sst_array == NULL || syn_block->b_sst_len == 0)
     return retval;
 
-  /* Compute normal distance between non-displayed entries. */
-  if (syn_block->b_sst_len <= Rows)
-    dist = 999999;
-  else
-    dist = syn_buf->b_ml.ml_line_count / (syn_block->b_sst_len - Rows) + 1;
-
-  /*
-   * Go through the list to find the "tick" for the oldest entry that can
-   * be removed.  Set "above" when the "tick" for the oldest entry is above
-   * "b_sst_lasttick" (the display tick wraps around).
-   */
-  tick = syn_block->b_sst_lasttick;
-  above = FALSE;
-  prev = syn_block->b_sst_first;
-  for (p = prev->sst_next; p != NULL; prev = p, p = p->sst_next) {
-    if (prev->sst_lnum + dist > p->sst_lnum) {
-      if (p->sst_tick > syn_block->b_sst_lasttick) {
-        if (!above || p->sst_tick < tick)
-          tick = p->sst_tick;
-        above = TRUE;
-      } else if (!above && p->sst_tick < tick)
-        tick = p->sst_tick;
+  for (int from = 0; from < syn_block->b_sst_len; from++) {
+    p = &syn_block->b_sst_array[from];
+    if ((from & 1) && p->sst_tick != syn_block->b_sst_lasttick) {
+      clear_syn_state(syn_block, p);
+      retval = TRUE;
+      continue;
     }
+    syn_block->b_sst_array[to++] = *p;
   }
+  syn_block->b_sst_len = to;
+  return retval;
+}
 
-  /*
-   * Go through the list to make the entries for the oldest tick at an
-   * interval of several lines.
-   */
-  prev = syn_block->b_sst_first;
-  for (p = prev->sst_next; p != NULL; prev = p, p = p->sst_next) {
-    if (p->sst_tick == tick && prev->sst_lnum + dist > p->sst_lnum) {
-      /* Move this entry from used list to free list */
-      prev->sst_next = p->sst_next;
-      syn_stack_free_entry(syn_block, p);
-      p = prev;
-      retval = TRUE;
+/*
+ * Find the index of the entry in b_sst_array[] at or before "lnum".
+ * Returns -1 when there is no entry or the first entry is after "lnum".
+ */
+static int syn_stack_find_idx(linenr_T lnum)
+{
+  int lo = 0;
+  int hi = syn_block->b_sst_len;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+
+    if (syn_block->b_sst_array[mid].sst_lnum <= lnum)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+/*
+ * Compute a hash of the current state stack.
+ */
+static uint64_t syn_stack_hash(void)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+#define SYN_HASH_ADD(v) \
+  hash = (hash ^ (uint64_t)(v)) * 1099511628211ULL
+  SYN_HASH_ADD(current_state.ga_len);
+  SYN_HASH_ADD(current_next_flags);
+  SYN_HASH_ADD((uintptr_t)current_next_list);
+  for (int i = 0; i < current_state.ga_len; i++) {
+    SYN_HASH_ADD(CUR_STATE(i).si_idx);
+    SYN_HASH_ADD(CUR_STATE(i).si_flags);
+    SYN_HASH_ADD(CUR_STATE(i).si_seqnr);
+    SYN_HASH_ADD(CUR_STATE(i).si_cchar);
+    SYN_HASH_ADD((uintptr_t)CUR_STATE(i).si_extmatch);
+  }
+#undef SYN_HASH_ADD
+  return hash;
+}
+
+/*
+ * Return TRUE when stack "ss" holds exactly the current state stack.
+ */
+static int syn_stack_same(synstack_T *ss)
+{
+  if (ss->ss_size != current_state.ga_len
+      || ss->ss_next_list != current_next_list
+      || ss->ss_next_flags != current_next_flags)
+    return FALSE;
+  for (int i = 0; i < ss->ss_size; i++) {
+    bufstate_T *bp = &ss->ss_states[i];
+
+    if (bp->bs_idx != CUR_STATE(i).si_idx
+        || bp->bs_flags != CUR_STATE(i).si_flags
+        || bp->bs_seqnr != CUR_STATE(i).si_seqnr
+        || bp->bs_cchar != CUR_STATE(i).si_cchar
+        || bp->bs_extmatch != CUR_STATE(i).si_extmatch)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/*
+ * Resize the b_sst_stacks[] hash table of "block" to "size" buckets.
+ */
+static void syn_stack_rehash(synblock_T *block, int size)
+{
+  synstack_T **stacks = xcalloc((size_t)size, sizeof(synstack_T *));
+
+  for (int i = 0; i < block->b_sst_stacks_size; i++) {
+    synstack_T *ss = block->b_sst_stacks[i];
+
+    while (ss != NULL) {
+      synstack_T *next = ss->ss_next;
+      synstack_T **bucket = &stacks[ss->ss_hash & (uint64_t)(size - 1)];
+
+      ss->ss_next = *bucket;
+      *bucket = ss;
+      ss = next;
     }
   }
-  return retval;
+  free(block->b_sst_stacks);
+  block->b_sst_stacks = stacks;
+  block->b_sst_stacks_size = size;
 }
 
 /*
- * Free the allocated memory for a syn_state item.
- * Move the entry into the free list.
+ * Get a reference to a stack equal to the current state stack: an existing
+ * one from the b_sst_stacks[] hash table or a new one.
  */
-static void syn_stack_free_entry(synblock_T *block, synstate_T *p)
+static synstack_T *syn_stack_intern(synblock_T *block)
 {
-  clear_syn_state(p);
-  p->sst_next = block->b_sst_firstfree;
-  block->b_sst_firstfree = p;
-  ++block->b_sst_freecount;
+  uint64_t hash = syn_stack_hash();
+  synstack_T **bucket;
+  synstack_T *ss;
+
+  if (block->b_sst_stacks_size == 0)
+    syn_stack_rehash(block, SST_MIN_STACKS);
+  bucket = &block->b_sst_stacks[hash & (uint64_t)(block->b_sst_stacks_size - 1)];
+  for (ss = *bucket; ss != NULL; ss = ss->ss_next) {
+    if (ss->ss_hash == hash && syn_stack_same(ss)) {
+      ++ss->ss_refcount;
+      return ss;
+    }
+  }
+
+  ss = xmalloc(sizeof(synstack_T)
+      + (size_t)current_state.ga_len * sizeof(bufstate_T));
+  ss->ss_hash = hash;
+  ss->ss_refcount = 1;
+  ss->ss_next_flags = current_next_flags;
+  ss->ss_next_list = current_next_list;
+  ss->ss_size = current_state.ga_len;
+  for (int i = 0; i < ss->ss_size; i++) {
+    ss->ss_states[i].bs_idx = CUR_STATE(i).si_idx;
+    ss->ss_states[i].bs_flags = CUR_STATE(i).si_flags;
+    ss->ss_states[i].bs_seqnr = CUR_STATE(i).si_seqnr;
+    ss->ss_states[i].bs_cchar = CUR_STATE(i).si_cchar;
+    ss->ss_states[i].bs_extmatch = ref_extmatch(CUR_STATE(i).si_extmatch);
+  }
+  ss->ss_next = *bucket;
+  *bucket = ss;
+  if (++block->b_sst_stacks_count > block->b_sst_stacks_size)
+    syn_stack_rehash(block, block->b_sst_stacks_size * 2);
+  return ss;
 }
 
 /*
- * Find an entry in the list of state stacks at or before "lnum".
- * Returns NULL when there is no entry or the first entry is after "lnum".
+ * Drop a reference to stack "ss", free it when it was the last one.
  */
-static synstate_T *syn_stack_find_entry(linenr_T lnum)
+static void syn_stack_unref(synblock_T *block, synstack_T *ss)
 {
-  synstate_T  *p, *prev;
+  synstack_T **pp;
 
-  prev = NULL;
-  for (p = syn_block->b_sst_first; p != NULL; prev = p, p = p->sst_next) {
-    if (p->sst_lnum == lnum)
-      return p;
-    if (p->sst_lnum > lnum)
-      break;
+  if (--ss->ss_refcount > 0)
+    return;
+  pp = &block->b_sst_stacks[ss->ss_hash
+                            & (uint64_t)(block->b_sst_stacks_size - 1)];
+  while (*pp != ss)
+    pp = &(*pp)->ss_next;
+  *pp = ss->ss_next;
+  --block->b_sst_stacks_count;
+  for (int i = 0; i < ss->ss_size; i++) {
+    unref_extmatch(ss->ss_states[i].bs_extmatch);
   }
-  return prev;
+  free(ss);
 }
 
 /*
@@ -1202,10 +1432,9 @@ static synstate_T *syn_stack_find_entry(linenr_T lnum)
 static synstate_T *store_current_state(void)
 {
   int i;
-  synstate_T  *p;
-  bufstate_T  *bp;
+  int idx;
   stateitem_T *cur_si;
-  synstate_T  *sp = syn_stack_find_entry(current_lnum);
+  synstate_T  *sp = NULL;
 
   /*
    * If the current state contains a start or end pattern that continues
@@ -1220,78 +1449,38 @@ static synstate_T *store_current_state(void)
             && cur_si->si_eoe_pos.lnum >= current_lnum))
       break;
   }
+  idx = syn_stack_find_idx(current_lnum);
   if (i >= 0) {
-    if (sp != NULL) {
-      /* find "sp" in the list and remove it */
-      if (syn_block->b_sst_first == sp)
-        /* it's the first entry */
-        syn_block->b_sst_first = sp->sst_next;
-      else {
-        /* find the entry just before this one to adjust sst_next */
-        for (p = syn_block->b_sst_first; p != NULL; p = p->sst_next)
-          if (p->sst_next == sp)
-            break;
-        if (p != NULL)          /* just in case */
-          p->sst_next = sp->sst_next;
-      }
-      syn_stack_free_entry(syn_block, sp);
-      sp = NULL;
+    if (idx >= 0) {
+      /* remove the entry at or before this line */
+      clear_syn_state(syn_block, &syn_block->b_sst_array[idx]);
+      memmove(syn_block->b_sst_array + idx, syn_block->b_sst_array + idx + 1,
+          (size_t)(syn_block->b_sst_len - idx - 1) * sizeof(synstate_T));
+      --syn_block->b_sst_len;
     }
-  } else if (sp == NULL || sp->sst_lnum != current_lnum)   {
+  } else if (idx < 0 || syn_block->b_sst_array[idx].sst_lnum != current_lnum) {
     /*
-     * Add a new entry
+     * Add a new entry after "idx".  Making room may remove entries.
      */
-    /* If no free items, cleanup the array first. */
-    if (syn_block->b_sst_freecount == 0) {
-      (void)syn_stack_cleanup();
-      /* "sp" may have been moved to the freelist now */
-      sp = syn_stack_find_entry(current_lnum);
-    }
-    /* Still no free items?  Must be a strange problem... */
-    if (syn_block->b_sst_freecount == 0)
-      sp = NULL;
-    else {
-      /* Take the first item from the free list and put it in the used
-       * list, after *sp */
-      p = syn_block->b_sst_firstfree;
-      syn_block->b_sst_firstfree = p->sst_next;
-      --syn_block->b_sst_freecount;
-      if (sp == NULL) {
-        /* Insert in front of the list */
-        p->sst_next = syn_block->b_sst_first;
-        syn_block->b_sst_first = p;
-      } else {
-        /* insert in list after *sp */
-        p->sst_next = sp->sst_next;
-        sp->sst_next = p;
-      }
-      sp = p;
-      sp->sst_stacksize = 0;
+    if (syn_stack_make_room()) {
+      idx = syn_stack_find_idx(current_lnum) + 1;
+      memmove(syn_block->b_sst_array + idx + 1, syn_block->b_sst_array + idx,
+          (size_t)(syn_block->b_sst_len - idx) * sizeof(synstate_T));
+      ++syn_block->b_sst_len;
+      sp = &syn_block->b_sst_array[idx];
       sp->sst_lnum = current_lnum;
+      sp->sst_stack = NULL;
     }
+  } else {
+    sp = &syn_block->b_sst_array[idx];
   }
   if (sp != NULL) {
-    /* When overwriting an existing state stack, clear it first */
-    clear_syn_state(sp);
-    sp->sst_stacksize = current_state.ga_len;
-    if (current_state.ga_len > SST_FIX_STATES) {
-      /* Need to clear it, might be something remaining from when the
-       * length was less than SST_FIX_STATES. */
-      ga_init(&sp->sst_union.sst_ga, (int)sizeof(bufstate_T), 1);
-      ga_grow(&sp->sst_union.sst_ga, current_state.ga_len);
-      sp->sst_union.sst_ga.ga_len = current_state.ga_len;
-      bp = SYN_STATE_P(&(sp->sst_union.sst_ga));
-    } else
-      bp = sp->sst_union.sst_stack;
-    for (i = 0; i < sp->sst_stacksize; ++i) {
-      bp[i].bs_idx = CUR_STATE(i).si_idx;
-      bp[i].bs_flags = CUR_STATE(i).si_flags;
-      bp[i].bs_seqnr = CUR_STATE(i).si_seqnr;
-      bp[i].bs_cchar = CUR_STATE(i).si_cchar;
-      bp[i].bs_extmatch = ref_extmatch(CUR_STATE(i).si_extmatch);
-    }
-    sp->sst_next_flags = current_next_flags;
-    sp->sst_next_list = current_next_list;
+    synstack_T *ss = syn_stack_intern(syn_block);
+
+    /* When overwriting an existing state stack, drop it after taking the
+     * new reference, they may be the same. */
+    clear_syn_state(syn_block, sp);
+    sp->sst_stack = ss;
     sp->sst_tick = display_tick;
     sp->sst_change_lnum = 0;
   }
@@ -1305,18 +1494,15 @@ static synstate_T *store_current_state(void)
 static void load_current_state(synstate_T *from)
 {
   int i;
-  bufstate_T  *bp;
+  synstack_T  *ss = from->sst_stack;
+  bufstate_T  *bp = ss->ss_states;
 
   clear_current_state();
   validate_current_state();
   keepend_level = -1;
-  if (from->sst_stacksize) {
-    ga_grow(&current_state, from->sst_stacksize);
-    if (from->sst_stacksize > SST_FIX_STATES)
-      bp = SYN_STATE_P(&(from->sst_union.sst_ga));
-    else
-      bp = from->sst_union.sst_stack;
-    for (i = 0; i < from->sst_stacksize; ++i) {
+  if (ss->ss_size) {
+    ga_grow(&current_state, ss->ss_size);
+    for (i = 0; i < ss->ss_size; ++i) {
       CUR_STATE(i).si_idx = bp[i].bs_idx;
       CUR_STATE(i).si_flags = bp[i].bs_flags;
       CUR_STATE(i).si_seqnr = bp[i].bs_seqnr;
@@ -1333,10 +1519,10 @@ static void load_current_state(synstate_T *from)
         CUR_STATE(i).si_next_list = NULL;
       update_si_attr(i);
     }
-    current_state.ga_len = from->sst_stacksize;
+    current_state.ga_len = ss->ss_size;
   }
-  current_next_list = from->sst_next_list;
-  current_next_flags = from->sst_next_flags;
+  current_next_list = ss->ss_next_list;
+  current_next_flags = ss->ss_next_flags;
   current_lnum = from->sst_lnum;
 }
 
@@ -1346,20 +1532,16 @@ static void load_current_state(synstate_T *from)
  */
 static int syn_stack_equal(synstate_T *sp)
 {
-  bufstate_T  *bp;
+  bufstate_T  *bp = sp->sst_stack->ss_states;
   reg_extmatch_T      *six, *bsx;
 
   /* First a quick check if the stacks have the same size end nextlist. */
-  if (sp->sst_stacksize != current_state.ga_len
-      || sp->sst_next_list != current_next_list) {
+  if (sp->sst_stack->ss_size != current_state.ga_len
+      || sp->sst_stack->ss_next_list != current_next_list) {
     return FALSE;
   }
 
   /* Need to compare all states on both stacks. */
-  if (sp->sst_stacksize > SST_FIX_STATES)
-    bp = SYN_STATE_P(&(sp->sst_union.sst_ga));
-  else
-    bp = sp->sst_union.sst_stack;
 
   int i;
   for (i = current_state.ga_len; --i >= 0; ) {
@@ -1418,13 +1600,367 @@ static int syn_stack_equal(synstate_T *sp)
 void syntax_end_parsing(linenr_T lnum)
 {
   synstate_T  *sp;
+  int idx;
+
+  idx = syn_stack_find_idx(lnum);
+  if (idx < 0)
+    return;
+  if (syn_block->b_sst_array[idx].sst_lnum < lnum)
+    ++idx;
+
+  if (idx < syn_block->b_sst_len) {
+    sp = &syn_block->b_sst_array[idx];
+    if (sp->sst_change_lnum != 0)
+      sp->sst_change_lnum = lnum;
+  }
+}
+
+/*
+ * Saving the state stack cache in a file.
+ *
+ * When 'synstatedir' is set, states of a big buffer are written to a file in
+ * that directory when the buffer is unloaded, or when exiting.  The file is
+ * named after a hash of the text, thus it is found again for the same text,
+ * also when the file was renamed.  A hash of everything that influences the
+ * syntax parsing is stored in the file, it is only used when that matches.
+ * States that refer to things other than syntax patterns ("\z(" matches, a
+ * keyword "nextgroup") are not saved.
+ */
+#define SYN_STATE_MAGIC     "VimSynState\n"
+#define SYN_STATE_MAGIC_LEN 12
+#define SYN_STATE_VERSION   1
+#define SYN_STATE_MINLINES  1000    /* don't save for smaller buffers */
+#define SYN_STATE_DIST      25      /* distance between saved states */
+#define SYN_STATE_MAXSTACK  1000    /* sanity check for the stack size */
+
+/*
+ * Compute the hash for the text of "buf" into "hash[SHA256_SUM_SIZE]".
+ */
+static void syn_state_text_hash(buf_T *buf, char_u *hash)
+{
+  context_sha256_T ctx;
+
+  sha256_start(&ctx);
+  for (linenr_T lnum = 1; lnum <= buf->b_ml.ml_line_count; ++lnum) {
+    char_u *p = ml_get_buf(buf, lnum, FALSE);
+    sha256_update(&ctx, p, STRLEN(p) + 1);
+  }
+  sha256_finish(&ctx, hash);
+}
+
+static void syn_state_hash_num(context_sha256_T *ctx, long n)
+{
+  sha256_update(ctx, (char_u *)&n, sizeof(n));
+}
+
+static void syn_state_hash_str(context_sha256_T *ctx, char_u *str)
+{
+  if (str == NULL)
+    str = (char_u *)"";
+  sha256_update(ctx, str, STRLEN(str) + 1);
+}
+
+/*
+ * Add a list of group IDs to the hash.  Only the names of groups and clusters
+ * are used, their IDs may be different in another session.
+ */
+static void syn_state_hash_list(context_sha256_T *ctx, synblock_T *block,
+                                short *list)
+{
+  if (list == NULL) {
+    syn_state_hash_num(ctx, -1);
+    return;
+  }
+  for (; *list != 0; ++list) {
+    if (*list < SYNID_ALLBUT) {
+      syn_state_hash_str(ctx, syn_id2name(*list));
+    } else if (*list >= SYNID_CLUSTER) {
+      syn_state_hash_str(ctx, SYN_CLSTR(block)[*list - SYNID_CLUSTER].scl_name);
+    } else {
+      /* ALLBUT, TOP or CONTAINED with the include tag. */
+      syn_state_hash_num(ctx, *list);
+    }
+  }
+  syn_state_hash_num(ctx, 0);
+}
+
+/*
+ * Add the keywords of hashtable "ht" to the hash.
+ */
+static void syn_state_hash_keywords(context_sha256_T *ctx, synblock_T *block,
+                                    hashtab_T *ht)
+{
+  int todo = (int)ht->ht_used;
+
+  syn_state_hash_num(ctx, todo);
+  for (hashitem_T *hi = ht->ht_array; todo > 0; ++hi) {
+    if (HASHITEM_EMPTY(hi))
+      continue;
+    --todo;
+    for (keyentry_T *kp = HI2KE(hi); kp != NULL; kp = kp->ke_next) {
+      syn_state_hash_str(ctx, kp->keyword);
+      syn_state_hash_str(ctx, syn_id2name(kp->k_syn.id));
+      syn_state_hash_num(ctx, kp->k_syn.inc_tag);
+      syn_state_hash_list(ctx, block, kp->k_syn.cont_in_list);
+      syn_state_hash_list(ctx, block, kp->next_list);
+      syn_state_hash_num(ctx, kp->flags);
+      syn_state_hash_num(ctx, kp->k_char);
+    }
+  }
+}
+
+/*
+ * Compute the hash for the syntax items of "buf", and the options that
+ * change how they match, into "hash[SHA256_SUM_SIZE]".
+ */
+static void syn_state_syntax_hash(buf_T *buf, char_u *hash)
+{
+  synblock_T *block = &buf->b_s;
+  context_sha256_T ctx;
+
+  sha256_start(&ctx);
+  syn_state_hash_str(&ctx, p_enc);
+  syn_state_hash_str(&ctx, buf->b_p_isk);
+  syn_state_hash_num(&ctx, buf->b_p_smc);
+  syn_state_hash_num(&ctx, block->b_syn_containedin);
+  syn_state_hash_num(&ctx, block->b_syn_sync_flags);
+  syn_state_hash_str(&ctx, syn_id2name(block->b_syn_sync_id));
+  syn_state_hash_num(&ctx, block->b_syn_sync_minlines);
+  syn_state_hash_num(&ctx, block->b_syn_sync_maxlines);
+  syn_state_hash_num(&ctx, block->b_syn_sync_linebreaks);
+  syn_state_hash_str(&ctx, block->b_syn_linecont_pat);
+  syn_state_hash_num(&ctx, block->b_syn_linecont_ic);
+  for (int idx = 0; idx < block->b_syn_patterns.ga_len; ++idx) {
+    synpat_T *spp = &SYN_ITEMS(block)[idx];
+
+    syn_state_hash_num(&ctx, spp->sp_type);
+    syn_state_hash_num(&ctx, spp->sp_syncing);
+    syn_state_hash_num(&ctx, spp->sp_flags);
+    syn_state_hash_num(&ctx, spp->sp_cchar);
+    syn_state_hash_num(&ctx, spp->sp_syn.inc_tag);
+    syn_state_hash_str(&ctx, syn_id2name(spp->sp_syn.id));
+    syn_state_hash_list(&ctx, block, spp->sp_syn.cont_in_list);
+    syn_state_hash_str(&ctx, syn_id2name(spp->sp_syn_match_id));
+    syn_state_hash_str(&ctx, spp->sp_pattern);
+    syn_state_hash_num(&ctx, spp->sp_ic);
+    syn_state_hash_num(&ctx, spp->sp_off_flags);
+    for (int i = 0; i < SPO_COUNT; ++i) {
+      syn_state_hash_num(&ctx, spp->sp_offsets[i]);
+    }
+    syn_state_hash_list(&ctx, block, spp->sp_cont_list);
+    syn_state_hash_list(&ctx, block, spp->sp_next_list);
+    syn_state_hash_num(&ctx, spp->sp_sync_idx);
+  }
+  for (int i = 0; i < block->b_syn_clusters.ga_len; ++i) {
+    syn_state_hash_str(&ctx, SYN_CLSTR(block)[i].scl_name);
+    syn_state_hash_list(&ctx, block, SYN_CLSTR(block)[i].scl_list);
+  }
+  syn_state_hash_keywords(&ctx, block, &block->b_keywtab);
+  syn_state_hash_keywords(&ctx, block, &block->b_keywtab_ic);
+  sha256_finish(&ctx, hash);
+}
+
+/*
+ * Get the allocated name of the file for the text with hash "text_hash".
+ * Returns NULL when 'synstatedir' is not a directory.
+ */
+static char_u *syn_state_file_name(char_u *text_hash)
+{
+  char_u name[SHA256_SUM_SIZE * 2 + 1];
+
+  if (!os_isdir(p_ssd))
+    return NULL;
+  for (int i = 0; i < SHA256_SUM_SIZE; ++i) {
+    vim_snprintf((char *)name + i * 2, 3, "%02x", text_hash[i]);
+  }
+  return concat_fnames(p_ssd, name, TRUE);
+}
 
-  sp = syn_stack_find_entry(lnum);
-  if (sp != NULL && sp->sst_lnum < lnum)
-    sp = sp->sst_next;
+/*
+ * Return the index + 1 of the pattern whose "nextgroup" list is "list", zero
+ * when "list" is NULL and -1 when it isn't the list of any pattern.
+ */
+static int syn_state_next_list_idx(synblock_T *block, short *list)
+{
+  if (list == NULL)
+    return 0;
+  for (int idx = 0; idx < block->b_syn_patterns.ga_len; ++idx) {
+    if (SYN_ITEMS(block)[idx].sp_next_list == list)
+      return idx + 1;
+  }
+  return -1;
+}
+
+/*
+ * Save the valid states of "buf" in 'synstatedir', when it is big enough.
+ */
+void syn_state_save(buf_T *buf)
+{
+  synblock_T *block = &buf->b_s;
+  char_u text_hash[SHA256_SUM_SIZE];
+  char_u syntax_hash[SHA256_SUM_SIZE];
+  linenr_T last = 0;
+  int count = 0;
+  int *next_idx;
+  char_u *fname;
+  FILE *fd;
+
+  if (*p_ssd == NUL || buf->b_ml.ml_mfp == NULL
+      || buf->b_ml.ml_line_count < SYN_STATE_MINLINES
+      || block->b_sst_array == NULL || block->b_syn_error
+      || block->b_syn_patterns.ga_len == 0)
+    return;
+
+  /* Select the states to save and find their "nextgroup" lists. */
+  next_idx = xmalloc((size_t)MAX(block->b_sst_len, 1) * sizeof(int));
+  for (int i = 0; i < block->b_sst_len; ++i) {
+    synstate_T *sp = &block->b_sst_array[i];
+    synstack_T *ss = sp->sst_stack;
+
+    next_idx[i] = -1;
+    if (sp->sst_change_lnum != 0 || sp->sst_lnum < last + SYN_STATE_DIST)
+      continue;
+    int j;
+    for (j = 0; j < ss->ss_size; ++j) {
+      if (ss->ss_states[j].bs_extmatch != NULL)
+        break;
+    }
+    if (j < ss->ss_size)
+      continue;
+    next_idx[i] = syn_state_next_list_idx(block, ss->ss_next_list);
+    if (next_idx[i] >= 0) {
+      last = sp->sst_lnum;
+      ++count;
+    }
+  }
 
-  if (sp != NULL && sp->sst_change_lnum != 0)
-    sp->sst_change_lnum = lnum;
+  if (count > 0) {
+    syn_state_text_hash(buf, text_hash);
+    fname = syn_state_file_name(text_hash);
+    if (fname != NULL && (fd = mch_fopen((char *)fname, WRITEBIN)) != NULL) {
+      syn_state_syntax_hash(buf, syntax_hash);
+      fwrite(SYN_STATE_MAGIC, SYN_STATE_MAGIC_LEN, 1, fd);
+      put_bytes(fd, SYN_STATE_VERSION, 2);
+      fwrite(syntax_hash, SHA256_SUM_SIZE, 1, fd);
+      put_bytes(fd, (uintmax_t)buf->b_ml.ml_line_count, 4);
+      put_bytes(fd, (uintmax_t)count, 4);
+      for (int i = 0; i < block->b_sst_len; ++i) {
+        if (next_idx[i] < 0)
+          continue;
+        synstack_T *ss = block->b_sst_array[i].sst_stack;
+
+        put_bytes(fd, (uintmax_t)block->b_sst_array[i].sst_lnum, 4);
+        put_bytes(fd, (uintmax_t)next_idx[i], 4);
+        put_bytes(fd, (uintmax_t)(unsigned)ss->ss_next_flags, 4);
+        put_bytes(fd, (uintmax_t)ss->ss_size, 2);
+        for (int j = 0; j < ss->ss_size; ++j) {
+          put_bytes(fd, (uintmax_t)ss->ss_states[j].bs_idx, 4);
+          put_bytes(fd, (uintmax_t)(unsigned)ss->ss_states[j].bs_flags, 4);
+          put_bytes(fd, (uintmax_t)ss->ss_states[j].bs_seqnr, 4);
+          put_bytes(fd, (uintmax_t)ss->ss_states[j].bs_cchar, 4);
+        }
+      }
+      if (fclose(fd) != 0)
+        os_remove((char *)fname);
+    }
+    free(fname);
+  }
+  free(next_idx);
+}
+
+/*
+ * Read the states of "buf" saved in 'synstatedir', if there are any for the
+ * same text and the same syntax items.  Sets syn_block.
+ */
+static void syn_state_load(buf_T *buf)
+{
+  synblock_T *block = &buf->b_s;
+  char_u text_hash[SHA256_SUM_SIZE];
+  char_u syntax_hash[SHA256_SUM_SIZE];
+  char_u file_hash[SHA256_SUM_SIZE];
+  char_u magic[SYN_STATE_MAGIC_LEN];
+  char_u *fname;
+  FILE *fd;
+  int count;
+  linenr_T last = 1;
+
+  if (buf->b_ml.ml_line_count < SYN_STATE_MINLINES
+      || block->b_syn_patterns.ga_len == 0)
+    return;
+  syn_state_text_hash(buf, text_hash);
+  fname = syn_state_file_name(text_hash);
+  if (fname == NULL)
+    return;
+  fd = mch_fopen((char *)fname, READBIN);
+  free(fname);
+  if (fd == NULL)
+    return;
+
+  syn_state_syntax_hash(buf, syntax_hash);
+  if (fread(magic, SYN_STATE_MAGIC_LEN, 1, fd) != 1
+      || memcmp(magic, SYN_STATE_MAGIC, SYN_STATE_MAGIC_LEN) != 0
+      || get2c(fd) != SYN_STATE_VERSION
+      || fread(file_hash, SHA256_SUM_SIZE, 1, fd) != 1
+      || memcmp(file_hash, syntax_hash, SHA256_SUM_SIZE) != 0
+      || get4c(fd) != buf->b_ml.ml_line_count
+      || (count = get4c(fd)) <= 0 || count > SST_MAX_ENTRIES) {
+    fclose(fd);
+    return;
+  }
+
+  syn_block = block;
+  syn_buf = buf;
+  if (block->b_sst_size < count) {
+    block->b_sst_array = xrealloc(block->b_sst_array,
+        (size_t)count * sizeof(synstate_T));
+    block->b_sst_size = count;
+  }
+
+  /* Build each stack in current_state and share it like a parsed one. */
+  clear_current_state();
+  validate_current_state();
+  for (int i = 0; i < count; ++i) {
+    linenr_T lnum = get4c(fd);
+    int next = get4c(fd);
+    int next_flags = get4c(fd);
+    int size = get2c(fd);
+
+    if (lnum <= last || lnum > buf->b_ml.ml_line_count
+        || next < 0 || next > block->b_syn_patterns.ga_len
+        || size < 0 || size > SYN_STATE_MAXSTACK)
+      break;
+    ga_grow(&current_state, size);
+    int j;
+    for (j = 0; j < size; ++j) {
+      stateitem_T *sip = &CUR_STATE(j);
+
+      sip->si_idx = get4c(fd);
+      sip->si_flags = get4c(fd);
+      sip->si_seqnr = get4c(fd);
+      sip->si_cchar = get4c(fd);
+      sip->si_extmatch = NULL;
+      if (sip->si_idx < 0 || sip->si_idx >= block->b_syn_patterns.ga_len
+          || sip->si_seqnr < 0)
+        break;
+      if (sip->si_seqnr >= next_seqnr)
+        next_seqnr = sip->si_seqnr + 1;
+    }
+    if (j < size || feof(fd))
+      break;
+    current_state.ga_len = size;
+    current_next_list = next == 0 ? NULL : SYN_ITEMS(block)[next - 1].sp_next_list;
+    current_next_flags = next_flags;
+
+    synstate_T *sp = &block->b_sst_array[block->b_sst_len++];
+    sp->sst_lnum = lnum;
+    sp->sst_change_lnum = 0;
+    sp->sst_tick = 0;
+    sp->sst_stack = syn_stack_intern(block);
+    last = lnum;
+    current_state.ga_len = 0;
+  }
+  invalidate_current_state();
+  fclose(fd);
 }
 
 /*
@@ -1463,7 +1999,9 @@ int syntax_check_changed(linenr_T lnum)
    * - lnum is at or before the last changed line.
    */
   if (VALID_STATE(&current_state) && lnum == current_lnum + 1) {
-    sp = syn_stack_find_entry(lnum);
+    int idx = syn_stack_find_idx(lnum);
+
+    sp = idx < 0 ? NULL : &syn_block->b_sst_array[idx];
     if (sp != NULL && sp->sst_lnum == lnum) {
       /*
        * finish the previous line (needed when not all of the line was
@@ -1794,6 +2332,13 @@ syn_current_attr (
               if (lc_col < 0)
                 lc_col = 0;
 
+              /* Matching is not needed when none of the literals that
+               * every match contains is in the rest of the line. */
+              if (syn_lits_reject(idx, (colnr_T)lc_col)) {
+                spp->sp_startcol = MAXCOL;
+                continue;
+              }
+
               regmatch.rmm_ic = spp->sp_ic;
               regmatch.regprog = spp->sp_prog;
               if (!syn_regexec(&regmatch,
@@ -2865,6 +3410,153 @@ static int syn_regexec(regmmatch_T *rmp, linenr_T lnum, colnr_T col, syn_time_T
   return FALSE;
 }
 
+/*
+ * Build the literals table for the patterns of "block".
+ */
+static synlits_T *syn_lits_build(synblock_T *block)
+{
+  synlits_T *sl = xcalloc(1, sizeof(synlits_T));
+  garray_T lits;
+  char_u *texts[NFA_MAX_LITERALS];
+  size_t lens[NFA_MAX_LITERALS];
+  int nitems = 0;
+
+  sl->sls_npat = block->b_syn_patterns.ga_len;
+  sl->sls_pats = xcalloc((size_t)MAX(sl->sls_npat, 1), sizeof(synlitpat_T));
+  sl->sls_line_id = -1;
+  ga_init(&lits, (int)sizeof(synlit_T), 32);
+  for (int idx = 0; idx < sl->sls_npat; idx++) {
+    synpat_T *spp = &SYN_ITEMS(block)[idx];
+    int ic;
+    int n;
+
+    if (spp->sp_type != SPTYPE_MATCH && spp->sp_type != SPTYPE_START)
+      continue;
+    n = vim_regliterals(spp->sp_prog, spp->sp_ic, &ic, texts, lens);
+    if (n == 0)
+      continue;
+    sl->sls_pats[idx].sp_known = TRUE;
+    sl->sls_pats[idx].sp_ic = ic;
+    for (int i = 0; i < n; i++) {
+      synlit_T *lit = GA_APPEND_VIA_PTR(synlit_T, &lits);
+
+      lit->sl_idx = idx;
+      lit->sl_ic = ic;
+      lit->sl_len = lens[i];
+      lit->sl_text = texts[i];
+      /* With ignore case the literal is found under both cases of its
+       * first byte.  Count the items for each byte first. */
+      int c = texts[i][0];
+      if (!ic)
+        sl->sls_start[c]++;
+      else {
+        sl->sls_start[TOLOWER_ASC(c)]++;
+        if (TOUPPER_ASC(c) != TOLOWER_ASC(c))
+          sl->sls_start[TOUPPER_ASC(c)]++;
+      }
+    }
+  }
+  sl->sls_lits = lits.ga_data;
+
+  /* Turn the counts into start indexes and fill sls_items[]. */
+  for (int c = 0; c < 256; c++) {
+    int count = sl->sls_start[c];
+
+    sl->sls_start[c] = nitems;
+    nitems += count;
+  }
+  sl->sls_start[256] = nitems;
+  sl->sls_items = xmalloc((size_t)MAX(nitems, 1) * sizeof(int));
+  int fill[256];
+  memmove(fill, sl->sls_start, sizeof(fill));
+  for (int i = 0; i < lits.ga_len; i++) {
+    synlit_T *lit = &sl->sls_lits[i];
+    int c = lit->sl_text[0];
+
+    if (lit->sl_ic) {
+      sl->sls_items[fill[TOLOWER_ASC(c)]++] = i;
+      if (TOUPPER_ASC(c) != TOLOWER_ASC(c))
+        sl->sls_items[fill[TOUPPER_ASC(c)]++] = i;
+    } else
+      sl->sls_items[fill[c]++] = i;
+  }
+  return sl;
+}
+
+/*
+ * Free the literals table of "block", it must be built again when the
+ * patterns changed.
+ */
+static void syn_lits_free(synblock_T *block)
+{
+  synlits_T *sl = block->b_syn_lits;
+
+  if (sl != NULL) {
+    free(sl->sls_pats);
+    free(sl->sls_lits);
+    free(sl->sls_items);
+    free(sl);
+    block->b_syn_lits = NULL;
+  }
+}
+
+/*
+ * Find the last column in "line" where a literal of each pattern starts,
+ * all patterns in one pass over the line.
+ */
+static void syn_lits_scan(synlits_T *sl, char_u *line)
+{
+  for (int idx = 0; idx < sl->sls_npat; idx++) {
+    sl->sls_pats[idx].sp_lastcol = -1;
+  }
+  sl->sls_nonascii = -1;
+  for (char_u *p = line; *p != NUL; p++) {
+    colnr_T col = (colnr_T)(p - line);
+
+    if (*p >= 0x80)
+      sl->sls_nonascii = col;
+    for (int i = sl->sls_start[*p]; i < sl->sls_start[*p + 1]; i++) {
+      synlit_T *lit = &sl->sls_lits[sl->sls_items[i]];
+      size_t n;
+
+      /* The line ends in a NUL, which is never in a literal. */
+      if (lit->sl_ic) {
+        for (n = 1; n < lit->sl_len
+             && TOLOWER_ASC(p[n]) == TOLOWER_ASC(lit->sl_text[n]); n++) {
+        }
+      } else {
+        for (n = 1; n < lit->sl_len && p[n] == lit->sl_text[n]; n++) {
+        }
+      }
+      if (n == lit->sl_len)
+        sl->sls_pats[lit->sl_idx].sp_lastcol = col;
+    }
+  }
+}
+
+/*
+ * Return TRUE when pattern "idx" can't match in the current line at or after
+ * column "col", because none of its literals appear there.
+ */
+static int syn_lits_reject(int idx, colnr_T col)
+{
+  synlits_T *sl = syn_block->b_syn_lits;
+
+  if (sl == NULL || sl->sls_npat != syn_block->b_syn_patterns.ga_len) {
+    syn_lits_free(syn_block);
+    sl = syn_block->b_syn_lits = syn_lits_build(syn_block);
+  }
+  if (!sl->sls_pats[idx].sp_known)
+    return FALSE;
+  if (sl->sls_line_id != current_line_id) {
+    syn_lits_scan(sl, syn_getcurline());
+    sl->sls_line_id = current_line_id;
+  }
+  /* Non-ASCII characters may fold to ASCII with ignore case. */
+  return sl->sls_pats[idx].sp_lastcol < col
+         && (!sl->sls_pats[idx].sp_ic || sl->sls_nonascii < col);
+}
+
 /*
  * Check one position in a line for a matching keyword.
  * The caller must check if a keyword can start at startcol.
@@ -2883,37 +3575,33 @@ check_keyword_id (
 {
   char_u      *kwp;
   int kwlen;
+  bool ascii;
   char_u keyword[MAXKEYWLEN + 1];        /* assume max. keyword len is 80 */
 
   /* Find first character after the keyword.  First character was already
    * checked. */
   kwp = line + startcol;
-  kwlen = 0;
-  do {
-    if (has_mbyte)
-      kwlen += (*mb_ptr2len)(kwp + kwlen);
-    else
-      ++kwlen;
-  } while (vim_iswordp_buf(kwp + kwlen, syn_buf));
+  kwlen = vim_keyword_len_buf(kwp, syn_buf, &ascii);
 
   if (kwlen > MAXKEYWLEN)
     return 0;
 
-  /*
-   * Must make a copy of the keyword, so we can add a NUL and make it
-   * lowercase.
-   */
-  STRLCPY(keyword, kwp, kwlen + 1);
-
   keyentry_T *kp = NULL;
 
-  // matching case
-  if (syn_block->b_keywtab.ht_used != 0) {
+  // matching case; skip the lookup when no keyword starts with the same
+  // byte and has the same length
+  if (syn_block->b_keywtab.ht_used != 0
+      && (syn_block->b_keywmask[*kwp] & KEYW_LENBIT(kwlen))) {
+    // Must make a copy of the keyword, so we can add a NUL.
+    STRLCPY(keyword, kwp, kwlen + 1);
     kp = match_keyword(keyword, &syn_block->b_keywtab, cur_si);
   }
 
-  // ignoring case
-  if (kp == NULL && syn_block->b_keywtab_ic.ht_used != 0) {
+  // ignoring case; folding ASCII keeps the length only for UTF-8
+  if (kp == NULL && syn_block->b_keywtab_ic.ht_used != 0
+      && (!ascii || !enc_utf8
+          || (syn_block->b_keywmask_ic[TOLOWER_ASC(*kwp)]
+              & KEYW_LENBIT(kwlen)))) {
     str_foldcase(kwp, kwlen, keyword, MAXKEYWLEN + 1);
     kp = match_keyword(keyword, &syn_block->b_keywtab_ic, cur_si);
   }
@@ -3030,6 +3718,8 @@ void syntax_clear(synblock_T *block)
   /* free the keywords */
   clear_keywtab(&block->b_keywtab);
   clear_keywtab(&block->b_keywtab_ic);
+  memset(block->b_keywmask, 0, sizeof(block->b_keywmask));
+  memset(block->b_keywmask_ic, 0, sizeof(block->b_keywmask_ic));
 
   /* free the syntax patterns */
   for (int i = block->b_syn_patterns.ga_len; --i >= 0; ) {
@@ -3049,6 +3739,7 @@ void syntax_clear(synblock_T *block)
   block->b_syn_sync_minlines = 0;
   block->b_syn_sync_maxlines = 0;
   block->b_syn_sync_linebreaks = 0;
+  block->b_syn_sync_statelines = 0;
 
   vim_regfree(block->b_syn_linecont_prog);
   block->b_syn_linecont_prog = NULL;
@@ -3071,6 +3762,7 @@ void reset_synblock(win_T *wp)
 {
   if (wp->w_s != &wp->w_buffer->b_s) {
     syntax_clear(wp->w_s);
+    spell_cache_clear(wp->w_s);
     free(wp->w_s);
     wp->w_s = &wp->w_buffer->b_s;
   }
@@ -3092,6 +3784,7 @@ static void syntax_sync_clear(void)
   curwin->w_s->b_syn_sync_minlines = 0;
   curwin->w_s->b_syn_sync_maxlines = 0;
   curwin->w_s->b_syn_sync_linebreaks = 0;
+  curwin->w_s->b_syn_sync_statelines = 0;
 
   vim_regfree(curwin->w_s->b_syn_linecont_prog);
   curwin->w_s->b_syn_linecont_prog = NULL;
@@ -3404,6 +4097,11 @@ static void syn_match_msg(void)
     msg_outnum(curwin->w_s->b_syn_sync_linebreaks);
     MSG_PUTS(_(" line breaks"));
   }
+  if (curwin->w_s->b_syn_sync_statelines > 1) {
+    MSG_PUTS(_("; state every "));
+    msg_outnum(curwin->w_s->b_syn_sync_statelines);
+    MSG_PUTS(_(" lines"));
+  }
 }
 
 static int last_matchgroup;
@@ -3831,6 +4529,17 @@ static void add_keyword(char_u *name,
   hash_T hash = hash_hash(kp->keyword);
   hashtab_T *ht = (curwin->w_s->b_syn_ic) ? &curwin->w_s->b_keywtab_ic
                                           : &curwin->w_s->b_keywtab;
+
+  // Remember the first byte and the length for check_keyword_id().  Removing
+  // keywords leaves the bits set, that only makes the check less useful.
+  int len = (int)STRLEN(kp->keyword);
+  if (len > 0) {
+    if (!curwin->w_s->b_syn_ic) {
+      curwin->w_s->b_keywmask[kp->keyword[0]] |= KEYW_LENBIT(len);
+    } else {
+      curwin->w_s->b_keywmask_ic[kp->keyword[0]] |= KEYW_LENBIT(len);
+    }
+  }
   hashitem_T *hi = hash_lookup(ht, kp->keyword, hash);
 
   // even though it looks like only the kp->keyword member is
@@ -4979,6 +5688,15 @@ static void syn_cmd_sync(exarg_T *eap, int syncing)
         else
           curwin->w_s->b_syn_sync_minlines = n;
       }
+    } else if (STRNCMP(key, "STATELINES", 10) == 0) {
+      arg_end = key + 11;
+      if (arg_end[-1] != '=' || !VIM_ISDIGIT(*arg_end)) {
+        illegal = TRUE;
+        break;
+      }
+      n = getdigits_long(&arg_end);
+      if (!eap->skip)
+        curwin->w_s->b_syn_sync_statelines = n;
     } else if (STRCMP(key, "FROMSTART") == 0)   {
       if (!eap->skip) {
         curwin->w_s->b_syn_sync_minlines = MAXLNUM;
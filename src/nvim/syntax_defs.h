@@ -5,14 +5,16 @@
 
 typedef int32_t RgbValue;
 
-# define SST_MIN_ENTRIES 150    /* minimal size for state stack array */
-# define SST_MAX_ENTRIES 1000   /* maximal size for state stack array */
-# define SST_FIX_STATES  7      /* size of sst_stack[]. */
-# define SST_DIST        16     /* normal distance between entries */
+# define SST_MIN_ENTRIES 150    /* initial size for state stack array */
+# define SST_MAX_ENTRIES 200000 /* maximal size for state stack array */
+# define SST_MIN_STACKS  64     /* initial size of the stack hash table */
 # define SST_INVALID    (synstate_T *)-1        /* invalid syn_state pointer */
 
 typedef unsigned short disptick_T;      /* display tick type */
 
+/* literals of the syntax patterns of a synblock_T, see syntax.c */
+typedef struct syn_lits synlits_T;
+
 /* struct passed to in_id_list() */
 struct sp_syn {
   int inc_tag;                  /* ":syn include" unique tag */
@@ -45,6 +47,24 @@ typedef struct buf_state {
   reg_extmatch_T *bs_extmatch;   /* external matches from start pattern */
 } bufstate_T;
 
+/*
+ * synstack_T is one state stack, shared by all lines that start with the
+ * same stack.  It is kept in the b_sst_stacks[] hash table, and freed when
+ * the last line using it is removed from b_sst_array[].
+ */
+typedef struct syn_stack synstack_T;
+
+struct syn_stack {
+  synstack_T  *ss_next;         /* next stack in the same hash bucket */
+  uint64_t ss_hash;             /* hash of the contents */
+  int ss_refcount;              /* number of b_sst_array[] entries using it */
+  int ss_next_flags;            /* flags for ss_next_list */
+  short       *ss_next_list;    /* "nextgroup" list in this state
+                                 * (this is a copy, don't free it! */
+  int ss_size;                  /* number of states on the stack */
+  bufstate_T ss_states[1];      /* actually longer */
+};
+
 /*
  * syn_state contains the syntax state stack for the start of one line.
  * Used by b_sst_array[].
@@ -52,19 +72,11 @@ typedef struct buf_state {
 typedef struct syn_state synstate_T;
 
 struct syn_state {
-  synstate_T  *sst_next;        /* next entry in used or free list */
   linenr_T sst_lnum;            /* line number for this state */
-  union {
-    bufstate_T sst_stack[SST_FIX_STATES];          /* short state stack */
-    garray_T sst_ga;            /* growarray for long state stack */
-  } sst_union;
-  int sst_next_flags;           /* flags for sst_next_list */
-  int sst_stacksize;            /* number of states on the stack */
-  short       *sst_next_list;   /* "nextgroup" list in this state
-                                 * (this is a copy, don't free it! */
-  disptick_T sst_tick;          /* tick when last displayed */
   linenr_T sst_change_lnum;     /* when non-zero, change in this line
                                  * may have made the state invalid */
+  synstack_T  *sst_stack;       /* the state stack, shared */
+  disptick_T sst_tick;          /* tick when last displayed */
 };
 
 // Structure shared between syntax.c, screen.c
@@ -6,8 +6,6 @@
 #include "nvim/os/input.h"
 #include "nvim/os/rstream.h"
 
-#define PASTETOGGLE_KEY "<f37>"
-
 struct term_input {
   int in_fd;
   bool paste_enabled;
@@ -163,11 +161,9 @@ static void timer_cb(uv_timer_t *handle)
 
 static bool handle_bracketed_paste(TermInput *input)
 {
-  char *ptr = rbuffer_read_ptr(input->read_buffer);
-  size_t len = rbuffer_pending(input->read_buffer);
-  if (len > 5 && (!strncmp(ptr, "\x1b[200~", 6)
-        || !strncmp(ptr, "\x1b[201~", 6))) {
-    bool enable = ptr[4] == '0';
+  if (!rbuffer_cmp(input->read_buffer, "\x1b[200~", 6)
+      || !rbuffer_cmp(input->read_buffer, "\x1b[201~", 6)) {
+    bool enable = rbuffer_get(input->read_buffer, 4) == '0';
     // Advance past the sequence
     rbuffer_consumed(input->read_buffer, 6);
     if (input->paste_enabled == enable) {
@@ -183,24 +179,49 @@ static bool handle_bracketed_paste(TermInput *input)
         // Remove the selected text and enter insert mode
         input_enqueue(cstr_as_string("c"));
       } else if (!(state & INSERT)) {
-        // Don't mess with the paste option
+        // Let the text be processed as typed keys
         return true;
       }
+      input_paste_start();
     }
-    input_enqueue(cstr_as_string(PASTETOGGLE_KEY));
     input->paste_enabled = enable;
     return true;
   }
   return false;
 }
 
+// While a paste is active, forward everything up to the end sequence as raw
+// text that is inserted without going through termkey or the typeahead buffer.
+// Returns false if more data is needed.
+static bool handle_paste_text(TermInput *input)
+{
+  size_t len;
+  char *ptr = rbuffer_read_ptr(input->read_buffer, &len);
+  size_t i = 0;
+  if (ptr[0] == ESC) {
+    size_t pending = rbuffer_pending(input->read_buffer);
+    if (pending < 6
+        && !rbuffer_cmp(input->read_buffer, "\x1b[201~", pending)) {
+      // Possibly an incomplete end sequence, wait for more data
+      return false;
+    }
+    i = 1;
+  }
+  while (i < len && ptr[i] != ESC) {
+    i++;
+  }
+  input_paste((String){.data = ptr, .size = i});
+  rbuffer_consumed(input->read_buffer, i);
+  return true;
+}
+
 static bool handle_forced_escape(TermInput *input)
 {
-  char *ptr = rbuffer_read_ptr(input->read_buffer);
-  size_t len = rbuffer_pending(input->read_buffer);
-  if (len > 1 && ptr[0] == ESC && ptr[1] == NUL) {
+  if (rbuffer_pending(input->read_buffer) > 1
+      && rbuffer_get(input->read_buffer, 0) == ESC
+      && rbuffer_get(input->read_buffer, 1) == NUL) {
     // skip the ESC and NUL and push one <esc> to the input buffer
-    termkey_push_bytes(input->tk, ptr, 1);
+    termkey_push_bytes(input->tk, &(char){ESC}, 1);
     rbuffer_consumed(input->read_buffer, 2);
     tk_getkeys(input, true);
     return true;
@@ -218,11 +239,23 @@ static void read_cb(RStream *rstream, void *rstream_data, bool eof)
   TermInput *input = rstream_data;
 
   do {
-    if (handle_bracketed_paste(input) || handle_forced_escape(input)) {
+    if (handle_bracketed_paste(input)) {
+      continue;
+    }
+    if (input->paste_enabled) {
+      if (handle_paste_text(input)) {
+        continue;
+      }
+      // Wait for the rest of the end sequence
+      break;
+    }
+    if (handle_forced_escape(input)) {
       continue;
     }
-    char *ptr = rbuffer_read_ptr(input->read_buffer);
-    size_t len = rbuffer_pending(input->read_buffer);
+    // Only the first contiguous region of the ring buffer is processed per
+    // iteration, the rest is handled by the next ones
+    size_t len;
+    char *ptr = rbuffer_read_ptr(input->read_buffer, &len);
     // Find the next 'esc' and push everything up to it(excluding)
     size_t i;
     for (i = ptr[0] == ESC ? 1 : 0; i < len; i++) {
@@ -269,11 +302,6 @@ static TermInput *term_input_new(void)
   // initialize a timer handle for handling ESC with libtermkey
   uv_timer_init(uv_default_loop(), &rv->timer_handle);
   rv->timer_handle.data = rv;
-  // Set the pastetoggle option to a special key that will be sent when
-  // \e[20{0,1}~/ are received
-  Error err = ERROR_INIT;
-  vim_set_option(cstr_as_string("pastetoggle"),
-      STRING_OBJ(cstr_as_string(PASTETOGGLE_KEY)), &err);
   return rv;
 }
 
@@ -18,6 +18,7 @@
 #include "nvim/misc2.h"
 #include "nvim/mbyte.h"
 #include "nvim/garray.h"
+#include "nvim/inputtrace.h"
 #include "nvim/memory.h"
 #include "nvim/move.h"
 #include "nvim/normal.h"
@@ -332,6 +333,7 @@ int ui_current_col(void)
 void ui_flush(void)
 {
   UI_CALL(flush);
+  INPUTTRACE(kTraceFlush, 0);
 }
 
 static void send_output(uint8_t **ptr)
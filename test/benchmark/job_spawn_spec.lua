@@ -0,0 +1,24 @@
+-- Measures the time spent creating short-lived child processes through the
+-- job control layer(job_start/job_wait), which is what plugins hit when
+-- running linters or formatters.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval = helpers.clear, helpers.execute, helpers.eval
+
+local N = tonumber(os.getenv('BENCH_JOB_COUNT') or 10000)
+
+describe('job spawn benchmark', function()
+  before_each(function()
+    clear()
+    -- `true` ignores the '-c cmd' arguments, so each system() call spawns
+    -- exactly one process without going through a real shell.
+    execute('set shell=true shellcmdflag=-c')
+  end)
+
+  it('launches '..N..' `true` processes', function()
+    execute('let g:start = reltime()')
+    execute('for i in range('..N..') | call system("true") | endfor')
+    local elapsed = tonumber(eval('reltimestr(reltime(g:start))'))
+    print(string.format('\n%d processes in %.3fs, %.1fus per spawn', N,
+                        elapsed, elapsed * 1e6 / N))
+  end)
+end)
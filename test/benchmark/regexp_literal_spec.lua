@@ -0,0 +1,43 @@
+-- Measures searching for a plain text pattern in a large buffer with the
+-- literal engine against the NFA engine.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval = helpers.clear, helpers.execute, helpers.eval
+
+local LINES = tonumber(os.getenv('BENCH_REGEXP_LINES') or 200000)
+local ITERATIONS = 5
+
+local function best_time(cmd)
+  local best
+  for _ = 1, ITERATIONS do
+    execute('let g:start = reltime()')
+    execute(cmd)
+    local elapsed = tonumber(eval('reltimestr(reltime(g:start))'))
+    best = best and math.min(best, elapsed) or elapsed
+  end
+  return best
+end
+
+local function bench(name, line)
+  it(name, function()
+    execute(('call setline(1, repeat([%q], %d))'):format(line, LINES))
+    execute(('call setline(%d, %q)'):format(LINES, line..' needle'))
+    for _, engine in ipairs({'0', '2'}) do
+      local pat = '\\%#='..engine..'needle'
+      local search = best_time(
+        ('call cursor(1, 1) | call search(%q, "W")'):format(pat))
+      local count = best_time(('silent %%s/%s//gn'):format(pat))
+      print(string.format('\n%s engine %s: search %.3fs, :s count %.3fs',
+                          name, engine, search, count))
+    end
+  end)
+end
+
+describe('literal search benchmark', function()
+  before_each(function()
+    clear()
+    execute('set encoding=utf-8')
+  end)
+
+  bench('ASCII', string.rep('the quick brown fox jumps over ', 3))
+  bench('UTF-8', string.rep('ünïcödé tëxt wïth äccents ', 3))
+end)
@@ -0,0 +1,43 @@
+-- Measures multi-line matches in a large buffer, which take their lines from
+-- the locked memline block while they stay in it.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval = helpers.clear, helpers.execute, helpers.eval
+
+local LINES = tonumber(os.getenv('BENCH_REGEXP_LINES') or 200000)
+local ITERATIONS = 5
+
+local function best_time(cmd)
+  local best
+  for _ = 1, ITERATIONS do
+    execute('let g:start = reltime()')
+    execute(cmd)
+    local elapsed = tonumber(eval('reltimestr(reltime(g:start))'))
+    best = best and math.min(best, elapsed) or elapsed
+  end
+  return best
+end
+
+local function bench(name, pattern)
+  it(name, function()
+    for _, engine in ipairs({'1', '2'}) do
+      local pat = '\\%#='..engine..pattern
+      local search = best_time(
+        ('call cursor(1, 1) | call search(%q, "W")'):format(pat))
+      local count = best_time(('silent %%s/%s//gn'):format(pat))
+      print(string.format('\n%s engine %s: search %.3fs, :s count %.3fs',
+                          name, engine, search, count))
+    end
+  end)
+end
+
+describe('multi-line regexp benchmark', function()
+  before_each(function()
+    clear()
+    execute(('call setline(1, map(range(%d), "\'line \' . v:val"))')
+            :format(LINES))
+    execute(('call setline(%d, "needle")'):format(LINES))
+  end)
+
+  bench('two lines', 'line \\d\\+\\nneedle')
+  bench('ten lines', 'line \\d*0\\n\\_.\\{-}line \\d*9$')
+end)
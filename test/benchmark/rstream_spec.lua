@@ -0,0 +1,40 @@
+-- Measures how fast job output flows through RStream/RBuffer into the
+-- consumer. Run it on two revisions to compare buffer implementations.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval = helpers.clear, helpers.execute, helpers.eval
+
+local MB = tonumber(os.getenv('BENCH_RSTREAM_MB') or 256)
+local ITERATIONS = 5
+
+describe('rstream throughput benchmark', function()
+  local fname
+
+  before_each(function()
+    clear()
+    fname = os.tmpname()
+    local f = io.open(fname, 'w')
+    -- 1MB chunks of 80-column lines
+    local line = string.rep('x', 79)..'\n'
+    local chunk = string.rep(line, math.floor(1024 * 1024 / #line))
+    for _ = 1, MB do
+      f:write(chunk)
+    end
+    f:close()
+  end)
+
+  after_each(function()
+    os.remove(fname)
+  end)
+
+  it('reads '..MB..'MB of job output', function()
+    local best
+    for _ = 1, ITERATIONS do
+      execute('let g:start = reltime()')
+      execute('call system("cat '..fname..'")')
+      local elapsed = tonumber(eval('reltimestr(reltime(g:start))'))
+      best = best and math.min(best, elapsed) or elapsed
+    end
+    print(string.format('\nbest of %d: %.3fs, %.1fMB/s', ITERATIONS, best,
+                        MB / best))
+  end)
+end)
@@ -161,6 +161,62 @@ describe('vim_* functions', function()
     end)
   end)
 
+  describe('get_regexp_cache_stats', function()
+    it('counts hits for a pattern compiled repeatedly', function()
+      local before = nvim('get_regexp_cache_stats')
+      nvim('command', 'for i in range(10) | call match("abc", "b\\\\+c") | endfor')
+      local after = nvim('get_regexp_cache_stats')
+      eq(before.misses + 1, after.misses)
+      eq(before.hits + 9, after.hits)
+    end)
+  end)
+
+  describe('get_wstream_stats', function()
+    it('counts the buffers written for responses', function()
+      local before = nvim('get_wstream_stats')
+      local after = nvim('get_wstream_stats')
+      -- the response to the first request was written in between
+      ok(after.buffers > before.buffers)
+      ok(after.writes > before.writes)
+      ok(after.writes <= after.buffers)
+      eq(after.buffers - after.writes, after.saved)
+    end)
+  end)
+
+  describe('get_regexp_profile', function()
+    local function profile(pattern)
+      for _, rp in ipairs(nvim('get_regexp_profile')) do
+        if rp.pattern == pattern then
+          return rp
+        end
+      end
+    end
+
+    it('counts executions of a pattern', function()
+      nvim('command', 'regtime on')
+      nvim('command', 'call match("abc", "x\\\\d\\\\+")')
+      nvim('command', 'call match("x12", "x\\\\d\\\\+")')
+      nvim('command', 'regtime off')
+      nvim('command', 'call match("x12", "x\\\\d\\\\+")')
+      local rp = profile('x\\d\\+')
+      eq(2, rp.count)
+      eq(1, rp.match)
+      ok(rp.total >= rp.slowest)
+      nvim('command', 'regtime clear')
+      eq(0, profile('x\\d\\+').count)
+    end)
+
+    it('counts fallbacks from the literal matcher', function()
+      nvim('command', 'set ignorecase')
+      nvim('command', 'regtime on')
+      nvim('command', 'call match("abc", "bc")')
+      nvim('command', 'call match("\195\164bc", "bc")')
+      local rp = profile('bc')
+      eq(2, rp.count)
+      eq(1, rp.fallbacks)
+    end)
+  end)
+
   it('can throw exceptions', function()
     local status, err = pcall(nvim, 'get_option', 'invalid-option')
     eq(false, status)
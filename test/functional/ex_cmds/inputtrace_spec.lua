@@ -0,0 +1,42 @@
+local helpers = require('test.functional.helpers')
+local clear, execute, feed, eq, ok, nvim = helpers.clear, helpers.execute,
+  helpers.feed, helpers.eq, helpers.ok, helpers.nvim
+
+describe(':inputtrace', function()
+  before_each(clear)
+
+  it('dumps a Chrome trace of typed keys', function()
+    local fname = os.tmpname()
+    execute('inputtrace on')
+    feed('ifoo<esc>')
+    nvim('eval', '1')  -- wait for the keys to be processed
+    execute('inputtrace off')
+    execute('inputtrace dump '..fname)
+    local f = io.open(fname)
+    local trace = f:read('*a')
+    f:close()
+    os.remove(fname)
+    eq('{"traceEvents":[', trace:sub(1, 16))
+    ok(trace:find('"name":"input"') ~= nil)
+    ok(trace:find('"name":"vgetc"') ~= nil)
+    ok(trace:find('"name":"command","ph":"B"') ~= nil)
+    ok(trace:find('"name":"command","ph":"E"') ~= nil)
+  end)
+
+  it('reports the time spent executing commands', function()
+    execute('inputtrace on')
+    feed('ifoo<esc>:let x = 1<cr>')
+    nvim('eval', '1')  -- wait for the keys to be processed
+    execute('inputtrace off')
+    local report = nvim('command_output', 'inputtrace report')
+    ok(report:find('\ncommand  ') ~= nil)
+    ok(report:find('key to command') ~= nil)
+    ok(report:find('command to redraw') ~= nil)
+  end)
+
+  it('fails with an invalid argument', function()
+    local status, err = pcall(nvim, 'command', 'inputtrace foo')
+    eq(false, status)
+    ok(err:find('E475') ~= nil)
+  end)
+end)
@@ -0,0 +1,171 @@
+-- Specs for
+-- :mkspell and loading the spell files it writes
+
+local helpers = require('test.functional.helpers')
+local clear, command, eval, eq = helpers.clear, helpers.command, helpers.eval,
+  helpers.eq
+
+local function read_file(name)
+  local file = io.open(name, 'rb')
+  local data = file:read('*a')
+  file:close()
+  return data
+end
+
+local function write_file(name, data)
+  local file = io.open(name, 'wb')
+  file:write(data)
+  file:close()
+end
+
+local spl = 'Xspell/spell/xx.utf-8.spl'
+
+describe('spell file tree map', function()
+  before_each(function()
+    clear()
+    command('call mkdir("Xspell/spell", "p")')
+    write_file('Xspell/spell/xx.aff', 'SET UTF-8\n')
+    write_file('Xspell/spell/xx.dic', '5\nbar\nfoo\nfoobar\nhello\nworld\n')
+    command('silent mkspell! Xspell/spell/xx Xspell/spell/xx')
+    command('set rtp^=Xspell')
+  end)
+
+  after_each(function()
+    for _, name in ipairs({'xx.aff', 'xx.dic', 'xx.utf-8.spl'}) do
+      os.remove('Xspell/spell/' .. name)
+    end
+    os.remove('Xspell/spell')
+    os.remove('Xspell')
+  end)
+
+  -- Loads the spell file, returns whether its trees were mapped.
+  local function load()
+    command('set verbose=3')
+    command('redir => g:msgs')
+    command('set spelllang=xx spell')
+    command('redir END')
+    command('set verbose=0')
+    return eval('g:msgs'):find('Mapped the word trees', 1, true) ~= nil
+  end
+
+  local function check_words()
+    eq({'helo', 'bad'}, eval('spellbadword("helo")'))
+    eq({'', ''}, eval('spellbadword("hello foobar")'))
+    eq('world', eval('spellsuggest("wrld", 1)')[1])
+    eq('foobar', eval('spellsuggest("fobar", 1)')[1])
+  end
+
+  it('is used when loading the file', function()
+    eq(true, load())
+    check_words()
+  end)
+
+  it('is not used with a damaged footer', function()
+    local data = read_file(spl)
+    write_file(spl, data:sub(1, -2) .. 'X')
+    eq(false, load())
+    check_words()
+  end)
+
+  it('is not used when truncated', function()
+    local data = read_file(spl)
+    write_file(spl, data:sub(1, -11))
+    eq(false, load())
+    check_words()
+  end)
+
+  it('is not used with a child index out of range', function()
+    local data = read_file(spl)
+    -- <mapstart> is the second number of the 20 byte <mapfooter>, in the
+    -- byte order of the machine.
+    local b1, b2, b3, b4 = data:byte(#data - 15, #data - 12)
+    local mapstart = b1 + b2 * 0x100 + b3 * 0x10000 + b4 * 0x1000000
+    if mapstart >= #data then
+      mapstart = b4 + b3 * 0x100 + b2 * 0x10000 + b1 * 0x1000000
+    end
+    -- Overwrite idxs[1] of the first tree, the child of the first sibling
+    -- of the root.
+    local pos = mapstart + 4 + 4
+    write_file(spl, data:sub(1, pos) .. '\127\255\255\127'
+                    .. data:sub(pos + 5))
+    eq(false, load())
+    check_words()
+  end)
+end)
+
+describe(':mkspell with threads', function()
+  local aff = [[
+SET UTF-8
+CIRCUMFIX X
+
+PFX A Y 2
+PFX A 0 un [^u]
+PFX A 0 re .
+
+PFX B Y 1
+PFX B 0 ge/X [^g]
+
+SFX S Y 3
+SFX S y ies [^aeiou]y
+SFX S 0 s [aeiou]y
+SFX S 0 s [^sy]
+
+SFX T Y 2
+SFX T 0 t/X [^t]
+SFX T e en/X e
+]]
+
+  before_each(function()
+    clear()
+    -- Enough lines to keep several workers busy, with all combinations of
+    -- the affixes and words that do and don't match their conditions.
+    local syllables = {'ka', 'u', 'ty', 'me', 'gay', 'se', 'lo', 'try'}
+    local flags = {'', '/A', '/S', '/AS', '/BT', '/ABST', '/T', '/BS'}
+    local lines = {}
+    for i, s1 in ipairs(syllables) do
+      for j, s2 in ipairs(syllables) do
+        for k, s3 in ipairs(syllables) do
+          lines[#lines + 1] = s1 .. s2 .. s3 .. flags[(i + j + k) % 8 + 1]
+        end
+      end
+    end
+    write_file('Xthreads.aff', aff)
+    write_file('Xthreads.dic', #lines .. '\n' .. table.concat(lines, '\n')
+                               .. '\n')
+  end)
+
+  after_each(function()
+    for _, name in ipairs({'Xthreads.aff', 'Xthreads.dic', 'Xthreaded.spl',
+                           spl}) do
+      os.remove(name)
+    end
+    os.remove('Xspell/spell')
+    os.remove('Xspell')
+  end)
+
+  it('writes the same file as without threads', function()
+    command('call mkdir("Xspell/spell", "p")')
+    command('let $NVIM_SPELL_THREADS = "1"')
+    command('silent mkspell! ' .. spl .. ' Xthreads')
+    command('let $NVIM_SPELL_THREADS = "4"')
+    command('silent mkspell! Xthreaded.spl Xthreads')
+    local single = read_file(spl)
+    eq(true, #single > 0)
+    eq(true, single == read_file('Xthreaded.spl'))
+
+    -- The affixes were applied with their conditions.
+    command('set rtp^=Xspell spelllang=xx spell')
+    local function bad(word)
+      return eval('spellbadword("' .. word .. '")')[1] == word
+    end
+    for _, word in ipairs({'kakaka', 'unkakaka', 'rekakaka', 'kakakas',
+                           'reukaka', 'kakaties', 'kakagays',
+                           'gekakaut'}) do
+      eq(false, bad(word))
+    end
+    for _, word in ipairs({'unukaka', 'kakatys', 'kakagaies', 'gekakau',
+                           'kakaut'}) do
+      eq(true, bad(word))
+    end
+  end)
+end)
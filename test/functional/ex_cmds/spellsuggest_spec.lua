@@ -0,0 +1,117 @@
+-- Specs for
+-- 'spellsuggest' and finding suggestions in worker threads
+
+local helpers = require('test.functional.helpers')
+local clear, command, execute, eval, eq, ok = helpers.clear, helpers.command,
+  helpers.execute, helpers.eval, helpers.eq, helpers.ok
+
+local function write_file(name, lines)
+  local file = io.open(name, 'w')
+  file:write(table.concat(lines, '\n') .. '\n')
+  file:close()
+end
+
+describe("'spellsuggest'", function()
+  before_each(clear)
+
+  local function set_sps(value)
+    execute('set spellsuggest=best')
+    execute('let v:errmsg = ""')
+    execute('set spellsuggest=' .. value)
+    return eval('v:errmsg')
+  end
+
+  it('accepts a timeout', function()
+    for _, value in ipairs({'timeout:0', 'timeout:100', 'timeout:-1',
+                            'best,timeout:200,5', 'timeout:999999999'}) do
+      eq('', set_sps(value))
+      eq(value, eval('&spellsuggest'))
+    end
+  end)
+
+  it('rejects an invalid timeout', function()
+    for _, value in ipairs({'timeout:', 'timeout:x', 'timeout:5x',
+                            'timeout:-', 'timeout:--1', 'timeout:1000000000',
+                            'timeout:99999999999999999999'}) do
+      ok(set_sps(value):find('E474:', 1, true) ~= nil)
+      eq('best', eval('&spellsuggest'))
+    end
+  end)
+end)
+
+describe('spell suggestions', function()
+  before_each(function()
+    clear()
+    -- All words of three of these syllables.
+    local syllables = {'ka', 'ri', 'to', 'me', 'su', 'lo', 'na', 'pe'}
+    local words = {}
+    for _, s1 in ipairs(syllables) do
+      for _, s2 in ipairs(syllables) do
+        for _, s3 in ipairs(syllables) do
+          words[#words + 1] = s1 .. s2 .. s3
+        end
+      end
+    end
+    table.insert(words, 1, tostring(#words))
+    command('call mkdir("Xspell/spell", "p")')
+    write_file('Xspell/spell/xx.aff', {'SET UTF-8'})
+    write_file('Xspell/spell/xx.dic', words)
+    command('silent mkspell! Xspell/spell/xx Xspell/spell/xx')
+    command('set rtp^=Xspell spelllang=xx spell')
+  end)
+
+  after_each(function()
+    for _, name in ipairs({'xx.aff', 'xx.dic', 'xx.utf-8.spl'}) do
+      os.remove('Xspell/spell/' .. name)
+    end
+    os.remove('Xspell/spell')
+    os.remove('Xspell')
+  end)
+
+  local function suggest(threads, word)
+    command('let $NVIM_SPELL_THREADS = "' .. threads .. '"')
+    local list = eval('spellsuggest("' .. word .. '", 10)')
+    return {list[1], list[2], list[3], list[4], list[5]}
+  end
+
+  it('are the same with and without threads', function()
+    for _, word in ipairs({'karit', 'mesuol', 'lonpae', 'tomeetoo',
+                           'sukarilo', 'xnape'}) do
+      local single = suggest(1, word)
+      eq(5, #single)
+      eq(single, suggest(4, word))
+    end
+  end)
+
+  it('are the same with and without threads for z=', function()
+    execute('set spellsuggest=best,5')
+    helpers.insert('pekamu')
+    command('let $NVIM_SPELL_THREADS = "1"')
+    command('redir => g:single | exe "normal! z=\\<Esc>" | redir END')
+    command('let $NVIM_SPELL_THREADS = "4"')
+    command('redir => g:threaded | exe "normal! z=\\<Esc>" | redir END')
+    ok(eval('g:single'):find('pekame', 1, true) ~= nil)
+    eq(eval('g:single'), eval('g:threaded'))
+  end)
+
+  it('are the same with and without threads with compounding and prefixes',
+  function()
+    -- The workers use their own copies of the regexp programs for the
+    -- COMPOUNDRULE and the prefix conditions.
+    write_file('Xspell/spell/xx.aff', {'SET UTF-8', 'PFXPOSTPONE',
+                                       'COMPOUNDFLAG c', 'COMPOUNDMIN 2',
+                                       'PFX A Y 1', 'PFX A 0 un [^u]'})
+    write_file('Xspell/spell/xx.dic', {'5', 'kari/Ac', 'tome/Ac', 'sulo/c',
+                                       'nape/A', 'uka/A'})
+    command('silent mkspell! Xspell/spell/xx Xspell/spell/xx')
+    command('set spelllang=xx')
+    eq({'', ''}, eval('spellbadword("karitome unnape")'))
+    eq({'unuka', 'bad'}, eval('spellbadword("unuka")'))
+    for _, word in ipairs({'karitom', 'sulotme', 'unkar', 'unuka',
+                           'tomekarsulo'}) do
+      local single = suggest(1, word)
+      ok(single[1] ~= nil)
+      eq(single, suggest(4, word))
+    end
+  end)
+end)
@@ -0,0 +1,76 @@
+-- Specs for
+-- :vimgrep with the "p" flag
+
+local helpers = require('test.functional.helpers')
+local clear, execute, eval, eq = helpers.clear, helpers.execute, helpers.eval,
+  helpers.eq
+
+local files = {
+  Xvimgrep1 = 'nothing\nhere\n',
+  Xvimgrep2 = 'call foo()\nfoo bar\n',
+  Xvimgrep3 = 'FOO\n',
+  Xvimgrep4 = '',
+  Xvimgrep5 = 'x = foo(1)\n',
+  Xvimgrep6 = 'dos foo\r\nline 2\r\n',
+  Xvimgrep7 = '\233foo 42\n',  -- latin1
+}
+
+describe(':vimgrep', function()
+  before_each(function()
+    clear()
+    for name, text in pairs(files) do
+      local f = io.open(name, 'w')
+      f:write(text)
+      f:close()
+    end
+  end)
+
+  after_each(function()
+    for name in pairs(files) do
+      os.remove(name)
+    end
+  end)
+
+  local function grep(cmd)
+    execute(cmd..' Xvimgrep*')
+    return eval('map(getqflist(), "[bufname(v:val.bufnr), v:val.lnum, '
+      ..'v:val.col]")')
+  end
+
+  it('finds the same matches with the p flag', function()
+    for _, pattern in ipairs({'/foo/gj', '/foo(/j', '/^\\w\\+ bar/j',
+                              '/\\cfoo/gj'}) do
+      eq(grep('vimgrep '..pattern), grep('vimgrep '..pattern..'p'))
+    end
+  end)
+
+  it('finds the same matches without required text with the p flag',
+     function()
+    for _, pattern in ipairs({'/\\d/j', '/\\<\\k\\+\\>/gj', '/^$/j',
+                              '/o\\+$/gj', '/^.foo/j', '/\\s\\d\\+$/j'}) do
+      eq(grep('vimgrep '..pattern), grep('vimgrep '..pattern..'p'))
+    end
+    eq({{'Xvimgrep6', 1, 5}}, grep('vimgrep /foo$/jp'))
+    eq({{'Xvimgrep7', 1, 1}}, grep('vimgrep /^.foo/jp'))
+  end)
+
+  it("uses the global 'iskeyword' with the p flag", function()
+    execute('set iskeyword+=(')
+    eq(grep('vimgrep /\\<foo(\\>/j'), grep('vimgrep /\\<foo(\\>/jp'))
+    eq(1, #grep('vimgrep /\\<foo(\\>/jp'))
+  end)
+
+  it('respects ignorecase with the p flag', function()
+    execute('set ignorecase')
+    eq(grep('vimgrep /foo/gj'), grep('vimgrep /foo/gjp'))
+    eq({'Xvimgrep3', 1, 1}, grep('vimgrep /foo/gjp')[3])
+  end)
+
+  it('searches a changed buffer instead of the file', function()
+    execute('edit Xvimgrep1')
+    execute('call setline(1, "foo()")')
+    eq({{'Xvimgrep1', 1, 1}, {'Xvimgrep2', 1, 6}, {'Xvimgrep5', 1, 5}},
+      grep('vimgrep /foo(/jp'))
+    execute('edit! Xvimgrep1')
+  end)
+end)
@@ -0,0 +1,79 @@
+-- The lazy DFA only filters lines, so with automatic engine selection every
+-- pattern must match exactly like it does with the NFA engine.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval, eq = helpers.clear, helpers.execute, helpers.eval,
+  helpers.eq
+
+local lines = {
+  'foo bar baz',
+  '  indented line 42',
+  'FOOBAR',
+  '',
+  'tab\there',
+  'x1y2z3',
+  'ümlaut ärger',
+}
+
+local patterns = {
+  'foo', '^foo', 'baz$', '^$', '\\d\\+', '[a-c]\\+r', '[^a-z ]',
+  '\\<line\\>', 'f\\(oo\\|ee\\)', 'o\\{2}', '\\s\\S', '\\u\\l', 'x.y',
+  '\\cfoobar', '\\Cfoobar', '[[:digit:]]\\+$', '\\a\\+\\d', 'ä', '\\%[ab]r',
+  'nomatch', '^\\s*\\w\\+ \\w',
+}
+
+local function matches(engine, pattern)
+  local result = {}
+  for i, line in ipairs(lines) do
+    result[i] = eval(('[match(%q, %q), matchend(%q, %q)]'):format(line,
+      '\\%#='..engine..pattern, line, '\\%#='..engine..pattern))
+  end
+  return result
+end
+
+describe('lazy DFA', function()
+  before_each(function()
+    clear()
+    execute('set encoding=utf-8')
+  end)
+
+  it('matches like the NFA engine', function()
+    for _, pattern in ipairs(patterns) do
+      eq(matches(2, pattern), matches(0, pattern))
+    end
+  end)
+
+  it('matches like the NFA engine with ignorecase', function()
+    execute('set ignorecase')
+    for _, pattern in ipairs(patterns) do
+      eq(matches(2, pattern), matches(0, pattern))
+    end
+  end)
+
+  it('treats composing characters like the NFA engine', function()
+    -- "x" with U+0303 COMBINING TILDE after an ASCII and a non-ASCII
+    -- character, and "a" with two composing characters
+    local composing = {
+      'ax\204\131b', '\195\188x\204\131b', 'a\204\131\204\136b',
+    }
+    local pats = { 'a.b', 'x.b', 'a..b', '^.\\{3}$', '[a-z].b', 'x\\_.b' }
+    for _, line in ipairs(composing) do
+      for _, pattern in ipairs(pats) do
+        local function match(engine)
+          return eval(('match(%q, %q)'):format(line,
+            '\\%#='..engine..pattern))
+        end
+        eq(match(2), match(0))
+      end
+    end
+    -- "." matches the composing character after the "x" by itself
+    eq(1, eval(('match(%q, %q)'):format('ax\204\131b', '\\%#=0x.b')))
+  end)
+
+  it('finds matches in the buffer', function()
+    execute('call setline(1, ["abc", "def", "x42", "abc def"])')
+    execute('call cursor(1, 1)')
+    eq(3, eval('search("\\\\%#=0\\\\d\\\\+")'))
+    eq(4, eval('search("\\\\%#=0c d")'))
+    eq(0, eval('search("\\\\%#=0^d.*c", "n")'))
+  end)
+end)
@@ -0,0 +1,57 @@
+-- Plain text patterns are found without a state machine when the engine is
+-- selected automatically, they must match exactly like the NFA engine.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval, eq = helpers.clear, helpers.execute, helpers.eval,
+  helpers.eq
+
+local lines = {
+  'foo bar baz foobar',
+  'FOO Bar',
+  'barfoo',
+  'x_foo foo_x foo',
+  'ümlaut ärger Ärger',
+  'e\204\129foo e',
+  '',
+}
+
+local patterns = {
+  'foo', 'bar', 'r b', '\\<foo\\>', '\\<bar', 'foo\\>', 'ärger', 'Ärger',
+  '\\<ärger\\>', 'e', 'o b', '\\cfoo', '\\CFoo', 'nomatch',
+}
+
+local function matches(engine, pattern)
+  local result = {}
+  for i, line in ipairs(lines) do
+    result[i] = eval(('[match(%q, %q), matchend(%q, %q)]'):format(line,
+      '\\%#='..engine..pattern, line, '\\%#='..engine..pattern))
+  end
+  return result
+end
+
+describe('literal regexp engine', function()
+  before_each(function()
+    clear()
+    execute('set encoding=utf-8')
+  end)
+
+  it('matches like the NFA engine', function()
+    for _, pattern in ipairs(patterns) do
+      eq(matches(2, pattern), matches(0, pattern))
+    end
+  end)
+
+  it('matches like the NFA engine with ignorecase', function()
+    execute('set ignorecase')
+    for _, pattern in ipairs(patterns) do
+      eq(matches(2, pattern), matches(0, pattern))
+    end
+  end)
+
+  it('finds and substitutes words in the buffer', function()
+    execute('call setline(1, ["foobar", "a foo", "foo foo"])')
+    execute('call cursor(1, 1)')
+    eq(2, eval('search("\\\\<foo\\\\>")'))
+    execute('%s/\\<foo\\>/X/g')
+    eq({'foobar', 'a X', 'X X'}, eval('getline(1, "$")'))
+  end)
+end)
@@ -0,0 +1,37 @@
+-- Lines without the literals a pattern requires are skipped before running
+-- the NFA engine, that must never lose a match.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval, eq = helpers.clear, helpers.execute, helpers.eval,
+  helpers.eq
+
+describe('regexp required literals', function()
+  before_each(function()
+    clear()
+    execute('set encoding=utf-8')
+    execute('call setline(1, ["nothing here", "x12yz", "foobar", '
+      ..'"BAR baz", "call func()", "end"])')
+  end)
+
+  local function search(pattern)
+    execute('call cursor(1, 1)')
+    return eval('search("\\\\%#=2'..pattern..'", "W")')
+  end
+
+  it('finds literals after other items', function()
+    eq(2, search('x\\\\d\\\\+yz'))
+    eq(5, search('^\\\\s*call \\\\w\\\\+('))
+    eq(0, search('x\\\\d\\\\+zz'))
+  end)
+
+  it('finds any of several alternatives', function()
+    eq(3, search('\\\\(quux\\\\|foo\\\\)bar'))
+    eq(4, search('\\\\(BAR\\\\|QUUX\\\\) baz'))
+    eq(0, search('\\\\(quux\\\\|xyzzy\\\\)'))
+  end)
+
+  it('ignores case', function()
+    execute('set ignorecase')
+    eq(3, search('FOOBAR'))
+    eq(4, search('bar Baz'))
+  end)
+end)
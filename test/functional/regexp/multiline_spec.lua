@@ -0,0 +1,44 @@
+-- Multi-line matches take lines straight from the memline data blocks, they
+-- must still see every line, also across block boundaries and after changes.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval, eq = helpers.clear, helpers.execute, helpers.eval,
+  helpers.eq
+local feed = helpers.feed
+
+describe('multi-line regexp', function()
+  before_each(function()
+    clear()
+    -- Enough lines to fill many data blocks
+    execute('call setline(1, map(range(1, 3000), '
+      ..'"v:val % 100 ? \'line \' . v:val : \'start\'"))')
+    execute('call append(2999, "end")')
+  end)
+
+  it('matches across lines in different blocks', function()
+    for _, engine in ipairs({1, 2}) do
+      execute('call cursor(1, 1)')
+      eq(100, eval('search("\\\\%#='..engine..'start\\\\nline 101", "W")'))
+      execute('call cursor(1, 1)')
+      eq(2999, eval('search("\\\\%#='..engine..'line 2999\\\\nend", "W")'))
+      execute('call cursor(1, 1)')
+      eq(0, eval('search("\\\\%#='..engine..'start\\\\nline 102", "W")'))
+    end
+  end)
+
+  it('sees lines changed by a substitute', function()
+    execute('%s/^start\\n\\zsline/first/')
+    eq('first 101', eval('getline(101)'))
+    eq('first 2901', eval('getline(2901)'))
+    eq(29, eval('len(filter(getline(1, "$"), "v:val =~ \'^first\'"))'))
+    execute('%s/^\\(first \\d\\+\\)\\n\\(line\\)/\\1 \\2/')
+    eq('first 101 line 102', eval('getline(101)'))
+  end)
+
+  it('sees a line that is being changed in Insert mode', function()
+    for _, engine in ipairs({1, 2}) do
+      feed('ggAxyz<C-o>:let g:pos = searchpos('
+        ..[['\%#=]]..engine..[[1xyz\nline 2', 'bcnW')<cr><esc>u]])
+      eq({1, 6}, eval('g:pos'))
+    end
+  end)
+end)
@@ -0,0 +1,22 @@
+-- A regexp can be executed while another execution is in progress, the outer
+-- one must keep its submatches.
+local helpers = require('test.functional.helpers')
+local clear, execute, eval, eq = helpers.clear, helpers.execute, helpers.eval,
+  helpers.eq
+
+describe('nested regexp execution', function()
+  before_each(clear)
+
+  it('keeps submatches with \\= in :substitute', function()
+    execute('call setline(1, ["foo bar", "one two"])')
+    execute([[%s/\(\w\+\) \(\w\+\)/\=substitute(submatch(2), 'o', '0', 'g')]]
+      ..[[.'-'.matchstr(submatch(1), '.$').'-'.submatch(1)/]])
+    eq({'bar-o-foo', 'tw0-e-one'}, eval('getline(1, "$")'))
+  end)
+
+  it('keeps multi-line submatches with \\= in :substitute', function()
+    execute('call setline(1, ["abc", "def", "abc", "xyz"])')
+    execute([[%s/b\(c\n\)d/\=match('xbx', 'b').submatch(1).'D'/]])
+    eq({'a1c', 'Def', 'abc', 'xyz'}, eval('getline(1, "$")'))
+  end)
+end)
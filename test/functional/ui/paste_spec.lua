@@ -0,0 +1,110 @@
+local helpers = require('test.functional.helpers')
+local clear, execute, feed, nvim = helpers.clear, helpers.execute,
+  helpers.feed, helpers.nvim
+local eq, expect, wait = helpers.eq, helpers.expect, helpers.wait
+
+describe('bracketed paste', function()
+  before_each(clear)
+
+  local paste = function(text, continued)
+    nvim('paste', text, continued or false)
+  end
+
+  it('inserts the text at the cursor in Insert mode', function()
+    execute('inoremap x y')
+    execute('iabbrev foo bar')
+    feed('iab<left>')
+    paste('x foo ')
+    feed('<esc>')
+    expect('ax foo b')
+  end)
+
+  it('starts Insert mode in Normal mode', function()
+    paste('pasted')
+    feed('<esc>')
+    expect('pasted')
+  end)
+
+  it('overwrites text in Replace mode', function()
+    feed('iabcdef<esc>0lR')
+    paste('xy\nz')
+    feed('<esc>')
+    expect([[
+      axy
+      zef]])
+    feed('0lRxyz<esc>')
+    expect([[
+      axy
+      zxyz]])
+  end)
+
+  it('can be undone with BS in Replace mode', function()
+    feed('iabcdef<esc>0lR')
+    paste('xyz')
+    feed('<bs><bs><esc>')
+    expect('axcdef')
+  end)
+
+  it('ignores a pending operator, count or Visual selection', function()
+    feed('iabc<esc>0d')
+    paste('x')
+    feed('<esc>')
+    expect('xabc')
+    feed('03')
+    paste('y')
+    feed('<esc>.')
+    expect('yyxabc')
+    feed('0vl')
+    paste('z')
+    feed('<esc>')
+    expect('yzyxabc')
+    eq('n', nvim('eval', 'mode()'))
+  end)
+
+  it('splits lines at CR, NL and CRLF', function()
+    feed('ifirst last<esc>6|i')
+    paste('one\rtwo\nthree\r\nfour')
+    feed('<esc>')
+    expect([[
+      firstone
+      two
+      three
+      four last]])
+  end)
+
+  it('joins a CRLF split over two chunks', function()
+    feed('i')
+    paste('one\r')
+    paste('\ntwo', true)
+    feed('<esc>')
+    expect([[
+      one
+      two]])
+  end)
+
+  it('does not join a CR and a NL of different pastes', function()
+    feed('i')
+    paste('one\r')
+    paste('\ntwo')
+    feed('<esc>')
+    expect([[
+      one
+
+      two]])
+  end)
+
+  it('is undone as a single change', function()
+    feed('i')
+    paste('one\ntwo\nthree')
+    feed('<esc>u')
+    expect('')
+  end)
+
+  it('handles the lines after the first on the command line as typed', function()
+    feed(':')
+    paste('let g:a = "one"\r:let g:b = "two"\r')
+    wait()
+    eq('one', nvim('get_var', 'a'))
+    eq('two', nvim('get_var', 'b'))
+  end)
+end)
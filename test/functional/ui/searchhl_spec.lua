@@ -93,6 +93,71 @@ describe('search highlighting', function()
     ]])
   end)
 
+  it('updates matches kept for changed lines', function()
+    execute('set hlsearch')
+    insert([[
+      one text
+      two
+      three text
+    ]])
+    feed("gg/text<cr>")
+    screen:expect([[
+        one {1:^text}                              |
+        two                                   |
+        three {1:text}                            |
+                                              |
+      ~                                       |
+      ~                                       |
+      /text                                   |
+    ]])
+
+    -- lines below an inserted line move down
+    feed("Onew text<esc>")
+    screen:expect([[
+      new {1:tex^t}                                |
+        one {1:text}                              |
+        two                                   |
+        three {1:text}                            |
+                                              |
+      ~                                       |
+      /text                                   |
+    ]])
+
+    feed("3Gatext<esc>")
+    screen:expect([[
+      new {1:text}                                |
+        one {1:text}                              |
+        two{1:tex^t}                               |
+        three {1:text}                            |
+                                              |
+      ~                                       |
+      /text                                   |
+    ]])
+
+    feed("ggdd")
+    screen:expect([[
+        ^one {1:text}                              |
+        two{1:text}                               |
+        three {1:text}                            |
+                                              |
+      ~                                       |
+      ~                                       |
+      /text                                   |
+    ]])
+
+    execute("set ignorecase")
+    feed("/TWO<cr>")
+    screen:expect([[
+        one text                              |
+        {1:^two}text                               |
+        three text                            |
+                                              |
+      ~                                       |
+      ~                                       |
+      /TWO                                    |
+    ]])
+  end)
+
   it('works with incsearch', function()
     execute('set hlsearch')
     execute('set incsearch')
@@ -157,6 +222,58 @@ describe('search highlighting', function()
     ]])
   end)
 
+  it('finds extended patterns with incsearch', function()
+    execute('set incsearch')
+    insert([[
+      the first line
+      in a little file
+    ]])
+    feed("ggj/fi")
+    screen:expect([[
+        the first line                        |
+        in a little {2:fi}le                      |
+                                              |
+      ~                                       |
+      ~                                       |
+      ~                                       |
+      /fi^                                     |
+    ]])
+
+    -- continues at the previous match and wraps around
+    feed("r")
+    screen:expect([[
+        the {2:fir}st line                        |
+        in a little file                      |
+                                              |
+      ~                                       |
+      ~                                       |
+      ~                                       |
+      /fir^                                    |
+    ]])
+
+    feed("x")
+    screen:expect([[
+        the first line                        |
+        in a little file                      |
+                                              |
+      ~                                       |
+      ~                                       |
+      ~                                       |
+      /firx^                                   |
+    ]])
+
+    feed("<bs>")
+    screen:expect([[
+        the {2:fir}st line                        |
+        in a little file                      |
+                                              |
+      ~                                       |
+      ~                                       |
+      ~                                       |
+      /fir^                                    |
+    ]])
+  end)
+
   it('works with multiline regexps', function()
     execute('set hlsearch')
     feed('4oa  repeated line<esc>')
@@ -0,0 +1,99 @@
+-- The spell checking results of a line are kept for when it is drawn again.
+-- They must be dropped when the words or the options change.
+local helpers = require('test.functional.helpers')
+local Screen = require('test.functional.ui.screen')
+local clear, feed, insert = helpers.clear, helpers.feed, helpers.insert
+local command = helpers.command
+
+local function write_file(name, lines)
+  local file = io.open(name, 'w')
+  file:write(table.concat(lines, '\n') .. '\n')
+  file:close()
+end
+
+-- Makes the spell file for language "lang" in Xspell/spell.
+local function mkspell(lang, words)
+  local base = 'Xspell/spell/' .. lang
+  write_file(base .. '.aff', {'SET UTF-8'})
+  table.insert(words, 1, tostring(#words))
+  write_file(base .. '.dic', words)
+  command('silent mkspell! ' .. base .. ' ' .. base)
+end
+
+describe('spell checking', function()
+  local screen
+
+  before_each(function()
+    clear()
+    screen = Screen.new(50, 4)
+    screen:attach()
+    screen:set_default_attr_ids({
+      [1] = {foreground = Screen.colors.Red},
+      [2] = {foreground = Screen.colors.Magenta},
+    })
+    screen:set_default_attr_ignore({{bold=true, foreground=Screen.colors.Blue}})
+    command('hi SpellBad guifg=Red gui=NONE guisp=NONE')
+    command('hi SpellCap guifg=Magenta gui=NONE guisp=NONE')
+    command('call mkdir("Xspell/spell", "p")')
+    mkspell('xx', {'good', 'text', 'here'})
+    mkspell('yy', {'good', 'text', 'wrong'})
+    command('set rtp^=Xspell spellfile=Xspell/xx.utf-8.add')
+    command('set spellcapcheck= spelllang=xx spell')
+    insert('good wrong text. here')
+    screen:expect([[
+      good {1:wrong} text. her^e                             |
+      ~                                                 |
+      ~                                                 |
+                                                        |
+    ]])
+  end)
+
+  after_each(function()
+    screen:detach()
+    for _, name in ipairs({'xx.aff', 'xx.dic', 'xx.utf-8.spl',
+                           'yy.aff', 'yy.dic', 'yy.utf-8.spl'}) do
+      os.remove('Xspell/spell/' .. name)
+    end
+    os.remove('Xspell/spell')
+    os.remove('Xspell/xx.utf-8.add')
+    os.remove('Xspell/xx.utf-8.add.spl')
+    os.remove('Xspell')
+  end)
+
+  it('updates the line after zg and zw', function()
+    feed('0wzg')
+    screen:expect([[
+      good ^wrong text. here                             |
+      ~                                                 |
+      ~                                                 |
+      Word 'wrong' added to Xspell/xx.utf-8.add         |
+    ]])
+    feed('0zw')
+    screen:expect([[
+      {1:^good} wrong text. here                             |
+      ~                                                 |
+      ~                                                 |
+      Word 'good' added to Xspell/xx.utf-8.add          |
+    ]])
+  end)
+
+  it("updates the line after 'spelllang' changed", function()
+    command('set spelllang=yy')
+    screen:expect([[
+      good wrong text. {1:her^e}                             |
+      ~                                                 |
+      ~                                                 |
+                                                        |
+    ]])
+  end)
+
+  it("updates the line after 'spellcapcheck' changed", function()
+    command('set spellcapcheck&')
+    screen:expect([[
+      {2:good} {1:wrong} text. {2:her^e}                             |
+      ~                                                 |
+      ~                                                 |
+                                                        |
+    ]])
+  end)
+end)
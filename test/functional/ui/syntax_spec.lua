@@ -0,0 +1,187 @@
+-- Syntax is parsed ahead while waiting for a typed key.  Lines drawn without
+-- highlighting because parsing took too long are redrawn when it is done.
+local helpers = require('test.functional.helpers')
+local Screen = require('test.functional.ui.screen')
+local clear, feed, execute = helpers.clear, helpers.feed, helpers.execute
+local eq, eval, ok = helpers.eq, helpers.eval, helpers.ok
+
+describe('syntax highlighting', function()
+  local screen
+
+  before_each(function()
+    clear()
+    screen = Screen.new(40, 4)
+    screen:attach()
+    screen:set_default_attr_ids({
+      [1] = {foreground = Screen.colors.Red},
+    })
+  end)
+
+  it('highlights the end of a long region with sync fromstart', function()
+    execute([[call setline(1, ['/*'] + repeat(['x'], 200000) + ['*/', 'y'])]])
+    execute('hi Comment guifg=Red')
+    execute([[syn region Comment start=+/\*+ end=+\*/+]])
+    execute('syn sync fromstart')
+    feed('G')
+    screen:expect([[
+      {1:x}                                       |
+      {1:*/}                                      |
+      ^y                                       |
+                                              |
+    ]])
+  end)
+
+  it('keeps highlighting when going back with statelines', function()
+    execute([[call setline(1, repeat(['/*', 'x', '*/', 'y'], 5000))]])
+    execute('hi Comment guifg=Red')
+    execute([[syn region Comment start=+/\*+ end=+\*/+]])
+    execute('syn sync fromstart statelines=7')
+    feed('G')
+    feed('10002G')
+    screen:expect([[
+      {1:/*}                                      |
+      {1:^x}                                       |
+      {1:*/}                                      |
+                                              |
+    ]])
+    feed('10004Gzt')
+    screen:expect([[
+      ^y                                       |
+      {1:/*}                                      |
+      {1:x}                                       |
+                                              |
+    ]])
+  end)
+
+  it('finds keywords of any length and case', function()
+    local long = string.rep('k', 40)
+    execute('syn case match')
+    execute('syn keyword Type int ' .. long .. ' \195\169t\195\169')
+    execute('syn case ignore')
+    execute('syn keyword Statement Return')
+    execute("call setline(1, 'int intx RETURN " .. long ..
+            " \195\169t\195\169 Int " .. long .. "k')")
+    local function group(col)
+      return eval('synIDattr(synID(1, ' .. col .. ', 1), "name")')
+    end
+    eq('Type', group(1))
+    eq('', group(5))
+    eq('Statement', group(10))
+    eq('Type', group(17))
+    eq('Type', group(58))
+    eq('', group(64))
+    eq('', group(68))
+  end)
+
+  it('does not try patterns whose text is not in the line', function()
+    execute('syn match Type /foo\\d/')
+    execute('syn case ignore')
+    execute('syn match Statement /bar/')
+    execute('syntime on')
+    local function group(col)
+      return eval('synIDattr(synID(1, ' .. col .. ', 1), "name")')
+    end
+    execute("call setline(1, 'foo1 bar')")
+    eq('Type', group(1))
+    eq('Statement', group(6))
+    execute("call setline(1, 'xx BAR')")
+    execute('syntime clear')
+    eq('Statement', group(4))
+    execute('redir => g:report | syntime report | redir END')
+    local report = eval('g:report')
+    eq(nil, report:find('foo', 1, true))
+    eq(true, report:find('bar', 1, true) ~= nil)
+  end)
+
+  it('uses the states saved in synstatedir', function()
+    local dir = eval('tempname()')
+    local fname = dir .. '/text'
+    execute('call mkdir("' .. dir .. '/states", "p")')
+    execute('call writefile(["/*"] + repeat(["x"], 3000) + ["*/", "y"], "' ..
+            fname .. '")')
+    execute('set synstatedir=' .. dir .. '/states')
+    local function define()
+      execute('edit ' .. fname)
+      execute([[syn region Comment start=+/\*+ end=+\*/+]])
+      execute('syn sync fromstart')
+    end
+    define()
+    feed('G')
+    execute('enew')
+    eq(1, eval('len(glob("' .. dir .. '/states/*", 0, 1))'))
+
+    define()
+    execute('syntime on')
+    eq('Comment', eval('synIDattr(synID(3001, 1, 1), "name")'))
+    eq('', eval('synIDattr(synID(3003, 1, 1), "name")'))
+    execute('redir => g:report | syntime report | redir END')
+    local tries = 0
+    for count in eval('g:report'):gmatch('\n%s*[%d.]+%s+(%d+)') do
+      tries = tries + tonumber(count)
+    end
+    eq(true, tries > 0 and tries < 500)
+  end)
+end)
+
+describe('saved syntax states', function()
+  local fname, dir = 'Xsyntext', 'Xsynstates'
+
+  before_each(function()
+    clear()
+    execute('call mkdir("' .. dir .. '")')
+    execute('call writefile(["/*"] + repeat(["x"], 3000) + ["*/", "y"], "' ..
+            fname .. '")')
+    execute('set synstatedir=' .. dir)
+  end)
+
+  after_each(function()
+    for _, f in ipairs(eval('glob("' .. dir .. '/*", 0, 1)')) do
+      os.remove(f)
+    end
+    os.remove(dir)
+    os.remove(fname)
+  end)
+
+  local function define(keywords)
+    execute('edit ' .. fname)
+    execute([[syn region MyComment start=+/\*+ end=+\*/+]])
+    if keywords then
+      execute('syn keyword MyKeyword ' .. keywords)
+    end
+    execute('syn sync fromstart')
+  end
+
+  local function save(keywords)
+    define(keywords)
+    feed('G')
+    execute('enew')
+    eq(1, eval('len(glob("' .. dir .. '/*", 0, 1))'))
+  end
+
+  -- Number of pattern tries needed for the syntax at the end of the text.
+  local function tries()
+    execute('syntime on')
+    eq('MyComment', eval('synIDattr(synID(3001, 1, 1), "name")'))
+    execute('redir => g:report | syntime report | redir END')
+    local total = 0
+    for count in eval('g:report'):gmatch('\n%s*[%d.]+%s+(%d+)') do
+      total = total + tonumber(count)
+    end
+    return total
+  end
+
+  it('are used in another session with other group IDs', function()
+    save()
+    clear()
+    execute('set synstatedir=' .. dir)
+    execute('hi Shifted ctermfg=1')
+    define()
+    ok(tries() < 500)
+  end)
+
+  it('are not used after the keywords changed', function()
+    save('foo')
+    define('bar')
+    ok(tries() >= 500)
+  end)
+end)
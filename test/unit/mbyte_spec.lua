@@ -0,0 +1,117 @@
+local helpers = require("test.unit.helpers")
+
+local cimport = helpers.cimport
+local eq = helpers.eq
+local to_cstr = helpers.to_cstr
+
+local mbyte = cimport('./src/nvim/mbyte.h', './src/nvim/option_defs.h')
+
+describe('mbyte', function()
+  describe('utf_ascii_len', function()
+    local function ascii_len(str)
+      return tonumber(mbyte.utf_ascii_len(to_cstr(str), #str))
+    end
+
+    it('counts a string without multi-byte characters', function()
+      eq(0, ascii_len(''))
+      eq(5, ascii_len('hello'))
+      eq(26, ascii_len('abcdefghijklmnopqrstuvwxyz'))
+    end)
+
+    it('stops at the first byte >= 0x80', function()
+      eq(0, ascii_len('\xc3\xa4bc'))
+      eq(3, ascii_len('abc\xc3\xa4'))
+      eq(8, ascii_len('abcdefgh\xc3\xa4'))
+      eq(13, ascii_len('abcdefghijklm\xe2\x82\xac'))
+    end)
+
+    it('does not look beyond the length', function()
+      eq(4, tonumber(mbyte.utf_ascii_len(to_cstr('abcd\xc3\xa4'), 4)))
+    end)
+  end)
+
+  describe('utf_valid_len', function()
+    local function valid_len(str)
+      return tonumber(mbyte.utf_valid_len(to_cstr(str), #str))
+    end
+
+    it('accepts valid UTF-8', function()
+      eq(0, valid_len(''))
+      eq(10, valid_len('abcdefghij'))
+      eq(8, valid_len('a\xc3\xa4b\xe2\x82\xacc'))
+      eq(15, valid_len('abcdefgh\xf0\x9f\x98\x80xyz'))
+    end)
+
+    it('stops at a missing trail byte', function()
+      eq(3, valid_len('abc\xc3def'))
+      eq(12, valid_len('abcdefghijkl\xe2\x82'))
+    end)
+
+    it('stops at an illegal lead byte', function()
+      eq(1, valid_len('a\x80b'))
+      eq(2, valid_len('ab\xffcd'))
+    end)
+
+    it('stops at an overlong sequence', function()
+      eq(2, valid_len('ab\xc0\xafcd'))
+      eq(0, valid_len('\xe0\x80\xaf'))
+    end)
+  end)
+
+  describe('cells', function()
+    -- Keep the option values alive while p_ambw points to them.
+    local single = to_cstr('single')
+    local double = to_cstr('double')
+
+    before_each(function()
+      mbyte.p_ambw = single
+    end)
+
+    local function string2cells(str)
+      return tonumber(mbyte.utf_string2cells(to_cstr(str), #str))
+    end
+
+    -- What utf_string2cells() replaces: one character at a time.
+    local function char_cells(str)
+      local p = to_cstr(str)
+      local cells, i = 0, 0
+      while i < #str do
+        cells = cells + mbyte.utf_ptr2cells(p + i)
+        i = i + mbyte.utfc_ptr2len(p + i)
+      end
+      return cells
+    end
+
+    it('are counted for a string like for each character', function()
+      for _, str in ipairs({'', 'abc', 'abcdefghijklmnop',
+                            '\xe4\xb8\xad\xe6\x96\x87',
+                            'ab\xe4\xb8\xadcdefghij\xe6\x96\x87xy',
+                            '\xe2\x91\xa0x', 'abc\xe4\xb8',
+                            '\xcc\x81abc', 'a\x80b'}) do
+        eq(char_cells(str), string2cells(str))
+      end
+    end)
+
+    it('include composing characters after an ASCII base', function()
+      for _, str in ipairs({'e\xcc\x81', 'ae\xcc\x81b',
+                            'abcdefghe\xcc\x81xyz',
+                            'abcdefghijklmno\xcc\x81\xcc\x82',
+                            'a\xcc\x81\xe4\xb8\xadb\xcc\x82'}) do
+        eq(char_cells(str), string2cells(str))
+      end
+      eq(1, string2cells('e\xcc\x81'))
+      eq(4, string2cells('ae\xcc\x81\xcc\x82bc'))
+    end)
+
+    it("of an ambiguous character depend on 'ambiwidth'", function()
+      -- U+2460 CIRCLED DIGIT ONE
+      eq(1, mbyte.utf_char2cells(0x2460))
+      eq(2, string2cells('\xe2\x91\xa0x'))
+      mbyte.p_ambw = double
+      eq(2, mbyte.utf_char2cells(0x2460))
+      eq(3, string2cells('\xe2\x91\xa0x'))
+      mbyte.p_ambw = single
+      eq(1, mbyte.utf_char2cells(0x2460))
+    end)
+  end)
+end)
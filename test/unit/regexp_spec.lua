@@ -0,0 +1,63 @@
+local helpers = require('test.unit.helpers')
+
+local cimport = helpers.cimport
+local ffi = helpers.ffi
+local eq = helpers.eq
+local to_cstr = helpers.to_cstr
+
+local regexp = cimport('./src/nvim/regexp.h', './src/nvim/option_defs.h')
+
+-- Only in the library built for the unit tests.
+ffi.cdef([[
+int regexec_test_threads(char *pat, char **lines, int nlines,
+                         int nthreads, int rounds, int *cols);
+]])
+
+describe('vim_regexec() in threads', function()
+  local cpo = to_cstr('aABceFs')
+
+  setup(function()
+    -- vim_regcomp() can't work when 'cpoptions' is unset
+    regexp.p_cpo = cpo
+  end)
+
+  local NTHREADS = 4
+  local ROUNDS = 200
+
+  -- Matches "pat" against "lines" in NTHREADS threads, checks that every
+  -- thread found the "expected" columns in every round.
+  local function check(pat, lines, expected)
+    local keep = {}
+    local clines = ffi.new('char *[?]', #lines)
+    for i, line in ipairs(lines) do
+      keep[i] = to_cstr(line)
+      clines[i - 1] = keep[i]
+    end
+    local cols = ffi.new('int[?]', NTHREADS * #lines)
+    eq(0, regexp.regexec_test_threads(to_cstr(pat), clines, #lines, NTHREADS,
+                                      ROUNDS, cols))
+    for t = 0, NTHREADS - 1 do
+      local got = {}
+      for i = 1, #lines do
+        got[i] = cols[t * #lines + i - 1]
+      end
+      eq(expected, got)
+    end
+  end
+
+  for _, engine in ipairs({'1', '2'}) do
+    describe('with regexpengine=' .. engine, function()
+      it('finds the same matches in each thread', function()
+        check('\\%#=' .. engine .. 'ab*c*d',
+              {'abcd', 'xxabbbd', 'no match', 'a1b2c3d', 'abd ad'},
+              {0, 2, -1, -1, 0})
+      end)
+
+      it('handles back references in each thread', function()
+        check('\\%#=' .. engine .. '\\(\\d\\)x\\1',
+              {'1x1', '12x2', 'x3x4', '9x9y'},
+              {0, 1, -1, 0})
+      end)
+    end)
+  end
+end)